@@ -0,0 +1,32 @@
+#ifndef CFA_PATTERN_H
+#define CFA_PATTERN_H
+
+// Layout of the 2x2 tile of a Bayer color filter array (CFA), named by its
+// colors in reading order (e.g., gbrg: G B on even rows, R G on odd rows).
+// Sensors differ, and cropping an odd number of rows or columns also turns
+// one layout into another.
+enum class CfaPattern {
+  rggb,
+  bggr,
+  grbg,
+  gbrg
+};
+
+// Channel sampled by the pixel at column x, row y (x,y >= 0)
+//
+// Inputs:
+//   pattern  CFA layout
+//   x  column
+//   y  row
+// Returns 0 for red, 1 for green, 2 for blue
+constexpr int cfa_channel(const CfaPattern pattern, const int x, const int y)
+{
+  constexpr int tiles[4][4] = {
+    {0, 1, 1, 2},   // rggb
+    {2, 1, 1, 0},   // bggr
+    {1, 0, 2, 1},   // grbg
+    {1, 2, 0, 1}};  // gbrg
+  return tiles[static_cast<int>(pattern)][2 * (y % 2) + x % 2];
+}
+
+#endif
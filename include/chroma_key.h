@@ -0,0 +1,40 @@
+#ifndef CHROMA_KEY_H
+#define CHROMA_KEY_H
+
+#include <array>
+#include <vector>
+
+// Key out a backdrop color (e.g., a green screen): build an rgba layer
+// whose alpha grows with the distance of each pixel's chroma from the
+// key's. Chroma is (Cb,Cr) in BT.601 YCbCr on the 0-255 scale, so the key
+// ignores brightness, and shadows on the backdrop are keyed out too.
+//
+//   alpha = 0                                 if distance <= inner
+//           255*(distance-inner)/(outer-inner) if inner < distance < outer
+//           255                               if distance >= outer
+//
+// The layer can be composited directly, e.g., over(layer, background, ...)
+// as main.cpp stacks its layers.
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   key  backdrop color
+//   inner  chroma distance up to which pixels are fully transparent
+//     (e.g., 20)
+//   outer  chroma distance from which pixels are fully opaque, >= inner
+//     (e.g., 60)
+// Outputs:
+//   rgba  width*height*4 array of 4-channel rgba intensities (the rgb
+//     intensities unchanged, plus the matte as alpha)
+void chroma_key(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const std::array<unsigned char, 3> & key,
+  const double inner,
+  const double outer,
+  std::vector<unsigned char> & rgba);
+
+#endif
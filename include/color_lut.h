@@ -0,0 +1,71 @@
+#ifndef COLOR_LUT_H
+#define COLOR_LUT_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// A 3D color lookup table: an rgb->rgb function sampled on a regular
+// size*size*size grid, applied with tetrahedral interpolation
+struct ColorLut {
+  int size;                 // grid points per axis (e.g., 33 or 65)
+  float domain_min[3];      // input r, g, b [0,1] mapped to the first grid point...
+  float domain_max[3];      // ...and to the last one
+  std::vector<float> data;  // size^3 rgb outputs [0,1], the red index
+                            // varying fastest (as in .cube files)
+};
+
+// A pointwise color edit of a whole rgb image, e.g.,
+//   [](const std::vector<unsigned char> & rgb, int width, int height,
+//      std::vector<unsigned char> & edited) {
+//     hue_shift(rgb, width, height, 180.0, edited); }
+using ColorEdit = std::function<void(
+  const std::vector<unsigned char> &,
+  const int,
+  const int,
+  std::vector<unsigned char> &)>;
+
+// Bake a chain of pointwise edits into a 3D lookup table. The edits are run
+// once, on the integer colors surrounding the grid points, and each grid
+// point is the trilinear blend of its 8 neighbors (so grids whose points
+// fall between integer intensities, like 33 and 65, still reproduce the
+// identity and other linear edits exactly).
+//
+// Inputs:
+//   size  grid points per axis [2,256]
+//   chain  edits applied in order
+// Outputs:
+//   lut  3D lookup table of the composed edits
+void bake_color_lut(
+  const int size,
+  const std::vector<ColorEdit> & chain,
+  ColorLut & lut);
+
+// Read a 3D lookup table from an Adobe .cube file
+//
+// Inputs:
+//   filename  path to .cube file
+// Outputs:
+//   lut  3D lookup table
+// Returns true on success, false on failure (e.g., a 1D table)
+bool read_cube(
+  const std::string & filename,
+  ColorLut & lut);
+
+// Apply a 3D lookup table to every pixel of an rgb image
+//
+// Inputs:
+//   lut  3D lookup table
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+// Outputs:
+//   graded  width*height*3 array containing rgb image color intensities
+void apply_color_lut(
+  const ColorLut & lut,
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  std::vector<unsigned char> & graded);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef CURVE_H
+#define CURVE_H
+
+#include "intensity_lut.h"
+#include <array>
+#include <functional>
+#include <vector>
+
+// A pointwise tone curve: maps an intensity in [0,1] to an intensity
+// (clamped to [0,1] wherever curves are chained or baked)
+using Curve = std::function<double(double)>;
+
+// Inputs:
+//   offset  amount added to every intensity (e.g., 0.1 brightens)
+// Returns x -> x + offset
+Curve brightness_curve(const double offset);
+
+// Inputs:
+//   factor  slope around mid-gray (e.g., 1.2 adds contrast, 0.8 removes it)
+// Returns x -> (x - 0.5)*factor + 0.5
+Curve contrast_curve(const double factor);
+
+// Inputs:
+//   gamma  gamma > 1 brightens the mid-tones, gamma < 1 darkens them
+// Returns x -> x^(1/gamma)
+Curve gamma_curve(const double gamma);
+
+// Photoshop-style levels: [in_black,in_white] is stretched onto [0,1],
+// bent by gamma, then compressed onto [out_black,out_white]
+//
+// Inputs:
+//   in_black  input intensity mapped to out_black
+//   in_white  input intensity mapped to out_white (> in_black)
+//   gamma  mid-tone gamma as in gamma_curve
+//   out_black  output intensity of in_black and below
+//   out_white  output intensity of in_white and above
+// Returns the levels curve
+Curve levels_curve(
+  const double in_black,
+  const double in_white,
+  const double gamma,
+  const double out_black,
+  const double out_white);
+
+// Smooth curve through control points, like the curves tool of an image
+// editor. Between points it is a monotone cubic (Fritsch-Carlson), so it
+// never overshoots; beyond the first and last points it is flat.
+//
+// Inputs:
+//   points  at least 2 control points (x,y) in [0,1], with increasing x
+// Returns the interpolating curve
+Curve spline_curve(const std::vector<std::array<double, 2>> & points);
+
+// Chain curves into a single one, evaluated in double precision (so the
+// chain is rounded to 8 bits once, when baked, instead of after every edit)
+//
+// Inputs:
+//   curves  curves applied in order, each result clamped to [0,1]
+// Returns the composed curve
+Curve compose_curves(const std::vector<Curve> & curves);
+
+// Sample a curve at the 256 intensities
+//
+// Inputs:
+//   curve  tone curve
+// Returns the lookup table round(255*clamp(curve(i/255),0,1))
+IntensityLut bake_curve(const Curve & curve);
+
+// Apply a curve to each channel of an image in a single pass, e.g.,
+//   apply_curves(rgb, width, height, 3, {compose_curves({
+//     brightness_curve(0.05), contrast_curve(1.1), gamma_curve(1.2)})}, graded);
+//
+// Inputs:
+//   image  width*height*num_channels array containing image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   num_channels  number of channels [1,4]
+//   curves  one curve per channel, or a single curve for all channels
+// Outputs:
+//   output  width*height*num_channels array containing image color
+//     intensities (may be the same vector as image)
+void apply_curves(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels,
+  const std::vector<Curve> & curves,
+  std::vector<unsigned char> & output);
+
+#endif
@@ -1,10 +1,15 @@
 #ifndef DEMOSAIC_H
 #define DEMOSAIC_H
+#include "cfa_pattern.h"
 #include <vector>
 
 // Given a mosaiced image (interleaved GBRG colors in a single channel), created
 // a 3-channel rgb image.
 //
+// Each missing color is the sum of the neighbors of that color in the 3x3
+// block, each divided (rounding down) by how many of them lie inside the
+// image. Dark (0) neighbors count like any other.
+//
 // Inputs:
 //   bayer  width*height array containing interleaved color intensities in
 //     the GBRG bayer pattern.
@@ -17,4 +22,62 @@ void demosaic(
   const int & width,
   const int & height,
   std::vector<unsigned char> & rgb);
+
+// Same as demosaic, for a mosaic in any Bayer pattern. Each pattern has its
+// own compiled kernel, picked here at run time.
+//
+// Inputs:
+//   bayer  width*height array containing interleaved color intensities in
+//     the given bayer pattern.
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   pattern  layout of the sensor's color filter array
+// Outputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+void demosaic(
+  const std::vector<unsigned char> & bayer,
+  const int & width,
+  const int & height,
+  const CfaPattern pattern,
+  std::vector<unsigned char> & rgb);
+
+// Same as demosaic (each missing color is the average of the neighboring
+// samples of that color), but averages in linear light instead of on the
+// sRGB-encoded intensities. Conversions are table lookups (see srgb.h).
+// Neighbors outside the image are left out of the average.
+//
+// Inputs:
+//   bayer  width*height array containing interleaved color intensities in
+//     the GBRG bayer pattern.
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+// Outputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+void demosaic_linear(
+  const std::vector<unsigned char> & bayer,
+  const int & width,
+  const int & height,
+  std::vector<unsigned char> & rgb);
+
+// Higher quality alternative to demosaic: Malvar-He-Cutler gradient-corrected
+// linear interpolation. Each missing color is the bilinear estimate
+// corrected by the Laplacian of the sampled color, through fixed 5x5
+// integer kernels, which removes most of the zipper and color fringing
+// along edges. Near the border the image is mirrored about its edges.
+// Images smaller than 3x3 fall back to demosaic.
+//
+// Inputs:
+//   bayer  width*height array containing interleaved color intensities in
+//     the given bayer pattern.
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   pattern  layout of the sensor's color filter array
+// Outputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+void demosaic_malvar(
+  const std::vector<unsigned char> & bayer,
+  const int & width,
+  const int & height,
+  const CfaPattern pattern,
+  std::vector<unsigned char> & rgb);
 #endif 
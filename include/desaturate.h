@@ -1,6 +1,8 @@
 #ifndef DESATURATE_H
 #define DESATURATE_H
 #include <vector>
+#include "planar_image.h"
+#include "hsv_n.h"
 // Desaturate a given rgb color image by a given factor.
 //
 // Inputs:
@@ -17,4 +19,36 @@ void desaturate(
   const int height,
   const double factor,
   std::vector<unsigned char> & desaturated);
+
+// Overload that selects how the hsv conversions are evaluated: exact (the
+// version above) or within_one (float batch kernels on several threads)
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   factor  fractional amount of saturation to remove
+//   accuracy  HsvAccuracy::exact or HsvAccuracy::within_one
+// Outputs:
+//   desaturated  width*height*3 array containing rgb image color intensities
+void desaturate(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const double factor,
+  const HsvAccuracy accuracy,
+  std::vector<unsigned char> & desaturated);
+
+// Overload for planar rgb images (same result as the interleaved version)
+//
+// Inputs:
+//   rgb  3-plane rgb image
+//   factor  fractional amount of saturation to remove
+// Outputs:
+//   desaturated  3-plane rgb image
+void desaturate(
+  const PlanarImage & rgb,
+  const double factor,
+  PlanarImage & desaturated);
+
 #endif
@@ -0,0 +1,91 @@
+#ifndef DITHER_H
+#define DITHER_H
+
+#include <array>
+#include <vector>
+
+// A palette of at most 256 rgb colors, with a precomputed inverse color map
+// so that finding the nearest palette color costs a single lookup
+struct Palette {
+  std::vector<std::array<unsigned char, 3>> colors;
+  // Index of the color nearest to the center of each cell of a 64x64x64
+  // grid over rgb space, at nearest[(r/4)*4096 + (g/4)*64 + b/4]
+  std::vector<unsigned char> nearest;
+};
+
+// Build a palette (and its inverse color map) from a list of colors
+//
+// Inputs:
+//   colors  1 to 256 rgb colors
+// Returns the palette
+Palette make_palette(const std::vector<std::array<unsigned char, 3>> & colors);
+
+// Palette of levels^3 colors evenly spaced along each channel (e.g., 6
+// levels give the 216-color web palette, 2 levels the 8 corners of the
+// rgb cube)
+//
+// Inputs:
+//   levels  intensities per channel [2,6]
+// Returns the palette
+Palette uniform_palette(const int levels);
+
+// Dither an rgb image to a palette with an 8x8 Bayer threshold matrix. Each
+// pixel depends only on its own color and position, so rows run in
+// parallel and 8 pixels at a time. The threshold amplitude is the typical
+// spacing of the palette colors.
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   palette  palette to dither to
+// Outputs:
+//   indices  width*height array of palette indices
+void ordered_dither(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const Palette & palette,
+  std::vector<unsigned char> & indices);
+
+// Dither an rgb image to a palette with Floyd-Steinberg error diffusion.
+// Rows scanned left to right run in parallel as a wavefront: each row
+// trails the one above it by two pixels, the closest it can follow and
+// still have received all of that row's error. Serpentine scanning
+// alternates the row direction (which avoids diagonal "worm" artifacts),
+// but then each row starts where the previous one finished, so it runs on
+// a single thread.
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   palette  palette to dither to
+//   serpentine  whether odd rows are scanned right to left
+// Outputs:
+//   indices  width*height array of palette indices
+void diffusion_dither(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const Palette & palette,
+  const bool serpentine,
+  std::vector<unsigned char> & indices);
+
+// Look up the colors of an indexed image
+//
+// Inputs:
+//   indices  width*height array of palette indices
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   palette  palette the indices refer to
+// Outputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+void indices_to_rgb(
+  const std::vector<unsigned char> & indices,
+  const int width,
+  const int height,
+  const Palette & palette,
+  std::vector<unsigned char> & rgb);
+
+#endif
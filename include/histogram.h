@@ -0,0 +1,97 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "intensity_lut.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Number of samples at each intensity
+using Histogram = std::array<std::uint64_t, 256>;
+
+// Count the intensities of each channel of an image. Rows are split across
+// threads, each counting into bins of its own that are summed at the end.
+//
+// Inputs:
+//   image  width*height*num_channels array containing image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   num_channels  number of channels (e.g., for rgb 3, for grayscale 1)
+// Outputs:
+//   histograms  num_channels histograms, one per channel
+void channel_histograms(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels,
+  std::vector<Histogram> & histograms);
+
+// Count the luminance intensities of an rgb image, i.e., the intensities of
+// rgb_to_gray(rgb)
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+// Outputs:
+//   histogram  luminance histogram
+void luminance_histogram(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  Histogram & histogram);
+
+// Lookup table stretching the intensities of all channels alike so that the
+// darkest channel reaches 0 and the brightest reaches 255 (which keeps the
+// color balance), ignoring a fraction of outliers at each end
+//
+// Inputs:
+//   histograms  one histogram per channel
+//   clip  fraction [0,0.5) of each channel's samples ignored at each end
+// Returns the stretching lookup table (the identity for flat images)
+IntensityLut auto_levels_lut(
+  const std::vector<Histogram> & histograms,
+  const double clip);
+
+// Lookup table that makes the cumulative histogram as close to linear as
+// possible
+//
+// Inputs:
+//   histogram  histogram to flatten
+// Returns the equalizing lookup table (the identity for flat images)
+IntensityLut equalization_lut(const Histogram & histogram);
+
+// Normalize the exposure of an rgb image by stretching its levels (see
+// auto_levels_lut)
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   clip  fraction [0,0.5) of each channel's samples ignored at each end
+//     (e.g., 0.005)
+// Outputs:
+//   leveled  width*height*3 array containing rgb image color intensities
+void auto_levels(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const double clip,
+  std::vector<unsigned char> & leveled);
+
+// Equalize the luminance histogram of an rgb image, applying the same
+// lookup table to every channel
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+// Outputs:
+//   equalized  width*height*3 array containing rgb image color intensities
+void equalize(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  std::vector<unsigned char> & equalized);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef HSV_N_H
+#define HSV_N_H
+
+#include <functional>
+#include <vector>
+
+// How hsv-based edits (hue_shift, desaturate) evaluate their conversions
+enum class HsvAccuracy {
+  // Per pixel in double precision (rgb_to_hsv/hsv_to_rgb): the reference
+  exact,
+  // Whole spans at a time in float with the batch kernels below: every
+  // channel within ±1 of the exact result
+  within_one,
+};
+
+// Convert a span of colors from red, green and blue intensities to hue,
+// saturation and value. Branch-free float version of rgb_to_hsv that
+// processes 8 pixels per step with AVX2 (and any count with the scalar
+// tail).
+//
+// Inputs:
+//   r  n red intensities [0,255]
+//   g  n green intensities [0,255]
+//   b  n blue intensities [0,255]
+//   n  number of pixels
+// Outputs:
+//   h  n hues in degrees [0,360)
+//   s  n saturation intensities [0,1]
+//   v  n value intensities [0,1]
+void rgb_to_hsv_n(
+  const unsigned char * r,
+  const unsigned char * g,
+  const unsigned char * b,
+  const int n,
+  float * h,
+  float * s,
+  float * v);
+
+// Convert a span of colors from hue, saturation and value back to red,
+// green and blue intensities, truncated like the callers of hsv_to_rgb.
+//
+// Inputs:
+//   h  n hues in degrees [0,360]
+//   s  n saturation intensities [0,1]
+//   v  n value intensities [0,1]
+//   n  number of pixels
+// Outputs:
+//   r  n red intensities [0,255]
+//   g  n green intensities [0,255]
+//   b  n blue intensities [0,255]
+void hsv_to_rgb_n(
+  const float * h,
+  const float * s,
+  const float * v,
+  const int n,
+  unsigned char * r,
+  unsigned char * g,
+  unsigned char * b);
+
+// Apply an edit in hsv space to every pixel of an rgb image. Rows are split
+// across threads, and each thread converts short spans of pixels with the
+// batch kernels so the intermediate h, s, v stay in cache.
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   edit  called as edit(h,s,v,n) to modify a span of n pixels in place
+// Outputs:
+//   edited  width*height*3 array containing rgb image color intensities
+void edit_in_hsv(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const std::function<void(float *, float *, float *, int)> & edit,
+  std::vector<unsigned char> & edited);
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef HUE_SHIFT_H
 #define HUE_SHIFT_H
 #include <vector>
+#include "planar_image.h"
+#include "hsv_n.h"
 // Shift the hue of a color rgb image.
 //
 // Inputs:
@@ -16,4 +18,36 @@ void hue_shift(
   const int height,
   const double shift,
   std::vector<unsigned char> & shifted);
+
+// Overload that selects how the hsv conversions are evaluated: exact (the
+// version above) or within_one (float batch kernels on several threads)
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   shift  hue shift given in degrees [-180,180)
+//   accuracy  HsvAccuracy::exact or HsvAccuracy::within_one
+// Outputs
+//   shifted  width*height*3 array containing rgb image color intensities
+void hue_shift(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const double shift,
+  const HsvAccuracy accuracy,
+  std::vector<unsigned char> & shifted);
+
+// Overload for planar rgb images (same result as the interleaved version)
+//
+// Inputs:
+//   rgb  3-plane rgb image
+//   shift  hue shift given in degrees [-180,180)
+// Outputs
+//   shifted  3-plane rgb image
+void hue_shift(
+  const PlanarImage & rgb,
+  const double shift,
+  PlanarImage & shifted);
+
 #endif
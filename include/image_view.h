@@ -0,0 +1,86 @@
+#ifndef IMAGE_VIEW_H
+#define IMAGE_VIEW_H
+
+#include <cstddef>
+#include <vector>
+
+// A lazy, non-owning view of an interleaved image. Geometric edits (flips,
+// 90° rotations, transposes, crops) only remap indices, so chaining them
+// costs nothing until the view is materialized or written out.
+//
+// The first channel of pixel (x,y) of the view lives at
+//   data[offset + x*x_stride + y*y_stride]
+// where the strides are counted in elements and may be negative.
+struct ImageView {
+  const unsigned char * data;  // Underlying image (must outlive the view)
+  int width;                   // View width (i.e., number of columns)
+  int height;                  // View height (i.e., number of rows)
+  int num_channels;            // e.g., for rgb 3, for grayscale 1
+  std::ptrdiff_t offset;       // Index of the first channel of pixel (0,0)
+  std::ptrdiff_t x_stride;     // Index step from one column to the next
+  std::ptrdiff_t y_stride;     // Index step from one row to the next
+};
+
+// View a whole row-major image
+//
+// Inputs:
+//   image  width*height*num_channels array containing image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   num_channels  number of channels (e.g., for rgb 3, for grayscale 1)
+// Returns a view covering the entire image
+ImageView make_image_view(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels);
+
+// Mirror a view left-to-right (like reflect)
+ImageView flip_horizontal(const ImageView & view);
+
+// Mirror a view top-to-bottom
+ImageView flip_vertical(const ImageView & view);
+
+// Swap rows and columns of a view
+ImageView transpose(const ImageView & view);
+
+// Rotate a view by a multiple of 90°
+//
+// Inputs:
+//   view  view to rotate
+//   quarter_turns  number of 90° counter-clockwise turns (negative turns
+//     rotate clockwise)
+// Returns the rotated view (width and height swap for odd turns)
+ImageView rotate_view(const ImageView & view, const int quarter_turns);
+
+// Restrict a view to a rectangle
+//
+// Inputs:
+//   view  view to crop
+//   x  left column of the rectangle
+//   y  top row of the rectangle
+//   width  rectangle width, x+width must not exceed view.width
+//   height  rectangle height, y+height must not exceed view.height
+// Returns the cropped view
+ImageView crop(
+  const ImageView & view,
+  const int x,
+  const int y,
+  const int width,
+  const int height);
+
+// Copy a view into contiguous row-major memory in a single pass. Views that
+// walk the source column-wise (after a transpose or odd rotation) are copied
+// in square tiles so that reads and writes both stay in cache, with 1- and
+// 4-channel tiles transposed in SIMD registers. Any other strides are
+// copied pixel by pixel. Rows are spread across threads.
+//
+// Inputs:
+//   view  view to copy
+// Outputs:
+//   output  view.width*view.height*view.num_channels array
+void materialize(
+  const ImageView & view,
+  std::vector<unsigned char> & output);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef INTENSITY_LUT_H
+#define INTENSITY_LUT_H
+
+#include <array>
+#include <vector>
+
+// A pointwise tone adjustment: output intensity of each input intensity
+using IntensityLut = std::array<unsigned char, 256>;
+
+// The lookup table that leaves every intensity unchanged
+IntensityLut identity_lut();
+
+// Map every intensity of an image (all channels alike) through a lookup
+// table, in a single pass
+//
+// Inputs:
+//   image  width*height*num_channels array containing image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   num_channels  number of channels (e.g., for rgb 3, for grayscale 1)
+//   lut  lookup table
+// Outputs:
+//   output  width*height*num_channels array containing image color
+//     intensities (may be the same vector as image)
+void apply_intensity_lut(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels,
+  const IntensityLut & lut,
+  std::vector<unsigned char> & output);
+
+// Map each channel of an image through a lookup table of its own, in a
+// single pass
+//
+// Inputs:
+//   image  width*height*num_channels array containing image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   num_channels  number of channels [1,4]
+//   luts  num_channels lookup tables, luts[c] for channel c
+// Outputs:
+//   output  width*height*num_channels array containing image color
+//     intensities (may be the same vector as image)
+void apply_intensity_luts(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels,
+  const std::vector<IntensityLut> & luts,
+  std::vector<unsigned char> & output);
+
+#endif
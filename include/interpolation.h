@@ -0,0 +1,10 @@
+#ifndef INTERPOLATION_H
+#define INTERPOLATION_H
+
+// How to sample an image between pixel centers
+enum class Interpolation {
+  bilinear,  // weighted 2x2 neighborhood
+  bicubic    // weighted 4x4 neighborhood (Catmull-Rom), sharper
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+#include "image_view.h"
+#include <vector>
+
+// One of the 8 orientations of a rectangular image (the dihedral group D4).
+// Any sequence of flips, transposes and 90° rotations composes to a single
+// orientation in the canonical form
+//
+//   transpose (if transposed), then flip left-to-right (if flipped_x), then
+//   flip top-to-bottom (if flipped_y)
+//
+// so a whole chain is applied with one pass over the pixels.
+struct Orientation {
+  bool transposed = false;
+  bool flipped_x = false;
+  bool flipped_y = false;
+
+  bool operator==(const Orientation &) const = default;
+};
+
+// Elementary orientations, matching the view functions in image_view.h
+Orientation horizontal_flip();
+Orientation vertical_flip();
+Orientation transposition();
+// Inputs:
+//   quarter_turns  number of 90° counter-clockwise turns (negative turns
+//     rotate clockwise)
+Orientation rotation(const int quarter_turns);
+
+// Orientation that brings an image stored with an EXIF orientation tag
+// upright
+//
+// Inputs:
+//   tag  EXIF orientation, 1 through 8 (1 is already upright)
+Orientation exif_orientation(const int tag);
+
+// Inputs:
+//   first  orientation applied first
+//   second  orientation applied to the result of first
+// Returns the single orientation equivalent to first then second
+Orientation compose(const Orientation & first, const Orientation & second);
+
+// Inputs:
+//   steps  orientations applied in order
+// Returns the single orientation equivalent to the whole sequence
+Orientation compose(const std::vector<Orientation> & steps);
+
+// Returns the orientation that undoes orientation
+Orientation inverse(const Orientation & orientation);
+
+// Apply an orientation to a view (no pixels are copied)
+ImageView orient_view(const ImageView & view, const Orientation & orientation);
+
+// Reorient an image in a single blocked pass
+//
+// Inputs:
+//   input width*height*num_channels array containing image color intensities
+//   width  input image width (i.e., number of columns)
+//   height  input image height (i.e., number of rows)
+//   num_channels  number of channels (e.g., for rgb 3, for grayscale 1)
+//   orientation  orientation to apply
+// Outputs:
+//   oriented  height*width*num_channels array if orientation.transposed,
+//     width*height*num_channels otherwise, containing the reoriented image
+void orient(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  const Orientation & orientation,
+  std::vector<unsigned char> & oriented);
+
+#endif
@@ -21,4 +21,26 @@ void over(
   const int & width,
   const int & height,
   std::vector<unsigned char> & C);
+
+// Same as over, but blends the colors in linear light instead of on the
+// sRGB-encoded intensities (so, e.g., a half-covered edge is as bright as
+// the average of its two colors looks). Conversions are table lookups (see
+// srgb.h) and the blend is integer arithmetic.
+//
+// Inputs:
+//   A  width*height*4 array of 4-channel rgba intensities (i.e., rgb +
+//     alpha channel for transparency)
+//   B  width*height*4 array of 4-channel rgba intensities (i.e., rgb +
+//     alpha channel for transparency)
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+// Outputs:
+//   C  width*height*4 array of 4-channel rgba intensities (i.e., rgb +
+//     alpha channel for transparency)
+void over_linear(
+  const std::vector<unsigned char> & A,
+  const std::vector<unsigned char> & B,
+  const int & width,
+  const int & height,
+  std::vector<unsigned char> & C);
 #endif
@@ -0,0 +1,48 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <cstddef>
+#include <functional>
+
+// Split the range [0,n) into contiguous chunks and process them on worker
+// threads (e.g., one chunk of image rows per thread). Small ranges run on
+// the calling thread only. Worker threads are claimed from a budget shared
+// by the whole process (see acquire_threads), so concurrent or nested calls
+// together never run more threads than the hardware has.
+//
+// Inputs:
+//   n  number of items (e.g., image rows)
+//   min_chunk  fewest items worth handing to a separate thread
+//   body  called as body(begin,end) for disjoint ranges that cover [0,n)
+void parallel_for(
+  const int n,
+  const int min_chunk,
+  const std::function<void(int, int)> & body);
+
+// Fewest rows of an image worth handing to a separate thread, i.e., the
+// min_chunk of a parallel_for over rows: enough rows for about a quarter
+// megabyte of pixels.
+//
+// Inputs:
+//   bytes_per_row  bytes of pixels each row (or other item) reads or writes
+// Returns at least 1
+int rows_per_chunk(const std::ptrdiff_t bytes_per_row);
+
+// Claim threads from the process-wide budget of hardware_concurrency-1
+// threads besides the calling one. Callers that start threads of their own
+// (e.g., the workers of run_stage_graph) claim them here too, so that
+// parallel_for calls inside them take fewer.
+//
+// Inputs:
+//   wanted  number of threads wanted
+// Returns the number of threads granted (from 0 to wanted); give them back
+// with release_threads
+int acquire_threads(const int wanted);
+
+// Give back threads granted by acquire_threads
+//
+// Inputs:
+//   count  number of threads to give back
+void release_threads(const int count);
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef PLANAR_IMAGE_H
+#define PLANAR_IMAGE_H
+
+#include <cstddef>
+#include <vector>
+
+// An image stored one channel after another (planar, "structure of
+// arrays") instead of interleaved. Each channel is a contiguous
+// width*height plane, so per-channel kernels read and write with unit
+// stride and vectorize cleanly.
+struct PlanarImage {
+  int width;                        // image width (i.e., number of columns)
+  int height;                       // image height (i.e., number of rows)
+  int num_channels;                 // number of planes (e.g., for rgb 3)
+  std::vector<unsigned char> data;  // num_channels*width*height intensities;
+                                    // plane c starts at c*width*height
+};
+
+// Pointer to the first intensity of plane c
+inline unsigned char * plane(PlanarImage & image, const int c)
+{
+  return image.data.data() + (size_t)c * image.width * image.height;
+}
+inline const unsigned char * plane(const PlanarImage & image, const int c)
+{
+  return image.data.data() + (size_t)c * image.width * image.height;
+}
+
+// Split an interleaved image into planes
+//
+// Inputs:
+//   input  width*height*num_channels array containing image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   num_channels  number of channels (1, 3 or 4)
+// Outputs:
+//   planar  planar copy of input
+void interleaved_to_planar(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  PlanarImage & planar);
+
+// Split an rgba image into rgb planes, dropping alpha in the same pass
+//
+// Inputs:
+//   rgba  width*height*4 array containing rgba image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+// Outputs:
+//   planar  3-plane rgb image
+void rgba_to_planar_rgb(
+  const std::vector<unsigned char> & rgba,
+  const int width,
+  const int height,
+  PlanarImage & planar);
+
+// Interleave planes back into a single array
+//
+// Inputs:
+//   planar  planar image with 1, 3 or 4 planes
+// Outputs:
+//   output  width*height*num_channels array containing image color intensities
+void planar_to_interleaved(
+  const PlanarImage & planar,
+  std::vector<unsigned char> & output);
+
+// Split a span of interleaved rgb or rgba pixels into r, g and b arrays
+// (dropping alpha), 16 pixels per step with SSSE3 or NEON
+//
+// Inputs:
+//   source  num_pixels*source_channels interleaved intensities
+//   num_pixels  number of pixels
+//   source_channels  3 for rgb, 4 for rgba
+// Outputs:
+//   r  num_pixels red intensities
+//   g  num_pixels green intensities
+//   b  num_pixels blue intensities
+void deinterleave_rgb(
+  const unsigned char * source,
+  const int num_pixels,
+  const int source_channels,
+  unsigned char * r,
+  unsigned char * g,
+  unsigned char * b);
+
+// Interleave a span of r, g and b arrays into rgb pixels, the inverse of
+// deinterleave_rgb for rgb
+//
+// Inputs:
+//   r  num_pixels red intensities
+//   g  num_pixels green intensities
+//   b  num_pixels blue intensities
+//   num_pixels  number of pixels
+// Outputs:
+//   rgb  num_pixels*3 interleaved intensities
+void interleave_rgb(
+  const unsigned char * r,
+  const unsigned char * g,
+  const unsigned char * b,
+  const int num_pixels,
+  unsigned char * rgb);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <vector>
+
+// One level of an image pyramid
+struct PyramidLevel {
+  int width;                          // level width (i.e., number of columns)
+  int height;                         // level height (i.e., number of rows)
+  std::vector<unsigned char> pixels;  // width*height*num_channels intensities
+};
+
+// Build every power-of-two reduction of an image (a mipmap chain) in one
+// streaming pass: pairs of source rows are averaged into a row of the first
+// level, pairs of those rows (still in cache) into the next level, and so
+// on, so the source is read once and each level written once (about 1.33x
+// the traffic of reading the source).
+//
+// Each level averages 2x2 blocks of the one above, rounding its size up;
+// odd last columns/rows are averaged with themselves.
+//
+// Inputs:
+//   image  width*height*num_channels array containing image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   num_channels  number of channels (e.g., for rgb 3, for grayscale 1)
+//   gamma_correct  whether to average sRGB colors in linear light (alpha,
+//     the last of 2 or 4 channels, is always averaged as is)
+// Outputs:
+//   levels  levels[k] is the image reduced 2^(k+1) times, down to 1x1 (empty
+//     for a 1x1 image)
+void build_pyramid(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels,
+  const bool gamma_correct,
+  std::vector<PyramidLevel> & levels);
+
+#endif
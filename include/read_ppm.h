@@ -0,0 +1,26 @@
+#ifndef READ_PPM_H
+#define READ_PPM_H
+
+#include <vector>
+#include <string>
+
+// Read an rgb or grayscale image from an ASCII (P2/P3) .ppm file, e.g., the
+// reference images in data/validation/
+//
+// Inputs:
+//   filename  path to .ppm file as string
+// Outputs:
+//   data  width*height*num_channels array of image intensity data
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   num_channels  number of channels (3 for P3, 1 for P2)
+// Returns true on success, false on failure (e.g., can't open file,
+// unsupported format or truncated pixel data)
+bool read_ppm(
+  const std::string & filename,
+  std::vector<unsigned char> & data,
+  int & width,
+  int & height,
+  int & num_channels);
+
+#endif
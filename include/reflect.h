@@ -18,4 +18,34 @@ void reflect(
   const int num_channels,
   std::vector<unsigned char> & reflected);
 
+// Horizontally reflect an image in place, without allocating a copy
+//
+// Inputs:
+//   image width*height*num_channels array containing image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   num_channels  number of channels (e.g., for rgb 3, for grayscale 1)
+// Outputs:
+//   image  reflected in place
+void reflect_in_place(
+  std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels);
+
+// Vertically reflect an image (upside down) in place by swapping rows
+//
+// Inputs:
+//   image width*height*num_channels array containing image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   num_channels  number of channels (e.g., for rgb 3, for grayscale 1)
+// Outputs:
+//   image  flipped in place
+void flip_vertical_in_place(
+  std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels);
+
 #endif
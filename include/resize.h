@@ -0,0 +1,78 @@
+#ifndef RESIZE_H
+#define RESIZE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Reconstruction filters for resize, from softest/fastest to sharpest
+enum class ResizeFilter {
+  box,       // area average (exact for integer downscales)
+  bilinear,  // triangle, support 1
+  bicubic,   // Catmull-Rom, support 2
+  lanczos3   // windowed sinc, support 3
+};
+
+// Precomputed weights of one axis of a resize: destination sample i is
+//   sum over k < num_taps of weights[i*num_taps+k]*source[first[i]+k]
+// with weights in 1/16384 units that sum to exactly 16384. Taps past the
+// image border are folded onto the edge sample, so every window lies inside
+// the source.
+struct ResizeWeights {
+  int num_taps;
+  std::vector<int> first;
+  std::vector<int16_t> weights;
+};
+
+// Both axes of a resize from width x height to new_width x new_height
+struct ResizePlan {
+  int width;
+  int height;
+  int new_width;
+  int new_height;
+  ResizeFilter filter;
+  ResizeWeights horizontal;  // source columns -> destination columns
+  ResizeWeights vertical;    // source rows -> destination rows
+};
+
+// Weights for resizing width x height images to new_width x new_height.
+// Plans are cached by (sizes, filter), so batches of same-size images only
+// build them once.
+//
+// Inputs:
+//   width  source image width (i.e., number of columns)
+//   height  source image height (i.e., number of rows)
+//   new_width  destination image width
+//   new_height  destination image height
+//   filter  reconstruction filter
+// Returns the shared, immutable plan
+std::shared_ptr<const ResizePlan> resize_plan(
+  const int width,
+  const int height,
+  const int new_width,
+  const int new_height,
+  const ResizeFilter filter);
+
+// Resize an image in two separable passes (horizontal, then vertical)
+//
+// Inputs:
+//   input width*height*num_channels array containing image color intensities
+//   width  input image width (i.e., number of columns)
+//   height  input image height (i.e., number of rows)
+//   num_channels  number of channels (e.g., for rgb 3, for grayscale 1)
+//   new_width  output image width
+//   new_height  output image height
+//   filter  reconstruction filter (e.g., ResizeFilter::lanczos3 for photos)
+// Outputs:
+//   resized  new_width*new_height*num_channels array containing resized image
+void resize(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  const int new_width,
+  const int new_height,
+  const ResizeFilter filter,
+  std::vector<unsigned char> & resized);
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef RGB_LANES_H
+#define RGB_LANES_H
+
+// Building blocks shared by the vectorized per-pixel rgb kernels (e.g.,
+// desaturate, hue_shift, color_lut): 8 interleaved or planar rgb pixels
+// spread over 32-bit lanes, byte tables read with 32-bit gathers, and the
+// hsv round trip of 4 pixels in double precision. Not part of the public
+// interface.
+
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Byte table read 8 entries at a time by gather_bytes. It is padded by 3
+// bytes so that the 32-bit gathers of its last entries stay in bounds.
+struct GatherTable
+{
+  std::vector<unsigned char> bytes;
+
+  explicit GatherTable(const int size) : bytes(size + 3) {}
+
+  unsigned char & operator[](const int i) { return bytes[i]; }
+  unsigned char operator[](const int i) const { return bytes[i]; }
+};
+
+#if defined(__AVX2__)
+// Load 8 rgb pixels: pixels 0-3 fill the first 12 bytes of the low 128-bit
+// half, pixels 4-7 those of the high half. Reads 28 bytes.
+inline __m256i load_rgb8(const unsigned char * rgb)
+{
+  return _mm256_setr_m128i(
+    _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgb)),
+    _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgb + 12)));
+}
+
+// Channel c (0 for red, 1 for green, 2 for blue) of 8 pixels from
+// load_rgb8, one pixel per 32-bit lane
+inline __m256i channel_lanes(const __m256i pixels, const int c)
+{
+  return _mm256_shuffle_epi8(pixels, _mm256_setr_epi8(
+    c, -1, -1, -1, 3 + c, -1, -1, -1, 6 + c, -1, -1, -1, 9 + c, -1, -1, -1,
+    c, -1, -1, -1, 3 + c, -1, -1, -1, 6 + c, -1, -1, -1, 9 + c, -1, -1, -1));
+}
+
+// Store 8 pixels given as 32-bit lanes 0x00bbggrr as 24 rgb bytes. Writes
+// 28 bytes (the last 4 are garbage).
+inline void store_rgb8(const __m256i lanes, unsigned char * rgb)
+{
+  const __m256i packed = _mm256_shuffle_epi8(lanes, _mm256_setr_epi8(
+    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(rgb), _mm256_castsi256_si128(packed));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(rgb + 12), _mm256_extracti128_si256(packed, 1));
+}
+
+// Load 8 intensities of a plane, one per 32-bit lane. Reads 8 bytes.
+inline __m256i load_plane8(const unsigned char * plane)
+{
+  return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(plane)));
+}
+
+// Store 8 intensities given as 32-bit lanes (0 to 255) to a plane. Writes 8
+// bytes.
+inline void store_plane8(const __m256i lanes, unsigned char * plane)
+{
+  const __m256i bytes = _mm256_shuffle_epi8(lanes, _mm256_setr_epi8(
+    0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+  const __m256i packed = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+  _mm_storel_epi64(reinterpret_cast<__m128i *>(plane), _mm256_castsi256_si128(packed));
+}
+
+// Entries index of a GatherTable, one per 32-bit lane
+inline __m256i gather_bytes(const GatherTable & table, const __m256i index)
+{
+  return _mm256_and_si256(
+    _mm256_i32gather_epi32(reinterpret_cast<const int *>(table.bytes.data()), index, 1),
+    _mm256_set1_epi32(0xff));
+}
+
+// Hue of 4 pixels given as 32-bit lanes (with their max and min channels),
+// with the same double operations as rgb_to_hsv. Lanes without a distinct
+// max and min give garbage.
+//
+// Outputs:
+//   cmax  max channel in [0,1] (v)
+//   diff  max minus min channel in [0,1]
+// Returns hue in degrees, in [0,360)
+inline __m256d hue_lanes(
+  const __m128i red,
+  const __m128i green,
+  const __m128i blue,
+  const __m128i max,
+  const __m128i min,
+  __m256d & cmax,
+  __m256d & diff)
+{
+  const __m256d scale = _mm256_set1_pd(255.0);
+  const __m256d r_prime = _mm256_div_pd(_mm256_cvtepi32_pd(red), scale);
+  const __m256d g_prime = _mm256_div_pd(_mm256_cvtepi32_pd(green), scale);
+  const __m256d b_prime = _mm256_div_pd(_mm256_cvtepi32_pd(blue), scale);
+  cmax = _mm256_div_pd(_mm256_cvtepi32_pd(max), scale);
+  diff = _mm256_sub_pd(cmax, _mm256_div_pd(_mm256_cvtepi32_pd(min), scale));
+
+  // fmod(q, 6) == q for the |q| <= 1 of the red case
+  const __m256d max_is_red = _mm256_castsi256_pd(
+    _mm256_cvtepi32_epi64(_mm_cmpeq_epi32(max, red)));
+  const __m256d max_is_green = _mm256_castsi256_pd(
+    _mm256_cvtepi32_epi64(_mm_cmpeq_epi32(max, green)));
+  const __m256d numerator = _mm256_blendv_pd(
+    _mm256_blendv_pd(
+      _mm256_sub_pd(r_prime, g_prime), _mm256_sub_pd(b_prime, r_prime), max_is_green),
+    _mm256_sub_pd(g_prime, b_prime), max_is_red);
+  const __m256d offset = _mm256_blendv_pd(
+    _mm256_blendv_pd(_mm256_set1_pd(4.0), _mm256_set1_pd(2.0), max_is_green),
+    _mm256_setzero_pd(), max_is_red);
+  const __m256d h = _mm256_mul_pd(_mm256_set1_pd(60.0),
+    _mm256_add_pd(_mm256_div_pd(numerator, diff), offset));
+  return _mm256_add_pd(h, _mm256_and_pd(
+    _mm256_cmp_pd(h, _mm256_setzero_pd(), _CMP_LT_OQ), _mm256_set1_pd(360.0)));
+}
+
+// Middle channel (neither max nor min) that hsv_to_rgb gives 4 pixels, with
+// the same double operations, truncated to integers
+//
+// Inputs:
+//   h  hue in degrees, in [0,360)
+//   c  chroma (v*s)
+//   cmax  v
+inline __m128i middle_lanes(const __m256d h, const __m256d c, const __m256d cmax)
+{
+  // fmod(h/60, 2) of h/60 in [0,6) is this exact subtraction
+  const __m256d sector = _mm256_div_pd(h, _mm256_set1_pd(60.0));
+  const __m256d wrapped = _mm256_sub_pd(sector, _mm256_mul_pd(_mm256_set1_pd(2.0),
+    _mm256_floor_pd(_mm256_div_pd(sector, _mm256_set1_pd(2.0)))));
+  const __m256d distance = _mm256_andnot_pd(_mm256_set1_pd(-0.0),
+    _mm256_sub_pd(wrapped, _mm256_set1_pd(1.0)));
+  const __m256d x = _mm256_mul_pd(c, _mm256_sub_pd(_mm256_set1_pd(1.0), distance));
+  return _mm256_cvttpd_epi32(_mm256_mul_pd(
+    _mm256_add_pd(x, _mm256_sub_pd(cmax, c)), _mm256_set1_pd(255.0)));
+}
+#endif
+
+#endif
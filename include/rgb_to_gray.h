@@ -2,9 +2,15 @@
 #define RGB_TO_GRAY_H
 
 #include <vector>
+#include "planar_image.h"
 
 // Convert a 3-channel RGB image to a 1-channel grayscale image
 //
+// gray = 0.2126*r + 0.7152*g + 0.0722*b truncated (BT.709), or
+// 0.299*r + 0.587*g + 0.114*b when built with RGB_TO_GRAY_BT601 (BT.601).
+// Computed in fixed point (SIMD, row-parallel), bit-exact with evaluating
+// that formula in double precision.
+//
 // Inputs:
 //   rgb  width*height*3 array containing rgb image color intensities
 //   width  image width (i.e., number of columns)
@@ -17,4 +23,15 @@ void rgb_to_gray(
   const int height,
   std::vector<unsigned char> & gray);
 
+
+// Overload for a planar rgb image, reading each channel with unit stride
+//
+// Inputs:
+//   rgb  3-plane rgb image
+// Outputs:
+//   gray  width*height array containing grayscale intensities
+void rgb_to_gray(
+  const PlanarImage & rgb,
+  std::vector<unsigned char> & gray);
+
 #endif
@@ -1,6 +1,7 @@
 #ifndef ROTATE_H
 #define ROTATE_H
 
+#include "interpolation.h"
 #include <vector>
 // Rotate an image 90°  counter-clockwise
 //
@@ -18,4 +19,54 @@ void rotate(
   const int num_channels,
   std::vector<unsigned char> & rotated);
 
+// Rotate an image by a multiple of 90° in a single cache-blocked pass
+//
+// Inputs:
+//   input width*height*num_channels array containing image color intensities
+//   width  input image width (i.e., number of columns)
+//   height  input image height (i.e., number of rows)
+//   num_channels  number of channels (e.g., for rgb 3, for grayscale 1)
+//   quarter_turns  number of 90° counter-clockwise turns (negative turns
+//     rotate clockwise, e.g., -1 for 90° clockwise, 2 for 180°)
+// Outputs:
+//   rotated  height*width*num_channels array for odd quarter_turns,
+//     width*height*num_channels otherwise, containing rotated image
+void rotate(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  const int quarter_turns,
+  std::vector<unsigned char> & rotated);
+
+// Rotate an image by an arbitrary angle about its center (e.g., to
+// straighten a scan). Output pixels whose centers fall outside the input
+// are 0 (transparent for rgba).
+//
+// Inputs:
+//   input width*height*num_channels array containing image color intensities
+//   width  input image width (i.e., number of columns), less than 32768
+//   height  input image height (i.e., number of rows), less than 32768
+//   num_channels  number of channels (e.g., for rgb 3, for grayscale 1)
+//   degrees  counter-clockwise angle in degrees
+//   interpolation  how to sample between input pixels
+//   expand  whether to grow the canvas to hold the whole rotated image
+//     (otherwise it stays width x height and the corners are cut off)
+// Outputs:
+//   rotated  rotated_width*rotated_height*num_channels array containing
+//     rotated image
+//   rotated_width  output image width
+//   rotated_height  output image height
+void rotate_by_angle(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  const double degrees,
+  const Interpolation interpolation,
+  const bool expand,
+  std::vector<unsigned char> & rotated,
+  int & rotated_width,
+  int & rotated_height);
+
 #endif
@@ -1,6 +1,7 @@
 #ifndef SIMULATE_BAYER_MOSAIC_H
 #define SIMULATE_BAYER_MOSAIC_H
 
+#include "cfa_pattern.h"
 #include <vector>
 
 // Simulate an image acquired from the Bayer mosaic by taking a 3-channel rgb
@@ -21,4 +22,21 @@ void simulate_bayer_mosaic(
   const int & height,
   std::vector<unsigned char> & bayer);
 
+// Same as simulate_bayer_mosaic, for any Bayer pattern
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   pattern  layout of the simulated sensor's color filter array
+// Outputs:
+//   bayer  width*height array containing interleaved color intensities in the
+//     given bayer pattern.
+void simulate_bayer_mosaic(
+  const std::vector<unsigned char> & rgb,
+  const int & width,
+  const int & height,
+  const CfaPattern pattern,
+  std::vector<unsigned char> & bayer);
+
 #endif
@@ -0,0 +1,114 @@
+#ifndef SRGB_H
+#define SRGB_H
+
+#include <array>
+#include <cstdint>
+
+// Conversions between sRGB-encoded 8-bit intensities and linear light, as
+// lookup tables generated at compile time. Linear light is held in 16-bit
+// fixed point (0 is black, 65535 is white), which is fine enough that every
+// 8-bit intensity survives srgb_to_linear -> linear_to_srgb unchanged.
+
+namespace srgb_detail
+{
+  // std::exp/std::log/std::pow are not constexpr, so the tables are built
+  // with series that are accurate to a few units in the last place
+  constexpr double ln2 = 0.693147180559945309417232121458;
+
+  // e^x: x = k*ln2 + r with |r| <= ln2/2, then a Taylor series in r
+  constexpr double exp(const double x)
+  {
+    int k = static_cast<int>(x / ln2 + (x < 0 ? -0.5 : 0.5));
+    const double r = x - k * ln2;
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 24; n++) {
+      term *= r / n;
+      sum += term;
+    }
+    for (; k > 0; k--) {
+      sum *= 2.0;
+    }
+    for (; k < 0; k++) {
+      sum *= 0.5;
+    }
+    return sum;
+  }
+
+  // ln(x) for x > 0: x = 2^k*m with m in [1,2), then
+  // ln(m) = 2*atanh((m-1)/(m+1))
+  constexpr double log(double x)
+  {
+    int k = 0;
+    for (; x >= 2.0; k++) {
+      x *= 0.5;
+    }
+    for (; x < 1.0; k--) {
+      x *= 2.0;
+    }
+    const double z = (x - 1.0) / (x + 1.0);
+    double power = z;
+    double sum = 0.0;
+    for (int n = 1; n < 60; n += 2) {
+      sum += power / n;
+      power *= z * z;
+    }
+    return 2.0 * sum + k * ln2;
+  }
+
+  constexpr double pow(const double base, const double exponent)
+  {
+    return base <= 0.0 ? 0.0 : exp(exponent * log(base));
+  }
+
+  // The sRGB transfer function and its inverse on [0,1]
+  constexpr double decode(const double encoded)
+  {
+    return encoded <= 0.04045 ?
+      encoded / 12.92 : pow((encoded + 0.055) / 1.055, 2.4);
+  }
+  constexpr double encode(const double linear)
+  {
+    return linear <= 0.0031308 ?
+      12.92 * linear : 1.055 * pow(linear, 1.0 / 2.4) - 0.055;
+  }
+}
+
+// Linear light of each 8-bit sRGB intensity, rounded to 16 bits
+inline constexpr std::array<std::uint16_t, 256> srgb_to_linear_table = [] {
+  std::array<std::uint16_t, 256> table{};
+  for (int i = 0; i < 256; i++) {
+    table[i] = static_cast<std::uint16_t>(
+      srgb_detail::decode(i / 255.0) * 65535.0 + 0.5);
+  }
+  return table;
+}();
+
+// 8-bit sRGB intensity of each 12-bit linear intensity i/4095, rounded
+inline constexpr std::array<unsigned char, 4096> linear_to_srgb_table = [] {
+  std::array<unsigned char, 4096> table{};
+  for (int i = 0; i < 4096; i++) {
+    table[i] = static_cast<unsigned char>(
+      srgb_detail::encode(i / 4095.0) * 255.0 + 0.5);
+  }
+  return table;
+}();
+
+// Inputs:
+//   intensity  sRGB-encoded intensity [0,255]
+// Returns linear light [0,65535]
+inline std::uint16_t srgb_to_linear(const unsigned char intensity)
+{
+  return srgb_to_linear_table[intensity];
+}
+
+// Inputs:
+//   linear  linear light [0,65535]
+// Returns the sRGB-encoded intensity [0,255], via the nearest 12-bit entry
+inline unsigned char linear_to_srgb(const std::uint32_t linear)
+{
+  const std::uint32_t index = (linear + 8) >> 4;
+  return linear_to_srgb_table[index < 4095 ? index : 4095];
+}
+
+#endif
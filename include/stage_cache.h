@@ -0,0 +1,98 @@
+#ifndef STAGE_CACHE_H
+#define STAGE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Bump whenever the output of any cached stage changes, so stale entries
+// from older builds are never reused
+#define STAGE_CACHE_VERSION "raster-cache-2"
+
+// Content-addressed on-disk cache of stage outputs. Each entry is one file
+// named by its 64-bit key holding a small header followed by the raw output
+// bytes (each 64-byte aligned). Least recently used entries are evicted
+// once the directory grows past max_bytes.
+struct StageCache {
+  std::string directory;          // Where entries are stored
+  std::uintmax_t max_bytes;       // Size bound of all entries together
+  int hits = 0;                   // Number of successful loads
+  int misses = 0;                 // Number of failed loads
+  int evictions = 0;              // Number of entries removed to stay in bounds
+  std::mutex mutex;               // Guards counters and eviction
+
+  StageCache(const std::string & directory, const std::uintmax_t max_bytes)
+    : directory(directory), max_bytes(max_bytes) {}
+};
+
+// Fold size bytes into a running 64-bit FNV-1a hash
+//
+// Inputs:
+//   data  pointer to bytes to hash
+//   size  number of bytes
+//   hash  running hash (start with stage_cache_hash_seed())
+// Returns the updated hash
+std::uint64_t stage_cache_hash(
+  const void * data,
+  const std::size_t size,
+  const std::uint64_t hash);
+
+// Initial hash value, already folded with STAGE_CACHE_VERSION
+std::uint64_t stage_cache_hash_seed();
+
+// Fold a string (and its length) into a running hash
+std::uint64_t stage_cache_hash(
+  const std::string & text,
+  const std::uint64_t hash);
+
+// Fold a byte buffer (and its length) into a running hash. Large buffers
+// are read 8 bytes at a time into 4 independent lanes (not FNV-1a), so
+// hashing runs at memory speed.
+std::uint64_t stage_cache_hash(
+  const std::vector<unsigned char> & bytes,
+  const std::uint64_t hash);
+
+// Fold the contents of a file into a running hash. The digest of each file
+// is remembered by path, modification time and size, so a file is only read
+// again once it changes.
+//
+// Inputs:
+//   filename  path of the file
+//   hash  running hash
+// Outputs:
+//   hash  updated hash
+// Returns true on success, false if the file can't be read
+bool stage_cache_hash_file(
+  const std::string & filename,
+  std::uint64_t & hash);
+
+// Look up the entry for key and, if found, load its outputs and mark it as
+// most recently used. Counts a hit or a miss.
+//
+// Inputs:
+//   cache  cache to look in
+//   key  content hash of everything the outputs depend on
+// Outputs:
+//   outputs  cached output buffers, in the order they were stored
+// Returns true on a hit, false on a miss (or a corrupt entry)
+bool stage_cache_load(
+  StageCache & cache,
+  const std::uint64_t key,
+  std::vector<std::vector<unsigned char> > & outputs);
+
+// Store outputs under key, then evict least recently used entries until the
+// cache fits in max_bytes again.
+//
+// Inputs:
+//   cache  cache to store into
+//   key  content hash of everything the outputs depend on
+//   outputs  output buffers to store
+// Returns true on success, false on failure (e.g., can't write file)
+bool stage_cache_store(
+  StageCache & cache,
+  const std::uint64_t key,
+  const std::vector<const std::vector<unsigned char> *> & outputs);
+
+#endif
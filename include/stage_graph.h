@@ -0,0 +1,103 @@
+#ifndef STAGE_GRAPH_H
+#define STAGE_GRAPH_H
+
+#include <functional>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct StageCache;
+
+// Named intermediate buffers shared between stages (e.g., "rgb", "bayer")
+using StageBuffers = std::map<std::string, std::vector<unsigned char> >;
+
+// One unit of work in a stage graph
+struct Stage {
+  std::string name;                  // Name shown in the run summary
+  std::vector<std::string> inputs;   // Buffers read by this stage
+  std::vector<std::string> outputs;  // Buffers written by this stage
+  // Work to do. Must only touch its declared inputs/outputs (via
+  // buffers.at(...)). Returns false on failure.
+  std::function<bool(StageBuffers &)> run;
+  // If non-empty, the outputs are cached (see stage_cache.h) keyed by the
+  // stage name, this parameter string, the keys of the input buffers and
+  // the contents of every file in input_files. On a hit run is skipped.
+  // The outputs of a cached stage are keyed by the stage's own key, so run
+  // must only depend on what that key covers; any other buffer is keyed by
+  // its bytes.
+  std::string cache_params = {};
+  std::vector<std::string> input_files = {};  // Files read by run
+};
+
+// Wall-clock timing of one stage, in milliseconds since the graph started
+struct StageTiming {
+  double start_ms;
+  double end_ms;
+  bool cached;  // Outputs were loaded from the cache instead of computed
+};
+
+// Run a graph of stages, executing independent branches concurrently. A
+// stage becomes ready once every stage producing one of its inputs has
+// finished. A buffer is released as soon as its last consumer has finished
+// (buffers that nobody consumes are released right after they are produced).
+// Stages running concurrently share the thread budget of parallel_for, so
+// the machine is not oversubscribed when each of them calls it.
+//
+// Inputs:
+//   stages  list of stages; each output name must be produced by exactly one
+//     stage and every input must be either produced by a stage or already
+//     present in buffers
+//   buffers  initial buffers (may be empty)
+//   num_threads  number of worker threads (<=0 uses the hardware concurrency)
+//   cache  cache for stages with cache_params set (nullptr disables caching)
+// Outputs:
+//   buffers  all declared buffers (released ones are left empty)
+//   timings  one timing per stage (same order as stages)
+// Returns true if every stage ran and succeeded, false otherwise (e.g.,
+// malformed graph, a cycle, or a stage returned false)
+bool run_stage_graph(
+  const std::vector<Stage> & stages,
+  StageBuffers & buffers,
+  const int num_threads,
+  StageCache * cache,
+  std::vector<StageTiming> & timings);
+
+// Print a per-stage timing table followed by the critical path (the chain of
+// dependent stages with the largest total duration).
+//
+// Inputs:
+//   stages  list of stages passed to run_stage_graph
+//   timings  timings filled by run_stage_graph
+//   out  stream to print to
+void print_stage_summary(
+  const std::vector<Stage> & stages,
+  const std::vector<StageTiming> & timings,
+  std::ostream & out);
+
+// Write one line to a stream shared by concurrently running stages (e.g.,
+// progress on std::cout), in a single call under a lock so that lines of
+// different stages never interleave
+//
+// Inputs:
+//   out  stream to print to
+//   line  text to print (a newline is appended)
+void stage_log_line(std::ostream & out, const std::string & line);
+
+// Format a line from values and manipulators and print it with
+// stage_log_line. Formatting happens in a local stream, so the format flags
+// of out (shared by every stage) are never changed.
+//
+// Inputs:
+//   out  stream to print to
+//   parts  values and manipulators making up the line
+template <typename... Parts>
+void stage_log(std::ostream & out, const Parts &... parts)
+{
+  std::ostringstream line;
+  (line << ... << parts);
+  stage_log_line(out, line.str());
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef SWIZZLE_H
+#define SWIZZLE_H
+
+#include <vector>
+
+// Channel reorderings of interleaved images (rgba_to_rgb.h holds the
+// rgba -> rgb one). Each is a byte shuffle of 16 pixels at a time, and
+// large images are split across threads.
+
+// Expand a 3-channel rgb image to rgba with the same alpha everywhere
+//
+// Inputs:
+//   rgb  width*height*3 array containing rgb image color intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+//   alpha  alpha given to every pixel (e.g., 255 for opaque)
+// Outputs:
+//   rgba  width*height*4 array of 4-channel rgba intensities
+void rgb_to_rgba(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const unsigned char alpha,
+  std::vector<unsigned char> & rgba);
+
+// Reorder a bgra image (e.g., from a Windows or Cairo surface) as rgba
+//
+// Inputs:
+//   bgra  width*height*4 array of 4-channel bgra intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+// Outputs:
+//   rgba  width*height*4 array of 4-channel rgba intensities
+void bgra_to_rgba(
+  const std::vector<unsigned char> & bgra,
+  const int width,
+  const int height,
+  std::vector<unsigned char> & rgba);
+
+// Reorder an rgba image as bgra
+//
+// Inputs:
+//   rgba  width*height*4 array of 4-channel rgba intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+// Outputs:
+//   bgra  width*height*4 array of 4-channel bgra intensities
+void rgba_to_bgra(
+  const std::vector<unsigned char> & rgba,
+  const int width,
+  const int height,
+  std::vector<unsigned char> & bgra);
+
+// Extract the alpha channel of an rgba image as a grayscale image
+//
+// Inputs:
+//   rgba  width*height*4 array of 4-channel rgba intensities
+//   width  image width (i.e., number of columns)
+//   height  image height (i.e., number of rows)
+// Outputs:
+//   alpha  width*height array of alpha intensities
+void extract_alpha(
+  const std::vector<unsigned char> & rgba,
+  const int width,
+  const int height,
+  std::vector<unsigned char> & alpha);
+
+#endif
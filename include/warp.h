@@ -0,0 +1,63 @@
+#ifndef WARP_H
+#define WARP_H
+
+#include "interpolation.h"
+#include <array>
+#include <vector>
+
+// A 2x3 affine matrix {a, b, c, d, e, f} taking a point (x,y) to
+//   (a*x + b*y + c, d*x + e*y + f)
+// Points are in pixel units with y pointing down, and pixel (i,j) covers
+// [i,i+1)x[j,j+1), so its center is (i+0.5, j+0.5).
+using AffineMatrix = std::array<double, 6>;
+
+// Scale about a center point, like transform_star_points does for points
+//
+// Inputs:
+//   center_x  x coordinate of the fixed point
+//   center_y  y coordinate of the fixed point
+//   scale_factor  scaling factor (1.0 = no change, <1.0 = contract, >1.0 = expand)
+// Returns the matrix of new_pos = center + scale_factor * (old_pos - center)
+AffineMatrix scaling(
+  const double center_x,
+  const double center_y,
+  const double scale_factor);
+
+// Compose two affine maps
+//
+// Inputs:
+//   first  map applied first
+//   second  map applied to the result of first
+// Returns the matrix of second(first(p))
+AffineMatrix compose(const AffineMatrix & first, const AffineMatrix & second);
+
+// Warp an image by an affine map. Each output row steps its source position
+// by fixed-point addition and is clipped to the span that lands inside the
+// input, so the inner loops have no bounds checks; rows are sampled 8
+// pixels at a time with SIMD and spread across threads. Output pixels whose
+// centers map outside the input are 0 (transparent for rgba).
+//
+// Inputs:
+//   input width*height*num_channels array containing image color intensities
+//   width  input image width (i.e., number of columns), less than 32768
+//   height  input image height (i.e., number of rows), less than 32768
+//   num_channels  number of channels (1 to 4, e.g., for rgb 3)
+//   matrix  invertible map from input positions to output positions
+//   interpolation  how to sample between input pixels
+//   warped_width  output image width
+//   warped_height  output image height
+// Outputs:
+//   warped  warped_width*warped_height*num_channels array containing warped
+//     image
+void affine_warp(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  const AffineMatrix & matrix,
+  const Interpolation interpolation,
+  const int warped_width,
+  const int warped_height,
+  std::vector<unsigned char> & warped);
+
+#endif
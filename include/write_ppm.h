@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include "image_view.h"
 
 // Write an rgb or grayscale image to an ASCII (P2/P3) .ppm file.
 //
@@ -20,4 +21,15 @@ bool write_ppm(
   const int height,
   const int num_channels);
 
+// Overload writing a (possibly flipped, rotated or cropped) view directly,
+// without materializing it first
+//
+// Inputs:
+//   filename  path to .ppm file as string
+//   view  view of an rgb or grayscale image
+// Returns true on success, false on failure (e.g., can't open file)
+bool write_ppm(
+  const std::string & filename,
+  const ImageView & view);
+
 #endif
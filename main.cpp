@@ -20,14 +20,16 @@
 #include "read_star_json.h"
 #include "transform_star_points.h"
 #include "create_gif_from_frames.h"
+#include "stage_graph.h"
+#include "stage_cache.h"
 
 #include <vector>
 #include <iostream>
-#include <fstream>
 #include <sys/stat.h>
 #include <cmath>
 #include <iomanip>
 #include <sstream>
+#include <cassert>
 
 int main(int argc, char *argv[])
 {
@@ -49,233 +51,350 @@ int main(int argc, char *argv[])
     num_inputs = 4;
   }
 
+  // The image size is read from the header up front so that every stage
+  // (and every cache key) knows it before anything is decoded
+  int width,height,num_components;
+  if(!stbi_info(input_filenames[0].c_str(),&width,&height,&num_components))
+  {
+    std::cerr << "Error: Failed to read " << input_filenames[0] << std::endl;
+    return 1;
+  }
+  std::ostringstream size_params;
+  size_params << width << "x" << height;
+  const std::string size = size_params.str();
+
+  // Outputs of stages with cache parameters are reused across runs as long
+  // as their inputs are unchanged
+  StageCache cache("stage_cache", 1ull << 30);
+
+  // Stages only run once everything they read has been produced, so
+  // independent branches (e.g., the color edits, the animations) run
+  // concurrently
+  std::vector<Stage> stages;
+
+  // Write a produced buffer to a .ppm file
+  const auto write_stage = [](
+    const std::string & buffer,
+    const std::string & filename,
+    const int & w,
+    const int & h,
+    const int num_channels)
+  {
+    // w and h refer to width/height in main, which outlive the graph
+    return Stage{"write " + filename, {buffer}, {},
+      [buffer, filename, &w, &h, num_channels](StageBuffers & buffers) {
+        return write_ppm(filename,buffers.at(buffer),w,h,num_channels);
+      }};
+  };
+
   // read a RGBA .png
-  int width,height;
-  std::vector<unsigned char> rgba;
-  read_rgba_from_png(input_filenames[0],rgba,width,height);
+  stages.push_back({"read_png", {}, {"rgba"}, [&](StageBuffers & buffers) {
+    int png_width,png_height;
+    if(!read_rgba_from_png(input_filenames[0],buffers.at("rgba"),png_width,png_height))
+    {
+      return false;
+    }
+    // Every other stage was sized from the header read up front
+    if(png_width != width || png_height != height)
+    {
+      stage_log(std::cerr, "Error: ", input_filenames[0], " decoded as ", png_width, "x",
+        png_height, " but its header says ", width, "x", height);
+      return false;
+    }
+    return true;
+  }, "rgba " + size, {input_filenames[0]}});
 
   // Convert to RGB
-  std::vector<unsigned char> rgb;
-  rgba_to_rgb(rgba,width,height,rgb);
+  stages.push_back({"rgba_to_rgb", {"rgba"}, {"rgb"}, [&](StageBuffers & buffers) {
+    rgba_to_rgb(buffers.at("rgba"),width,height,buffers.at("rgb"));
+    return true;
+  }, size});
 
   // Write to .ppm file format
-  write_ppm("rgb.ppm",rgb,width,height,3);
+  stages.push_back(write_stage("rgb","rgb.ppm",width,height,3));
 
   // Reflection
-  std::vector<unsigned char> reflected;
-  reflect(rgb,width,height,3,reflected);
-  write_ppm("reflected.ppm",reflected,width,height,3);
+  stages.push_back({"reflect", {"rgb"}, {"reflected"}, [&](StageBuffers & buffers) {
+    reflect(buffers.at("rgb"),width,height,3,buffers.at("reflected"));
+    return true;
+  }, size});
+  stages.push_back(write_stage("reflected","reflected.ppm",width,height,3));
 
   // Rotation
-  std::vector<unsigned char> rotated;
-  rotate(rgb,width,height,3,rotated);
-  write_ppm("rotated.ppm",rotated,height,width,3);
+  stages.push_back({"rotate", {"rgb"}, {"rotated"}, [&](StageBuffers & buffers) {
+    rotate(buffers.at("rgb"),width,height,3,buffers.at("rotated"));
+    return true;
+  }, size});
+  stages.push_back(write_stage("rotated","rotated.ppm",height,width,3));
 
   // Convert to gray
-  std::vector<unsigned char> gray;
-  rgb_to_gray(rgb,width,height,gray);
-  write_ppm("gray.ppm",gray,width,height,1);
+  stages.push_back({"rgb_to_gray", {"rgb"}, {"gray"}, [&](StageBuffers & buffers) {
+    rgb_to_gray(buffers.at("rgb"),width,height,buffers.at("gray"));
+    return true;
+  }, size});
+  stages.push_back(write_stage("gray","gray.ppm",width,height,1));
 
   // Create fake bayer mosaic image
-  std::vector<unsigned char> bayer;
-  simulate_bayer_mosaic(rgb,width,height,bayer);
-  write_ppm("bayer.ppm",bayer,width,height,1);
+  stages.push_back({"simulate_bayer_mosaic", {"rgb"}, {"bayer"}, [&](StageBuffers & buffers) {
+    simulate_bayer_mosaic(buffers.at("rgb"),width,height,buffers.at("bayer"));
+    return true;
+  }, size});
+  stages.push_back(write_stage("bayer","bayer.ppm",width,height,1));
 
   // Demosaic that output
-  std::vector<unsigned char> demosaicked;
-  demosaic(bayer,width,height,demosaicked);
-  write_ppm("demosaicked.ppm",demosaicked,width,height,3);
+  stages.push_back({"demosaic", {"bayer"}, {"demosaicked"}, [&](StageBuffers & buffers) {
+    demosaic(buffers.at("bayer"),width,height,buffers.at("demosaicked"));
+    return true;
+  }, size});
+  stages.push_back(write_stage("demosaicked","demosaicked.ppm",width,height,3));
 
   // Shift the hue of the image by 180°
-  std::vector<unsigned char> shifted;
-  hue_shift(rgb,width,height,180.0,shifted);
-  write_ppm("shifted.ppm",shifted,width,height,3);
+  stages.push_back({"hue_shift", {"rgb"}, {"shifted"}, [&](StageBuffers & buffers) {
+    hue_shift(buffers.at("rgb"),width,height,180.0,buffers.at("shifted"));
+    return true;
+  }, size + " shift=180"});
+  stages.push_back(write_stage("shifted","shifted.ppm",width,height,3));
 
   // Partially desaturate an image by 25%
-  std::vector<unsigned char> desaturated;
-  desaturate(rgb,width,height,0.25,desaturated);
-  write_ppm("desaturated.ppm",desaturated,width,height,3);
+  stages.push_back({"desaturate", {"rgb"}, {"desaturated"}, [&](StageBuffers & buffers) {
+    desaturate(buffers.at("rgb"),width,height,0.25,buffers.at("desaturated"));
+    return true;
+  }, size + " factor=0.25"});
+  stages.push_back(write_stage("desaturated","desaturated.ppm",width,height,3));
 
-  // Alpha composite multiple images (if present)
-  std::vector<unsigned char> composite_rgba;
-  read_rgba_from_png(input_filenames[0],composite_rgba,width,height);
-  for(int f = 1;f<num_inputs;f++)
-  {
-    std::vector<unsigned char> next_rgba;
-    int next_height,next_width;
-    read_rgba_from_png(input_filenames[f],next_rgba,next_width,next_height);
-    assert(height == next_height && "height must match");
-    assert(width == next_width && "width must match");
-    over(next_rgba,composite_rgba,width,height,composite_rgba);
-  }
-  std::vector<unsigned char> composite;
-  rgba_to_rgb(composite_rgba,width,height,composite);
-  write_ppm("composite.ppm",composite,width,height,3);
+  // Alpha composite multiple images (if present), starting from the already
+  // decoded first input
+  const std::vector<std::string> layer_filenames(
+    input_filenames.begin() + 1, input_filenames.begin() + num_inputs);
+  stages.push_back({"composite", {"rgba"}, {"composite"}, [&](StageBuffers & buffers) {
+    std::vector<unsigned char> composite_rgba = buffers.at("rgba");
+    for(const auto & layer_filename : layer_filenames)
+    {
+      std::vector<unsigned char> next_rgba;
+      int next_height,next_width;
+      read_rgba_from_png(layer_filename,next_rgba,next_width,next_height);
+      assert(height == next_height && "height must match");
+      assert(width == next_width && "width must match");
+      over(next_rgba,composite_rgba,width,height,composite_rgba);
+    }
+    rgba_to_rgb(composite_rgba,width,height,buffers.at("composite"));
+    return true;
+  }, size, layer_filenames});
+  stages.push_back(write_stage("composite","composite.ppm",width,height,3));
 
-  // Heart animation: Generate heart.json if it doesn't exist
-  const std::string heart_json_path = "../data/heart.json";
-  struct stat buffer;
-  bool heart_json_exists = (stat(heart_json_path.c_str(), &buffer) == 0);
+  stages.push_back({"heart_animation", {}, {}, [&](StageBuffers &) {
+    // Heart animation: Generate heart.json if it doesn't exist
+    const std::string heart_json_path = "../data/heart.json";
+    struct stat buffer;
+    bool heart_json_exists = (stat(heart_json_path.c_str(), &buffer) == 0);
   
-  std::vector<HeartPoint> heart_points;
+    std::vector<HeartPoint> heart_points;
   
-  if (!heart_json_exists) {
-    std::cout << "Generating heart.json..." << std::endl;
-    generate_heart_points(heart_points, 500, 500, 5000);  // More particles for denser look
-    write_heart_json(heart_json_path, heart_points);
-    std::cout << "Generated " << heart_points.size() << " heart points." << std::endl;
-  } else {
-    std::cout << "heart.json already exists, skipping generation." << std::endl;
-  }
+    if (!heart_json_exists) {
+      stage_log(std::cout, "Generating heart.json...");
+      generate_heart_points(heart_points, 500, 500, 5000);  // More particles for denser look
+      write_heart_json(heart_json_path, heart_points);
+      stage_log(std::cout, "Generated ", heart_points.size(), " heart points.");
+    } else {
+      stage_log(std::cout, "heart.json already exists, skipping generation.");
+    }
   
-  // Load points from heart.json
-  std::cout << "Loading heart points from " << heart_json_path << "..." << std::endl;
-  if (!read_heart_json(heart_json_path, heart_points)) {
-    std::cerr << "Error: Failed to read heart.json" << std::endl;
-    return 1;
-  }
-  std::cout << "Loaded " << heart_points.size() << " heart points." << std::endl;
+    // Load points from heart.json
+    stage_log(std::cout, "Loading heart points from ", heart_json_path, "...");
+    if (!read_heart_json(heart_json_path, heart_points)) {
+      stage_log(std::cerr, "Error: Failed to read heart.json");
+      return false;
+    }
+    stage_log(std::cout, "Loaded ", heart_points.size(), " heart points.");
+
+    // Frames are cached by the contents of heart.json and the frame size
+    std::uint64_t heart_frame_key = stage_cache_hash("heart_frame 500x500", stage_cache_hash_seed());
+    if (!stage_cache_hash_file(heart_json_path, heart_frame_key)) {
+      stage_log(std::cerr, "Error: Failed to read heart.json");
+      return false;
+    }
   
-  // Render single static frame
-  std::cout << "Rendering static heart image..." << std::endl;
-  const int heart_width = 500;
-  const int heart_height = 500;
-  std::vector<unsigned char> heart_image;
-  heart_image.resize(heart_width * heart_height * 3);
+    // Render single static frame
+    stage_log(std::cout, "Rendering static heart image...");
+    const int heart_width = 500;
+    const int heart_height = 500;
+    std::vector<unsigned char> heart_image;
+    heart_image.resize(heart_width * heart_height * 3);
   
-  render_points(heart_image, heart_width, heart_height, heart_points, 1);
-  write_ppm("heart_static.ppm", heart_image, heart_width, heart_height, 3);
-  std::cout << "Static heart image saved as heart_static.ppm" << std::endl;
+    render_points(heart_image, heart_width, heart_height, heart_points, 1);
+    write_ppm("heart_static.ppm", heart_image, heart_width, heart_height, 3);
+    stage_log(std::cout, "Static heart image saved as heart_static.ppm");
   
-  // Generate animation frames
-  std::cout << "\nGenerating animation frames..." << std::endl;
+    // Generate animation frames
+    stage_log(std::cout, "\nGenerating animation frames...");
   
-  // Calculate centroid for contraction center
-  double center_x, center_y;
-  calculate_centroid(heart_points, center_x, center_y);
-  std::cout << "Heart centroid: (" << center_x << ", " << center_y << ")" << std::endl;
+    // Calculate centroid for contraction center
+    double center_x, center_y;
+    calculate_centroid(heart_points, center_x, center_y);
+    stage_log(std::cout, "Heart centroid: (", center_x, ", ", center_y, ")");
   
-  // Animation parameters
-  const int num_frames = 30;
-  const double contraction_amplitude = 0.15;
+    // Animation parameters
+    const int num_frames = 30;
+    const double contraction_amplitude = 0.15;
   
-  // Generate each frame
-  for (int frame = 0; frame < num_frames; frame++) {
-    // Calculate contraction factor using cosine wave
-    // This creates a smooth pulsing effect
-    const double phase = (2.0 * M_PI * frame) / num_frames;
-    const double contraction_factor = 1.0 - contraction_amplitude * (1.0 + cos(phase)) / 2.0;
+    // Generate each frame
+    for (int frame = 0; frame < num_frames; frame++) {
+      // Calculate contraction factor using cosine wave
+      // This creates a smooth pulsing effect
+      const double phase = (2.0 * M_PI * frame) / num_frames;
+      const double contraction_factor = 1.0 - contraction_amplitude * (1.0 + cos(phase)) / 2.0;
     
-    // Transform points based on contraction factor
-    std::vector<HeartPoint> transformed_points;
-    transform_heart_points(heart_points, transformed_points, center_x, center_y, contraction_factor);
+      // Reuse the frame rendered by a previous run if the points and the
+      // contraction are unchanged
+      const std::uint64_t frame_key =
+        stage_cache_hash(&contraction_factor, sizeof(contraction_factor), heart_frame_key);
+      std::vector<std::vector<unsigned char> > cached_frame;
+      std::vector<unsigned char> frame_image;
+      if (stage_cache_load(cache, frame_key, cached_frame) && cached_frame.size() == 1) {
+        frame_image.swap(cached_frame[0]);
+      } else {
+        // Transform points based on contraction factor
+        std::vector<HeartPoint> transformed_points;
+        transform_heart_points(heart_points, transformed_points, center_x, center_y, contraction_factor);
     
-    // Render the transformed points
-    std::vector<unsigned char> frame_image;
-    frame_image.resize(heart_width * heart_height * 3);
-    render_points(frame_image, heart_width, heart_height, transformed_points, 1);
+        // Render the transformed points
+        frame_image.resize(heart_width * heart_height * 3);
+        render_points(frame_image, heart_width, heart_height, transformed_points, 1);
+        stage_cache_store(cache, frame_key, {&frame_image});
+      }
     
-    // Generate filename with zero-padded frame number
-    std::ostringstream filename;
-    filename << "heart_frame_" << std::setfill('0') << std::setw(3) << frame << ".ppm";
+      // Generate filename with zero-padded frame number
+      std::ostringstream filename;
+      filename << "heart_frame_" << std::setfill('0') << std::setw(3) << frame << ".ppm";
     
-    // Write frame to file
-    write_ppm(filename.str(), frame_image, heart_width, heart_height, 3);
+      // Write frame to file
+      write_ppm(filename.str(), frame_image, heart_width, heart_height, 3);
     
-    // Print progress
-    std::cout << "Frame " << frame << "/" << num_frames << " - " 
-              << filename.str() << " (contraction: " 
-              << std::fixed << std::setprecision(3) << contraction_factor << ")" << std::endl;
-  }
+      // Print progress
+      stage_log(std::cout, "Frame ", frame, "/", num_frames, " - ", filename.str(),
+        " (contraction: ", std::fixed, std::setprecision(3), contraction_factor, ")");
+    }
   
-  std::cout << "\nAnimation complete! Generated " << num_frames << " frames." << std::endl;
+    stage_log(std::cout, "\nAnimation complete! Generated ", num_frames, " frames.");
   
-  // Star animation: Generate star.json if it doesn't exist
-  const std::string star_json_path = "../data/star.json";
-  bool star_json_exists = (stat(star_json_path.c_str(), &buffer) == 0);
+    return true;
+  }});
+
+  stages.push_back({"star_animation", {}, {}, [&](StageBuffers &) {
+    // Star animation: Generate star.json if it doesn't exist
+    const std::string star_json_path = "../data/star.json";
+    struct stat buffer;
+    bool star_json_exists = (stat(star_json_path.c_str(), &buffer) == 0);
   
-  std::vector<StarPoint> star_points;
+    std::vector<StarPoint> star_points;
   
-  if (!star_json_exists) {
-    std::cout << "\nGenerating star.json..." << std::endl;
-    generate_star_points(star_points, 500, 500, 5000);
-    write_star_json(star_json_path, star_points);
-    std::cout << "Generated " << star_points.size() << " star points." << std::endl;
-  } else {
-    std::cout << "\nstar.json already exists, skipping generation." << std::endl;
-  }
+    if (!star_json_exists) {
+      stage_log(std::cout, "\nGenerating star.json...");
+      generate_star_points(star_points, 500, 500, 5000);
+      write_star_json(star_json_path, star_points);
+      stage_log(std::cout, "Generated ", star_points.size(), " star points.");
+    } else {
+      stage_log(std::cout, "\nstar.json already exists, skipping generation.");
+    }
   
-  // Load points from star.json
-  std::cout << "Loading star points from " << star_json_path << "..." << std::endl;
-  if (!read_star_json(star_json_path, star_points)) {
-    std::cerr << "Error: Failed to read star.json" << std::endl;
-    return 1;
-  }
-  std::cout << "Loaded " << star_points.size() << " star points." << std::endl;
+    // Load points from star.json
+    stage_log(std::cout, "Loading star points from ", star_json_path, "...");
+    if (!read_star_json(star_json_path, star_points)) {
+      stage_log(std::cerr, "Error: Failed to read star.json");
+      return false;
+    }
+    stage_log(std::cout, "Loaded ", star_points.size(), " star points.");
+
+    // Frames are cached by the contents of star.json and the frame size
+    std::uint64_t star_frame_key = stage_cache_hash("star_frame 500x500", stage_cache_hash_seed());
+    if (!stage_cache_hash_file(star_json_path, star_frame_key)) {
+      stage_log(std::cerr, "Error: Failed to read star.json");
+      return false;
+    }
   
-  // Render single static frame
-  std::cout << "Rendering static star image..." << std::endl;
-  const int star_width = 500;
-  const int star_height = 500;
-  std::vector<unsigned char> star_image;
-  star_image.resize(star_width * star_height * 3);
+    // Render single static frame
+    stage_log(std::cout, "Rendering static star image...");
+    const int star_width = 500;
+    const int star_height = 500;
+    std::vector<unsigned char> star_image;
+    star_image.resize(star_width * star_height * 3);
   
-  render_points(star_image, star_width, star_height, star_points, 1);
-  write_ppm("star_static.ppm", star_image, star_width, star_height, 3);
-  std::cout << "Static star image saved as star_static.ppm" << std::endl;
+    render_points(star_image, star_width, star_height, star_points, 1);
+    write_ppm("star_static.ppm", star_image, star_width, star_height, 3);
+    stage_log(std::cout, "Static star image saved as star_static.ppm");
   
-  // Generate animation frames
-  std::cout << "\nGenerating star animation frames..." << std::endl;
+    // Generate animation frames
+    stage_log(std::cout, "\nGenerating star animation frames...");
   
-  // Calculate centroid for contraction center
-  double star_center_x, star_center_y;
-  calculate_centroid(star_points, star_center_x, star_center_y);
-  std::cout << "Star centroid: (" << star_center_x << ", " << star_center_y << ")" << std::endl;
+    // Calculate centroid for contraction center
+    double star_center_x, star_center_y;
+    calculate_centroid(star_points, star_center_x, star_center_y);
+    stage_log(std::cout, "Star centroid: (", star_center_x, ", ", star_center_y, ")");
   
-  // Animation parameters
-  const int star_num_frames = 30;
-  const double star_contraction_amplitude = 0.15;
+    // Animation parameters
+    const int star_num_frames = 30;
+    const double star_contraction_amplitude = 0.15;
   
-  // Store frame filenames for GIF creation
-  std::vector<std::string> star_frame_paths;
+    // Store frame filenames for GIF creation
+    std::vector<std::string> star_frame_paths;
   
-  // Generate each frame
-  for (int frame = 0; frame < star_num_frames; frame++) {
-    // Calculate contraction factor using cosine wave
-    // This creates a smooth pulsing effect
-    const double phase = (2.0 * M_PI * frame) / star_num_frames;
-    const double contraction_factor = 1.0 - star_contraction_amplitude * (1.0 + cos(phase)) / 2.0;
+    // Generate each frame
+    for (int frame = 0; frame < star_num_frames; frame++) {
+      // Calculate contraction factor using cosine wave
+      // This creates a smooth pulsing effect
+      const double phase = (2.0 * M_PI * frame) / star_num_frames;
+      const double contraction_factor = 1.0 - star_contraction_amplitude * (1.0 + cos(phase)) / 2.0;
     
-    // Transform points based on contraction factor
-    std::vector<StarPoint> transformed_star_points;
-    transform_star_points(star_points, transformed_star_points, star_center_x, star_center_y, contraction_factor);
+      // Reuse the frame rendered by a previous run if the points and the
+      // contraction are unchanged
+      const std::uint64_t frame_key =
+        stage_cache_hash(&contraction_factor, sizeof(contraction_factor), star_frame_key);
+      std::vector<std::vector<unsigned char> > cached_frame;
+      std::vector<unsigned char> frame_image;
+      if (stage_cache_load(cache, frame_key, cached_frame) && cached_frame.size() == 1) {
+        frame_image.swap(cached_frame[0]);
+      } else {
+        // Transform points based on contraction factor
+        std::vector<StarPoint> transformed_star_points;
+        transform_star_points(star_points, transformed_star_points, star_center_x, star_center_y, contraction_factor);
     
-    // Render the transformed points
-    std::vector<unsigned char> frame_image;
-    frame_image.resize(star_width * star_height * 3);
-    render_points(frame_image, star_width, star_height, transformed_star_points, 1);
+        // Render the transformed points
+        frame_image.resize(star_width * star_height * 3);
+        render_points(frame_image, star_width, star_height, transformed_star_points, 1);
+        stage_cache_store(cache, frame_key, {&frame_image});
+      }
     
-    // Generate filename with zero-padded frame number
-    std::ostringstream filename;
-    filename << "star_frame_" << std::setfill('0') << std::setw(3) << frame << ".ppm";
+      // Generate filename with zero-padded frame number
+      std::ostringstream filename;
+      filename << "star_frame_" << std::setfill('0') << std::setw(3) << frame << ".ppm";
     
-    // Write frame to file
-    write_ppm(filename.str(), frame_image, star_width, star_height, 3);
-    star_frame_paths.push_back(filename.str());
+      // Write frame to file
+      write_ppm(filename.str(), frame_image, star_width, star_height, 3);
+      star_frame_paths.push_back(filename.str());
     
-    // Print progress
-    std::cout << "Frame " << frame << "/" << star_num_frames << " - " 
-              << filename.str() << " (contraction: " 
-              << std::fixed << std::setprecision(3) << contraction_factor << ")" << std::endl;
-  }
+      // Print progress
+      stage_log(std::cout, "Frame ", frame, "/", star_num_frames, " - ", filename.str(),
+        " (contraction: ", std::fixed, std::setprecision(3), contraction_factor, ")");
+    }
   
-  std::cout << "\nStar animation complete! Generated " << star_num_frames << " frames." << std::endl;
+    stage_log(std::cout, "\nStar animation complete! Generated ", star_num_frames, " frames.");
   
-  // Create animated GIF from frames
-  std::cout << "\nCreating star_animation.gif..." << std::endl;
-  if (create_gif_from_frames("star_animation.gif", star_frame_paths, 3)) {
-    std::cout << "Successfully created star_animation.gif" << std::endl;
-  } else {
-    std::cerr << "Warning: Failed to create star_animation.gif (ImageMagick may not be installed)" << std::endl;
-  }
+    // Create animated GIF from frames
+    stage_log(std::cout, "\nCreating star_animation.gif...");
+    if (create_gif_from_frames("star_animation.gif", star_frame_paths, 3)) {
+      stage_log(std::cout, "Successfully created star_animation.gif");
+    } else {
+      stage_log(std::cerr,
+        "Warning: Failed to create star_animation.gif (ImageMagick may not be installed)");
+    }
+    return true;
+  }});
+
+  std::vector<StageTiming> timings;
+  StageBuffers buffers;
+  const bool ok = run_stage_graph(stages, buffers, 0, &cache, timings);
+  print_stage_summary(stages, timings, std::cout);
+  std::cout << "Cache: " << cache.hits << " hits, " << cache.misses
+            << " misses, " << cache.evictions << " evictions" << std::endl;
+  return ok ? 0 : 1;
 }
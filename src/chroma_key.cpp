@@ -0,0 +1,116 @@
+#include "chroma_key.h"
+#include "parallel_for.h"
+#include "rgb_lanes.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  // BT.601 chroma weights on the 0-255 scale (the 128 offsets cancel in
+  // differences)
+  const float cb_weights[3] = {-0.168736f, -0.331264f, 0.5f};
+  const float cr_weights[3] = {0.5f, -0.418688f, -0.081312f};
+
+  struct Matte {
+    float key_cb;
+    float key_cr;
+    float inner;
+    float scale;  // 255/(outer-inner)
+
+    // Alpha of one pixel. The SIMD path performs the same float operations
+    // in the same order, so both give identical results.
+    inline unsigned char alpha(const float r, const float g, const float b) const
+    {
+      const float cb = cb_weights[0] * r + cb_weights[1] * g + cb_weights[2] * b - key_cb;
+      const float cr = cr_weights[0] * r + cr_weights[1] * g + cr_weights[2] * b - key_cr;
+      const float ramp = (std::sqrt(cb * cb + cr * cr) - inner) * scale;
+      return static_cast<unsigned char>(std::min(std::max(ramp, 0.0f), 255.0f) + 0.5f);
+    }
+  };
+
+  void key_span(
+    const unsigned char * rgb,
+    const int num_pixels,
+    const Matte & matte,
+    unsigned char * rgba)
+  {
+    int i = 0;
+#if defined(__AVX2__)
+    // Spread 8 pixels into 32-bit lanes per channel, then pack r, g, b and
+    // the alpha lanes straight into 8 rgba pixels
+    const __m256i take_rgb = _mm256_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256 key_cb = _mm256_set1_ps(matte.key_cb);
+    const __m256 key_cr = _mm256_set1_ps(matte.key_cr);
+    const __m256 inner = _mm256_set1_ps(matte.inner);
+    const __m256 scale = _mm256_set1_ps(matte.scale);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max = _mm256_set1_ps(255.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const auto weigh = [](const float (&weights)[3], const __m256 r, const __m256 g, const __m256 b) {
+      return _mm256_add_ps(
+        _mm256_add_ps(
+          _mm256_mul_ps(_mm256_set1_ps(weights[0]), r),
+          _mm256_mul_ps(_mm256_set1_ps(weights[1]), g)),
+        _mm256_mul_ps(_mm256_set1_ps(weights[2]), b));
+    };
+    for (; 3 * i + 28 <= 3 * num_pixels; i += 8) {
+      const __m256i pixels = load_rgb8(rgb + 3 * i);
+      const __m256 r = _mm256_cvtepi32_ps(channel_lanes(pixels, 0));
+      const __m256 g = _mm256_cvtepi32_ps(channel_lanes(pixels, 1));
+      const __m256 b = _mm256_cvtepi32_ps(channel_lanes(pixels, 2));
+      const __m256 cb = _mm256_sub_ps(weigh(cb_weights, r, g, b), key_cb);
+      const __m256 cr = _mm256_sub_ps(weigh(cr_weights, r, g, b), key_cr);
+      const __m256 distance = _mm256_sqrt_ps(
+        _mm256_add_ps(_mm256_mul_ps(cb, cb), _mm256_mul_ps(cr, cr)));
+      const __m256 ramp = _mm256_mul_ps(_mm256_sub_ps(distance, inner), scale);
+      const __m256i alpha = _mm256_cvttps_epi32(
+        _mm256_add_ps(_mm256_min_ps(_mm256_max_ps(ramp, zero), max), half));
+      _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(rgba + 4 * i),
+        _mm256_or_si256(_mm256_shuffle_epi8(pixels, take_rgb), _mm256_slli_epi32(alpha, 24)));
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      rgba[4 * i] = rgb[3 * i];
+      rgba[4 * i + 1] = rgb[3 * i + 1];
+      rgba[4 * i + 2] = rgb[3 * i + 2];
+      rgba[4 * i + 3] = matte.alpha(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+    }
+  }
+}
+
+void chroma_key(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const std::array<unsigned char, 3> & key,
+  const double inner,
+  const double outer,
+  std::vector<unsigned char> & rgba)
+{
+  assert(inner >= 0.0 && outer >= inner);
+  rgba.resize((std::size_t)width * height * 4);
+
+  Matte matte;
+  matte.key_cb = cb_weights[0] * key[0] + cb_weights[1] * key[1] + cb_weights[2] * key[2];
+  matte.key_cr = cr_weights[0] * key[0] + cr_weights[1] * key[1] + cr_weights[2] * key[2];
+  matte.inner = inner;
+  // A hard key (inner == outer) becomes a very steep ramp
+  matte.scale = 255.0 / std::max(outer - inner, 1e-3);
+
+  parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+    key_span(
+      rgb.data() + (std::size_t)3 * begin * width,
+      (end - begin) * width,
+      matte,
+      rgba.data() + (std::size_t)4 * begin * width);
+  });
+}
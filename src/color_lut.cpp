@@ -0,0 +1,329 @@
+#include "color_lut.h"
+#include "parallel_for.h"
+#include "rgb_lanes.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  // Grid coordinate x = intensity*scale + offset of each channel
+  struct LutCoordinates
+  {
+    float scale[3];
+    float offset[3];
+  };
+
+  LutCoordinates lut_coordinates(const ColorLut & lut)
+  {
+    LutCoordinates coordinates;
+    for (int c = 0; c < 3; ++c) {
+      const float extent = lut.domain_max[c] - lut.domain_min[c];
+      coordinates.scale[c] = (lut.size - 1) / (255.0f * extent);
+      coordinates.offset[c] = -lut.domain_min[c] * (lut.size - 1) / extent;
+    }
+    return coordinates;
+  }
+
+  // Tetrahedral interpolation of one pixel. The unit cube around the pixel
+  // is split into 6 tetrahedra along its 000-111 diagonal; the one holding
+  // the pixel runs from corner 000 along the axis with the largest
+  // fraction (A), then the second largest (B), to corner 111.
+  inline void interpolate_pixel(
+    const ColorLut & lut,
+    const LutCoordinates & coordinates,
+    const unsigned char * rgb,
+    unsigned char * graded)
+  {
+    const int size = lut.size;
+    const int strides[3] = {3, 3 * size, 3 * size * size};
+    int node = 0;
+    float fraction[3];
+    for (int c = 0; c < 3; ++c) {
+      const float x = std::min(std::max(
+        rgb[c] * coordinates.scale[c] + coordinates.offset[c], 0.0f), (float)(size - 1));
+      const int base = std::min((int)x, size - 2);
+      fraction[c] = x - base;
+      node += base * strides[c];
+    }
+    const float fr = fraction[0], fg = fraction[1], fb = fraction[2];
+    // Ties may pick any order, as long as the max and min axes differ
+    const int max_axis = (fr >= fg && fr >= fb) ? 0 : (fg >= fb ? 1 : 2);
+    const int min_axis = (fb <= fg && fb <= fr) ? 2 : (fg <= fr && fg <= fb ? 1 : 0);
+    const float f1 = fraction[max_axis];
+    const float f3 = fraction[min_axis];
+    const float f2 = std::max(std::min(fr, fg), std::min(std::max(fr, fg), fb));
+    const float * c000 = lut.data.data() + node;
+    const float * ca = c000 + strides[max_axis];
+    const float * cb = c000 + strides[0] + strides[1] + strides[2] - strides[min_axis];
+    const float * c111 = c000 + strides[0] + strides[1] + strides[2];
+    for (int c = 0; c < 3; ++c) {
+      const float value =
+        (1 - f1) * c000[c] + (f1 - f2) * ca[c] + (f2 - f3) * cb[c] + f3 * c111[c];
+      graded[c] = (unsigned char)std::min(std::max(value * 255.0f + 0.5f, 0.0f), 255.0f);
+    }
+  }
+
+  // Apply the table to num_pixels interleaved rgb pixels
+  void interpolate_span(
+    const ColorLut & lut,
+    const LutCoordinates & coordinates,
+    const unsigned char * rgb,
+    const int num_pixels,
+    unsigned char * graded)
+  {
+    int i = 0;
+#if defined(__AVX2__)
+    const int size = lut.size;
+    const int strides[3] = {3, 3 * size, 3 * size * size};
+    const __m256 last = _mm256_set1_ps((float)(size - 1));
+    const __m256i last_base = _mm256_set1_epi32(size - 2);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    // load_rgb8 and store_rgb8 touch 28 bytes
+    for (; 3 * i + 28 <= 3 * num_pixels; i += 8) {
+      const __m256i v = load_rgb8(rgb + 3 * i);
+      __m256i node = _mm256_setzero_si256();
+      __m256 fraction[3];
+      for (int c = 0; c < 3; ++c) {
+        const __m256 x = _mm256_min_ps(_mm256_max_ps(
+          _mm256_add_ps(
+            _mm256_mul_ps(
+              _mm256_cvtepi32_ps(channel_lanes(v, c)),
+              _mm256_set1_ps(coordinates.scale[c])),
+            _mm256_set1_ps(coordinates.offset[c])),
+          _mm256_setzero_ps()), last);
+        const __m256i base = _mm256_min_epi32(_mm256_cvttps_epi32(x), last_base);
+        fraction[c] = _mm256_sub_ps(x, _mm256_cvtepi32_ps(base));
+        node = _mm256_add_epi32(node, _mm256_mullo_epi32(base, _mm256_set1_epi32(strides[c])));
+      }
+      const __m256 fr = fraction[0], fg = fraction[1], fb = fraction[2];
+
+      // Same choice of tetrahedron as interpolate_pixel
+      const __m256 r_is_max = _mm256_and_ps(
+        _mm256_cmp_ps(fr, fg, _CMP_GE_OQ), _mm256_cmp_ps(fr, fb, _CMP_GE_OQ));
+      const __m256 g_over_b = _mm256_cmp_ps(fg, fb, _CMP_GE_OQ);
+      const __m256 b_is_min = _mm256_and_ps(
+        _mm256_cmp_ps(fb, fg, _CMP_LE_OQ), _mm256_cmp_ps(fb, fr, _CMP_LE_OQ));
+      const __m256 g_is_min = _mm256_and_ps(
+        _mm256_cmp_ps(fg, fr, _CMP_LE_OQ), _mm256_cmp_ps(fg, fb, _CMP_LE_OQ));
+      const auto select = [](const __m256 mask, const int a, const int b) {
+        return _mm256_castps_si256(_mm256_blendv_ps(
+          _mm256_castsi256_ps(_mm256_set1_epi32(b)),
+          _mm256_castsi256_ps(_mm256_set1_epi32(a)), mask));
+      };
+      const __m256i max_stride = _mm256_castps_si256(_mm256_blendv_ps(
+        _mm256_castsi256_ps(select(g_over_b, strides[1], strides[2])),
+        _mm256_castsi256_ps(_mm256_set1_epi32(strides[0])), r_is_max));
+      const __m256i min_stride = _mm256_castps_si256(_mm256_blendv_ps(
+        _mm256_castsi256_ps(select(g_is_min, strides[1], strides[0])),
+        _mm256_castsi256_ps(_mm256_set1_epi32(strides[2])), b_is_min));
+      const __m256 f1 = _mm256_blendv_ps(_mm256_blendv_ps(fb, fg, g_over_b), fr, r_is_max);
+      const __m256 f3 = _mm256_blendv_ps(_mm256_blendv_ps(fr, fg, g_is_min), fb, b_is_min);
+      const __m256 f2 = _mm256_max_ps(_mm256_min_ps(fr, fg),
+        _mm256_min_ps(_mm256_max_ps(fr, fg), fb));
+      const __m256 w000 = _mm256_sub_ps(one, f1);
+      const __m256 wa = _mm256_sub_ps(f1, f2);
+      const __m256 wb = _mm256_sub_ps(f2, f3);
+      const __m256i diagonal = _mm256_set1_epi32(strides[0] + strides[1] + strides[2]);
+      const __m256i node_a = _mm256_add_epi32(node, max_stride);
+      const __m256i node_b = _mm256_sub_epi32(_mm256_add_epi32(node, diagonal), min_stride);
+      const __m256i node_111 = _mm256_add_epi32(node, diagonal);
+
+      __m256i packed = _mm256_setzero_si256();
+      for (int c = 0; c < 3; ++c) {
+        const float * data = lut.data.data() + c;
+        // Summed in the same order as interpolate_pixel
+        __m256 value = _mm256_mul_ps(w000, _mm256_i32gather_ps(data, node, 4));
+        value = _mm256_add_ps(value, _mm256_mul_ps(wa, _mm256_i32gather_ps(data, node_a, 4)));
+        value = _mm256_add_ps(value, _mm256_mul_ps(wb, _mm256_i32gather_ps(data, node_b, 4)));
+        value = _mm256_add_ps(value, _mm256_mul_ps(f3, _mm256_i32gather_ps(data, node_111, 4)));
+        const __m256i intensity = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(
+          _mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)),
+          _mm256_setzero_ps()), _mm256_set1_ps(255.0f)));
+        packed = _mm256_or_si256(packed, _mm256_slli_epi32(intensity, 8 * c));
+      }
+      store_rgb8(packed, graded + 3 * i);
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      interpolate_pixel(lut, coordinates, rgb + 3 * i, graded + 3 * i);
+    }
+  }
+}
+
+void bake_color_lut(
+  const int size,
+  const std::vector<ColorEdit> & chain,
+  ColorLut & lut)
+{
+  assert(size >= 2 && size <= 256);
+  lut.size = size;
+  for (int c = 0; c < 3; ++c) {
+    lut.domain_min[c] = 0;
+    lut.domain_max[c] = 1;
+  }
+
+  // Integer intensities just below and above each grid position
+  std::vector<int> below(size);
+  std::vector<double> weight(size);
+  std::vector<int> levels;
+  for (int i = 0; i < size; ++i) {
+    const double x = 255.0 * i / (size - 1);
+    below[i] = std::min((int)std::floor(x), 254);
+    weight[i] = x - below[i];
+    levels.push_back(below[i]);
+    levels.push_back(below[i] + 1);
+  }
+  std::sort(levels.begin(), levels.end());
+  levels.erase(std::unique(levels.begin(), levels.end()), levels.end());
+  int level_index[256];
+  for (int k = 0; k < (int)levels.size(); ++k) {
+    level_index[levels[k]] = k;
+  }
+
+  // Run the chain once over every combination of those intensities
+  const int n = (int)levels.size();
+  std::vector<unsigned char> lattice((size_t)n * n * n * 3);
+  for (int b = 0; b < n; ++b) {
+    for (int g = 0; g < n; ++g) {
+      for (int r = 0; r < n; ++r) {
+        unsigned char * pixel = lattice.data() + 3 * (((size_t)b * n + g) * n + r);
+        pixel[0] = levels[r];
+        pixel[1] = levels[g];
+        pixel[2] = levels[b];
+      }
+    }
+  }
+  std::vector<unsigned char> edited;
+  for (const auto & edit : chain) {
+    edit(lattice, n, n * n, edited);
+    lattice.swap(edited);
+  }
+
+  // Blend the 8 edited neighbors of each grid point
+  lut.data.resize((size_t)size * size * size * 3);
+  for (int b = 0; b < size; ++b) {
+    for (int g = 0; g < size; ++g) {
+      for (int r = 0; r < size; ++r) {
+        double value[3] = {0, 0, 0};
+        for (int corner = 0; corner < 8; ++corner) {
+          const int dr = corner & 1, dg = (corner >> 1) & 1, db = corner >> 2;
+          const double w =
+            (dr ? weight[r] : 1 - weight[r]) *
+            (dg ? weight[g] : 1 - weight[g]) *
+            (db ? weight[b] : 1 - weight[b]);
+          const unsigned char * pixel = lattice.data() + 3 * (
+            ((size_t)level_index[below[b] + db] * n + level_index[below[g] + dg]) * n +
+            level_index[below[r] + dr]);
+          for (int c = 0; c < 3; ++c) {
+            value[c] += w * pixel[c];
+          }
+        }
+        float * node = lut.data.data() + 3 * (((size_t)b * size + g) * size + r);
+        for (int c = 0; c < 3; ++c) {
+          node[c] = (float)(value[c] / 255.0);
+        }
+      }
+    }
+  }
+}
+
+bool read_cube(
+  const std::string & filename,
+  ColorLut & lut)
+{
+  std::ifstream ifs(filename);
+  if (!ifs) {
+    std::cerr << "Failed to open " << filename << std::endl;
+    return false;
+  }
+
+  lut.size = 0;
+  lut.data.clear();
+  for (int c = 0; c < 3; ++c) {
+    lut.domain_min[c] = 0;
+    lut.domain_max[c] = 1;
+  }
+  std::string line;
+  while (std::getline(ifs, line)) {
+    std::istringstream fields(line);
+    std::string keyword;
+    if (!(fields >> keyword) || keyword[0] == '#' || keyword == "TITLE") {
+      continue;
+    }
+    if (keyword == "LUT_3D_SIZE") {
+      fields >> lut.size;
+      if (!fields || lut.size < 2 || lut.size > 256) {
+        std::cerr << filename << ": unsupported LUT_3D_SIZE" << std::endl;
+        return false;
+      }
+      lut.data.reserve((size_t)lut.size * lut.size * lut.size * 3);
+    } else if (keyword == "DOMAIN_MIN" || keyword == "DOMAIN_MAX") {
+      float * domain = keyword == "DOMAIN_MIN" ? lut.domain_min : lut.domain_max;
+      if (!(fields >> domain[0] >> domain[1] >> domain[2])) {
+        std::cerr << filename << ": malformed " << keyword << std::endl;
+        return false;
+      }
+    } else if (keyword == "LUT_3D_INPUT_RANGE") {
+      if (!(fields >> lut.domain_min[0] >> lut.domain_max[0])) {
+        std::cerr << filename << ": malformed " << keyword << std::endl;
+        return false;
+      }
+      std::fill(lut.domain_min + 1, lut.domain_min + 3, lut.domain_min[0]);
+      std::fill(lut.domain_max + 1, lut.domain_max + 3, lut.domain_max[0]);
+    } else if (keyword == "LUT_1D_SIZE") {
+      std::cerr << filename << ": 1D lookup tables are not supported" << std::endl;
+      return false;
+    } else {
+      // A table entry: three values, the first already read as the keyword
+      float entry[3];
+      std::istringstream values(line);
+      if (!(values >> entry[0] >> entry[1] >> entry[2])) {
+        std::cerr << filename << ": unexpected line: " << line << std::endl;
+        return false;
+      }
+      lut.data.insert(lut.data.end(), entry, entry + 3);
+    }
+  }
+
+  if (lut.size == 0 || lut.data.size() != (size_t)lut.size * lut.size * lut.size * 3) {
+    std::cerr << filename << ": expected LUT_3D_SIZE^3 table entries" << std::endl;
+    return false;
+  }
+  for (int c = 0; c < 3; ++c) {
+    if (!(lut.domain_max[c] > lut.domain_min[c])) {
+      std::cerr << filename << ": empty domain" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+void apply_color_lut(
+  const ColorLut & lut,
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  std::vector<unsigned char> & graded)
+{
+  assert(lut.size >= 2 && lut.data.size() == (size_t)lut.size * lut.size * lut.size * 3);
+  graded.resize((size_t)width * height * 3);
+  const LutCoordinates coordinates = lut_coordinates(lut);
+  parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+    interpolate_span(
+      lut,
+      coordinates,
+      rgb.data() + (size_t)3 * begin * width,
+      (end - begin) * width,
+      graded.data() + (size_t)3 * begin * width);
+  });
+}
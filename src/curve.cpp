@@ -0,0 +1,138 @@
+#include "curve.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+  inline double clamp01(const double x)
+  {
+    return std::clamp(x, 0.0, 1.0);
+  }
+}
+
+Curve brightness_curve(const double offset)
+{
+  return [offset](const double x) { return x + offset; };
+}
+
+Curve contrast_curve(const double factor)
+{
+  return [factor](const double x) { return (x - 0.5) * factor + 0.5; };
+}
+
+Curve gamma_curve(const double gamma)
+{
+  assert(gamma > 0.0);
+  return [gamma](const double x) { return std::pow(clamp01(x), 1.0 / gamma); };
+}
+
+Curve levels_curve(
+  const double in_black,
+  const double in_white,
+  const double gamma,
+  const double out_black,
+  const double out_white)
+{
+  assert(in_white > in_black && gamma > 0.0);
+  return [=](const double x) {
+    const double stretched = clamp01((x - in_black) / (in_white - in_black));
+    return out_black + (out_white - out_black) * std::pow(stretched, 1.0 / gamma);
+  };
+}
+
+Curve spline_curve(const std::vector<std::array<double, 2>> & points)
+{
+  const int n = points.size();
+  assert(n >= 2);
+  std::vector<double> xs(n), ys(n), slopes(n);
+  for (int k = 0; k < n; ++k) {
+    xs[k] = points[k][0];
+    ys[k] = points[k][1];
+    assert(k == 0 || xs[k] > xs[k - 1]);
+  }
+
+  // Secant slopes, then tangents at the points: the average of the
+  // neighboring secants, or 0 at a local extremum
+  std::vector<double> secants(n - 1);
+  for (int k = 0; k + 1 < n; ++k) {
+    secants[k] = (ys[k + 1] - ys[k]) / (xs[k + 1] - xs[k]);
+  }
+  slopes[0] = secants[0];
+  slopes[n - 1] = secants[n - 2];
+  for (int k = 1; k + 1 < n; ++k) {
+    slopes[k] = secants[k - 1] * secants[k] <= 0.0 ?
+      0.0 : 0.5 * (secants[k - 1] + secants[k]);
+  }
+  // Fritsch-Carlson: shrink tangents that would make a segment overshoot
+  for (int k = 0; k + 1 < n; ++k) {
+    if (secants[k] == 0.0) {
+      slopes[k] = slopes[k + 1] = 0.0;
+      continue;
+    }
+    const double a = slopes[k] / secants[k];
+    const double b = slopes[k + 1] / secants[k];
+    const double length = a * a + b * b;
+    if (length > 9.0) {
+      const double tau = 3.0 / std::sqrt(length);
+      slopes[k] = tau * a * secants[k];
+      slopes[k + 1] = tau * b * secants[k];
+    }
+  }
+
+  return [xs, ys, slopes](const double x) {
+    if (x <= xs.front()) {
+      return ys.front();
+    }
+    if (x >= xs.back()) {
+      return ys.back();
+    }
+    const int k = std::upper_bound(xs.begin(), xs.end(), x) - xs.begin() - 1;
+    const double h = xs[k + 1] - xs[k];
+    const double t = (x - xs[k]) / h;
+    // Cubic Hermite basis
+    const double t2 = t * t;
+    const double t3 = t2 * t;
+    return (2 * t3 - 3 * t2 + 1) * ys[k] + (t3 - 2 * t2 + t) * h * slopes[k] +
+      (-2 * t3 + 3 * t2) * ys[k + 1] + (t3 - t2) * h * slopes[k + 1];
+  };
+}
+
+Curve compose_curves(const std::vector<Curve> & curves)
+{
+  return [curves](double x) {
+    for (const Curve & curve : curves) {
+      x = clamp01(curve(x));
+    }
+    return x;
+  };
+}
+
+IntensityLut bake_curve(const Curve & curve)
+{
+  IntensityLut lut;
+  for (int i = 0; i < 256; ++i) {
+    lut[i] = std::lround(255.0 * clamp01(curve(i / 255.0)));
+  }
+  return lut;
+}
+
+void apply_curves(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels,
+  const std::vector<Curve> & curves,
+  std::vector<unsigned char> & output)
+{
+  assert(curves.size() == 1 || (int)curves.size() == num_channels);
+  if (curves.size() == 1) {
+    apply_intensity_lut(image, width, height, num_channels, bake_curve(curves[0]), output);
+    return;
+  }
+  std::vector<IntensityLut> luts;
+  for (const Curve & curve : curves) {
+    luts.push_back(bake_curve(curve));
+  }
+  apply_intensity_luts(image, width, height, num_channels, luts, output);
+}
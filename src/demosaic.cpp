@@ -1,8 +1,399 @@
 #include "demosaic.h"
-#include <iostream>
+#include "parallel_for.h"
+#include "srgb.h"
 #include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <cstdint>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace
+{
+  // In every Bayer pattern a green pixel has its row's other color on its
+  // left and right and the remaining color above and below, and a red or
+  // blue pixel has green on its four sides and the remaining color on its
+  // diagonals. So every missing color is one of four neighbor sets: the two
+  // vertical, the two horizontal, the four adjacent (cross) or the four
+  // diagonal neighbors. Each neighbor contributes its value divided by the
+  // size of its set, rounded down, so every sum still fits in a byte.
+  enum Neighbors { own, vertical, horizontal, cross, diagonal };
+
+  // Where channel c of a pixel at column parity q, row parity r comes from
+  constexpr Neighbors neighbors(const CfaPattern pattern, const int q, const int r, const int c)
+  {
+    const int sampled = cfa_channel(pattern, q, r);
+    if (c == sampled) {
+      return own;
+    }
+    if (sampled == 1) {
+      return c == cfa_channel(pattern, 1 - q, r) ? horizontal : vertical;
+    }
+    return c == 1 ? cross : diagonal;
+  }
+
+  // Demosaic pixel (x,y) near the border, where some neighbors are outside
+  // the image and the sets shrink to the neighbors that are inside
+  template <CfaPattern pattern>
+  void demosaic_border_pixel(
+    const unsigned char * bayer,
+    const int width,
+    const int height,
+    const int x,
+    const int y,
+    unsigned char * pixel)
+  {
+    const int x0 = std::max(x - 1, 0);
+    const int x1 = std::min(x + 1, width - 1);
+    const int y0 = std::max(y - 1, 0);
+    const int y1 = std::min(y + 1, height - 1);
+    int count[3] = {0, 0, 0};
+    for (int ny = y0; ny <= y1; ++ny) {
+      for (int nx = x0; nx <= x1; ++nx) {
+        count[cfa_channel(pattern, nx, ny)]++;
+      }
+    }
+    int sum[3] = {0, 0, 0};
+    for (int ny = y0; ny <= y1; ++ny) {
+      for (int nx = x0; nx <= x1; ++nx) {
+        const int c = cfa_channel(pattern, nx, ny);
+        sum[c] += bayer[ny * width + nx] / count[c];
+      }
+    }
+    // The center keeps its own sample (only the sums of the two missing
+    // colors are used). A color with no neighbors at all (in images a single
+    // row or column wide) is 0.
+    const int center = cfa_channel(pattern, x, y);
+    for (int c = 0; c < 3; ++c) {
+      pixel[c] = c == center ? bayer[y * width + x] : (unsigned char)sum[c];
+    }
+  }
+
+#if defined(__SSSE3__)
+  // pshufb masks moving channel k of 16 pixels into the j-th of the three
+  // 16-byte blocks of their interleaved rgb (0x80 zeroes a lane)
+  struct InterleaveMasks {
+    alignas(16) unsigned char bytes[3][3][16];
+  };
+
+  constexpr InterleaveMasks make_interleave_masks()
+  {
+    InterleaveMasks masks{};
+    for (int k = 0; k < 3; ++k) {
+      for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 16; ++i) {
+          // interleaved byte 16*j+i comes from planar byte (16*j+i)/3
+          const int target = 16 * j + i;
+          masks.bytes[k][j][i] = (target % 3 == k) ? target / 3 : 0x80;
+        }
+      }
+    }
+    return masks;
+  }
+
+  constexpr InterleaveMasks interleave_masks = make_interleave_masks();
+
+  inline __m128i mask(const int k, const int j)
+  {
+    return _mm_load_si128(reinterpret_cast<const __m128i *>(interleave_masks.bytes[k][j]));
+  }
+#endif
+
+  // Demosaic the interior columns [2,x_end) of a row whose neighbors above
+  // and below are both inside the image. Columns come in (even,odd) pairs,
+  // i.e., one row of a 2x2 quad, and the pattern and row parity are fixed
+  // at compile time, so no pixel picks its formula at run time.
+  template <CfaPattern pattern, int row_parity>
+  void demosaic_interior(
+    const unsigned char * up,
+    const unsigned char * center,
+    const unsigned char * down,
+    const int x_end,
+    unsigned char * rgb)
+  {
+    constexpr Neighbors sources[2][3] = {
+      {neighbors(pattern, 0, row_parity, 0), neighbors(pattern, 0, row_parity, 1), neighbors(pattern, 0, row_parity, 2)},
+      {neighbors(pattern, 1, row_parity, 0), neighbors(pattern, 1, row_parity, 1), neighbors(pattern, 1, row_parity, 2)}};
+    int x = 2;
+#if defined(__SSSE3__)
+    // 16 pixels per step, sums computed directly on bytes. Lanes hold even
+    // and odd columns alternately, and each channel picks one of the two
+    // neighbor sums per lane.
+    const __m128i even_lanes = _mm_set1_epi16(0x00FF);
+    const __m128i seven_bits = _mm_set1_epi8(0x7F);
+    const __m128i six_bits = _mm_set1_epi8(0x3F);
+    const auto load = [](const unsigned char * p) {
+      return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    };
+    const auto half = [&](const __m128i v) {
+      return _mm_and_si128(_mm_srli_epi16(v, 1), seven_bits);
+    };
+    const auto quarter = [&](const __m128i v) {
+      return _mm_and_si128(_mm_srli_epi16(v, 2), six_bits);
+    };
+    const auto select = [&](const __m128i even, const __m128i odd) {
+      return _mm_or_si128(_mm_and_si128(even_lanes, even), _mm_andnot_si128(even_lanes, odd));
+    };
+    for (; x + 16 <= x_end; x += 16) {
+      const __m128i left = load(center + x - 1);
+      const __m128i right = load(center + x + 1);
+      const __m128i sums[5] = {
+        load(center + x),
+        _mm_add_epi8(half(load(up + x)), half(load(down + x))),
+        _mm_add_epi8(half(left), half(right)),
+        _mm_add_epi8(
+          _mm_add_epi8(quarter(load(up + x)), quarter(load(down + x))),
+          _mm_add_epi8(quarter(left), quarter(right))),
+        _mm_add_epi8(
+          _mm_add_epi8(quarter(load(up + x - 1)), quarter(load(up + x + 1))),
+          _mm_add_epi8(quarter(load(down + x - 1)), quarter(load(down + x + 1))))};
+      const __m128i channels[3] = {
+        select(sums[sources[0][0]], sums[sources[1][0]]),
+        select(sums[sources[0][1]], sums[sources[1][1]]),
+        select(sums[sources[0][2]], sums[sources[1][2]])};
+      for (int block = 0; block < 3; ++block) {
+        const __m128i packed = _mm_or_si128(
+          _mm_or_si128(
+            _mm_shuffle_epi8(channels[0], mask(0, block)),
+            _mm_shuffle_epi8(channels[1], mask(1, block))),
+          _mm_shuffle_epi8(channels[2], mask(2, block)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(rgb + 3 * x + 16 * block), packed);
+      }
+    }
+#endif
+    for (; x < x_end; x += 2) {
+      for (int odd = 0; odd < 2; ++odd) {
+        const int i = x + odd;
+        const int sums[5] = {
+          center[i],
+          up[i] / 2 + down[i] / 2,
+          center[i - 1] / 2 + center[i + 1] / 2,
+          up[i] / 4 + down[i] / 4 + center[i - 1] / 4 + center[i + 1] / 4,
+          up[i - 1] / 4 + up[i + 1] / 4 + down[i - 1] / 4 + down[i + 1] / 4};
+        for (int c = 0; c < 3; ++c) {
+          rgb[3 * i + c] = (unsigned char)sums[sources[odd][c]];
+        }
+      }
+    }
+  }
+
+  // Demosaic the whole image, one row per iteration spread across threads
+  template <CfaPattern pattern>
+  void demosaic_pattern(
+    const unsigned char * bayer,
+    const int width,
+    const int height,
+    unsigned char * rgb)
+  {
+    // Interior pixels take whole column pairs starting at column 2; column 0,
+    // column 1, a last unpaired column, and the first and last rows take the
+    // border path
+    const int x_end = 2 + std::max(0, (width - 3) / 2 * 2);
+    parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+      for (int y = begin; y < end; ++y) {
+        const unsigned char * center = bayer + (std::size_t)y * width;
+        unsigned char * row = rgb + (std::size_t)3 * y * width;
+        if (y == 0 || y == height - 1) {
+          for (int x = 0; x < width; ++x) {
+            demosaic_border_pixel<pattern>(bayer, width, height, x, y, row + 3 * x);
+          }
+          continue;
+        }
+        for (int x = 0; x < std::min(2, width); ++x) {
+          demosaic_border_pixel<pattern>(bayer, width, height, x, y, row + 3 * x);
+        }
+        if (y % 2 == 0) {
+          demosaic_interior<pattern, 0>(center - width, center, center + width, x_end, row);
+        } else {
+          demosaic_interior<pattern, 1>(center - width, center, center + width, x_end, row);
+        }
+        for (int x = std::max(2, x_end); x < width; ++x) {
+          demosaic_border_pixel<pattern>(bayer, width, height, x, y, row + 3 * x);
+        }
+      }
+    });
+  }
+  // Malvar-He-Cutler gradient-corrected interpolation: each missing color
+  // starts from the bilinear estimate and adds the Laplacian of the sampled
+  // color at the center, through 5x5 kernels. In 1/16 units (i.e., twice
+  // the published eighths) every weight is an integer:
+  //   own         16 c
+  //   vertical    10 c + 8 (up + down) - 2 (diagonals) - 2 (up2 + down2) + (left2 + right2)
+  //   horizontal  10 c + 8 (left + right) - 2 (diagonals) - 2 (left2 + right2) + (up2 + down2)
+  //   cross       8 c + 4 (up + down + left + right) - 2 (up2 + down2 + left2 + right2)
+  //   diagonal    12 c + 4 (diagonals) - 3 (up2 + down2 + left2 + right2)
+  // so the sums stay within 16 bits and each pixel is (sum + 8) >> 4,
+  // clamped to 0-255.
+
+  // The five sums of the pixel whose neighbor (dx,dy) is at(dx,dy)
+  template <typename At>
+  inline void malvar_sums(const At & at, int sums[5])
+  {
+    const int c = at(0, 0);
+    const int vertical1 = at(0, -1) + at(0, 1);
+    const int horizontal1 = at(-1, 0) + at(1, 0);
+    const int vertical2 = at(0, -2) + at(0, 2);
+    const int horizontal2 = at(-2, 0) + at(2, 0);
+    const int diagonals = at(-1, -1) + at(1, -1) + at(-1, 1) + at(1, 1);
+    sums[own] = 16 * c;
+    sums[vertical] = 10 * c + 8 * vertical1 - 2 * diagonals - 2 * vertical2 + horizontal2;
+    sums[horizontal] = 10 * c + 8 * horizontal1 - 2 * diagonals - 2 * horizontal2 + vertical2;
+    sums[cross] = 8 * c + 4 * (vertical1 + horizontal1) - 2 * (vertical2 + horizontal2);
+    sums[diagonal] = 12 * c + 4 * diagonals - 3 * (vertical2 + horizontal2);
+  }
+
+  inline unsigned char malvar_round(const int sum)
+  {
+    return (unsigned char)std::min(std::max((sum + 8) >> 4, 0), 255);
+  }
+
+  // Index i mirrored into [0,n) without repeating the edge (-1 -> 1,
+  // n -> n-2), which keeps every sample's color for n >= 3
+  inline int reflect_index(const int i, const int n)
+  {
+    const int mirrored = i < 0 ? -i : i;
+    return mirrored >= n ? 2 * (n - 1) - mirrored : mirrored;
+  }
+
+  // Malvar-He-Cutler at pixel (x,y) within 2 pixels of the border, reading
+  // the image as if mirrored about its edges
+  template <CfaPattern pattern>
+  void malvar_border_pixel(
+    const unsigned char * bayer,
+    const int width,
+    const int height,
+    const int x,
+    const int y,
+    unsigned char * pixel)
+  {
+    int sums[5];
+    malvar_sums([&](const int dx, const int dy) {
+      return (int)bayer[reflect_index(y + dy, height) * width + reflect_index(x + dx, width)];
+    }, sums);
+    for (int c = 0; c < 3; ++c) {
+      pixel[c] = malvar_round(sums[neighbors(pattern, x % 2, y % 2, c)]);
+    }
+  }
+
+  // Malvar-He-Cutler on the columns [2,x_end) of a row at least 2 rows from
+  // the top and bottom, in (even,odd) column pairs as in demosaic_interior.
+  // rows[k] is the row k-2 rows below this one.
+  template <CfaPattern pattern, int row_parity>
+  void malvar_interior(
+    const unsigned char * const (&rows)[5],
+    const int x_end,
+    unsigned char * rgb)
+  {
+    constexpr Neighbors sources[2][3] = {
+      {neighbors(pattern, 0, row_parity, 0), neighbors(pattern, 0, row_parity, 1), neighbors(pattern, 0, row_parity, 2)},
+      {neighbors(pattern, 1, row_parity, 0), neighbors(pattern, 1, row_parity, 1), neighbors(pattern, 1, row_parity, 2)}};
+    int x = 2;
+#if defined(__AVX2__)
+    // 16 pixels per step in 16-bit lanes, even and odd columns alternating
+    const auto load = [&](const int dx, const int dy) {
+      return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[dy + 2] + x + dx)));
+    };
+    const auto times = [](const int weight, const __m256i v) {
+      return _mm256_mullo_epi16(_mm256_set1_epi16((short)weight), v);
+    };
+    for (; x + 16 <= x_end; x += 16) {
+      const __m256i c = load(0, 0);
+      const __m256i vertical1 = _mm256_add_epi16(load(0, -1), load(0, 1));
+      const __m256i horizontal1 = _mm256_add_epi16(load(-1, 0), load(1, 0));
+      const __m256i vertical2 = _mm256_add_epi16(load(0, -2), load(0, 2));
+      const __m256i horizontal2 = _mm256_add_epi16(load(-2, 0), load(2, 0));
+      const __m256i diagonals = _mm256_add_epi16(
+        _mm256_add_epi16(load(-1, -1), load(1, -1)),
+        _mm256_add_epi16(load(-1, 1), load(1, 1)));
+      const __m256i both1 = _mm256_add_epi16(vertical1, horizontal1);
+      const __m256i both2 = _mm256_add_epi16(vertical2, horizontal2);
+      const __m256i sums[5] = {
+        _mm256_slli_epi16(c, 4),
+        _mm256_add_epi16(
+          _mm256_add_epi16(times(10, c), _mm256_slli_epi16(vertical1, 3)),
+          _mm256_sub_epi16(horizontal2, _mm256_slli_epi16(_mm256_add_epi16(diagonals, vertical2), 1))),
+        _mm256_add_epi16(
+          _mm256_add_epi16(times(10, c), _mm256_slli_epi16(horizontal1, 3)),
+          _mm256_sub_epi16(vertical2, _mm256_slli_epi16(_mm256_add_epi16(diagonals, horizontal2), 1))),
+        _mm256_sub_epi16(
+          _mm256_add_epi16(_mm256_slli_epi16(c, 3), _mm256_slli_epi16(both1, 2)),
+          _mm256_slli_epi16(both2, 1)),
+        _mm256_sub_epi16(
+          _mm256_add_epi16(times(12, c), _mm256_slli_epi16(diagonals, 2)),
+          times(3, both2))};
+      __m128i channels[3];
+      for (int k = 0; k < 3; ++k) {
+        // Odd lanes from the odd-column sum, then round, shift and saturate
+        const __m256i chosen = _mm256_srai_epi16(_mm256_add_epi16(
+          _mm256_blend_epi16(sums[sources[0][k]], sums[sources[1][k]], 0xAA), _mm256_set1_epi16(8)), 4);
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(chosen, chosen), 0x08);
+        channels[k] = _mm256_castsi256_si128(packed);
+      }
+      for (int block = 0; block < 3; ++block) {
+        const __m128i packed = _mm_or_si128(
+          _mm_or_si128(
+            _mm_shuffle_epi8(channels[0], mask(0, block)),
+            _mm_shuffle_epi8(channels[1], mask(1, block))),
+          _mm_shuffle_epi8(channels[2], mask(2, block)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(rgb + 3 * x + 16 * block), packed);
+      }
+    }
+#endif
+    for (; x < x_end; x += 2) {
+      for (int odd = 0; odd < 2; ++odd) {
+        const int i = x + odd;
+        int sums[5];
+        malvar_sums([&](const int dx, const int dy) { return (int)rows[dy + 2][i + dx]; }, sums);
+        for (int c = 0; c < 3; ++c) {
+          rgb[3 * i + c] = malvar_round(sums[sources[odd][c]]);
+        }
+      }
+    }
+  }
+
+  // Malvar-He-Cutler over the whole image (at least 3x3), one row per
+  // iteration spread across threads
+  template <CfaPattern pattern>
+  void malvar_pattern(
+    const unsigned char * bayer,
+    const int width,
+    const int height,
+    unsigned char * rgb)
+  {
+    // Interior pixels take whole column pairs starting at column 2 and
+    // ending 2 columns from the right; the rest take the border path
+    const int x_end = 2 + std::max(0, (width - 4) / 2 * 2);
+    parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+      for (int y = begin; y < end; ++y) {
+        unsigned char * row = rgb + (std::size_t)3 * y * width;
+        if (y < 2 || y >= height - 2) {
+          for (int x = 0; x < width; ++x) {
+            malvar_border_pixel<pattern>(bayer, width, height, x, y, row + 3 * x);
+          }
+          continue;
+        }
+        for (int x = 0; x < std::min(2, width); ++x) {
+          malvar_border_pixel<pattern>(bayer, width, height, x, y, row + 3 * x);
+        }
+        const unsigned char * center = bayer + (std::size_t)y * width;
+        const unsigned char * const rows[5] = {
+          center - 2 * width, center - width, center, center + width, center + 2 * width};
+        if (y % 2 == 0) {
+          malvar_interior<pattern, 0>(rows, x_end, row);
+        } else {
+          malvar_interior<pattern, 1>(rows, x_end, row);
+        }
+        for (int x = std::max(2, x_end); x < width; ++x) {
+          malvar_border_pixel<pattern>(bayer, width, height, x, y, row + 3 * x);
+        }
+      }
+    });
+  }
+}
 
 void demosaic(
   const std::vector<unsigned char> & bayer,
@@ -10,91 +401,90 @@ void demosaic(
   const int & height,
   std::vector<unsigned char> & rgb)
 {
-  rgb.resize(width*height*3);
-  ////////////////////////////////////////////////////////////////////////////
-  // Add your code here
-  ////////////////////////////////////////////////////////////////////////////
-
   // green = even row even column (in terms of index), odd row odd column
   // red = odd row even column
   // blue = even row odd column
+  demosaic(bayer, width, height, CfaPattern::gbrg, rgb);
+}
+
+void demosaic(
+  const std::vector<unsigned char> & bayer,
+  const int & width,
+  const int & height,
+  const CfaPattern pattern,
+  std::vector<unsigned char> & rgb)
+{
+  assert(bayer.size() >= (std::size_t)width * height);
+  rgb.resize(width*height*3);
+  switch (pattern) {
+    case CfaPattern::rggb: demosaic_pattern<CfaPattern::rggb>(bayer.data(), width, height, rgb.data()); break;
+    case CfaPattern::bggr: demosaic_pattern<CfaPattern::bggr>(bayer.data(), width, height, rgb.data()); break;
+    case CfaPattern::grbg: demosaic_pattern<CfaPattern::grbg>(bayer.data(), width, height, rgb.data()); break;
+    case CfaPattern::gbrg: demosaic_pattern<CfaPattern::gbrg>(bayer.data(), width, height, rgb.data()); break;
+  }
+}
+
+void demosaic_linear(
+  const std::vector<unsigned char> & bayer,
+  const int & width,
+  const int & height,
+  std::vector<unsigned char> & rgb)
+{
+  rgb.resize(width*height*3);
+
+  // Channel sampled at (x,y) in the GBRG pattern: 0 red, 1 green, 2 blue
+  const auto sampled = [](const int x, const int y) {
+    return y % 2 == 0 ? (x % 2 == 0 ? 1 : 2) : (x % 2 == 0 ? 0 : 1);
+  };
 
+  // In a GBRG mosaic the 3x3 neighbors of a given color other than the
+  // center's are exactly the ones demosaic averages (e.g., up/down for red
+  // at an even-row green, the diagonals for red at a blue)
   for (int y = 0; y < height; ++y) {
     for (int x = 0; x < width; ++x) {
-      int row = y * width;
-      int column = x;
-
-      int up = (y > 0) ? bayer[row - width + column] : 0;
-      int down = (y < height - 1) ? bayer[row + width + column] : 0;
-      int left = (x > 0) ? bayer[row + column - 1] : 0;
-      int right = (x < width - 1) ? bayer[row + column + 1] : 0;
-      int upleft = (y > 0 && x > 0) ? bayer[row - width + column - 1] : 0;
-      int upright = (y > 0 && x < width - 1) ? bayer[row - width + column + 1] : 0;
-      int downleft = (y < height - 1 && x > 0) ? bayer[row + width + column - 1] : 0;
-      int downright = (y < height - 1 && x < width - 1) ? bayer[row + width + column + 1] : 0;
-
-      // even row
-      if (y % 2 == 0) { 
-        // even column
-        if (x % 2 == 0) { 
-          // green
-          rgb[(row + column) * 3 + 1] = bayer[row + column];
-          
-          // red = average(up, down)
-          std::vector<int> red_values = {up, down};
-          int total_red = std::count_if(red_values.begin(), red_values.end(), [](int x) { return x != 0; });
-          rgb[(row + column) * 3] = static_cast<unsigned char>(std::floor(static_cast<double>(up + down)/ total_red));
-          // blue = average(left, right)
-          std::vector<int> blue_values = {left, right};
-          int total_blue = std::count_if(blue_values.begin(), blue_values.end(), [](int x) { return x != 0; });
-          rgb[(row + column) * 3 + 2] = static_cast<unsigned char>(std::floor(static_cast<double>(left + right) / total_blue));
-        } 
-        // odd column
-        else { 
-          // blue
-          rgb[(row + column) * 3 + 2] = bayer[row + column]; 
-
-          // red = average(diagonals)
-          std::vector<int> red_values = {upleft, upright, downleft, downright};
-          int total_red = std::count_if(red_values.begin(), red_values.end(), [](int x) { return x != 0; });
-          rgb[(row + column) * 3] = static_cast<unsigned char>(std::floor(static_cast<double>(upleft + upright + downleft + downright) / total_red));
-          // green = average(up, down, left, right)
-          std::vector<int> green_values = {up, down, left, right};
-          int total_green = std::count_if(green_values.begin(), green_values.end(), [](int x) { return x != 0; });
-          rgb[(row + column) * 3 + 1] = static_cast<unsigned char>(std::floor(static_cast<double>(up + down + left + right) / total_green));
+      const int center = sampled(x, y);
+      std::uint32_t sum[3] = {0, 0, 0};
+      std::uint32_t count[3] = {0, 0, 0};
+      for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, height - 1); ++ny) {
+        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); ++nx) {
+          const int c = sampled(nx, ny);
+          sum[c] += srgb_to_linear(bayer[ny * width + nx]);
+          count[c]++;
         }
-      } 
-      // odd row
-      else { 
-        // even column
-        if (x % 2 == 0) { 
-          // red
-          rgb[(row + column) * 3] = bayer[row + column]; 
-
-          // green = average(up, down, left, right)
-          std::vector<int> green_values = {up, down, left, right};
-          int total_green = std::count_if(green_values.begin(), green_values.end(), [](int x) { return x != 0; });
-          rgb[(row + column) * 3 + 1] = static_cast<unsigned char>(std::floor(static_cast<double>(up + down + left + right) / total_green));
-          // blue = average(diagonals)
-          std::vector<int> blue_values = {upleft, upright, downleft, downright};
-          int total_blue = std::count_if(blue_values.begin(), blue_values.end(), [](int x) { return x != 0; });
-          rgb[(row + column) * 3 + 2] = static_cast<unsigned char>(std::floor(static_cast<double>(upleft + upright + downleft + downright) / total_blue));
-        } 
-        // odd column
-        else { 
-          // green
-          rgb[(row + column) * 3 + 1] = bayer[row + column]; 
-
-          // red = average(left, right)
-          std::vector<int> red_values = {left, right};
-          int total_red = std::count_if(red_values.begin(), red_values.end(), [](int x) { return x != 0; });
-          rgb[(row + column) * 3] = static_cast<unsigned char>(std::floor(static_cast<double>(left + right) / total_red));
-          // blue = average(up, down)
-          std::vector<int> blue_values = {up, down};
-          int total_blue = std::count_if(blue_values.begin(), blue_values.end(), [](int x) { return x != 0; });
-          rgb[(row + column) * 3 + 2] = static_cast<unsigned char>(std::floor(static_cast<double>(up + down) / total_blue));
+      }
+      for (int c = 0; c < 3; ++c) {
+        if (c == center) {
+          rgb[(y * width + x) * 3 + c] = bayer[y * width + x];
+        } else if (count[c] == 0) {
+          // Only in images a single row or column wide
+          rgb[(y * width + x) * 3 + c] = 0;
+        } else {
+          rgb[(y * width + x) * 3 + c] =
+            linear_to_srgb((sum[c] + count[c] / 2) / count[c]);
         }
       }
     }
   }
 }
+
+void demosaic_malvar(
+  const std::vector<unsigned char> & bayer,
+  const int & width,
+  const int & height,
+  const CfaPattern pattern,
+  std::vector<unsigned char> & rgb)
+{
+  assert(bayer.size() >= (std::size_t)width * height);
+  if (width < 3 || height < 3) {
+    // Too small to mirror the 5x5 kernels about the edges
+    demosaic(bayer, width, height, pattern, rgb);
+    return;
+  }
+  rgb.resize(width*height*3);
+  switch (pattern) {
+    case CfaPattern::rggb: malvar_pattern<CfaPattern::rggb>(bayer.data(), width, height, rgb.data()); break;
+    case CfaPattern::bggr: malvar_pattern<CfaPattern::bggr>(bayer.data(), width, height, rgb.data()); break;
+    case CfaPattern::grbg: malvar_pattern<CfaPattern::grbg>(bayer.data(), width, height, rgb.data()); break;
+    case CfaPattern::gbrg: malvar_pattern<CfaPattern::gbrg>(bayer.data(), width, height, rgb.data()); break;
+  }
+}
@@ -1,6 +1,279 @@
 #include "desaturate.h"
 #include "hsv_to_rgb.h"
+#include "parallel_for.h"
+#include "rgb_lanes.h"
 #include "rgb_to_hsv.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+  // Desaturate a single pixel
+  void desaturate_pixel(
+    const int r,
+    const int g,
+    const int b,
+    const double factor,
+    unsigned char & new_r,
+    unsigned char & new_g,
+    unsigned char & new_b)
+  {
+    double h;
+    double s;
+    double v;
+    rgb_to_hsv(r, g, b, h, s, v);
+
+    // desaturate
+    s = s * (1 - factor);
+
+    double desaturated_r;
+    double desaturated_g;
+    double desaturated_b;
+    hsv_to_rgb(h, s, v, desaturated_r, desaturated_g, desaturated_b);
+
+    new_r = desaturated_r;
+    new_g = desaturated_g;
+    new_b = desaturated_b;
+  }
+
+  // The middle channel (max > mid > min) of desaturate_pixel, evaluated
+  // with the same double operations as rgb_to_hsv and hsv_to_rgb but
+  // without computing the other two channels
+  unsigned char desaturate_middle(
+    const int r,
+    const int g,
+    const int b,
+    const double factor)
+  {
+    const double r_prime = r / 255.0;
+    const double g_prime = g / 255.0;
+    const double b_prime = b / 255.0;
+    const double cmax = std::max({r_prime, g_prime, b_prime});
+    const double diff = cmax - std::min({r_prime, g_prime, b_prime});
+
+    // fmod(q, 6) == q for the |q| <= 1 of the red case
+    double h;
+    if (cmax == r_prime) {
+      h = 60 * ((g_prime - b_prime) / diff);
+    } else if (cmax == g_prime) {
+      h = 60 * ((b_prime - r_prime) / diff + 2);
+    } else {
+      h = 60 * ((r_prime - g_prime) / diff + 4);
+    }
+    if (h < 0.0) {
+      h += 360.0;
+    }
+
+    const double s = diff / cmax * (1 - factor);
+    const double c = cmax * s;
+    // h/60 is in [0,6), so fmod(h/60, 2) is this subtraction, which is exact
+    const double sector = h / 60.0;
+    const double x = c * (1 - std::fabs(sector - 2 * std::floor(sector / 2) - 1));
+    return (x + (cmax - c)) * 255;
+  }
+
+#if defined(__AVX2__)
+  // desaturate_middle of 4 pixels given as 32-bit lanes, with the same
+  // double operations (lanes without a distinct middle give garbage)
+  __m128i desaturate_middle_lanes(
+    const __m128i red,
+    const __m128i green,
+    const __m128i blue,
+    const __m128i max,
+    const __m128i min,
+    const double factor)
+  {
+    __m256d cmax;
+    __m256d diff;
+    const __m256d h = hue_lanes(red, green, blue, max, min, cmax, diff);
+    const __m256d s = _mm256_mul_pd(_mm256_div_pd(diff, cmax), _mm256_set1_pd(1 - factor));
+    return middle_lanes(h, _mm256_mul_pd(cmax, s), cmax);
+  }
+#endif
+
+  // Scaling s by k = 1-factor moves every channel toward the max: exactly,
+  // new = max - k*(max - c). The round trip through hsv (in double, then
+  // truncated) reproduces floor() of that except when it is an integer,
+  // where it may land one below. The closed form below therefore looks up
+  // - the max and min channels, which only depend on (max,min), in tables
+  //   filled by desaturate_pixel itself, and
+  // - the middle channel as max - ceil(k*(max - mid)), a per-difference
+  //   table, unless k*(max - mid) is (nearly) an integer: then it is
+  //   evaluated by desaturate_middle.
+  // The output is identical to desaturate_pixel for every input.
+  struct ClosedForm
+  {
+    // New max and min channels, indexed by 256*max+min
+    GatherTable high;
+    GatherTable low;
+    // max - new middle channel, indexed by max - mid; -1 if ambiguous
+    int drop[256];
+    double factor;
+
+    explicit ClosedForm(const double factor)
+      : high(256 * 256), low(256 * 256), factor(factor)
+    {
+      for (int max = 0; max < 256; ++max) {
+        for (int min = 0; min <= max; ++min) {
+          unsigned char unused;
+          desaturate_pixel(max, max, min, factor,
+            high[256 * max + min], unused, low[256 * max + min]);
+        }
+      }
+      const double k = 1 - factor;
+      for (int difference = 0; difference < 256; ++difference) {
+        const double scaled = k * difference;
+        drop[difference] = std::fabs(scaled - std::round(scaled)) < 1e-6
+          ? -1 : (int)std::ceil(scaled);
+      }
+    }
+
+    void apply(
+      const int r,
+      const int g,
+      const int b,
+      unsigned char & new_r,
+      unsigned char & new_g,
+      unsigned char & new_b) const
+    {
+      const int max = std::max({r, g, b});
+      const int min = std::min({r, g, b});
+      const int mid = r + g + b - max - min;
+      const int index = 256 * max + min;
+      const int high_value = high[index];
+      const int low_value = low[index];
+      int middle_value = max - drop[max - mid];
+      if (drop[max - mid] < 0 && mid != max && mid != min) {
+        middle_value = desaturate_middle(r, g, b, factor);
+      }
+      // Selects rather than branches: the roles of r, g and b are random
+      const auto channel = [&](const int c) {
+        int value = middle_value;
+        value = c == min ? low_value : value;
+        value = c == max ? high_value : value;
+        return (unsigned char)value;
+      };
+      new_r = channel(r);
+      new_g = channel(g);
+      new_b = channel(b);
+    }
+  };
+
+#if defined(__AVX2__)
+  // ClosedForm::apply to 8 pixels given as 32-bit lanes, in place
+  void desaturate_lanes(
+    const ClosedForm & closed_form,
+    __m256i & red,
+    __m256i & green,
+    __m256i & blue)
+  {
+    const __m256i max = _mm256_max_epi32(_mm256_max_epi32(red, green), blue);
+    const __m256i min = _mm256_min_epi32(_mm256_min_epi32(red, green), blue);
+    const __m256i difference = _mm256_sub_epi32(max, _mm256_sub_epi32(
+      _mm256_add_epi32(_mm256_add_epi32(red, green), blue), _mm256_add_epi32(max, min)));
+    const __m256i index = _mm256_add_epi32(_mm256_slli_epi32(max, 8), min);
+    const __m256i high_value = gather_bytes(closed_form.high, index);
+    const __m256i low_value = gather_bytes(closed_form.low, index);
+    const __m256i drop = _mm256_i32gather_epi32(closed_form.drop, difference, 4);
+    __m256i middle_value = _mm256_sub_epi32(max, drop);
+
+    // Evaluate ambiguous middle channels (a drop of -1 with the middle
+    // distinct from max and min, i.e., 0 < difference < max-min) exactly
+    const __m256i ambiguous = _mm256_and_si256(
+      _mm256_cmpgt_epi32(_mm256_setzero_si256(), drop),
+      _mm256_and_si256(
+        _mm256_cmpgt_epi32(difference, _mm256_setzero_si256()),
+        _mm256_cmpgt_epi32(_mm256_sub_epi32(max, min), difference)));
+    if (!_mm256_testz_si256(ambiguous, ambiguous)) {
+      const auto low_half = [](const __m256i lanes) {
+        return _mm256_castsi256_si128(lanes);
+      };
+      const auto high_half = [](const __m256i lanes) {
+        return _mm256_extracti128_si256(lanes, 1);
+      };
+      const __m256i exact = _mm256_setr_m128i(
+        desaturate_middle_lanes(low_half(red), low_half(green), low_half(blue),
+          low_half(max), low_half(min), closed_form.factor),
+        desaturate_middle_lanes(high_half(red), high_half(green), high_half(blue),
+          high_half(max), high_half(min), closed_form.factor));
+      middle_value = _mm256_blendv_epi8(middle_value, exact, ambiguous);
+    }
+    const auto channel = [&](const __m256i c) {
+      return _mm256_blendv_epi8(
+        _mm256_blendv_epi8(middle_value, low_value, _mm256_cmpeq_epi32(c, min)),
+        high_value, _mm256_cmpeq_epi32(c, max));
+    };
+    const __m256i new_red = channel(red);
+    const __m256i new_green = channel(green);
+    blue = channel(blue);
+    red = new_red;
+    green = new_green;
+  }
+#endif
+
+  // Desaturate num_pixels interleaved rgb pixels with the closed form
+  void desaturate_span(
+    const ClosedForm & closed_form,
+    const unsigned char * rgb,
+    const int num_pixels,
+    unsigned char * desaturated)
+  {
+    int i = 0;
+#if defined(__AVX2__)
+    // load_rgb8 and store_rgb8 touch 28 bytes
+    for (; 3 * i + 28 <= 3 * num_pixels; i += 8) {
+      const __m256i v = load_rgb8(rgb + 3 * i);
+      __m256i red = channel_lanes(v, 0);
+      __m256i green = channel_lanes(v, 1);
+      __m256i blue = channel_lanes(v, 2);
+      desaturate_lanes(closed_form, red, green, blue);
+      store_rgb8(_mm256_or_si256(
+        _mm256_or_si256(red, _mm256_slli_epi32(green, 8)),
+        _mm256_slli_epi32(blue, 16)), desaturated + 3 * i);
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      closed_form.apply(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2],
+        desaturated[3 * i], desaturated[3 * i + 1], desaturated[3 * i + 2]);
+    }
+  }
+
+  // Desaturate num_pixels pixels of rgb planes with the closed form
+  void desaturate_planes(
+    const ClosedForm & closed_form,
+    const unsigned char * r,
+    const unsigned char * g,
+    const unsigned char * b,
+    const int num_pixels,
+    unsigned char * new_r,
+    unsigned char * new_g,
+    unsigned char * new_b)
+  {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= num_pixels; i += 8) {
+      __m256i red = load_plane8(r + i);
+      __m256i green = load_plane8(g + i);
+      __m256i blue = load_plane8(b + i);
+      desaturate_lanes(closed_form, red, green, blue);
+      store_plane8(red, new_r + i);
+      store_plane8(green, new_g + i);
+      store_plane8(blue, new_b + i);
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      closed_form.apply(r[i], g[i], b[i], new_r[i], new_g[i], new_b[i]);
+    }
+  }
+
+  // Filling the tables costs about as much as 30K pixels of round trips
+  bool use_closed_form(const int num_pixels, const double factor)
+  {
+    return num_pixels >= (1 << 16) && factor >= 0 && factor <= 1;
+  }
+}
 
 void desaturate(
   const std::vector<unsigned char> & rgb,
@@ -14,26 +287,72 @@ void desaturate(
   // Add your code here
   ////////////////////////////////////////////////////////////////////////////
 
-  for (int i = 0; i < width * height; ++i) {
-    int r = rgb[i * 3];
-    int g = rgb[i * 3 + 1];
-    int b = rgb[i * 3 + 2];
+  if (!use_closed_form(width * height, factor)) {
+    for (int i = 0; i < width * height; ++i) {
+      desaturate_pixel(rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2], factor,
+        desaturated[i * 3], desaturated[i * 3 + 1], desaturated[i * 3 + 2]);
+    }
+    return;
+  }
 
-    double h;
-    double s;
-    double v;
-    rgb_to_hsv(r, g, b, h, s, v);
+  const ClosedForm closed_form(factor);
+  parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+    desaturate_span(
+      closed_form,
+      rgb.data() + (size_t)3 * begin * width,
+      (end - begin) * width,
+      desaturated.data() + (size_t)3 * begin * width);
+  });
+}
 
-    // desaturate
-    s = s * (1 - factor);
+void desaturate(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const double factor,
+  const HsvAccuracy accuracy,
+  std::vector<unsigned char> & desaturated)
+{
+  if (accuracy == HsvAccuracy::exact) {
+    desaturate(rgb, width, height, factor, desaturated);
+    return;
+  }
+  const float keep = 1 - factor;
+  edit_in_hsv(rgb, width, height, [keep](float *, float * s, float *, const int n) {
+    for (int i = 0; i < n; ++i) {
+      s[i] *= keep;
+    }
+  }, desaturated);
+}
 
-    double new_r;
-    double new_g;
-    double new_b;
-    hsv_to_rgb(h, s, v, new_r, new_g, new_b);
+void desaturate(
+  const PlanarImage & rgb,
+  const double factor,
+  PlanarImage & desaturated)
+{
+  desaturated.width = rgb.width;
+  desaturated.height = rgb.height;
+  desaturated.num_channels = 3;
+  desaturated.data.resize((size_t)rgb.width * rgb.height * 3);
 
-    desaturated[i * 3] = new_r;
-    desaturated[i * 3 + 1] = new_g;
-    desaturated[i * 3 + 2] = new_b;
+  const unsigned char * r = plane(rgb, 0);
+  const unsigned char * g = plane(rgb, 1);
+  const unsigned char * b = plane(rgb, 2);
+  unsigned char * new_r = plane(desaturated, 0);
+  unsigned char * new_g = plane(desaturated, 1);
+  unsigned char * new_b = plane(desaturated, 2);
+  const int num_pixels = rgb.width * rgb.height;
+  if (!use_closed_form(num_pixels, factor)) {
+    for (int i = 0; i < num_pixels; ++i) {
+      desaturate_pixel(r[i], g[i], b[i], factor, new_r[i], new_g[i], new_b[i]);
+    }
+    return;
   }
+
+  const ClosedForm closed_form(factor);
+  parallel_for(rgb.height, rows_per_chunk(3 * rgb.width), [&](const int begin, const int end) {
+    const size_t first = (size_t)begin * rgb.width;
+    desaturate_planes(closed_form, r + first, g + first, b + first, (end - begin) * rgb.width,
+      new_r + first, new_g + first, new_b + first);
+  });
 }
@@ -0,0 +1,319 @@
+#include "dither.h"
+#include "parallel_for.h"
+#include "rgb_lanes.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <thread>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  // Cell of the inverse color map holding an rgb color
+  inline int cell(const int r, const int g, const int b)
+  {
+    return (r >> 2) << 12 | (g >> 2) << 6 | (b >> 2);
+  }
+
+  // 8x8 Bayer matrix, from M(2n) = [[4M, 4M+2], [4M+3, 4M+1]] (one
+  // quadrant per block): neighboring pixels get the most distant thresholds
+  constexpr std::array<std::array<int, 8>, 8> bayer8 = [] {
+    std::array<std::array<int, 8>, 8> m{};
+    for (int y = 0; y < 8; ++y) {
+      for (int x = 0; x < 8; ++x) {
+        int value = 0;
+        for (int bit = 0; bit < 3; ++bit) {
+          const int xb = (x >> bit) & 1;
+          const int yb = (y >> bit) & 1;
+          value = 4 * value + (yb ? (xb ? 1 : 3) : (xb ? 2 : 0));
+        }
+        m[y][x] = value;
+      }
+    }
+    return m;
+  }();
+
+  // Per-pixel offsets added before the nearest-color lookup:
+  // ((M + 0.5)/64 - 0.5) * spread, where spread estimates the spacing of the
+  // palette colors along a channel (exact for uniform palettes)
+  std::array<std::array<int, 8>, 8> bayer_offsets(const Palette & palette)
+  {
+    const double per_channel = std::round(std::cbrt((double)palette.colors.size()));
+    const double spread = 255.0 / std::max(1.0, per_channel - 1.0);
+    std::array<std::array<int, 8>, 8> offsets{};
+    for (int y = 0; y < 8; ++y) {
+      for (int x = 0; x < 8; ++x) {
+        offsets[y][x] = std::lround(((bayer8[y][x] + 0.5) / 64.0 - 0.5) * spread);
+      }
+    }
+    return offsets;
+  }
+
+  // Ordered dither of one row. bytes_left is the number of rgb bytes from
+  // the start of the row to the end of the image (the SIMD loads read 4
+  // bytes past the 8 pixels they convert).
+  void ordered_row(
+    const unsigned char * rgb,
+    const int width,
+    [[maybe_unused]] const std::size_t bytes_left,
+    const std::array<int, 8> & offsets,
+    const Palette & palette,
+    unsigned char * indices)
+  {
+    const unsigned char * nearest = palette.nearest.data();
+    int x = 0;
+#if defined(__AVX2__)
+    // Rows start at x = 0, so the 8 pixels of each step see the 8 offsets
+    // of the row in order
+    const __m256i offset = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(offsets.data()));
+    const __m256i pack = _mm256_setr_epi8(
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi32(255);
+    const auto dither = [&](const __m256i pixels, const int c) {
+      const __m256i v = _mm256_add_epi32(channel_lanes(pixels, c), offset);
+      return _mm256_srli_epi32(_mm256_min_epi32(_mm256_max_epi32(v, zero), max), 2);
+    };
+    for (; x + 8 <= width && 3 * (std::size_t)x + 28 <= bytes_left; x += 8) {
+      const __m256i pixels = load_rgb8(rgb + 3 * x);
+      const __m256i cells = _mm256_or_si256(
+        _mm256_or_si256(
+          _mm256_slli_epi32(dither(pixels, 0), 12),
+          _mm256_slli_epi32(dither(pixels, 1), 6)),
+        dither(pixels, 2));
+      // The map is padded so 32-bit gathers of its last cells stay inside
+      const __m256i found = _mm256_shuffle_epi8(
+        _mm256_i32gather_epi32(reinterpret_cast<const int *>(nearest), cells, 1), pack);
+      const int low = _mm_cvtsi128_si32(_mm256_castsi256_si128(found));
+      const int high = _mm_cvtsi128_si32(_mm256_extracti128_si256(found, 1));
+      std::copy_n(reinterpret_cast<const unsigned char *>(&low), 4, indices + x);
+      std::copy_n(reinterpret_cast<const unsigned char *>(&high), 4, indices + x + 4);
+    }
+#endif
+    for (; x < width; ++x) {
+      const int o = offsets[x & 7];
+      indices[x] = nearest[cell(
+        std::clamp(rgb[3 * x] + o, 0, 255),
+        std::clamp(rgb[3 * x + 1] + o, 0, 255),
+        std::clamp(rgb[3 * x + 2] + o, 0, 255))];
+    }
+  }
+
+  // Floyd-Steinberg diffusion of one row scanned in direction (+1 or -1).
+  // Errors are in units of 1/16 intensity: current holds what the row above
+  // pushed into this row (each entry is cleared once used) and next
+  // collects what this row pushes into the one below. ready(k) is called
+  // before the k-th pixel of the scan and done(k) after the first k pixels.
+  template <typename Ready, typename Done>
+  void diffuse_row(
+    const unsigned char * rgb,
+    const int width,
+    const int direction,
+    const Palette & palette,
+    int * current,
+    int * next,
+    unsigned char * indices,
+    const Ready & ready,
+    const Done & done)
+  {
+    int carry[3] = {0, 0, 0};
+    for (int k = 0; k < width; ++k) {
+      ready(k);
+      const int x = direction > 0 ? k : width - 1 - k;
+      int value[3];
+      for (int c = 0; c < 3; ++c) {
+        const int error = current[3 * x + c] + carry[c];
+        current[3 * x + c] = 0;
+        value[c] = std::clamp(rgb[3 * x + c] + ((error + 8) >> 4), 0, 255);
+      }
+      const unsigned char index = palette.nearest[cell(value[0], value[1], value[2])];
+      indices[x] = index;
+
+      // 7/16 ahead, 3/16 behind below, 5/16 below and 1/16 ahead below
+      const int ahead = x + direction;
+      const int behind = x - direction;
+      const bool has_ahead = ahead >= 0 && ahead < width;
+      const bool has_behind = behind >= 0 && behind < width;
+      for (int c = 0; c < 3; ++c) {
+        const int error = value[c] - palette.colors[index][c];
+        carry[c] = has_ahead ? 7 * error : 0;
+        next[3 * x + c] += 5 * error;
+        if (has_behind) {
+          next[3 * behind + c] += 3 * error;
+        }
+        if (has_ahead) {
+          next[3 * ahead + c] += error;
+        }
+      }
+      done(k + 1);
+    }
+  }
+}
+
+Palette make_palette(const std::vector<std::array<unsigned char, 3>> & colors)
+{
+  assert(!colors.empty() && colors.size() <= 256);
+  Palette palette;
+  palette.colors = colors;
+  // 3 bytes of padding for 32-bit gathers
+  palette.nearest.assign(64 * 64 * 64 + 3, 0);
+
+  const int num_colors = colors.size();
+  parallel_for(64, 1, [&](const int begin, const int end) {
+    std::vector<int> rg_distance(num_colors);
+    for (int r = begin; r < end; ++r) {
+      for (int g = 0; g < 64; ++g) {
+        // Cell centers are at 4*i + 1.5; work in half units to stay integer
+        for (int i = 0; i < num_colors; ++i) {
+          const int dr = 8 * r + 3 - 2 * colors[i][0];
+          const int dg = 8 * g + 3 - 2 * colors[i][1];
+          rg_distance[i] = dr * dr + dg * dg;
+        }
+        for (int b = 0; b < 64; ++b) {
+          int best = 0;
+          int best_distance = 1 << 30;
+          for (int i = 0; i < num_colors; ++i) {
+            const int db = 8 * b + 3 - 2 * colors[i][2];
+            const int distance = rg_distance[i] + db * db;
+            if (distance < best_distance) {
+              best_distance = distance;
+              best = i;
+            }
+          }
+          palette.nearest[r << 12 | g << 6 | b] = best;
+        }
+      }
+    }
+  });
+  return palette;
+}
+
+Palette uniform_palette(const int levels)
+{
+  assert(levels >= 2 && levels <= 6);
+  std::vector<std::array<unsigned char, 3>> colors;
+  for (int r = 0; r < levels; ++r) {
+    for (int g = 0; g < levels; ++g) {
+      for (int b = 0; b < levels; ++b) {
+        colors.push_back({
+          (unsigned char)(255 * r / (levels - 1)),
+          (unsigned char)(255 * g / (levels - 1)),
+          (unsigned char)(255 * b / (levels - 1))});
+      }
+    }
+  }
+  return make_palette(colors);
+}
+
+void ordered_dither(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const Palette & palette,
+  std::vector<unsigned char> & indices)
+{
+  indices.resize((std::size_t)width * height);
+  const std::array<std::array<int, 8>, 8> offsets = bayer_offsets(palette);
+  parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+    for (int y = begin; y < end; ++y) {
+      const std::size_t first = (std::size_t)y * width;
+      ordered_row(
+        rgb.data() + 3 * first,
+        width,
+        rgb.size() - 3 * first,
+        offsets[y & 7],
+        palette,
+        indices.data() + first);
+    }
+  });
+}
+
+void diffusion_dither(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const Palette & palette,
+  const bool serpentine,
+  std::vector<unsigned char> & indices)
+{
+  indices.resize((std::size_t)width * height);
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+  // Row y reads the errors of errors[y % 2] and writes those of
+  // errors[(y + 1) % 2]. When row y+1 starts writing into errors[y % 2],
+  // row y has already used (and cleared) every entry it touches.
+  std::vector<int> errors[2] = {
+    std::vector<int>((std::size_t)3 * width, 0),
+    std::vector<int>((std::size_t)3 * width, 0)};
+  const auto row = [&](const int y, const int direction, const auto & ready, const auto & done) {
+    diffuse_row(
+      rgb.data() + (std::size_t)3 * y * width,
+      width,
+      direction,
+      palette,
+      errors[y % 2].data(),
+      errors[(y + 1) % 2].data(),
+      indices.data() + (std::size_t)y * width,
+      ready,
+      done);
+  };
+  const auto always = [](int) {};
+
+  if (serpentine) {
+    for (int y = 0; y < height; ++y) {
+      row(y, y % 2 == 0 ? 1 : -1, always, always);
+    }
+    return;
+  }
+
+  // Wavefront: thread t takes rows t, t + num_threads, ... and pixel x of a
+  // row waits until the row above has finished pixel x + 1
+  std::vector<std::atomic<int>> progress(height);
+  const int num_threads = std::max(1, (int)std::min<unsigned>(std::thread::hardware_concurrency(), height));
+  parallel_for(num_threads, 1, [&](const int begin, const int end) {
+    // Rows are taken in order, so a row whose predecessor belongs to the
+    // same thread never waits
+    for (int y = 0; y < height; ++y) {
+      if (y % num_threads < begin || y % num_threads >= end) {
+        continue;
+      }
+      int above = y == 0 ? width : 0;
+      const auto ready = [&](const int k) {
+        const int needed = std::min(k + 2, width);
+        while (above < needed) {
+          above = progress[y - 1].load(std::memory_order_acquire);
+          if (above < needed) {
+            std::this_thread::yield();
+          }
+        }
+      };
+      const auto done = [&](const int k) {
+        progress[y].store(k, std::memory_order_release);
+      };
+      row(y, 1, ready, done);
+    }
+  });
+}
+
+void indices_to_rgb(
+  const std::vector<unsigned char> & indices,
+  const int width,
+  const int height,
+  const Palette & palette,
+  std::vector<unsigned char> & rgb)
+{
+  rgb.resize((std::size_t)width * height * 3);
+  for (std::size_t i = 0; i < (std::size_t)width * height; ++i) {
+    const std::array<unsigned char, 3> & color = palette.colors[indices[i]];
+    rgb[3 * i] = color[0];
+    rgb[3 * i + 1] = color[1];
+    rgb[3 * i + 2] = color[2];
+  }
+}
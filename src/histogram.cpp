@@ -0,0 +1,175 @@
+#include "histogram.h"
+#include "parallel_for.h"
+#include "rgb_to_gray.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <mutex>
+
+namespace
+{
+  // Consecutive pixels count into different copies of the bins, so runs of
+  // equal intensities don't serialize on a single counter
+  const int num_copies = 4;
+
+  // Count num_pixels pixels into copies*num_channels*256 bins
+  void count_span(
+    const unsigned char * image,
+    const int num_pixels,
+    const int num_channels,
+    std::uint32_t * bins)
+  {
+    const std::ptrdiff_t copy_size = (std::ptrdiff_t)num_channels * 256;
+    int i = 0;
+    for (; i + num_copies <= num_pixels; i += num_copies) {
+      for (int copy = 0; copy < num_copies; ++copy) {
+        const unsigned char * pixel = image + (std::ptrdiff_t)(i + copy) * num_channels;
+        std::uint32_t * copy_bins = bins + copy * copy_size;
+        for (int c = 0; c < num_channels; ++c) {
+          copy_bins[c * 256 + pixel[c]]++;
+        }
+      }
+    }
+    for (; i < num_pixels; ++i) {
+      for (int c = 0; c < num_channels; ++c) {
+        bins[c * 256 + image[(std::ptrdiff_t)i * num_channels + c]]++;
+      }
+    }
+  }
+
+  // Intensity below which (above which, if from_top) at most clip*total
+  // samples lie
+  int percentile(const Histogram & histogram, const double clip, const bool from_top)
+  {
+    std::uint64_t total = 0;
+    for (const std::uint64_t count : histogram) {
+      total += count;
+    }
+    const double ignored = clip * total;
+    std::uint64_t seen = 0;
+    for (int k = 0; k < 256; ++k) {
+      const int v = from_top ? 255 - k : k;
+      seen += histogram[v];
+      if (seen > ignored) {
+        return v;
+      }
+    }
+    return from_top ? 0 : 255;
+  }
+}
+
+void channel_histograms(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels,
+  std::vector<Histogram> & histograms)
+{
+  histograms.assign(num_channels, Histogram{});
+  std::mutex merge;
+  // A chunk of rows must be large enough to amortize clearing and merging
+  // its private bins
+  parallel_for(height, rows_per_chunk(width * num_channels), [&](const int begin, const int end) {
+    std::vector<std::uint32_t> bins((std::size_t)num_copies * num_channels * 256, 0);
+    count_span(
+      image.data() + (std::size_t)begin * width * num_channels,
+      (end - begin) * width,
+      num_channels,
+      bins.data());
+    std::lock_guard<std::mutex> lock(merge);
+    for (int copy = 0; copy < num_copies; ++copy) {
+      for (int c = 0; c < num_channels; ++c) {
+        for (int v = 0; v < 256; ++v) {
+          histograms[c][v] += bins[((std::size_t)copy * num_channels + c) * 256 + v];
+        }
+      }
+    }
+  });
+}
+
+void luminance_histogram(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  Histogram & histogram)
+{
+  std::vector<unsigned char> gray;
+  rgb_to_gray(rgb, width, height, gray);
+  std::vector<Histogram> histograms;
+  channel_histograms(gray, width, height, 1, histograms);
+  histogram = histograms[0];
+}
+
+IntensityLut auto_levels_lut(
+  const std::vector<Histogram> & histograms,
+  const double clip)
+{
+  assert(clip >= 0.0 && clip < 0.5);
+  int low = 255;
+  int high = 0;
+  for (const Histogram & histogram : histograms) {
+    low = std::min(low, percentile(histogram, clip, false));
+    high = std::max(high, percentile(histogram, clip, true));
+  }
+  if (high <= low) {
+    return identity_lut();
+  }
+
+  IntensityLut lut;
+  for (int v = 0; v < 256; ++v) {
+    const double stretched = (v - low) * 255.0 / (high - low);
+    lut[v] = std::clamp(std::lround(stretched), 0L, 255L);
+  }
+  return lut;
+}
+
+IntensityLut equalization_lut(const Histogram & histogram)
+{
+  // Map the cumulative count linearly onto [0,255], with the darkest
+  // occupied intensity going to 0
+  std::uint64_t total = 0;
+  std::uint64_t darkest = 0;
+  for (const std::uint64_t count : histogram) {
+    if (total == 0) {
+      darkest = count;
+    }
+    total += count;
+  }
+  if (total == darkest) {
+    return identity_lut();
+  }
+
+  IntensityLut lut;
+  std::uint64_t cumulative = 0;
+  for (int v = 0; v < 256; ++v) {
+    cumulative += histogram[v];
+    const double fraction = cumulative < darkest ?
+      0.0 : double(cumulative - darkest) / (total - darkest);
+    lut[v] = std::lround(fraction * 255.0);
+  }
+  return lut;
+}
+
+void auto_levels(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const double clip,
+  std::vector<unsigned char> & leveled)
+{
+  std::vector<Histogram> histograms;
+  channel_histograms(rgb, width, height, 3, histograms);
+  apply_intensity_lut(rgb, width, height, 3, auto_levels_lut(histograms, clip), leveled);
+}
+
+void equalize(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  std::vector<unsigned char> & equalized)
+{
+  Histogram histogram;
+  luminance_histogram(rgb, width, height, histogram);
+  apply_intensity_lut(rgb, width, height, 3, equalization_lut(histogram), equalized);
+}
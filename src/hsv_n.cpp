@@ -0,0 +1,195 @@
+#include "hsv_n.h"
+#include "parallel_for.h"
+#include "planar_image.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  // Hue, saturation and value of one pixel. Follows rgb_to_hsv, but picks
+  // the hue formula with selects instead of branches: the numerator and the
+  // sector offset come from the channel holding the max (red, then green,
+  // then blue, as in rgb_to_hsv). Intensities are integers, so a non-zero
+  // diff (or cmax) is at least 1 and max(diff,1) avoids 0/0 for grays.
+  inline void rgb_to_hsv_one(
+    const float r,
+    const float g,
+    const float b,
+    float & h,
+    float & s,
+    float & v)
+  {
+    const float cmax = std::max(std::max(r, g), b);
+    const float cmin = std::min(std::min(r, g), b);
+    const float diff = cmax - cmin;
+    const float numerator = cmax == r ? g - b : (cmax == g ? b - r : r - g);
+    const float sector = cmax == r ? 0.0f : (cmax == g ? 2.0f : 4.0f);
+    float hue = 60.0f * (numerator / std::max(diff, 1.0f) + sector);
+    hue = hue < 0.0f ? hue + 360.0f : hue;
+    h = hue >= 360.0f ? hue - 360.0f : hue;
+    s = diff / std::max(cmax, 1.0f);
+    v = cmax / 255.0f;
+  }
+
+  // One channel of hsv_to_rgb without the six-way sector branch:
+  // channel = v - c*clamp(min(k,4-k),0,1) with k = (n + h/60) mod 6, where
+  // n is 5 for red, 3 for green and 1 for blue
+  inline unsigned char hsv_channel(
+    const float n,
+    const float hue_sector,
+    const float c,
+    const float v)
+  {
+    float k = n + hue_sector;
+    k = k >= 6.0f ? k - 6.0f : k;
+    const float t = std::min(std::max(std::min(k, 4.0f - k), 0.0f), 1.0f);
+    const float channel = (v - c * t) * 255.0f;
+    return static_cast<unsigned char>(std::min(std::max(channel, 0.0f), 255.0f));
+  }
+
+#if defined(__AVX2__)
+  inline __m256 load_intensities(const unsigned char * p)
+  {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))));
+  }
+
+  // Truncate 8 lanes in [0,255] and store them as bytes
+  inline void store_intensities(const __m256 lanes, unsigned char * p)
+  {
+    const __m256i low_bytes = _mm256_shuffle_epi8(_mm256_cvttps_epi32(lanes), _mm256_setr_epi8(
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const std::uint32_t low = _mm256_cvtsi256_si32(low_bytes);
+    const std::uint32_t high = _mm_cvtsi128_si32(_mm256_extracti128_si256(low_bytes, 1));
+    std::memcpy(p, &low, 4);
+    std::memcpy(p + 4, &high, 4);
+  }
+
+  // Same as hsv_channel for 8 lanes
+  inline __m256 hsv_channel_lanes(
+    const float n,
+    const __m256 hue_sector,
+    const __m256 c,
+    const __m256 v)
+  {
+    const __m256 six = _mm256_set1_ps(6.0f);
+    __m256 k = _mm256_add_ps(_mm256_set1_ps(n), hue_sector);
+    k = _mm256_sub_ps(k, _mm256_and_ps(_mm256_cmp_ps(k, six, _CMP_GE_OQ), six));
+    const __m256 t = _mm256_min_ps(
+      _mm256_max_ps(
+        _mm256_min_ps(k, _mm256_sub_ps(_mm256_set1_ps(4.0f), k)),
+        _mm256_setzero_ps()),
+      _mm256_set1_ps(1.0f));
+    const __m256 channel = _mm256_mul_ps(
+      _mm256_sub_ps(v, _mm256_mul_ps(c, t)), _mm256_set1_ps(255.0f));
+    return _mm256_min_ps(
+      _mm256_max_ps(channel, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+  }
+#endif
+
+  // Pixels converted per step of edit_in_hsv (h, s, v of a span fit in L1)
+  const int span_size = 512;
+}
+
+void rgb_to_hsv_n(
+  const unsigned char * r,
+  const unsigned char * g,
+  const unsigned char * b,
+  const int n,
+  float * h,
+  float * s,
+  float * v)
+{
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 full_turn = _mm256_set1_ps(360.0f);
+  for (; i + 8 <= n; i += 8) {
+    const __m256 red = load_intensities(r + i);
+    const __m256 green = load_intensities(g + i);
+    const __m256 blue = load_intensities(b + i);
+    const __m256 cmax = _mm256_max_ps(_mm256_max_ps(red, green), blue);
+    const __m256 cmin = _mm256_min_ps(_mm256_min_ps(red, green), blue);
+    const __m256 diff = _mm256_sub_ps(cmax, cmin);
+    const __m256 max_is_red = _mm256_cmp_ps(cmax, red, _CMP_EQ_OQ);
+    const __m256 max_is_green = _mm256_cmp_ps(cmax, green, _CMP_EQ_OQ);
+    const __m256 numerator = _mm256_blendv_ps(
+      _mm256_blendv_ps(
+        _mm256_sub_ps(red, green), _mm256_sub_ps(blue, red), max_is_green),
+      _mm256_sub_ps(green, blue), max_is_red);
+    const __m256 sector = _mm256_blendv_ps(
+      _mm256_blendv_ps(_mm256_set1_ps(4.0f), _mm256_set1_ps(2.0f), max_is_green),
+      _mm256_setzero_ps(), max_is_red);
+    __m256 hue = _mm256_mul_ps(_mm256_set1_ps(60.0f), _mm256_add_ps(
+      _mm256_div_ps(numerator, _mm256_max_ps(diff, one)), sector));
+    hue = _mm256_add_ps(hue, _mm256_and_ps(
+      _mm256_cmp_ps(hue, _mm256_setzero_ps(), _CMP_LT_OQ), full_turn));
+    hue = _mm256_sub_ps(hue, _mm256_and_ps(
+      _mm256_cmp_ps(hue, full_turn, _CMP_GE_OQ), full_turn));
+    _mm256_storeu_ps(h + i, hue);
+    _mm256_storeu_ps(s + i, _mm256_div_ps(diff, _mm256_max_ps(cmax, one)));
+    _mm256_storeu_ps(v + i, _mm256_div_ps(cmax, _mm256_set1_ps(255.0f)));
+  }
+#endif
+  for (; i < n; ++i) {
+    rgb_to_hsv_one(r[i], g[i], b[i], h[i], s[i], v[i]);
+  }
+}
+
+void hsv_to_rgb_n(
+  const float * h,
+  const float * s,
+  const float * v,
+  const int n,
+  unsigned char * r,
+  unsigned char * g,
+  unsigned char * b)
+{
+  int i = 0;
+#if defined(__AVX2__)
+  for (; i + 8 <= n; i += 8) {
+    const __m256 hue_sector = _mm256_div_ps(_mm256_loadu_ps(h + i), _mm256_set1_ps(60.0f));
+    const __m256 value = _mm256_loadu_ps(v + i);
+    const __m256 c = _mm256_mul_ps(value, _mm256_loadu_ps(s + i));
+    store_intensities(hsv_channel_lanes(5.0f, hue_sector, c, value), r + i);
+    store_intensities(hsv_channel_lanes(3.0f, hue_sector, c, value), g + i);
+    store_intensities(hsv_channel_lanes(1.0f, hue_sector, c, value), b + i);
+  }
+#endif
+  for (; i < n; ++i) {
+    const float hue_sector = h[i] / 60.0f;
+    const float c = v[i] * s[i];
+    r[i] = hsv_channel(5.0f, hue_sector, c, v[i]);
+    g[i] = hsv_channel(3.0f, hue_sector, c, v[i]);
+    b[i] = hsv_channel(1.0f, hue_sector, c, v[i]);
+  }
+}
+
+void edit_in_hsv(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const std::function<void(float *, float *, float *, int)> & edit,
+  std::vector<unsigned char> & edited)
+{
+  edited.resize(rgb.size());
+  parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+    unsigned char r[span_size], g[span_size], b[span_size];
+    float h[span_size], s[span_size], v[span_size];
+    const size_t last = (size_t)end * width;
+    for (size_t first = (size_t)begin * width; first < last; first += span_size) {
+      const int n = (int)std::min<size_t>(span_size, last - first);
+      deinterleave_rgb(rgb.data() + 3 * first, n, 3, r, g, b);
+      rgb_to_hsv_n(r, g, b, n, h, s, v);
+      edit(h, s, v, n);
+      hsv_to_rgb_n(h, s, v, n, r, g, b);
+      interleave_rgb(r, g, b, n, edited.data() + 3 * first);
+    }
+  });
+}
@@ -1,24 +1,24 @@
 #include "hue_shift.h"
 #include "hsv_to_rgb.h"
+#include "parallel_for.h"
+#include "rgb_lanes.h"
 #include "rgb_to_hsv.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
-void hue_shift(
-  const std::vector<unsigned char> & rgb,
-  const int width,
-  const int height,
-  const double shift,
-  std::vector<unsigned char> & shifted)
+namespace
 {
-  shifted.resize(rgb.size());
-  ////////////////////////////////////////////////////////////////////////////
-  // Add your code here
-  ////////////////////////////////////////////////////////////////////////////
-
-  for (int i = 0; i < width * height; ++i) {
-    int r = rgb[i * 3];
-    int g = rgb[i * 3 + 1];
-    int b = rgb[i * 3 + 2];
-
+  // Shift the hue of a single pixel
+  void shift_pixel(
+    const int r,
+    const int g,
+    const int b,
+    const double shift,
+    unsigned char & new_r,
+    unsigned char & new_g,
+    unsigned char & new_b)
+  {
     double h;
     double s;
     double v;
@@ -35,13 +35,342 @@ void hue_shift(
       h -= 360.0;
     }
 
-    double new_r;
-    double new_g;
-    double new_b;
-    hsv_to_rgb(h, s, v, new_r, new_g, new_b);
+    double shifted_r;
+    double shifted_g;
+    double shifted_b;
+    hsv_to_rgb(h, s, v, shifted_r, shifted_g, shifted_b);
+
+    new_r = shifted_r;
+    new_g = shifted_g;
+    new_b = shifted_b;
+  }
+
+  // A shift by a multiple of 60 degrees (a sixth of a turn) keeps s and v,
+  // so every pixel keeps its max and min intensities, and only the roles of
+  // the channels move: 120 degrees moves each role to the next channel
+  // (r->g->b->r) and 180 degrees swaps max and min. The round trip through
+  // hsv reproduces max exactly, but its min (v - c) and middle channel
+  // (x + v - c) may truncate one below the integer they should be, so
+  // - the new max and min come from tables indexed by (max,min), filled by
+  //   shift_pixel itself, and
+  // - the new middle channel is evaluated with the same double operations
+  //   as rgb_to_hsv, fmod and hsv_to_rgb (8 pixels at a time with AVX2).
+  // The output is identical to shift_pixel for every input.
+  struct SixthTurn
+  {
+    // New max and min channels, indexed by 256*max+min
+    GatherTable high;
+    GatherTable low;
+    int steps;    // channel c takes the role of channel (c - steps) mod 3...
+    bool swap;    // ...with max and min swapped
+    double shift;
+
+    explicit SixthTurn(const double shift)
+      : high(256 * 256), low(256 * 256), shift(shift)
+    {
+      // h, and so the shift, does not matter for max and min: with h = 0,
+      // (max,min,min) maps to (new max, new min, new min)
+      for (int max = 0; max < 256; ++max) {
+        for (int min = 0; min <= max; ++min) {
+          unsigned char unused;
+          shift_pixel(max, min, min, 0.0,
+            high[256 * max + min], low[256 * max + min], unused);
+        }
+      }
+      // 60*sixths = 120*steps + 180*swap (mod 360)
+      const int sixths = ((int)std::lround(shift / 60) % 6 + 6) % 6;
+      swap = sixths % 2 == 1;
+      steps = ((swap ? sixths - 3 : sixths) / 2 + 3) % 3;
+    }
+  };
+
+  // Multiples of 60 degrees in (-360,360) on images large enough to amortize
+  // the tables (about 30K pixels of round trips)
+  bool use_sixth_turn(const int num_pixels, const double shift)
+  {
+    return num_pixels >= (1 << 16) && std::fabs(shift) < 360 &&
+      std::fmod(shift, 60.0) == 0;
+  }
+
+  // New middle channel of a pixel whose middle channel is neither its max
+  // nor its min, with the same double operations as shift_middle_lanes
+  int shift_middle(
+    const int r,
+    const int g,
+    const int b,
+    const int max,
+    const int min,
+    const double shift)
+  {
+    const double r_prime = r / 255.0;
+    const double g_prime = g / 255.0;
+    const double b_prime = b / 255.0;
+    const double cmax = max / 255.0;
+    const double diff = cmax - min / 255.0;
+
+    // fmod(q, 6) == q for the |q| <= 1 of the red case
+    double h;
+    if (max == r) {
+      h = 60.0 * ((g_prime - b_prime) / diff + 0.0);
+    } else if (max == g) {
+      h = 60.0 * ((b_prime - r_prime) / diff + 2.0);
+    } else {
+      h = 60.0 * ((r_prime - g_prime) / diff + 4.0);
+    }
+    if (h < 0.0) {
+      h += 360.0;
+    }
+
+    h += shift;
+    if (h >= 360.0) {
+      h -= 360.0;
+    }
+    if (h < 0.0) {
+      h += 360.0;
+    }
+    if (h >= 360.0) {
+      h -= 360.0;
+    }
+
+    const double c = cmax * (diff / cmax);
+    const double sector = h / 60.0;
+    const double wrapped = sector - 2.0 * std::floor(sector / 2.0);
+    const double x = c * (1.0 - std::fabs(wrapped - 1.0));
+    return (int)((x + (cmax - c)) * 255.0);
+  }
+
+  // Shift the hue of a single pixel by a multiple of 60 degrees (same result
+  // as shift_pixel)
+  void shift_sixth_pixel(
+    const SixthTurn & sixth_turn,
+    const int r,
+    const int g,
+    const int b,
+    unsigned char & new_r,
+    unsigned char & new_g,
+    unsigned char & new_b)
+  {
+    const int max = std::max({r, g, b});
+    const int min = std::min({r, g, b});
+    int high_value = sixth_turn.high[256 * max + min];
+    int low_value = sixth_turn.low[256 * max + min];
+    if (sixth_turn.swap) {
+      std::swap(high_value, low_value);
+    }
+
+    // New value of the role held by a channel
+    const auto role = [&](const int c) {
+      if (c == max) return high_value;
+      if (c == min) return low_value;
+      return shift_middle(r, g, b, max, min, sixth_turn.shift);
+    };
+    const int roles[3] = {role(r), role(g), role(b)};
+    new_r = roles[(3 - sixth_turn.steps) % 3];
+    new_g = roles[(4 - sixth_turn.steps) % 3];
+    new_b = roles[(5 - sixth_turn.steps) % 3];
+  }
+
+#if defined(__AVX2__)
+  // New middle channel of 4 pixels given as 32-bit lanes, with the same
+  // double operations as shift_pixel (lanes without a distinct middle give
+  // garbage)
+  __m128i shift_middle_lanes(
+    const __m128i red,
+    const __m128i green,
+    const __m128i blue,
+    const __m128i max,
+    const __m128i min,
+    const double shift)
+  {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d full_turn = _mm256_set1_pd(360.0);
+    __m256d cmax;
+    __m256d diff;
+    __m256d h = hue_lanes(red, green, blue, max, min, cmax, diff);
+
+    // fmod(h + shift, 360) of h + shift in (-360,720) is this exact
+    // subtraction, then the same range adjustments as shift_pixel
+    h = _mm256_add_pd(h, _mm256_set1_pd(shift));
+    h = _mm256_sub_pd(h, _mm256_and_pd(_mm256_cmp_pd(h, full_turn, _CMP_GE_OQ), full_turn));
+    h = _mm256_add_pd(h, _mm256_and_pd(_mm256_cmp_pd(h, zero, _CMP_LT_OQ), full_turn));
+    h = _mm256_sub_pd(h, _mm256_and_pd(_mm256_cmp_pd(h, full_turn, _CMP_GE_OQ), full_turn));
 
-    shifted[i * 3] = new_r;
-    shifted[i * 3 + 1] = new_g;
-    shifted[i * 3 + 2] = new_b;
+    return middle_lanes(h, _mm256_mul_pd(cmax, _mm256_div_pd(diff, cmax)), cmax);
   }
+
+  // New r, g and b of 8 pixels given as 32-bit lanes, in place
+  void shift_lanes(const SixthTurn & sixth_turn, __m256i (&channels)[3])
+  {
+    const __m256i max = _mm256_max_epi32(_mm256_max_epi32(channels[0], channels[1]), channels[2]);
+    const __m256i min = _mm256_min_epi32(_mm256_min_epi32(channels[0], channels[1]), channels[2]);
+    const __m256i index = _mm256_add_epi32(_mm256_slli_epi32(max, 8), min);
+    __m256i high_value = gather_bytes(sixth_turn.high, index);
+    __m256i low_value = gather_bytes(sixth_turn.low, index);
+    if (sixth_turn.swap) {
+      std::swap(high_value, low_value);
+    }
+
+    const auto low_half = [](const __m256i lanes) {
+      return _mm256_castsi256_si128(lanes);
+    };
+    const auto high_half = [](const __m256i lanes) {
+      return _mm256_extracti128_si256(lanes, 1);
+    };
+    const __m256i middle_value = _mm256_setr_m128i(
+      shift_middle_lanes(low_half(channels[0]), low_half(channels[1]),
+        low_half(channels[2]), low_half(max), low_half(min), sixth_turn.shift),
+      shift_middle_lanes(high_half(channels[0]), high_half(channels[1]),
+        high_half(channels[2]), high_half(max), high_half(min), sixth_turn.shift));
+
+    // New value of the role held by channel c
+    const auto role = [&](const __m256i c) {
+      return _mm256_blendv_epi8(
+        _mm256_blendv_epi8(middle_value, low_value, _mm256_cmpeq_epi32(c, min)),
+        high_value, _mm256_cmpeq_epi32(c, max));
+    };
+    const __m256i roles[3] = {role(channels[0]), role(channels[1]), role(channels[2])};
+    for (int c = 0; c < 3; ++c) {
+      channels[c] = roles[(3 + c - sixth_turn.steps) % 3];
+    }
+  }
+#endif
+
+  // Shift num_pixels interleaved rgb pixels by a multiple of 60 degrees
+  void shift_span(
+    const SixthTurn & sixth_turn,
+    const unsigned char * rgb,
+    const int num_pixels,
+    unsigned char * shifted)
+  {
+    int i = 0;
+#if defined(__AVX2__)
+    // load_rgb8 and store_rgb8 touch 28 bytes
+    for (; 3 * i + 28 <= 3 * num_pixels; i += 8) {
+      const __m256i v = load_rgb8(rgb + 3 * i);
+      __m256i channels[3] = {channel_lanes(v, 0), channel_lanes(v, 1), channel_lanes(v, 2)};
+      shift_lanes(sixth_turn, channels);
+      store_rgb8(_mm256_or_si256(
+        _mm256_or_si256(channels[0], _mm256_slli_epi32(channels[1], 8)),
+        _mm256_slli_epi32(channels[2], 16)), shifted + 3 * i);
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      shift_sixth_pixel(sixth_turn, rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2],
+        shifted[3 * i], shifted[3 * i + 1], shifted[3 * i + 2]);
+    }
+  }
+
+  // Shift num_pixels pixels of rgb planes by a multiple of 60 degrees
+  void shift_planes(
+    const SixthTurn & sixth_turn,
+    const unsigned char * r,
+    const unsigned char * g,
+    const unsigned char * b,
+    const int num_pixels,
+    unsigned char * new_r,
+    unsigned char * new_g,
+    unsigned char * new_b)
+  {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= num_pixels; i += 8) {
+      __m256i channels[3] = {load_plane8(r + i), load_plane8(g + i), load_plane8(b + i)};
+      shift_lanes(sixth_turn, channels);
+      store_plane8(channels[0], new_r + i);
+      store_plane8(channels[1], new_g + i);
+      store_plane8(channels[2], new_b + i);
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      shift_sixth_pixel(sixth_turn, r[i], g[i], b[i], new_r[i], new_g[i], new_b[i]);
+    }
+  }
+}
+
+void hue_shift(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const double shift,
+  std::vector<unsigned char> & shifted)
+{
+  shifted.resize(rgb.size());
+  ////////////////////////////////////////////////////////////////////////////
+  // Add your code here
+  ////////////////////////////////////////////////////////////////////////////
+
+  if (use_sixth_turn(width * height, shift)) {
+    const SixthTurn sixth_turn(shift);
+    parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+      shift_span(
+        sixth_turn,
+        rgb.data() + (size_t)3 * begin * width,
+        (end - begin) * width,
+        shifted.data() + (size_t)3 * begin * width);
+    });
+    return;
+  }
+
+  parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+    for (int i = begin * width; i < end * width; ++i) {
+      shift_pixel(rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2], shift,
+        shifted[i * 3], shifted[i * 3 + 1], shifted[i * 3 + 2]);
+    }
+  });
+}
+
+void hue_shift(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const double shift,
+  const HsvAccuracy accuracy,
+  std::vector<unsigned char> & shifted)
+{
+  if (accuracy == HsvAccuracy::exact) {
+    hue_shift(rgb, width, height, shift, shifted);
+    return;
+  }
+  const float degrees = shift;
+  edit_in_hsv(rgb, width, height, [degrees](float * h, float *, float *, const int n) {
+    // h + shift lies in [-180,540): wrap it back into [0,360) like fmod
+    for (int i = 0; i < n; ++i) {
+      const float shifted_h = h[i] + degrees;
+      const float wrapped_h = shifted_h >= 360.0f ? shifted_h - 360.0f : shifted_h;
+      h[i] = wrapped_h < 0.0f ? wrapped_h + 360.0f : wrapped_h;
+    }
+  }, shifted);
+}
+
+void hue_shift(
+  const PlanarImage & rgb,
+  const double shift,
+  PlanarImage & shifted)
+{
+  shifted.width = rgb.width;
+  shifted.height = rgb.height;
+  shifted.num_channels = 3;
+  shifted.data.resize((size_t)rgb.width * rgb.height * 3);
+
+  const unsigned char * r = plane(rgb, 0);
+  const unsigned char * g = plane(rgb, 1);
+  const unsigned char * b = plane(rgb, 2);
+  unsigned char * new_r = plane(shifted, 0);
+  unsigned char * new_g = plane(shifted, 1);
+  unsigned char * new_b = plane(shifted, 2);
+  if (use_sixth_turn(rgb.width * rgb.height, shift)) {
+    const SixthTurn sixth_turn(shift);
+    parallel_for(rgb.height, rows_per_chunk(3 * rgb.width), [&](const int begin, const int end) {
+      const size_t first = (size_t)begin * rgb.width;
+      shift_planes(sixth_turn, r + first, g + first, b + first, (end - begin) * rgb.width,
+        new_r + first, new_g + first, new_b + first);
+    });
+    return;
+  }
+
+  parallel_for(rgb.height, rows_per_chunk(3 * rgb.width), [&](const int begin, const int end) {
+    for (int i = begin * rgb.width; i < end * rgb.width; ++i) {
+      shift_pixel(r[i], g[i], b[i], shift, new_r[i], new_g[i], new_b[i]);
+    }
+  });
 }
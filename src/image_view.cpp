@@ -0,0 +1,323 @@
+#include "image_view.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+#if defined(__SSE2__)
+  // Transpose a 16x16 block of bytes: dst[k*dst_stride + i] =
+  // src[i*src_stride + k], in four rounds of interleaving
+  inline void transpose16x16(
+    const unsigned char * src,
+    const std::ptrdiff_t src_stride,
+    unsigned char * dst,
+    const std::ptrdiff_t dst_stride)
+  {
+    __m128i a[16], b[16];
+    for (int i = 0; i < 16; ++i) {
+      a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * src_stride));
+    }
+    for (int i = 0; i < 8; ++i) {
+      b[i] = _mm_unpacklo_epi8(a[2 * i], a[2 * i + 1]);
+      b[i + 8] = _mm_unpackhi_epi8(a[2 * i], a[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+      a[i] = _mm_unpacklo_epi16(b[2 * i], b[2 * i + 1]);
+      a[i + 8] = _mm_unpackhi_epi16(b[2 * i], b[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+      b[i] = _mm_unpacklo_epi32(a[2 * i], a[2 * i + 1]);
+      b[i + 8] = _mm_unpackhi_epi32(a[2 * i], a[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+      a[i] = _mm_unpacklo_epi64(b[2 * i], b[2 * i + 1]);
+      a[i + 8] = _mm_unpackhi_epi64(b[2 * i], b[2 * i + 1]);
+    }
+    // After the rounds, row k sits at a[j] with j the bit-reversal of k
+    for (int k = 0; k < 16; ++k) {
+      const int j = ((k & 1) << 3) | ((k & 2) << 1) | ((k & 4) >> 1) | ((k & 8) >> 3);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + k * dst_stride), a[j]);
+    }
+  }
+
+  // Transpose a 4x4 block of 4-byte pixels
+  inline void transpose4x4(
+    const unsigned char * src,
+    const std::ptrdiff_t src_stride,
+    unsigned char * dst,
+    const std::ptrdiff_t dst_stride)
+  {
+    const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + src_stride));
+    const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * src_stride));
+    const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * src_stride));
+    const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + dst_stride), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * dst_stride), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * dst_stride), _mm_unpackhi_epi64(t2, t3));
+  }
+#endif
+
+  // Copy width pixels of num_channels channels in reverse order
+  void reverse_row(
+    const unsigned char * source,
+    const int width,
+    const int num_channels,
+    unsigned char * target)
+  {
+    int x = 0;
+#if defined(__SSSE3__)
+    if (num_channels == 1) {
+      const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+      for (; x + 16 <= width; x += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + width - 16 - x));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(target + x), _mm_shuffle_epi8(v, reverse));
+      }
+    }
+    if (num_channels == 3) {
+      // 5 pixels per vector, loaded from one byte before them so that the
+      // load stays inside the row; each store spills one byte that the next
+      // store (or the tail) overwrites
+      const __m128i reverse = _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -1);
+      for (; x + 6 <= width; x += 5) {
+        const __m128i v = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(source + 3 * (width - 5 - x) - 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(target + 3 * x), _mm_shuffle_epi8(v, reverse));
+      }
+    }
+#endif
+#if defined(__SSE2__)
+    if (num_channels == 4) {
+      for (; x + 4 <= width; x += 4) {
+        const __m128i v = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(source + 4 * (width - 4 - x)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(target + 4 * x), _mm_shuffle_epi32(v, 0x1B));
+      }
+    }
+#endif
+    for (; x < width; ++x) {
+      for (int c = 0; c < num_channels; ++c) {
+        target[x * num_channels + c] = source[(width - 1 - x) * num_channels + c];
+      }
+    }
+  }
+
+  // Copy pixels (x,y) of [x0,x1)x[y0,y1) one at a time (the channel count is
+  // a template parameter so that the per-pixel copy unrolls)
+  template <int num_channels>
+  void copy_pixels(
+    const ImageView & view,
+    const int x0,
+    const int x1,
+    const int y0,
+    const int y1,
+    unsigned char * output,
+    const std::ptrdiff_t row_size)
+  {
+    const unsigned char * origin = view.data + view.offset;
+    for (int y = y0; y < y1; ++y) {
+      const unsigned char * source = origin + y * view.y_stride;
+      unsigned char * target = output + y * row_size;
+      for (int x = x0; x < x1; ++x) {
+        for (int c = 0; c < num_channels; ++c) {
+          target[x * num_channels + c] = source[x * view.x_stride + c];
+        }
+      }
+    }
+  }
+
+  void copy_pixels(
+    const ImageView & view,
+    const int x0,
+    const int x1,
+    const int y0,
+    const int y1,
+    unsigned char * output,
+    const std::ptrdiff_t row_size)
+  {
+    switch (view.num_channels) {
+      case 1: copy_pixels<1>(view, x0, x1, y0, y1, output, row_size); break;
+      case 3: copy_pixels<3>(view, x0, x1, y0, y1, output, row_size); break;
+      case 4: copy_pixels<4>(view, x0, x1, y0, y1, output, row_size); break;
+      default: {
+        const unsigned char * origin = view.data + view.offset;
+        for (int y = y0; y < y1; ++y) {
+          for (int x = x0; x < x1; ++x) {
+            std::memcpy(
+              output + y * row_size + x * view.num_channels,
+              origin + x * view.x_stride + y * view.y_stride,
+              view.num_channels);
+          }
+        }
+      }
+    }
+  }
+
+  // Copy the tile [x0,x1)x[y0,y1) of a view whose rows run along columns of
+  // the source (|y_stride| == num_channels) into output rows of row_size
+  void transpose_tile(
+    const ImageView & view,
+    const int x0,
+    const int x1,
+    const int y0,
+    const int y1,
+    unsigned char * output,
+    const std::ptrdiff_t row_size)
+  {
+    assert(view.y_stride == view.num_channels || view.y_stride == -view.num_channels);
+#if defined(__SSE2__)
+    // Blocks of block x block pixels, a column of blocks at a time so that
+    // each source cache line is used up while it is hot. Where y_stride is
+    // negative, a block is read from its lowest address, so its first
+    // transposed row is the last output row of the block.
+    const int num_channels = view.num_channels;
+    const int block = num_channels == 1 ? 16 : (num_channels == 4 ? 4 : 0);
+    if (block > 0) {
+      const unsigned char * origin = view.data + view.offset;
+      const bool ascending = view.y_stride > 0;
+      const std::ptrdiff_t dst_stride = ascending ? row_size : -row_size;
+      const int x_end = x0 + (x1 - x0) / block * block;
+      const int y_end = y0 + (y1 - y0) / block * block;
+      for (int x = x0; x < x_end; x += block) {
+        for (int y = y0; y < y_end; y += block) {
+          const int first = ascending ? y : y + block - 1;
+          const unsigned char * src = origin + x * view.x_stride + first * view.y_stride;
+          unsigned char * dst = output + first * row_size + x * num_channels;
+          if (num_channels == 1) {
+            transpose16x16(src, view.x_stride, dst, dst_stride);
+          } else {
+            transpose4x4(src, view.x_stride, dst, dst_stride);
+          }
+        }
+      }
+      copy_pixels(view, x_end, x1, y0, y_end, output, row_size);
+      copy_pixels(view, x0, x1, y_end, y1, output, row_size);
+      return;
+    }
+#endif
+    copy_pixels(view, x0, x1, y0, y1, output, row_size);
+  }
+}
+
+ImageView make_image_view(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels)
+{
+  assert(image.size() >= (size_t)width * height * num_channels);
+  return {image.data(), width, height, num_channels,
+    0, num_channels, (std::ptrdiff_t)width * num_channels};
+}
+
+ImageView flip_horizontal(const ImageView & view)
+{
+  ImageView flipped = view;
+  flipped.offset += (view.width - 1) * view.x_stride;
+  flipped.x_stride = -view.x_stride;
+  return flipped;
+}
+
+ImageView flip_vertical(const ImageView & view)
+{
+  ImageView flipped = view;
+  flipped.offset += (view.height - 1) * view.y_stride;
+  flipped.y_stride = -view.y_stride;
+  return flipped;
+}
+
+ImageView transpose(const ImageView & view)
+{
+  ImageView transposed = view;
+  std::swap(transposed.width, transposed.height);
+  std::swap(transposed.x_stride, transposed.y_stride);
+  return transposed;
+}
+
+ImageView rotate_view(const ImageView & view, const int quarter_turns)
+{
+  ImageView rotated = view;
+  // One counter-clockwise turn maps output (x,y) to input (width-1-y, x)
+  for (int turn = ((quarter_turns % 4) + 4) % 4; turn > 0; --turn) {
+    rotated = flip_vertical(transpose(rotated));
+  }
+  return rotated;
+}
+
+ImageView crop(
+  const ImageView & view,
+  const int x,
+  const int y,
+  const int width,
+  const int height)
+{
+  assert(x >= 0 && y >= 0 && width >= 0 && height >= 0);
+  assert(x + width <= view.width && y + height <= view.height);
+  ImageView cropped = view;
+  cropped.offset += x * view.x_stride + y * view.y_stride;
+  cropped.width = width;
+  cropped.height = height;
+  return cropped;
+}
+
+void materialize(
+  const ImageView & view,
+  std::vector<unsigned char> & output)
+{
+  const int num_channels = view.num_channels;
+  const std::ptrdiff_t row_size = (std::ptrdiff_t)view.width * num_channels;
+  output.resize(row_size * view.height);
+
+  // Rows of the view are rows of the source: copy row by row (reversing
+  // mirrored rows)
+  if (view.x_stride == num_channels || view.x_stride == -num_channels) {
+    parallel_for(view.height, rows_per_chunk(row_size), [&](const int begin, const int end) {
+      for (int y = begin; y < end; ++y) {
+        const unsigned char * source = view.data + view.offset + y * view.y_stride;
+        unsigned char * target = output.data() + y * row_size;
+        if (view.x_stride == num_channels) {
+          std::memcpy(target, source, row_size);
+        } else {
+          reverse_row(source - (view.width - 1) * num_channels, view.width, num_channels, target);
+        }
+      }
+    });
+    return;
+  }
+
+  // Rows of the view are columns of the source: copy in tiles so that the
+  // strided reads of one tile reuse the same few source cache lines, and
+  // transpose 1- and 4-channel tiles in registers. Views whose pixels are
+  // not adjacent along either axis (only built by hand, e.g. every other
+  // pixel) are copied pixel by pixel in the same tiles. Threads take bands
+  // of tile rows.
+  const bool columns = view.y_stride == num_channels || view.y_stride == -num_channels;
+  const int tile = 64;
+  const int num_bands = (view.height + tile - 1) / tile;
+  parallel_for(num_bands, rows_per_chunk(tile * row_size), [&](const int begin, const int end) {
+    for (int band = begin; band < end; ++band) {
+      const int y0 = band * tile;
+      const int y1 = std::min(y0 + tile, view.height);
+      for (int x0 = 0; x0 < view.width; x0 += tile) {
+        const int x1 = std::min(x0 + tile, view.width);
+        if (columns) {
+          transpose_tile(view, x0, x1, y0, y1, output.data(), row_size);
+        } else {
+          copy_pixels(view, x0, x1, y0, y1, output.data(), row_size);
+        }
+      }
+    }
+  });
+}
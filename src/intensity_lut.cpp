@@ -0,0 +1,180 @@
+#include "intensity_lut.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+#if defined(__AVX512VBMI__)
+#include <immintrin.h>
+#endif
+
+// Only AVX-512 VBMI can look a byte up in a 256-byte table in one
+// instruction. With AVX2, vpshufb indexes 16 bytes at a time, so a lookup
+// takes 16 shuffles (one per high nibble) plus the masks to merge them:
+// that measured no faster than the scalar loop, which already does about a
+// byte per cycle, and three times slower per channel. Other targets use the
+// scalar loops, which walk whole pixels so that each channel's table is
+// picked at compile time.
+
+namespace
+{
+#if defined(__AVX512VBMI__)
+  // The four 64-byte quarters of a lookup table
+  struct LutQuarters {
+    __m512i q[4];
+  };
+
+  inline LutQuarters load_quarters(const IntensityLut & lut)
+  {
+    return {{
+      _mm512_loadu_si512(lut.data()),
+      _mm512_loadu_si512(lut.data() + 64),
+      _mm512_loadu_si512(lut.data() + 128),
+      _mm512_loadu_si512(lut.data() + 192)}};
+  }
+
+  // vpermi2b indexes a 128-byte table with the low 7 bits of each byte:
+  // look up both halves of the table and pick by the top bit
+  inline __m512i lookup64(const __m512i x, const LutQuarters & lut)
+  {
+    const __m512i low = _mm512_permutex2var_epi8(lut.q[0], x, lut.q[1]);
+    const __m512i high = _mm512_permutex2var_epi8(lut.q[2], x, lut.q[3]);
+    return _mm512_mask_blend_epi8(_mm512_movepi8_mask(x), low, high);
+  }
+#endif
+
+  // Look up n consecutive intensities
+  void lookup_span(
+    const unsigned char * input,
+    const std::size_t n,
+    const IntensityLut & lut,
+    unsigned char * output)
+  {
+    std::size_t i = 0;
+#if defined(__AVX512VBMI__)
+    const LutQuarters quarters = load_quarters(lut);
+    for (; i + 64 <= n; i += 64) {
+      _mm512_storeu_si512(output + i, lookup64(_mm512_loadu_si512(input + i), quarters));
+    }
+#endif
+    for (; i < n; ++i) {
+      output[i] = lut[input[i]];
+    }
+  }
+
+  // Look up the intensities of interleaved NumChannels pixels from i to n,
+  // i being the start of a pixel
+  template <int NumChannels>
+  void lookup_pixels(
+    const unsigned char * input,
+    const std::size_t n,
+    const std::vector<IntensityLut> & luts,
+    unsigned char * output,
+    std::size_t i)
+  {
+    for (; i + NumChannels <= n; i += NumChannels) {
+      for (int c = 0; c < NumChannels; ++c) {
+        output[i + c] = luts[c][input[i + c]];
+      }
+    }
+    for (int c = 0; i < n; ++i, ++c) {
+      output[i] = luts[c][input[i]];
+    }
+  }
+
+  // Look up n consecutive intensities of interleaved num_channels pixels
+  // (starting with channel 0), each channel in its own table
+  void lookup_channels_span(
+    const unsigned char * input,
+    const std::size_t n,
+    const int num_channels,
+    const std::vector<IntensityLut> & luts,
+    unsigned char * output)
+  {
+    std::size_t i = 0;
+#if defined(__AVX512VBMI__)
+    // Look every byte up in each channel's table and keep the lookups that
+    // match its channel. Which byte of a vector holds which channel repeats
+    // every 3 vectors for rgb, and every vector otherwise.
+    LutQuarters quarters[4];
+    for (int c = 0; c < num_channels; ++c) {
+      quarters[c] = load_quarters(luts[c]);
+    }
+    const int period = num_channels == 3 ? 3 : 1;
+    __mmask64 channel_masks[3][4] = {};
+    for (int phase = 0; phase < period; ++phase) {
+      for (int j = 0; j < 64; ++j) {
+        channel_masks[phase][(64 * phase + j) % num_channels] |= __mmask64(1) << j;
+      }
+    }
+    for (int phase = 0; i + 64 <= n; i += 64, phase = phase + 1 == period ? 0 : phase + 1) {
+      const __m512i x = _mm512_loadu_si512(input + i);
+      __m512i mapped = lookup64(x, quarters[0]);
+      for (int c = 1; c < num_channels; ++c) {
+        mapped = _mm512_mask_blend_epi8(channel_masks[phase][c], mapped, lookup64(x, quarters[c]));
+      }
+      _mm512_storeu_si512(output + i, mapped);
+    }
+#endif
+    // Finish the pixel the vectors stopped in, then go pixel by pixel
+    for (int c = i % num_channels; c != 0 && i < n; ++i, c = c + 1 == num_channels ? 0 : c + 1) {
+      output[i] = luts[c][input[i]];
+    }
+    switch (num_channels) {
+      case 1: lookup_pixels<1>(input, n, luts, output, i); break;
+      case 2: lookup_pixels<2>(input, n, luts, output, i); break;
+      case 3: lookup_pixels<3>(input, n, luts, output, i); break;
+      default: lookup_pixels<4>(input, n, luts, output, i); break;
+    }
+  }
+}
+
+IntensityLut identity_lut()
+{
+  IntensityLut lut;
+  for (int i = 0; i < 256; ++i) {
+    lut[i] = i;
+  }
+  return lut;
+}
+
+void apply_intensity_lut(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels,
+  const IntensityLut & lut,
+  std::vector<unsigned char> & output)
+{
+  const std::size_t row_size = (std::size_t)width * num_channels;
+  output.resize(row_size * height);
+  parallel_for(height, rows_per_chunk(row_size), [&](const int begin, const int end) {
+    lookup_span(
+      image.data() + begin * row_size,
+      (end - begin) * row_size,
+      lut,
+      output.data() + begin * row_size);
+  });
+}
+
+void apply_intensity_luts(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels,
+  const std::vector<IntensityLut> & luts,
+  std::vector<unsigned char> & output)
+{
+  assert(num_channels >= 1 && num_channels <= 4);
+  assert((int)luts.size() == num_channels && "one lookup table per channel");
+  const std::size_t row_size = (std::size_t)width * num_channels;
+  output.resize(row_size * height);
+  parallel_for(height, rows_per_chunk(row_size), [&](const int begin, const int end) {
+    lookup_channels_span(
+      image.data() + begin * row_size,
+      (end - begin) * row_size,
+      num_channels,
+      luts,
+      output.data() + begin * row_size);
+  });
+}
@@ -0,0 +1,124 @@
+#include "orientation.h"
+#include <array>
+#include <cassert>
+
+namespace
+{
+  // An orientation acts on pixel coordinates (centered on the image) as a
+  // signed permutation matrix M: output pixel p of the oriented view is
+  // input pixel M*p. Flipping x negates the first coordinate, flipping y the
+  // second and transposing swaps them; since each view reads the one before
+  // it, the canonical form is M = S^transposed * X^flipped_x * Y^flipped_y.
+  using Matrix = std::array<int, 4>;  // {m00, m01, m10, m11}
+
+  Matrix to_matrix(const Orientation & orientation)
+  {
+    const int sx = orientation.flipped_x ? -1 : 1;
+    const int sy = orientation.flipped_y ? -1 : 1;
+    return orientation.transposed ? Matrix{0, sy, sx, 0} : Matrix{sx, 0, 0, sy};
+  }
+
+  Orientation from_matrix(const Matrix & m)
+  {
+    Orientation orientation;
+    orientation.transposed = m[0] == 0;
+    orientation.flipped_x = (orientation.transposed ? m[2] : m[0]) < 0;
+    orientation.flipped_y = (orientation.transposed ? m[1] : m[3]) < 0;
+    return orientation;
+  }
+
+  Matrix multiply(const Matrix & a, const Matrix & b)
+  {
+    return {
+      a[0] * b[0] + a[1] * b[2], a[0] * b[1] + a[1] * b[3],
+      a[2] * b[0] + a[3] * b[2], a[2] * b[1] + a[3] * b[3]};
+  }
+}
+
+Orientation horizontal_flip()
+{
+  return {false, true, false};
+}
+
+Orientation vertical_flip()
+{
+  return {false, false, true};
+}
+
+Orientation transposition()
+{
+  return {true, false, false};
+}
+
+Orientation rotation(const int quarter_turns)
+{
+  // One counter-clockwise turn is a transpose then a vertical flip (see
+  // rotate_view)
+  Orientation rotated;
+  for (int turn = ((quarter_turns % 4) + 4) % 4; turn > 0; --turn) {
+    rotated = compose(rotated, {true, false, true});
+  }
+  return rotated;
+}
+
+Orientation exif_orientation(const int tag)
+{
+  switch (tag) {
+    case 1: return {};
+    case 2: return horizontal_flip();
+    case 3: return rotation(2);
+    case 4: return vertical_flip();
+    case 5: return transposition();
+    case 6: return rotation(-1);
+    case 7: return compose(transposition(), rotation(2));
+    case 8: return rotation(1);
+  }
+  assert(false && "EXIF orientation tags range from 1 to 8");
+  return {};
+}
+
+Orientation compose(const Orientation & first, const Orientation & second)
+{
+  // The second view reads the first, so its matrix applies first
+  return from_matrix(multiply(to_matrix(first), to_matrix(second)));
+}
+
+Orientation compose(const std::vector<Orientation> & steps)
+{
+  Orientation composed;
+  for (const Orientation & step : steps) {
+    composed = compose(composed, step);
+  }
+  return composed;
+}
+
+Orientation inverse(const Orientation & orientation)
+{
+  // Signed permutation matrices are orthogonal
+  const Matrix m = to_matrix(orientation);
+  return from_matrix({m[0], m[2], m[1], m[3]});
+}
+
+ImageView orient_view(const ImageView & view, const Orientation & orientation)
+{
+  ImageView oriented = orientation.transposed ? transpose(view) : view;
+  if (orientation.flipped_x) {
+    oriented = flip_horizontal(oriented);
+  }
+  if (orientation.flipped_y) {
+    oriented = flip_vertical(oriented);
+  }
+  return oriented;
+}
+
+void orient(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  const Orientation & orientation,
+  std::vector<unsigned char> & oriented)
+{
+  const ImageView view = make_image_view(input, width, height, num_channels);
+  materialize(orient_view(view, orientation), oriented);
+}
@@ -1,4 +1,6 @@
 #include "over.h"
+#include "srgb.h"
+#include <cstdint>
 
 void over(
   const std::vector<unsigned char> & A,
@@ -49,3 +51,29 @@ void over(
     }
   }
 }
+
+void over_linear(
+  const std::vector<unsigned char> & A,
+  const std::vector<unsigned char> & B,
+  const int & width,
+  const int & height,
+  std::vector<unsigned char> & C)
+{
+  C.resize(A.size());
+
+  // The DestAtop blend of over, in linear light and fixed point: with
+  // alphas a_s, a_d in [0,255] and linear colors s, d in [0,65535],
+  //   a_s*((255 - a_d)*s + a_d*d) <= 255*255*65535 < 2^32
+  // and dividing by 255*255 (rounded) gives the linear result
+  for (int i = 0; i < width * height; ++i) {
+    const std::uint32_t alpha_s = B[i * 4 + 3];
+    const std::uint32_t alpha_d = A[i * 4 + 3];
+    for (int c = 0; c < 3; ++c) {
+      const std::uint32_t s = srgb_to_linear(B[i * 4 + c]);
+      const std::uint32_t d = srgb_to_linear(A[i * 4 + c]);
+      const std::uint32_t blended = alpha_s * ((255 - alpha_d) * s + alpha_d * d);
+      C[i * 4 + c] = linear_to_srgb((blended + 65025 / 2) / 65025);
+    }
+    C[i * 4 + 3] = alpha_s;
+  }
+}
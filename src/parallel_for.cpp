@@ -0,0 +1,65 @@
+#include "parallel_for.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  std::atomic<int> & spare_threads()
+  {
+    static std::atomic<int> spare((int)std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return spare;
+  }
+}
+
+int acquire_threads(const int wanted)
+{
+  std::atomic<int> & spare = spare_threads();
+  int available = spare.load();
+  int granted;
+  do {
+    granted = std::max(0, std::min(wanted, available));
+  } while (granted > 0 && !spare.compare_exchange_weak(available, available - granted));
+  return granted;
+}
+
+void release_threads(const int count)
+{
+  spare_threads() += count;
+}
+
+void parallel_for(
+  const int n,
+  const int min_chunk,
+  const std::function<void(int, int)> & body)
+{
+  if (n <= 0) {
+    return;
+  }
+  const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+  const int wanted = std::max(1, std::min(max_threads, n / std::max(1, min_chunk)));
+  const int num_chunks = wanted == 1 ? 1 : 1 + acquire_threads(wanted - 1);
+  if (num_chunks == 1) {
+    body(0, n);
+    return;
+  }
+
+  // The calling thread takes the first chunk itself
+  std::vector<std::thread> workers;
+  for (int chunk = 1; chunk < num_chunks; ++chunk) {
+    const int begin = (int)((long long)n * chunk / num_chunks);
+    const int end = (int)((long long)n * (chunk + 1) / num_chunks);
+    workers.emplace_back(body, begin, end);
+  }
+  body(0, (int)((long long)n / num_chunks));
+  for (auto & worker : workers) {
+    worker.join();
+  }
+  release_threads(num_chunks - 1);
+}
+
+int rows_per_chunk(const std::ptrdiff_t bytes_per_row)
+{
+  return (int)std::max<std::ptrdiff_t>(1, (1 << 18) / std::max<std::ptrdiff_t>(1, bytes_per_row));
+}
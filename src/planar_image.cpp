@@ -0,0 +1,309 @@
+#include "planar_image.h"
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+#if defined(__SSSE3__)
+  // pshufb masks moving channel k of 16 rgb pixels out of the j-th of the
+  // three 16-byte blocks holding them (0x80 zeroes a lane)
+  struct Rgb3Masks {
+    alignas(16) unsigned char deinterleave[3][3][16];
+    alignas(16) unsigned char interleave[3][3][16];
+  };
+
+  constexpr Rgb3Masks make_rgb3_masks()
+  {
+    Rgb3Masks masks{};
+    for (int k = 0; k < 3; ++k) {
+      for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 16; ++i) {
+          // planar byte i of channel k comes from interleaved byte 3*i+k
+          const int source = 3 * i + k - 16 * j;
+          masks.deinterleave[k][j][i] =
+            (source >= 0 && source < 16) ? source : 0x80;
+          // interleaved byte 16*j+i comes from planar byte (16*j+i)/3
+          const int target = 16 * j + i;
+          masks.interleave[k][j][i] = (target % 3 == k) ? target / 3 : 0x80;
+        }
+      }
+    }
+    return masks;
+  }
+
+  constexpr Rgb3Masks rgb3_masks = make_rgb3_masks();
+
+  inline __m128i mask(const unsigned char (&bytes)[16])
+  {
+    return _mm_load_si128(reinterpret_cast<const __m128i *>(bytes));
+  }
+
+  // Split 16 rgba pixels into 4 vectors of 16 r, g, b and a intensities
+  inline void deinterleave4(
+    const unsigned char * source,
+    __m128i & r,
+    __m128i & g,
+    __m128i & b,
+    __m128i & a)
+  {
+    // Group each block of 4 pixels as rrrr gggg bbbb aaaa...
+    const __m128i group = _mm_setr_epi8(
+      0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m128i b0 = _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(source)), group);
+    const __m128i b1 = _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 16)), group);
+    const __m128i b2 = _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 32)), group);
+    const __m128i b3 = _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 48)), group);
+    // ...then transpose the 4x4 matrix of 32-bit groups
+    const __m128i t0 = _mm_unpacklo_epi32(b0, b1);
+    const __m128i t1 = _mm_unpackhi_epi32(b0, b1);
+    const __m128i t2 = _mm_unpacklo_epi32(b2, b3);
+    const __m128i t3 = _mm_unpackhi_epi32(b2, b3);
+    r = _mm_unpacklo_epi64(t0, t2);
+    g = _mm_unpackhi_epi64(t0, t2);
+    b = _mm_unpacklo_epi64(t1, t3);
+    a = _mm_unpackhi_epi64(t1, t3);
+  }
+#endif
+}
+
+void deinterleave_rgb(
+  const unsigned char * source,
+  const int num_pixels,
+  const int source_channels,
+  unsigned char * r,
+  unsigned char * g,
+  unsigned char * b)
+{
+  int i = 0;
+#if defined(__SSSE3__)
+  if (source_channels == 3) {
+    const Rgb3Masks & m = rgb3_masks;
+    for (; i + 16 <= num_pixels; i += 16) {
+      const unsigned char * p = source + 3 * i;
+      const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+      const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 32));
+      unsigned char * planes[3] = {r + i, g + i, b + i};
+      for (int k = 0; k < 3; ++k) {
+        const __m128i channel = _mm_or_si128(
+          _mm_or_si128(
+            _mm_shuffle_epi8(v0, mask(m.deinterleave[k][0])),
+            _mm_shuffle_epi8(v1, mask(m.deinterleave[k][1]))),
+          _mm_shuffle_epi8(v2, mask(m.deinterleave[k][2])));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(planes[k]), channel);
+      }
+    }
+  } else {
+    for (; i + 16 <= num_pixels; i += 16) {
+      __m128i vr, vg, vb, va;
+      deinterleave4(source + 4 * i, vr, vg, vb, va);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(r + i), vr);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(g + i), vg);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(b + i), vb);
+    }
+  }
+#elif defined(__ARM_NEON)
+  if (source_channels == 3) {
+    for (; i + 16 <= num_pixels; i += 16) {
+      const uint8x16x3_t v = vld3q_u8(source + 3 * i);
+      vst1q_u8(r + i, v.val[0]);
+      vst1q_u8(g + i, v.val[1]);
+      vst1q_u8(b + i, v.val[2]);
+    }
+  } else {
+    for (; i + 16 <= num_pixels; i += 16) {
+      const uint8x16x4_t v = vld4q_u8(source + 4 * i);
+      vst1q_u8(r + i, v.val[0]);
+      vst1q_u8(g + i, v.val[1]);
+      vst1q_u8(b + i, v.val[2]);
+    }
+  }
+#endif
+  for (; i < num_pixels; ++i) {
+    r[i] = source[source_channels * i];
+    g[i] = source[source_channels * i + 1];
+    b[i] = source[source_channels * i + 2];
+  }
+}
+
+void interleave_rgb(
+  const unsigned char * r,
+  const unsigned char * g,
+  const unsigned char * b,
+  const int num_pixels,
+  unsigned char * rgb)
+{
+  int i = 0;
+#if defined(__SSSE3__)
+  const Rgb3Masks & m = rgb3_masks;
+  for (; i + 16 <= num_pixels; i += 16) {
+    const __m128i vr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r + i));
+    const __m128i vg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g + i));
+    const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+    for (int j = 0; j < 3; ++j) {
+      const __m128i block = _mm_or_si128(
+        _mm_or_si128(
+          _mm_shuffle_epi8(vr, mask(m.interleave[0][j])),
+          _mm_shuffle_epi8(vg, mask(m.interleave[1][j]))),
+        _mm_shuffle_epi8(vb, mask(m.interleave[2][j])));
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(rgb + 3 * i + 16 * j), block);
+    }
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= num_pixels; i += 16) {
+    uint8x16x3_t v;
+    v.val[0] = vld1q_u8(r + i);
+    v.val[1] = vld1q_u8(g + i);
+    v.val[2] = vld1q_u8(b + i);
+    vst3q_u8(rgb + 3 * i, v);
+  }
+#endif
+  for (; i < num_pixels; ++i) {
+    rgb[3 * i] = r[i];
+    rgb[3 * i + 1] = g[i];
+    rgb[3 * i + 2] = b[i];
+  }
+}
+
+void interleaved_to_planar(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  PlanarImage & planar)
+{
+  assert(
+    (num_channels == 1 || num_channels == 3 || num_channels == 4) &&
+    "only grayscale, rgb and rgba images are supported");
+  const int num_pixels = width * height;
+  planar.width = width;
+  planar.height = height;
+  planar.num_channels = num_channels;
+  planar.data.resize((size_t)num_pixels * num_channels);
+
+  if (num_channels == 1) {
+    std::memcpy(planar.data.data(), input.data(), num_pixels);
+    return;
+  }
+  if (num_channels == 3) {
+    deinterleave_rgb(input.data(), num_pixels, 3,
+      plane(planar, 0), plane(planar, 1), plane(planar, 2));
+    return;
+  }
+
+  unsigned char * r = plane(planar, 0);
+  unsigned char * g = plane(planar, 1);
+  unsigned char * b = plane(planar, 2);
+  unsigned char * a = plane(planar, 3);
+  int i = 0;
+#if defined(__SSSE3__)
+  for (; i + 16 <= num_pixels; i += 16) {
+    __m128i vr, vg, vb, va;
+    deinterleave4(input.data() + 4 * i, vr, vg, vb, va);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(r + i), vr);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(g + i), vg);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(b + i), vb);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(a + i), va);
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= num_pixels; i += 16) {
+    const uint8x16x4_t v = vld4q_u8(input.data() + 4 * i);
+    vst1q_u8(r + i, v.val[0]);
+    vst1q_u8(g + i, v.val[1]);
+    vst1q_u8(b + i, v.val[2]);
+    vst1q_u8(a + i, v.val[3]);
+  }
+#endif
+  for (; i < num_pixels; ++i) {
+    r[i] = input[4 * i];
+    g[i] = input[4 * i + 1];
+    b[i] = input[4 * i + 2];
+    a[i] = input[4 * i + 3];
+  }
+}
+
+void rgba_to_planar_rgb(
+  const std::vector<unsigned char> & rgba,
+  const int width,
+  const int height,
+  PlanarImage & planar)
+{
+  planar.width = width;
+  planar.height = height;
+  planar.num_channels = 3;
+  planar.data.resize((size_t)width * height * 3);
+  deinterleave_rgb(rgba.data(), width * height, 4,
+    plane(planar, 0), plane(planar, 1), plane(planar, 2));
+}
+
+void planar_to_interleaved(
+  const PlanarImage & planar,
+  std::vector<unsigned char> & output)
+{
+  const int num_channels = planar.num_channels;
+  assert(
+    (num_channels == 1 || num_channels == 3 || num_channels == 4) &&
+    "only grayscale, rgb and rgba images are supported");
+  const int num_pixels = planar.width * planar.height;
+  output.resize((size_t)num_pixels * num_channels);
+  unsigned char * target = output.data();
+
+  if (num_channels == 1) {
+    std::memcpy(target, planar.data.data(), num_pixels);
+    return;
+  }
+
+  const unsigned char * r = plane(planar, 0);
+  const unsigned char * g = plane(planar, 1);
+  const unsigned char * b = plane(planar, 2);
+  if (num_channels == 3) {
+    interleave_rgb(r, g, b, num_pixels, target);
+    return;
+  }
+
+  int i = 0;
+  const unsigned char * a = plane(planar, 3);
+#if defined(__SSSE3__)
+  for (; i + 16 <= num_pixels; i += 16) {
+    const __m128i vr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r + i));
+    const __m128i vg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g + i));
+    const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+    const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    const __m128i rg_lo = _mm_unpacklo_epi8(vr, vg);
+    const __m128i rg_hi = _mm_unpackhi_epi8(vr, vg);
+    const __m128i ba_lo = _mm_unpacklo_epi8(vb, va);
+    const __m128i ba_hi = _mm_unpackhi_epi8(vb, va);
+    __m128i * out = reinterpret_cast<__m128i *>(target + 4 * i);
+    _mm_storeu_si128(out, _mm_unpacklo_epi16(rg_lo, ba_lo));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= num_pixels; i += 16) {
+    uint8x16x4_t v;
+    v.val[0] = vld1q_u8(r + i);
+    v.val[1] = vld1q_u8(g + i);
+    v.val[2] = vld1q_u8(b + i);
+    v.val[3] = vld1q_u8(a + i);
+    vst4q_u8(target + 4 * i, v);
+  }
+#endif
+  for (; i < num_pixels; ++i) {
+    target[4 * i] = r[i];
+    target[4 * i + 1] = g[i];
+    target[4 * i + 2] = b[i];
+    target[4 * i + 3] = a[i];
+  }
+}
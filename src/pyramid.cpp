@@ -0,0 +1,169 @@
+#include "pyramid.h"
+#include "parallel_for.h"
+#include "srgb.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  // Average the 2x2 blocks of two rows of width pixels (bottom may be top)
+  // into (width+1)/2 pixels
+  void reduce_rows(
+    const unsigned char * top,
+    const unsigned char * bottom,
+    const int width,
+    const int num_channels,
+    const bool gamma_correct,
+    unsigned char * output)
+  {
+    const int new_width = (width + 1) / 2;
+    int x = 0;
+    if (gamma_correct) {
+      const bool has_alpha = num_channels == 2 || num_channels == 4;
+      for (; x < new_width; ++x) {
+        const int left = 2 * x * num_channels;
+        const int right = std::min(2 * x + 1, width - 1) * num_channels;
+        for (int c = 0; c < num_channels; ++c) {
+          if (has_alpha && c == num_channels - 1) {
+            output[x * num_channels + c] =
+              (top[left + c] + top[right + c] + bottom[left + c] + bottom[right + c] + 2) >> 2;
+          } else {
+            const unsigned int sum =
+              srgb_to_linear(top[left + c]) + srgb_to_linear(top[right + c]) +
+              srgb_to_linear(bottom[left + c]) + srgb_to_linear(bottom[right + c]);
+            output[x * num_channels + c] = linear_to_srgb((sum + 2) >> 2);
+          }
+        }
+      }
+      return;
+    }
+#if defined(__AVX2__)
+    if (num_channels <= 4) {
+      // Each 128-bit lane takes 16 bytes of pixel pairs (12 for rgb), lines
+      // up the two bytes of each channel of a pair and sums them with
+      // maddubs; top and bottom sums are then added and rounded
+      const int lane_bytes = num_channels == 3 ? 12 : 16;
+      const int lane_pixels = lane_bytes / (2 * num_channels);
+      const __m256i pairs =
+        num_channels == 1 ? _mm256_setr_epi8(
+          0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+          0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15) :
+        num_channels == 2 ? _mm256_setr_epi8(
+          0, 2, 1, 3, 4, 6, 5, 7, 8, 10, 9, 11, 12, 14, 13, 15,
+          0, 2, 1, 3, 4, 6, 5, 7, 8, 10, 9, 11, 12, 14, 13, 15) :
+        num_channels == 3 ? _mm256_setr_epi8(
+          0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, -1, -1, -1, -1,
+          0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, -1, -1, -1, -1) :
+        _mm256_setr_epi8(
+          0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15,
+          0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+      const __m256i ones = _mm256_set1_epi8(1);
+      const __m256i two = _mm256_set1_epi16(2);
+      const auto load = [&](const unsigned char * p) {
+        return _mm256_shuffle_epi8(_mm256_setr_m128i(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)),
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + lane_bytes))), pairs);
+      };
+      const int out_bytes = lane_bytes / 2;
+      for (; 2 * x * num_channels + lane_bytes + 16 <= width * num_channels; x += 2 * lane_pixels) {
+        const int offset = 2 * x * num_channels;
+        const __m256i sum = _mm256_add_epi16(
+          _mm256_add_epi16(_mm256_maddubs_epi16(load(top + offset), ones), _mm256_maddubs_epi16(load(bottom + offset), ones)),
+          two);
+        const __m256i averages = _mm256_packus_epi16(_mm256_srli_epi16(sum, 2), _mm256_setzero_si256());
+        unsigned char * target = output + x * num_channels;
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(target), _mm256_castsi256_si128(averages));
+        const long long high = _mm_cvtsi128_si64(_mm256_extracti128_si256(averages, 1));
+        std::memcpy(target + out_bytes, &high, out_bytes);
+      }
+    }
+#endif
+    for (; x < new_width; ++x) {
+      const int left = 2 * x * num_channels;
+      const int right = std::min(2 * x + 1, width - 1) * num_channels;
+      for (int c = 0; c < num_channels; ++c) {
+        output[x * num_channels + c] =
+          (top[left + c] + top[right + c] + bottom[left + c] + bottom[right + c] + 2) >> 2;
+      }
+    }
+  }
+
+  // Stream the source rows [begin,end) through levels [first,first+depth):
+  // each pair of rows of one level that is complete immediately yields a
+  // row of the next
+  void reduce_band(
+    const unsigned char * source,
+    const int width,
+    const int height,
+    const int num_channels,
+    const bool gamma_correct,
+    std::vector<PyramidLevel> & levels,
+    const int first,
+    const int depth,
+    const int begin,
+    const int end)
+  {
+    const auto row = [num_channels](auto * pixels, const int level_width, const int y) {
+      return pixels + (std::size_t)y * level_width * num_channels;
+    };
+    for (int y = begin; y < end; y += 2) {
+      PyramidLevel * level = &levels[first];
+      int r = y / 2;
+      reduce_rows(
+        row(source, width, y), row(source, width, std::min(y + 1, height - 1)),
+        width, num_channels, gamma_correct, row(level->pixels.data(), level->width, r));
+      for (int k = first + 1; k < first + depth && (r % 2 == 1 || r == level->height - 1); ++k) {
+        PyramidLevel & next = levels[k];
+        reduce_rows(
+          row(level->pixels.data(), level->width, r - r % 2), row(level->pixels.data(), level->width, r),
+          level->width, num_channels, gamma_correct, row(next.pixels.data(), next.width, r / 2));
+        level = &next;
+        r /= 2;
+      }
+    }
+  }
+}
+
+void build_pyramid(
+  const std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels,
+  const bool gamma_correct,
+  std::vector<PyramidLevel> & levels)
+{
+  assert(width > 0 && height > 0);
+  assert(image.size() >= (std::size_t)width * height * num_channels);
+  levels.clear();
+  for (int w = width, h = height; w > 1 || h > 1;) {
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+    levels.push_back({w, h, std::vector<unsigned char>((std::size_t)w * h * num_channels)});
+  }
+
+  // Bands of 2^depth source rows cascade through depth levels on their
+  // own, so threads can take separate bands. The few remaining levels are
+  // streamed the same way from the last level built.
+  const int max_depth = 6;
+  const unsigned char * source = image.data();
+  int source_width = width;
+  int source_height = height;
+  for (int first = 0; first < (int)levels.size(); first += max_depth) {
+    const int depth = std::min(max_depth, (int)levels.size() - first);
+    const int band = 1 << depth;
+    const int num_bands = (source_height + band - 1) / band;
+    parallel_for(num_bands, rows_per_chunk(band * source_width * num_channels), [&](const int band_begin, const int band_end) {
+      reduce_band(source, source_width, source_height, num_channels, gamma_correct, levels,
+        first, depth, band_begin * band, std::min(band_end * band, source_height));
+    });
+    const PyramidLevel & last = levels[first + depth - 1];
+    source = last.pixels.data();
+    source_width = last.width;
+    source_height = last.height;
+  }
+}
@@ -0,0 +1,35 @@
+#include "read_ppm.h"
+#include <fstream>
+
+bool read_ppm(
+  const std::string & filename,
+  std::vector<unsigned char> & data,
+  int & width,
+  int & height,
+  int & num_channels)
+{
+  std::ifstream ifs(filename);
+  if (!ifs) return false;
+
+  // Read header
+  std::string magic;
+  int max_value;
+  ifs >> magic >> width >> height >> max_value;
+  if (!ifs || max_value != 255 || width <= 0 || height <= 0) return false;
+  if (magic == "P2") {
+    num_channels = 1;
+  } else if (magic == "P3") {
+    num_channels = 3;
+  } else {
+    return false;
+  }
+
+  // Read pixels
+  data.resize((size_t)width * height * num_channels);
+  for (auto & value : data) {
+    int intensity;
+    if (!(ifs >> intensity) || intensity < 0 || intensity > 255) return false;
+    value = static_cast<unsigned char>(intensity);
+  }
+  return true;
+}
@@ -1,5 +1,76 @@
 #include "reflect.h"
-#include <iostream>
+#include "orientation.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  // Reverse the order of the width pixels of a row in place, swapping
+  // vectors from both ends towards the middle
+  void reverse_row_in_place(
+    unsigned char * row,
+    const int width,
+    const int num_channels)
+  {
+    int x = 0;
+#if defined(__SSSE3__)
+    if (num_channels == 1) {
+      const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+      for (; 2 * x + 32 <= width; x += 16) {
+        __m128i * left = reinterpret_cast<__m128i *>(row + x);
+        __m128i * right = reinterpret_cast<__m128i *>(row + width - 16 - x);
+        const __m128i l = _mm_loadu_si128(left);
+        const __m128i r = _mm_loadu_si128(right);
+        _mm_storeu_si128(left, _mm_shuffle_epi8(r, reverse));
+        _mm_storeu_si128(right, _mm_shuffle_epi8(l, reverse));
+      }
+    }
+    if (num_channels == 3) {
+      // 5 pixels from each end. The left vector carries the first byte of
+      // the pixel after its 5 and the right vector the last byte of the pixel
+      // before its 5; both bytes are written back unchanged.
+      const __m128i reverse_left = _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -1);
+      const __m128i reverse_right = _mm_setr_epi8(-1, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2);
+      const __m128i last = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1);
+      const __m128i first = _mm_setr_epi8(-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+      for (; 6 * x + 32 <= 3 * width; x += 5) {
+        __m128i * left = reinterpret_cast<__m128i *>(row + 3 * x);
+        __m128i * right = reinterpret_cast<__m128i *>(row + 3 * (width - 5 - x) - 1);
+        const __m128i l = _mm_loadu_si128(left);
+        const __m128i r = _mm_loadu_si128(right);
+        _mm_storeu_si128(left, _mm_or_si128(_mm_shuffle_epi8(r, reverse_left), _mm_and_si128(l, last)));
+        _mm_storeu_si128(right, _mm_or_si128(_mm_shuffle_epi8(l, reverse_right), _mm_and_si128(r, first)));
+      }
+    }
+#endif
+#if defined(__SSE2__)
+    if (num_channels == 4) {
+      for (; 2 * x + 8 <= width; x += 4) {
+        __m128i * left = reinterpret_cast<__m128i *>(row + 4 * x);
+        __m128i * right = reinterpret_cast<__m128i *>(row + 4 * (width - 4 - x));
+        const __m128i l = _mm_loadu_si128(left);
+        const __m128i r = _mm_loadu_si128(right);
+        _mm_storeu_si128(left, _mm_shuffle_epi32(r, 0x1B));
+        _mm_storeu_si128(right, _mm_shuffle_epi32(l, 0x1B));
+      }
+    }
+#endif
+    for (; x < width - 1 - x; ++x) {
+      std::swap_ranges(
+        row + x * num_channels,
+        row + (x + 1) * num_channels,
+        row + (width - 1 - x) * num_channels);
+    }
+  }
+}
 
 void reflect(
   const std::vector<unsigned char> & input,
@@ -8,32 +79,50 @@ void reflect(
   const int num_channels,
   std::vector<unsigned char> & reflected)
 {
-  reflected.resize(width*height*num_channels);
   ////////////////////////////////////////////////////////////////////////////
   // Add your code here
   ////////////////////////////////////////////////////////////////////////////
 
-  std::cout << num_channels << std::endl;
-
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      // because indexing starts at 0 instead of 1
-      int width_index = width - 1;
-
-      // new x value after reflection against y-axis
-      int new_x = width_index - x;
-
-      // move to the correct row in the flattened array
-      int row = y * width;
+  // new x value after reflection against y-axis is (width - 1) - x, which a
+  // horizontal flip applies while copying each row
+  orient(input, width, height, num_channels, horizontal_flip(), reflected);
+}
 
-      // current column in the flattened array
-      int column = x;
+void reflect_in_place(
+  std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels)
+{
+  assert(image.size() >= (size_t)width * height * num_channels);
+  const std::ptrdiff_t row_size = (std::ptrdiff_t)width * num_channels;
+  parallel_for(height, rows_per_chunk(row_size), [&](const int begin, const int end) {
+    for (int y = begin; y < end; ++y) {
+      reverse_row_in_place(image.data() + y * row_size, width, num_channels);
+    }
+  });
+}
 
-      // go through all values in each channel - e.g., if 3-channel, c = 0 = R, c = 1 = G, c = 2 = B
-      for (int c = 0; c < num_channels; ++c) {
-        // multiply by num_channels to get to the index for the start of each pixel
-        reflected[(row + new_x) * num_channels + c] = input[(row + column) * num_channels + c];
+void flip_vertical_in_place(
+  std::vector<unsigned char> & image,
+  const int width,
+  const int height,
+  const int num_channels)
+{
+  assert(image.size() >= (size_t)width * height * num_channels);
+  const std::ptrdiff_t row_size = (std::ptrdiff_t)width * num_channels;
+  // Swap row y with row height-1-y through a small buffer, a piece at a time
+  parallel_for(height / 2, rows_per_chunk(2 * row_size), [&](const int begin, const int end) {
+    unsigned char buffer[4096];
+    for (int y = begin; y < end; ++y) {
+      unsigned char * top = image.data() + y * row_size;
+      unsigned char * bottom = image.data() + (height - 1 - y) * row_size;
+      for (std::ptrdiff_t i = 0; i < row_size; i += sizeof(buffer)) {
+        const std::size_t size = std::min<std::ptrdiff_t>(sizeof(buffer), row_size - i);
+        std::memcpy(buffer, top + i, size);
+        std::memcpy(top + i, bottom + i, size);
+        std::memcpy(bottom + i, buffer, size);
       }
     }
-  }
+  });
 }
@@ -0,0 +1,380 @@
+#include "resize.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace
+{
+  const int weight_bits = 14;
+
+  double filter_support(const ResizeFilter filter)
+  {
+    switch (filter) {
+      case ResizeFilter::box: return 0.5;
+      case ResizeFilter::bilinear: return 1.0;
+      case ResizeFilter::bicubic: return 2.0;
+      case ResizeFilter::lanczos3: return 3.0;
+    }
+    return 0.0;
+  }
+
+  double filter_weight(const ResizeFilter filter, const double x)
+  {
+    const double t = std::abs(x);
+    switch (filter) {
+      case ResizeFilter::box:
+        return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+      case ResizeFilter::bilinear:
+        return t < 1.0 ? 1.0 - t : 0.0;
+      case ResizeFilter::bicubic:
+        // Catmull-Rom (a = -0.5)
+        if (t < 1.0) {
+          return (1.5 * t - 2.5) * t * t + 1.0;
+        }
+        return t < 2.0 ? ((-0.5 * t + 2.5) * t - 4.0) * t + 2.0 : 0.0;
+      case ResizeFilter::lanczos3: {
+        if (t < 1e-8) {
+          return 1.0;
+        }
+        if (t >= 3.0) {
+          return 0.0;
+        }
+        const double a = M_PI * t;
+        return 3.0 * std::sin(a) * std::sin(a / 3.0) / (a * a);
+      }
+    }
+    return 0.0;
+  }
+
+  ResizeWeights axis_weights(const int size, const int new_size, const ResizeFilter filter)
+  {
+    // Downscaling stretches the filter over the source, so that every
+    // source sample contributes (antialiasing)
+    const double scale = (double)size / new_size;
+    const double stretch = std::max(scale, 1.0);
+    const double support = filter_support(filter) * stretch;
+
+    // Weights of each destination sample over its (clamped) window
+    // [lo[i],lo[i]+taps[i].size())
+    std::vector<std::vector<int>> taps(new_size);
+    std::vector<int> lo(new_size);
+    int num_taps = 1;
+    for (int i = 0; i < new_size; ++i) {
+      const double center = (i + 0.5) * scale;
+      const int begin = (int)std::floor(center - support - 0.5);
+      const int end = (int)std::ceil(center + support - 0.5);
+      lo[i] = std::min(std::max(begin, 0), size - 1);
+      std::vector<double> raw(std::min(std::max(end, 0), size - 1) - lo[i] + 1, 0.0);
+      double sum = 0.0;
+      for (int j = begin; j <= end; ++j) {
+        const double weight = filter_weight(filter, (j + 0.5 - center) / stretch);
+        raw[std::min(std::max(j, 0), size - 1) - lo[i]] += weight;
+        sum += weight;
+      }
+      // Quantize, handing the rounding residue to the largest weight so the
+      // weights sum to exactly 1
+      std::vector<int> & quantized = taps[i];
+      quantized.resize(raw.size());
+      int total = 0;
+      std::size_t largest = 0;
+      for (std::size_t j = 0; j < raw.size(); ++j) {
+        quantized[j] = (int)std::lround(raw[j] / sum * (1 << weight_bits));
+        total += quantized[j];
+        largest = std::abs(quantized[j]) > std::abs(quantized[largest]) ? j : largest;
+      }
+      quantized[largest] += (1 << weight_bits) - total;
+      // Trim zero weights off both ends
+      while (quantized.back() == 0) {
+        quantized.pop_back();
+      }
+      const auto nonzero = std::find_if(quantized.begin(), quantized.end(), [](const int w) { return w != 0; });
+      lo[i] += (int)(nonzero - quantized.begin());
+      quantized.erase(quantized.begin(), nonzero);
+      num_taps = std::max(num_taps, (int)quantized.size());
+    }
+
+    ResizeWeights weights;
+    weights.num_taps = num_taps;
+    weights.first.resize(new_size);
+    weights.weights.assign((std::size_t)new_size * num_taps, 0);
+    for (int i = 0; i < new_size; ++i) {
+      weights.first[i] = std::min(lo[i], size - num_taps);
+      for (std::size_t j = 0; j < taps[i].size(); ++j) {
+        weights.weights[(std::size_t)i * num_taps + lo[i] - weights.first[i] + j] = (int16_t)taps[i][j];
+      }
+    }
+    return weights;
+  }
+
+  inline unsigned char round_weighted(const int sum)
+  {
+    return (unsigned char)std::min(std::max((sum + (1 << (weight_bits - 1))) >> weight_bits, 0), 255);
+  }
+
+  // One row of the horizontal pass: new_width pixels from width pixels
+  template <int num_channels>
+  void resample_row(
+    const unsigned char * source,
+    [[maybe_unused]] const int width,
+    const ResizeWeights & axis,
+    const int new_width,
+    unsigned char * target)
+  {
+    const int num_taps = axis.num_taps;
+    for (int i = 0; i < new_width; ++i) {
+      const unsigned char * pixels = source + axis.first[i] * num_channels;
+      const int16_t * weights = axis.weights.data() + (std::size_t)i * num_taps;
+      int sums[num_channels] = {};
+      int k = 0;
+#if defined(__SSSE3__)
+      // Zero-extend the taps into 16-bit lanes that pair each channel of one
+      // tap with the same channel of the next, so one madd weighs and adds
+      // both
+      __m128i sum = _mm_setzero_si128();
+      if constexpr (num_channels == 1) {
+        const __m128i widen = _mm_setr_epi8(0, -1, 1, -1, 2, -1, 3, -1, 4, -1, 5, -1, 6, -1, 7, -1);
+        for (; k + 8 <= num_taps; k += 8) {
+          sum = _mm_add_epi32(sum, _mm_madd_epi16(
+            _mm_shuffle_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixels + k)), widen),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + k))));
+        }
+        for (; k + 4 <= num_taps; k += 4) {
+          int32_t taps;
+          int64_t quad;
+          std::memcpy(&taps, pixels + k, 4);
+          std::memcpy(&quad, weights + k, 8);
+          sum = _mm_add_epi32(sum, _mm_madd_epi16(
+            _mm_shuffle_epi8(_mm_cvtsi32_si128(taps), widen), _mm_cvtsi64_si128(quad)));
+        }
+        sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+        sums[0] = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 4));
+      } else if constexpr (num_channels <= 4) {
+        const __m128i widen = num_channels == 2
+          ? _mm_setr_epi8(0, -1, 2, -1, 1, -1, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1)
+          : num_channels == 3
+          ? _mm_setr_epi8(0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1)
+          : _mm_setr_epi8(0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1);
+#if defined(__AVX2__)
+        // Four taps per step: the low lane pairs taps k and k+1, the high
+        // lane taps k+2 and k+3. Loads of 16 bytes must stay in the row.
+        const __m256i widen4 = _mm256_add_epi8(
+          _mm256_broadcastsi128_si256(widen),
+          _mm256_and_si256(
+            _mm256_setr_epi8(
+              0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+              2 * num_channels, 0, 2 * num_channels, 0, 2 * num_channels, 0, 2 * num_channels, 0,
+              2 * num_channels, 0, 2 * num_channels, 0, 2 * num_channels, 0, 2 * num_channels, 0),
+            _mm256_cmpgt_epi8(_mm256_broadcastsi128_si256(widen), _mm256_set1_epi8(-1))));
+        const __m256i spread = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+        const int end = std::min(num_taps, (width * num_channels - 16) / num_channels - axis.first[i]);
+        __m256i sum4 = _mm256_setzero_si256();
+        for (; k + 4 <= end; k += 4) {
+          const __m256i taps = _mm256_shuffle_epi8(
+            _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + k * num_channels))),
+            widen4);
+          const __m256i quad = _mm256_permutevar8x32_epi32(
+            _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(weights + k))), spread);
+          sum4 = _mm256_add_epi32(sum4, _mm256_madd_epi16(taps, quad));
+        }
+        sum = _mm_add_epi32(_mm256_castsi256_si128(sum4), _mm256_extracti128_si256(sum4, 1));
+#endif
+        for (; k + 2 <= num_taps; k += 2) {
+          int64_t taps = 0;
+          int32_t pair;
+          std::memcpy(&taps, pixels + k * num_channels, 2 * num_channels);
+          std::memcpy(&pair, weights + k, 4);
+          sum = _mm_add_epi32(sum, _mm_madd_epi16(
+            _mm_shuffle_epi8(_mm_cvtsi64_si128(taps), widen), _mm_set1_epi32(pair)));
+        }
+        alignas(16) int lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), sum);
+        for (int c = 0; c < num_channels; ++c) {
+          sums[c] = lanes[c];
+        }
+      }
+#endif
+      for (; k < num_taps; ++k) {
+        for (int c = 0; c < num_channels; ++c) {
+          sums[c] += weights[k] * pixels[k * num_channels + c];
+        }
+      }
+      for (int c = 0; c < num_channels; ++c) {
+        target[i * num_channels + c] = round_weighted(sums[c]);
+      }
+    }
+  }
+
+  void resample_row(
+    const unsigned char * source,
+    const int width,
+    const ResizeWeights & axis,
+    const int num_channels,
+    const int new_width,
+    unsigned char * target)
+  {
+    switch (num_channels) {
+      case 1: resample_row<1>(source, width, axis, new_width, target); break;
+      case 2: resample_row<2>(source, width, axis, new_width, target); break;
+      case 3: resample_row<3>(source, width, axis, new_width, target); break;
+      case 4: resample_row<4>(source, width, axis, new_width, target); break;
+      default: {
+        const int num_taps = axis.num_taps;
+        for (int i = 0; i < new_width; ++i) {
+          const unsigned char * pixels = source + axis.first[i] * num_channels;
+          const int16_t * weights = axis.weights.data() + (std::size_t)i * num_taps;
+          for (int c = 0; c < num_channels; ++c) {
+            int sum = 0;
+            for (int k = 0; k < num_taps; ++k) {
+              sum += weights[k] * pixels[k * num_channels + c];
+            }
+            target[i * num_channels + c] = round_weighted(sum);
+          }
+        }
+      }
+    }
+  }
+
+  // One row of the vertical pass: a weighted sum of num_taps rows of size
+  // bytes, rows[k] = first + k*stride
+  void blend_rows(
+    const unsigned char * first,
+    const std::ptrdiff_t stride,
+    const int16_t * weights,
+    const int num_taps,
+    const std::ptrdiff_t size,
+    unsigned char * target)
+  {
+    std::ptrdiff_t i = 0;
+#if defined(__AVX2__)
+    // 16 bytes at a time; pairs of rows are interleaved into 16-bit lanes so
+    // that one madd weighs and adds both
+    for (; i + 16 <= size; i += 16) {
+      __m256i low = _mm256_setzero_si256();
+      __m256i high = _mm256_setzero_si256();
+      int k = 0;
+      for (; k < num_taps; k += 2) {
+        const __m256i a = _mm256_cvtepu8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + k * stride + i)));
+        const __m256i b = k + 1 < num_taps
+          ? _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(first + (k + 1) * stride + i)))
+          : _mm256_setzero_si256();
+        const int16_t next = k + 1 < num_taps ? weights[k + 1] : 0;
+        const __m256i pair = _mm256_set1_epi32((int32_t)(uint16_t)weights[k] | ((int32_t)next << 16));
+        low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), pair));
+        high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), pair));
+      }
+      const __m256i round = _mm256_set1_epi32(1 << (weight_bits - 1));
+      low = _mm256_srai_epi32(_mm256_add_epi32(low, round), weight_bits);
+      high = _mm256_srai_epi32(_mm256_add_epi32(high, round), weight_bits);
+      // The unpacks split each 128-bit lane in halves, which packs restore
+      const __m256i words = _mm256_packs_epi32(low, high);
+      const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(target + i), _mm256_castsi256_si128(bytes));
+    }
+#endif
+    for (; i < size; ++i) {
+      int sum = 0;
+      for (int k = 0; k < num_taps; ++k) {
+        sum += weights[k] * first[k * stride + i];
+      }
+      target[i] = round_weighted(sum);
+    }
+  }
+}
+
+std::shared_ptr<const ResizePlan> resize_plan(
+  const int width,
+  const int height,
+  const int new_width,
+  const int new_height,
+  const ResizeFilter filter)
+{
+  assert(width > 0 && height > 0 && new_width > 0 && new_height > 0);
+  using Key = std::tuple<int, int, int, int, ResizeFilter>;
+  static std::mutex mutex;
+  static std::map<Key, std::shared_ptr<const ResizePlan>> plans;
+  const Key key{width, height, new_width, new_height, filter};
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto found = plans.find(key);
+    if (found != plans.end()) {
+      return found->second;
+    }
+  }
+
+  auto plan = std::make_shared<ResizePlan>();
+  plan->width = width;
+  plan->height = height;
+  plan->new_width = new_width;
+  plan->new_height = new_height;
+  plan->filter = filter;
+  plan->horizontal = axis_weights(width, new_width, filter);
+  plan->vertical = axis_weights(height, new_height, filter);
+
+  // Keep the cache small: batches reuse a handful of size pairs
+  std::lock_guard<std::mutex> lock(mutex);
+  if (plans.size() >= 64) {
+    plans.clear();
+  }
+  return plans.emplace(key, std::move(plan)).first->second;
+}
+
+void resize(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  const int new_width,
+  const int new_height,
+  const ResizeFilter filter,
+  std::vector<unsigned char> & resized)
+{
+  assert(input.size() >= (std::size_t)width * height * num_channels);
+  const std::shared_ptr<const ResizePlan> plan = resize_plan(width, height, new_width, new_height, filter);
+  const std::ptrdiff_t row_size = (std::ptrdiff_t)width * num_channels;
+  const std::ptrdiff_t new_row_size = (std::ptrdiff_t)new_width * num_channels;
+
+  // Horizontal pass over every source row (skipped when the width stays:
+  // the weights would be the identity)
+  std::vector<unsigned char> columns;
+  const unsigned char * horizontal = input.data();
+  if (new_width != width) {
+    columns.resize((std::size_t)height * new_row_size);
+    parallel_for(height, rows_per_chunk(new_row_size), [&](const int begin, const int end) {
+      for (int y = begin; y < end; ++y) {
+        resample_row(input.data() + y * row_size, width, plan->horizontal, num_channels, new_width,
+          columns.data() + y * new_row_size);
+      }
+    });
+    horizontal = columns.data();
+  }
+
+  resized.resize((std::size_t)new_height * new_row_size);
+  if (new_height == height) {
+    std::memcpy(resized.data(), horizontal, resized.size());
+    return;
+  }
+  const ResizeWeights & vertical = plan->vertical;
+  parallel_for(new_height, rows_per_chunk(new_row_size), [&](const int begin, const int end) {
+    for (int y = begin; y < end; ++y) {
+      blend_rows(
+        horizontal + vertical.first[y] * new_row_size,
+        new_row_size,
+        vertical.weights.data() + (std::size_t)y * vertical.num_taps,
+        vertical.num_taps,
+        new_row_size,
+        resized.data() + y * new_row_size);
+    }
+  });
+}
@@ -1,4 +1,231 @@
 #include "rgb_to_gray.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+namespace
+{
+  // Luma weights, as doubles (the reference) and in units of 1/10000
+#if defined(RGB_TO_GRAY_BT601)
+  const double red_weight = 0.299;
+  const double green_weight = 0.587;
+  const double blue_weight = 0.114;
+  const std::uint64_t decimal_weights[3] = {2990, 5870, 1140};
+#else
+  const double red_weight = 0.2126;
+  const double green_weight = 0.7152;
+  const double blue_weight = 0.0722;
+  const std::uint64_t decimal_weights[3] = {2126, 7152, 722};
+#endif
+
+  // The reference conversion: evaluated in double and truncated on store
+  inline unsigned char gray_reference(const int red, const int green, const int blue)
+  {
+    return static_cast<unsigned char>(
+      red_weight * red + green_weight * green + blue_weight * blue);
+  }
+
+  // 8.24 fixed-point weights, rounded up. Each weight is at most one unit
+  // above its exact value, so for any input the fixed-point sum overshoots
+  // the exact luma by at most 3*255 = 765 units (< 2^-14). That never
+  // carries into the integer part (a non-integer luma is at least
+  // 10000^-1 * 2^24 ~ 1677 units below the next integer), so y >> 24 is
+  // exactly floor(luma), and y has a fractional part below
+  // exact_threshold exactly when the luma is an integer. For those inputs
+  // (e.g., every neutral gray) the double reference may land just below the
+  // integer and truncate one lower, so they are delegated to it.
+  constexpr std::uint32_t fixed_weight(const std::uint64_t decimal_weight)
+  {
+    return (std::uint32_t)(((decimal_weight << 24) + 9999) / 10000);
+  }
+  const std::uint32_t red_fixed = fixed_weight(decimal_weights[0]);
+  const std::uint32_t green_fixed = fixed_weight(decimal_weights[1]);
+  const std::uint32_t blue_fixed = fixed_weight(decimal_weights[2]);
+  const std::uint32_t fraction_mask = (1u << 24) - 1;
+  const std::uint32_t exact_threshold = 1u << 10;
+
+  inline unsigned char gray_fixed(const int red, const int green, const int blue)
+  {
+    const std::uint32_t y = red_fixed * red + green_fixed * green + blue_fixed * blue;
+    if ((y & fraction_mask) < exact_threshold) {
+      return gray_reference(red, green, blue);
+    }
+    return y >> 24;
+  }
+
+#if defined(__AVX2__)
+  // Luma of 8 pixels held in 32-bit lanes. Lanes whose luma is an exact
+  // integer are flagged in exact_lanes (one bit per lane).
+  inline __m256i gray_lanes(
+    const __m256i red,
+    const __m256i green,
+    const __m256i blue,
+    int & exact_lanes)
+  {
+    const __m256i y = _mm256_add_epi32(
+      _mm256_add_epi32(
+        _mm256_mullo_epi32(red, _mm256_set1_epi32(red_fixed)),
+        _mm256_mullo_epi32(green, _mm256_set1_epi32(green_fixed))),
+      _mm256_mullo_epi32(blue, _mm256_set1_epi32(blue_fixed)));
+    const __m256i exact = _mm256_cmpgt_epi32(
+      _mm256_set1_epi32(exact_threshold),
+      _mm256_and_si256(y, _mm256_set1_epi32(fraction_mask)));
+    exact_lanes = _mm256_movemask_ps(_mm256_castsi256_ps(exact));
+    return _mm256_srli_epi32(y, 24);
+  }
+
+  // Store the low byte of each of 8 lanes
+  inline void store_lanes(const __m256i lanes, unsigned char * gray)
+  {
+    const __m256i low_bytes = _mm256_shuffle_epi8(lanes, _mm256_setr_epi8(
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const std::uint32_t low = _mm256_cvtsi256_si32(low_bytes);
+    const std::uint32_t high = _mm_cvtsi128_si32(_mm256_extracti128_si256(low_bytes, 1));
+    std::memcpy(gray, &low, 4);
+    std::memcpy(gray + 4, &high, 4);
+  }
+#elif defined(__SSE4_1__)
+  // Luma of 4 pixels held in 32-bit lanes (see the AVX2 version)
+  inline __m128i gray_lanes(
+    const __m128i red,
+    const __m128i green,
+    const __m128i blue,
+    int & exact_lanes)
+  {
+    const __m128i y = _mm_add_epi32(
+      _mm_add_epi32(
+        _mm_mullo_epi32(red, _mm_set1_epi32(red_fixed)),
+        _mm_mullo_epi32(green, _mm_set1_epi32(green_fixed))),
+      _mm_mullo_epi32(blue, _mm_set1_epi32(blue_fixed)));
+    const __m128i exact = _mm_cmpgt_epi32(
+      _mm_set1_epi32(exact_threshold),
+      _mm_and_si128(y, _mm_set1_epi32(fraction_mask)));
+    exact_lanes = _mm_movemask_ps(_mm_castsi128_ps(exact));
+    return _mm_srli_epi32(y, 24);
+  }
+
+  // Store the low byte of each of 4 lanes
+  inline void store_lanes(const __m128i lanes, unsigned char * gray)
+  {
+    const std::uint32_t low = _mm_cvtsi128_si32(_mm_shuffle_epi8(lanes, _mm_setr_epi8(
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)));
+    std::memcpy(gray, &low, 4);
+  }
+#endif
+
+  // Convert num_pixels interleaved rgb pixels
+  // Index of the lowest set bit of a nonzero lane mask (std::countr_zero
+  // rather than a compiler builtin, so MSVC builds it too)
+  inline int lowest_lane(const int lanes)
+  {
+    return std::countr_zero(static_cast<unsigned>(lanes));
+  }
+
+  void gray_span(
+    const unsigned char * rgb,
+    const int num_pixels,
+    unsigned char * gray)
+  {
+    int i = 0;
+#if defined(__AVX2__) || defined(__SSE4_1__)
+    // Spread r, g and b of 4 pixels (12 bytes) over 32-bit lanes
+    const __m128i red_bytes = _mm_setr_epi8(
+      0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1);
+    const __m128i green_bytes = _mm_setr_epi8(
+      1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1);
+    const __m128i blue_bytes = _mm_setr_epi8(
+      2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+#endif
+#if defined(__AVX2__)
+    const __m256i red_mask = _mm256_broadcastsi128_si256(red_bytes);
+    const __m256i green_mask = _mm256_broadcastsi128_si256(green_bytes);
+    const __m256i blue_mask = _mm256_broadcastsi128_si256(blue_bytes);
+    // Each 16-byte load covers 4 pixels, the second one ends 28 bytes in
+    for (; 3 * i + 28 <= 3 * num_pixels; i += 8) {
+      const unsigned char * p = rgb + 3 * i;
+      const __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 12)), 1);
+      int exact_lanes;
+      store_lanes(gray_lanes(
+        _mm256_shuffle_epi8(v, red_mask),
+        _mm256_shuffle_epi8(v, green_mask),
+        _mm256_shuffle_epi8(v, blue_mask), exact_lanes), gray + i);
+      for (; exact_lanes; exact_lanes &= exact_lanes - 1) {
+        const int k = i + lowest_lane(exact_lanes);
+        gray[k] = gray_reference(rgb[3 * k], rgb[3 * k + 1], rgb[3 * k + 2]);
+      }
+    }
+#elif defined(__SSE4_1__)
+    for (; 3 * i + 16 <= 3 * num_pixels; i += 4) {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgb + 3 * i));
+      int exact_lanes;
+      store_lanes(gray_lanes(
+        _mm_shuffle_epi8(v, red_bytes),
+        _mm_shuffle_epi8(v, green_bytes),
+        _mm_shuffle_epi8(v, blue_bytes), exact_lanes), gray + i);
+      for (; exact_lanes; exact_lanes &= exact_lanes - 1) {
+        const int k = i + lowest_lane(exact_lanes);
+        gray[k] = gray_reference(rgb[3 * k], rgb[3 * k + 1], rgb[3 * k + 2]);
+      }
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      gray[i] = gray_fixed(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+    }
+  }
+
+  // Convert num_pixels pixels given as separate r, g and b planes
+  void gray_span_planar(
+    const unsigned char * red,
+    const unsigned char * green,
+    const unsigned char * blue,
+    const int num_pixels,
+    unsigned char * gray)
+  {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= num_pixels; i += 8) {
+      const auto load = [i](const unsigned char * channel) {
+        return _mm256_cvtepu8_epi32(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i *>(channel + i)));
+      };
+      int exact_lanes;
+      store_lanes(gray_lanes(load(red), load(green), load(blue), exact_lanes), gray + i);
+      for (; exact_lanes; exact_lanes &= exact_lanes - 1) {
+        const int k = i + lowest_lane(exact_lanes);
+        gray[k] = gray_reference(red[k], green[k], blue[k]);
+      }
+    }
+#elif defined(__SSE4_1__)
+    for (; i + 4 <= num_pixels; i += 4) {
+      const auto load = [i](const unsigned char * channel) {
+        std::int32_t bytes;
+        std::memcpy(&bytes, channel + i, 4);
+        return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+      };
+      int exact_lanes;
+      store_lanes(gray_lanes(load(red), load(green), load(blue), exact_lanes), gray + i);
+      for (; exact_lanes; exact_lanes &= exact_lanes - 1) {
+        const int k = i + lowest_lane(exact_lanes);
+        gray[k] = gray_reference(red[k], green[k], blue[k]);
+      }
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      gray[i] = gray_fixed(red[i], green[i], blue[i]);
+    }
+  }
+}
 
 void rgb_to_gray(
   const std::vector<unsigned char> & rgb,
@@ -11,12 +238,28 @@ void rgb_to_gray(
   // Add your code here
   ////////////////////////////////////////////////////////////////////////////
 
-  for (int i = 0; i < width * height; ++i) {
-    int red = rgb[i * 3];
-    int green = rgb[i * 3 + 1];
-    int blue = rgb[i * 3 + 2];
-    gray[i] = 0.2126 * red + 0.7152 * green + 0.0722 * blue;
-  }
+  // gray = 0.2126 * red + 0.7152 * green + 0.0722 * blue, in fixed point
+  parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+    gray_span(
+      rgb.data() + (size_t)3 * begin * width,
+      (end - begin) * width,
+      gray.data() + (size_t)begin * width);
+  });
 }
 
-
+void rgb_to_gray(
+  const PlanarImage & rgb,
+  std::vector<unsigned char> & gray)
+{
+  const int width = rgb.width;
+  gray.resize((size_t)width * rgb.height);
+  parallel_for(rgb.height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+    const size_t offset = (size_t)begin * width;
+    gray_span_planar(
+      plane(rgb, 0) + offset,
+      plane(rgb, 1) + offset,
+      plane(rgb, 2) + offset,
+      (end - begin) * width,
+      gray.data() + offset);
+  });
+}
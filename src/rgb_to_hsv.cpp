@@ -1,5 +1,6 @@
 #include "rgb_to_hsv.h"
 #include <algorithm>
+#include <cmath>
 
 void rgb_to_hsv(
   const double r,
@@ -1,4 +1,55 @@
 #include "rgba_to_rgb.h"
+#include "parallel_for.h"
+#include <algorithm>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+  // Drop the alpha of num_pixels rgba pixels
+  void rgba_to_rgb_span(
+    const unsigned char * rgba,
+    const int num_pixels,
+    unsigned char * rgb)
+  {
+    int i = 0;
+#if defined(__SSSE3__)
+    // Pack the 12 rgb bytes of 4 pixels at the bottom of each block, then
+    // splice the four 12-byte runs into three 16-byte stores
+    const __m128i pack = _mm_setr_epi8(
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    for (; i + 16 <= num_pixels; i += 16) {
+      const __m128i * p = reinterpret_cast<const __m128i *>(rgba + 4 * i);
+      const __m128i s0 = _mm_shuffle_epi8(_mm_loadu_si128(p), pack);
+      const __m128i s1 = _mm_shuffle_epi8(_mm_loadu_si128(p + 1), pack);
+      const __m128i s2 = _mm_shuffle_epi8(_mm_loadu_si128(p + 2), pack);
+      const __m128i s3 = _mm_shuffle_epi8(_mm_loadu_si128(p + 3), pack);
+      __m128i * q = reinterpret_cast<__m128i *>(rgb + 3 * i);
+      _mm_storeu_si128(q, _mm_or_si128(s0, _mm_slli_si128(s1, 12)));
+      _mm_storeu_si128(q + 1, _mm_or_si128(_mm_srli_si128(s1, 4), _mm_slli_si128(s2, 8)));
+      _mm_storeu_si128(q + 2, _mm_or_si128(_mm_srli_si128(s2, 8), _mm_slli_si128(s3, 4)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= num_pixels; i += 16) {
+      const uint8x16x4_t v = vld4q_u8(rgba + 4 * i);
+      uint8x16x3_t w;
+      w.val[0] = v.val[0];
+      w.val[1] = v.val[1];
+      w.val[2] = v.val[2];
+      vst3q_u8(rgb + 3 * i, w);
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      rgb[i * 3] = rgba[i * 4];
+      rgb[i * 3 + 1] = rgba[i * 4 + 1];
+      rgb[i * 3 + 2] = rgba[i * 4 + 2];
+    }
+  }
+}
 
 void rgba_to_rgb(
   const std::vector<unsigned char> & rgba,
@@ -10,9 +61,11 @@ void rgba_to_rgb(
   ////////////////////////////////////////////////////////////////////////////
   // Add your code here
   ////////////////////////////////////////////////////////////////////////////
-  for (int i = 0; i < width * height; ++i) {
-    rgb[i * 3] = rgba[i * 4];
-    rgb[i * 3 + 1] = rgba[i * 4 + 1];
-    rgb[i * 3 + 2] = rgba[i * 4 + 2];
-  }
+
+  parallel_for(height, rows_per_chunk(4 * width), [&](const int begin, const int end) {
+    rgba_to_rgb_span(
+      rgba.data() + (size_t)4 * begin * width,
+      (end - begin) * width,
+      rgb.data() + (size_t)3 * begin * width);
+  });
 }
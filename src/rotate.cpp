@@ -1,6 +1,8 @@
 #include "rotate.h"
-#include <iostream>
-
+#include "orientation.h"
+#include "warp.h"
+#include <cassert>
+#include <cmath>
 
 void rotate(
   const std::vector<unsigned char> & input,
@@ -9,7 +11,6 @@ void rotate(
   const int num_channels,
   std::vector<unsigned char> & rotated)
 {
-  rotated.resize(height*width*num_channels);
   ////////////////////////////////////////////////////////////////////////////
   // Add your code here
   ////////////////////////////////////////////////////////////////////////////
@@ -31,54 +32,53 @@ void rotate(
     3 6 9 ]     1 4 7 ]
   */
 
-  std::vector<unsigned char> transposed;
-  transposed.resize(height*width*num_channels);
-
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      // move to the correct row in the flattened array
-      int row = y * width;
-
-      // move to the correct column in the flattened array
-      int new_column = x * height;
+  // Both steps only remap indices, so the rotated view is copied out in a
+  // single (tiled) pass without an intermediate transposed image
+  rotate(input, width, height, num_channels, 1, rotated);
+}
 
-      // current column in the flattened array
-      int column = x;
+void rotate(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  const int quarter_turns,
+  std::vector<unsigned char> & rotated)
+{
+  // 180° copies reversed rows; 90° and 270° transpose 64x64 tiles
+  orient(input, width, height, num_channels, rotation(quarter_turns), rotated);
+}
 
-      // go through all values in each channel - e.g., if 3-channel, c = 0 = R, c = 1 = G, c = 2 = B
-      for (int c = 0; c < num_channels; ++c) {
-        // multiply by num_channels to get to the index for the start of each pixel
-        transposed[(y + new_column) * num_channels + c] = input[(row + column) * num_channels + c];
-      }
-    }
+void rotate_by_angle(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  const double degrees,
+  const Interpolation interpolation,
+  const bool expand,
+  std::vector<unsigned char> & rotated,
+  int & rotated_width,
+  int & rotated_height)
+{
+  assert(width > 0 && height > 0 && width < 32768 && height < 32768);
+  assert(input.size() >= (std::size_t)width * height * num_channels);
+  const double radians = degrees * M_PI / 180.0;
+  const double c = std::cos(radians);
+  const double s = std::sin(radians);
+  rotated_width = width;
+  rotated_height = height;
+  if (expand) {
+    rotated_width = (int)std::ceil(width * std::abs(c) + height * std::abs(s) - 1e-6);
+    rotated_height = (int)std::ceil(width * std::abs(s) + height * std::abs(c) - 1e-6);
   }
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      int transposed_width = height;
-
-      int transposed_height = width;
-
-      // because indexing starts at 0 instead of 1
-      int height_index = transposed_height - 1;
-
-      // new y value after reflection against x-axis
-      int new_y = height_index - x;
-
-      // move to the correct row in the flattened array
-      int row = x * transposed_width;
-
-      // move to the correct column in the flattened array
-      int new_column = new_y * transposed_width;
-
-      // current column in the flattened array
-      int column = y;
-
-      // go through all values in each channel - e.g., if 3-channel, c = 0 = R, c = 1 = G, c = 2 = B
-      for (int c = 0; c < num_channels; ++c) {
-        // multiply by num_channels to get to the index for the start of each pixel
-        rotated[(new_column + column) * num_channels + c] = transposed[(row + column) * num_channels + c];
-      }
-    }
-  }
+  // Counter-clockwise on screen (y points down) about the centers of both
+  // images: (u,v) -> (u*c + v*s, -u*s + v*c)
+  const double u0 = width / 2.0;
+  const double v0 = height / 2.0;
+  const AffineMatrix matrix = {
+    c, s, rotated_width / 2.0 - c * u0 - s * v0,
+    -s, c, rotated_height / 2.0 + s * u0 - c * v0};
+  affine_warp(input, width, height, num_channels, matrix, interpolation, rotated_width, rotated_height, rotated);
 }
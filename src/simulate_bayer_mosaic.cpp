@@ -1,4 +1,96 @@
 #include "simulate_bayer_mosaic.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <cassert>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace
+{
+#if defined(__SSSE3__)
+  // pshufb masks picking, from the j-th of the three 16-byte blocks of 16
+  // rgb pixels, channel even_channel of the even pixels and odd_channel of
+  // the odd ones (0x80 zeroes a lane)
+  struct PickMasks {
+    alignas(16) unsigned char bytes[3][16];
+  };
+
+  constexpr PickMasks make_pick_masks(const int even_channel, const int odd_channel)
+  {
+    PickMasks masks{};
+    for (int j = 0; j < 3; ++j) {
+      for (int i = 0; i < 16; ++i) {
+        const int source = 3 * i + (i % 2 == 0 ? even_channel : odd_channel) - 16 * j;
+        masks.bytes[j][i] = (source >= 0 && source < 16) ? source : 0x80;
+      }
+    }
+    return masks;
+  }
+
+  template <int even_channel, int odd_channel>
+  constexpr PickMasks pick_masks = make_pick_masks(even_channel, odd_channel);
+#endif
+
+  // Sample one row. Pixels come in (even,odd) column pairs, i.e., one row of
+  // a 2x2 quad, and the pattern and row parity are fixed at compile time, so
+  // no pixel picks its channel at run time.
+  template <CfaPattern pattern, int row_parity>
+  void mosaic_row(
+    const unsigned char * rgb,
+    const int width,
+    unsigned char * bayer)
+  {
+    constexpr int even_channel = cfa_channel(pattern, 0, row_parity);
+    constexpr int odd_channel = cfa_channel(pattern, 1, row_parity);
+    int x = 0;
+#if defined(__SSSE3__)
+    const PickMasks & masks = pick_masks<even_channel, odd_channel>;
+    const auto load = [](const unsigned char * p) {
+      return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    };
+    const auto mask = [&](const int j) {
+      return _mm_load_si128(reinterpret_cast<const __m128i *>(masks.bytes[j]));
+    };
+    for (; x + 16 <= width; x += 16) {
+      const __m128i picked = _mm_or_si128(
+        _mm_or_si128(
+          _mm_shuffle_epi8(load(rgb + 3 * x), mask(0)),
+          _mm_shuffle_epi8(load(rgb + 3 * x + 16), mask(1))),
+        _mm_shuffle_epi8(load(rgb + 3 * x + 32), mask(2)));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(bayer + x), picked);
+    }
+#endif
+    for (; x + 2 <= width; x += 2) {
+      bayer[x] = rgb[3 * x + even_channel];
+      bayer[x + 1] = rgb[3 * x + 3 + odd_channel];
+    }
+    if (x < width) {
+      bayer[x] = rgb[3 * x + even_channel];
+    }
+  }
+
+  template <CfaPattern pattern>
+  void mosaic_pattern(
+    const unsigned char * rgb,
+    const int width,
+    const int height,
+    unsigned char * bayer)
+  {
+    parallel_for(height, rows_per_chunk(3 * width), [&](const int begin, const int end) {
+      for (int y = begin; y < end; ++y) {
+        const unsigned char * source = rgb + (std::size_t)3 * y * width;
+        unsigned char * target = bayer + (std::size_t)y * width;
+        if (y % 2 == 0) {
+          mosaic_row<pattern, 0>(source, width, target);
+        } else {
+          mosaic_row<pattern, 1>(source, width, target);
+        }
+      }
+    });
+  }
+}
 
 void simulate_bayer_mosaic(
   const std::vector<unsigned char> & rgb,
@@ -6,48 +98,25 @@ void simulate_bayer_mosaic(
   const int & height,
   std::vector<unsigned char> & bayer)
 {
-  bayer.resize(width*height);
-  ////////////////////////////////////////////////////////////////////////////
-  // Add your code here
-  ////////////////////////////////////////////////////////////////////////////
-  
   // green = even row even column (in terms of index), odd row odd column
   // red = odd row even column
   // blue = even row odd column
+  simulate_bayer_mosaic(rgb, width, height, CfaPattern::gbrg, bayer);
+}
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      int row = y * width;
-      int column = x;
-
-      // even row
-      if (y % 2 == 0) { 
-        // even column
-        if (x % 2 == 0) { 
-          // green
-          bayer[row + column] = rgb[(row + column) * 3 + 1];
-        } 
-        // odd column
-        else { 
-          // blue
-          bayer[row + column] = rgb[(row + column) * 3 + 2]; 
-        }
-      } 
-      // odd row
-      else { 
-        // even column
-        if (x % 2 == 0) { 
-          // red
-          bayer[row + column] = rgb[(row + column) * 3]; 
-        } 
-        // odd column
-        else { 
-          // green
-          bayer[row + column] = rgb[(row + column) * 3 + 1]; 
-        }
-      }
-    }
+void simulate_bayer_mosaic(
+  const std::vector<unsigned char> & rgb,
+  const int & width,
+  const int & height,
+  const CfaPattern pattern,
+  std::vector<unsigned char> & bayer)
+{
+  assert(rgb.size() >= (std::size_t)width * height * 3);
+  bayer.resize(width*height);
+  switch (pattern) {
+    case CfaPattern::rggb: mosaic_pattern<CfaPattern::rggb>(rgb.data(), width, height, bayer.data()); break;
+    case CfaPattern::bggr: mosaic_pattern<CfaPattern::bggr>(rgb.data(), width, height, bayer.data()); break;
+    case CfaPattern::grbg: mosaic_pattern<CfaPattern::grbg>(rgb.data(), width, height, bayer.data()); break;
+    case CfaPattern::gbrg: mosaic_pattern<CfaPattern::gbrg>(rgb.data(), width, height, bayer.data()); break;
   }
 }
-
-
@@ -0,0 +1,264 @@
+#include "stage_cache.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+  const char magic[8] = {'R', 'S', 'T', 'C', 'A', 'C', 'H', 'E'};
+  const std::uint64_t alignment = 64;
+
+  std::uint64_t align_up(const std::uint64_t offset)
+  {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+
+  const std::uint64_t golden = 0x9e3779b97f4a7c15ull;
+
+  // Mix a 64-bit word into a running value: the multiplication spreads low
+  // bits upwards, the shift brings high bits back down
+  std::uint64_t mix(const std::uint64_t value, const std::uint64_t word)
+  {
+    const std::uint64_t product = (value ^ word) * golden;
+    return product ^ (product >> 32);
+  }
+
+  // Digest of a file's contents, as of its modification time and size
+  struct FileDigest
+  {
+    std::filesystem::file_time_type time;
+    std::uintmax_t size;
+    std::uint64_t digest;
+  };
+
+  std::filesystem::path entry_path(const StageCache & cache, const std::uint64_t key)
+  {
+    std::ostringstream name;
+    name << std::hex << std::setfill('0') << std::setw(16) << key << ".bin";
+    return std::filesystem::path(cache.directory) / name.str();
+  }
+
+  // Read an entry, each output straight from the file into its buffer.
+  // Returns false if it is missing, truncated or not a cache entry.
+  bool read_entry(
+    const std::filesystem::path & path,
+    std::vector<std::vector<unsigned char> > & outputs)
+  {
+    std::error_code error;
+    const std::uint64_t size = std::filesystem::file_size(path, error);
+    if (error) return false;
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return false;
+
+    char header[16];
+    std::uint64_t num_outputs;
+    if (size < 16 || !ifs.read(header, 16) || std::memcmp(header, magic, 8) != 0) return false;
+    std::memcpy(&num_outputs, header + 8, 8);
+    if (num_outputs > (size - 16) / 8) return false;
+
+    std::vector<std::uint64_t> sizes(num_outputs);
+    if (!ifs.read(reinterpret_cast<char *>(sizes.data()), 8 * num_outputs)) return false;
+    std::uint64_t offset = align_up(16 + 8 * num_outputs);
+    outputs.resize(num_outputs);
+    for (std::uint64_t i = 0; i < num_outputs; ++i) {
+      if (offset > size || sizes[i] > size - offset) return false;
+      outputs[i].resize(sizes[i]);
+      ifs.seekg(offset);
+      if (!ifs.read(reinterpret_cast<char *>(outputs[i].data()), sizes[i])) return false;
+      offset = align_up(offset + sizes[i]);
+    }
+    return true;
+  }
+
+  // Remove least recently used entries until the directory fits. Caller
+  // holds cache.mutex.
+  void evict(StageCache & cache)
+  {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    std::vector<std::pair<fs::file_time_type, fs::path> > entries;
+    std::uintmax_t total = 0;
+    for (const auto & entry : fs::directory_iterator(cache.directory, error)) {
+      if (entry.path().extension() != ".bin") continue;
+      total += entry.file_size(error);
+      entries.emplace_back(entry.last_write_time(error), entry.path());
+    }
+    std::sort(entries.begin(), entries.end());
+    for (const auto & entry : entries) {
+      if (total <= cache.max_bytes) break;
+      const std::uintmax_t size = fs::file_size(entry.second, error);
+      if (fs::remove(entry.second, error)) {
+        total -= size;
+        cache.evictions++;
+      }
+    }
+  }
+}
+
+std::uint64_t stage_cache_hash(
+  const void * data,
+  const std::size_t size,
+  const std::uint64_t hash)
+{
+  const unsigned char * bytes = static_cast<const unsigned char *>(data);
+  std::uint64_t h = hash;
+  for (std::size_t i = 0; i < size; ++i) {
+    h ^= bytes[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+std::uint64_t stage_cache_hash_seed()
+{
+  return stage_cache_hash(std::string(STAGE_CACHE_VERSION), 14695981039346656037ull);
+}
+
+std::uint64_t stage_cache_hash(
+  const std::string & text,
+  const std::uint64_t hash)
+{
+  const std::uint64_t size = text.size();
+  return stage_cache_hash(text.data(), text.size(),
+    stage_cache_hash(&size, sizeof(size), hash));
+}
+
+std::uint64_t stage_cache_hash(
+  const std::vector<unsigned char> & bytes,
+  const std::uint64_t hash)
+{
+  const std::uint64_t size = bytes.size();
+  std::uint64_t h = stage_cache_hash(&size, sizeof(size), hash);
+
+  // Whole 32-byte blocks go to 4 lanes that don't wait on each other
+  std::size_t i = 0;
+  if (bytes.size() >= 32) {
+    std::uint64_t lanes[4] = {h, h + golden, h + 2 * golden, h + 3 * golden};
+    for (; i + 32 <= bytes.size(); i += 32) {
+      for (int k = 0; k < 4; ++k) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes.data() + i + 8 * k, 8);
+        lanes[k] = mix(lanes[k], word);
+      }
+    }
+    for (int k = 0; k < 4; ++k) {
+      h = mix(h, lanes[k]);
+    }
+  }
+  return stage_cache_hash(bytes.data() + i, bytes.size() - i, h);
+}
+
+bool stage_cache_hash_file(
+  const std::string & filename,
+  std::uint64_t & hash)
+{
+  static std::mutex mutex;
+  static std::map<std::string, FileDigest> digests;
+
+  std::error_code error;
+  const std::filesystem::file_time_type time =
+    std::filesystem::last_write_time(filename, error);
+  if (error) return false;
+  const std::uintmax_t size = std::filesystem::file_size(filename, error);
+  if (error) return false;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto it = digests.find(filename);
+    if (it != digests.end() && it->second.time == time && it->second.size == size) {
+      hash = stage_cache_hash(&it->second.digest, sizeof(it->second.digest), hash);
+      return true;
+    }
+  }
+
+  std::ifstream ifs(filename, std::ios::binary);
+  if (!ifs) return false;
+  std::vector<unsigned char> contents(size);
+  if (!ifs.read(reinterpret_cast<char *>(contents.data()), size) || ifs.peek() != EOF) {
+    return false;
+  }
+  const std::uint64_t digest = stage_cache_hash(contents, stage_cache_hash_seed());
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    digests[filename] = {time, size, digest};
+  }
+  hash = stage_cache_hash(&digest, sizeof(digest), hash);
+  return true;
+}
+
+bool stage_cache_load(
+  StageCache & cache,
+  const std::uint64_t key,
+  std::vector<std::vector<unsigned char> > & outputs)
+{
+  const std::filesystem::path path = entry_path(cache, key);
+  const bool hit = read_entry(path, outputs);
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  if (hit) {
+    // Last write time doubles as the last use time for LRU eviction
+    std::error_code error;
+    std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now(), error);
+    cache.hits++;
+  } else {
+    cache.misses++;
+  }
+  return hit;
+}
+
+bool stage_cache_store(
+  StageCache & cache,
+  const std::uint64_t key,
+  const std::vector<const std::vector<unsigned char> *> & outputs)
+{
+  std::error_code error;
+  std::filesystem::create_directories(cache.directory, error);
+
+  // Write to a private temporary file and rename it into place so that
+  // concurrent readers never see a partial entry
+  const std::filesystem::path path = entry_path(cache, key);
+  std::ostringstream suffix;
+  suffix << ".tmp" << std::this_thread::get_id();
+  std::filesystem::path temporary = path;
+  temporary += suffix.str();
+  {
+    std::ofstream ofs(temporary, std::ios::binary);
+    if (!ofs) return false;
+
+    const std::uint64_t num_outputs = outputs.size();
+    ofs.write(magic, 8);
+    ofs.write(reinterpret_cast<const char *>(&num_outputs), 8);
+    for (const auto * output : outputs) {
+      const std::uint64_t size = output->size();
+      ofs.write(reinterpret_cast<const char *>(&size), 8);
+    }
+    const char padding[alignment] = {};
+    std::uint64_t offset = 16 + 8 * num_outputs;
+    for (const auto * output : outputs) {
+      ofs.write(padding, align_up(offset) - offset);
+      offset = align_up(offset);
+      ofs.write(reinterpret_cast<const char *>(output->data()), output->size());
+      offset += output->size();
+    }
+    if (!ofs.good()) {
+      ofs.close();
+      std::filesystem::remove(temporary, error);
+      return false;
+    }
+  }
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  evict(cache);
+  return true;
+}
@@ -0,0 +1,337 @@
+#include "stage_graph.h"
+#include "parallel_for.h"
+#include "stage_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+  // For every stage, the index of the stage producing each of its inputs
+  // (-1 if the input was supplied by the caller). Inputs that are neither
+  // produced nor in buffers are an error unless allow_unknown is set.
+  // Returns false if the graph is malformed.
+  bool resolve_producers(
+    const std::vector<Stage> & stages,
+    const StageBuffers & buffers,
+    const bool allow_unknown,
+    std::vector<std::vector<int> > & producers)
+  {
+    std::map<std::string, int> producer_of;
+    for (int s = 0; s < (int)stages.size(); ++s) {
+      for (const auto & name : stages[s].outputs) {
+        if (producer_of.count(name) || buffers.count(name)) {
+          std::cerr << "Error: buffer '" << name
+                    << "' has more than one producer" << std::endl;
+          return false;
+        }
+        producer_of[name] = s;
+      }
+    }
+
+    producers.assign(stages.size(), {});
+    for (int s = 0; s < (int)stages.size(); ++s) {
+      for (const auto & name : stages[s].inputs) {
+        auto it = producer_of.find(name);
+        if (it != producer_of.end()) {
+          producers[s].push_back(it->second);
+        } else if (allow_unknown || buffers.count(name)) {
+          producers[s].push_back(-1);
+        } else {
+          std::cerr << "Error: stage '" << stages[s].name
+                    << "' reads unknown buffer '" << name << "'" << std::endl;
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Key of everything a cached stage's outputs depend on: its name and
+  // parameters, the keys of its input buffers and the contents of its input
+  // files. Returns false if an input file can't be read.
+  bool stage_key(
+    const Stage & stage,
+    const std::map<std::string, std::uint64_t> & buffer_keys,
+    std::uint64_t & key)
+  {
+    key = stage_cache_hash(stage.name, stage_cache_hash_seed());
+    key = stage_cache_hash(stage.cache_params, key);
+    for (const auto & name : stage.inputs) {
+      key = stage_cache_hash(&buffer_keys.at(name), sizeof(std::uint64_t), key);
+    }
+    for (const auto & filename : stage.input_files) {
+      if (!stage_cache_hash_file(filename, key)) return false;
+    }
+    return true;
+  }
+
+  // Run a stage, or load its outputs from the cache, then set the keys of
+  // its outputs that a cached stage reads. Outputs of a cached stage are
+  // keyed by the stage's key, so their bytes never need hashing; other
+  // outputs are keyed by their bytes. Returns false if the stage failed.
+  bool run_or_load(
+    const Stage & stage,
+    StageBuffers & buffers,
+    StageCache * cache,
+    std::map<std::string, std::uint64_t> & buffer_keys,
+    const std::map<std::string, bool> & key_needed,
+    bool & cached)
+  {
+    cached = false;
+    std::uint64_t key = 0;
+    const bool use_cache = cache && !stage.cache_params.empty() &&
+      stage_key(stage, buffer_keys, key);
+    const auto set_output_keys = [&]() {
+      for (std::uint64_t i = 0; i < stage.outputs.size(); ++i) {
+        const std::string & name = stage.outputs[i];
+        if (!key_needed.at(name)) continue;
+        buffer_keys.at(name) = use_cache ?
+          stage_cache_hash(&i, sizeof(i), key) :
+          stage_cache_hash(buffers.at(name), stage_cache_hash_seed());
+      }
+    };
+    if (use_cache) {
+      std::vector<std::vector<unsigned char> > loaded;
+      if (stage_cache_load(*cache, key, loaded) &&
+        loaded.size() == stage.outputs.size())
+      {
+        for (size_t i = 0; i < loaded.size(); ++i) {
+          buffers.at(stage.outputs[i]).swap(loaded[i]);
+        }
+        set_output_keys();
+        cached = true;
+        return true;
+      }
+    }
+
+    if (!stage.run(buffers)) {
+      return false;
+    }
+    set_output_keys();
+    if (use_cache) {
+      std::vector<const std::vector<unsigned char> *> outputs;
+      for (const auto & name : stage.outputs) {
+        outputs.push_back(&buffers.at(name));
+      }
+      stage_cache_store(*cache, key, outputs);
+    }
+    return true;
+  }
+
+  void release(std::vector<unsigned char> & buffer)
+  {
+    std::vector<unsigned char>().swap(buffer);
+  }
+}
+
+bool run_stage_graph(
+  const std::vector<Stage> & stages,
+  StageBuffers & buffers,
+  const int num_threads,
+  StageCache * cache,
+  std::vector<StageTiming> & timings)
+{
+  const int num_stages = stages.size();
+  timings.assign(num_stages, {0.0, 0.0, false});
+
+  std::vector<std::vector<int> > producers;
+  if (!resolve_producers(stages, buffers, false, producers)) {
+    return false;
+  }
+
+  // Create every buffer (and its key) up front so that stages running
+  // concurrently never insert into the maps
+  std::map<std::string, int> consumers_left;
+  std::map<std::string, std::uint64_t> buffer_keys;
+  std::map<std::string, bool> key_needed;
+  for (const auto & stage : stages) {
+    for (const auto & name : stage.outputs) {
+      buffers[name];
+      consumers_left[name];
+      buffer_keys[name];
+      key_needed[name];
+    }
+  }
+  for (const auto & stage : stages) {
+    for (const auto & name : stage.inputs) {
+      consumers_left[name]++;
+      key_needed[name] = key_needed[name] || (cache && !stage.cache_params.empty());
+    }
+  }
+  // Buffers supplied by the caller have no producer to derive a key from
+  for (const auto & [name, needed] : key_needed) {
+    if (needed && !buffer_keys.count(name)) {
+      buffer_keys[name] = stage_cache_hash(buffers.at(name), stage_cache_hash_seed());
+    }
+  }
+
+  // Dependency counts (a stage reading two outputs of the same producer
+  // waits on it once)
+  std::vector<int> pending(num_stages, 0);
+  std::vector<std::vector<int> > dependents(num_stages);
+  for (int s = 0; s < num_stages; ++s) {
+    std::vector<int> preds = producers[s];
+    std::sort(preds.begin(), preds.end());
+    preds.erase(std::unique(preds.begin(), preds.end()), preds.end());
+    for (int p : preds) {
+      if (p < 0) continue;
+      pending[s]++;
+      dependents[p].push_back(s);
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable ready_changed;
+  std::deque<int> ready;
+  int running = 0;
+  int finished = 0;
+  bool failed = false;
+  for (int s = 0; s < num_stages; ++s) {
+    if (pending[s] == 0) ready.push_back(s);
+  }
+
+  const auto t0 = std::chrono::steady_clock::now();
+  const auto elapsed_ms = [&t0]() {
+    return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - t0).count();
+  };
+
+  // Workers started here claim a thread from the budget of parallel_for
+  // while they run a stage, so that the parallel_for calls of concurrent
+  // stages share the machine instead of each starting a thread per core
+  const auto worker = [&](const bool own_thread) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      ready_changed.wait(lock, [&]() { return !ready.empty() || running == 0; });
+      if (ready.empty()) {
+        return;
+      }
+      const int s = ready.front();
+      ready.pop_front();
+      running++;
+      lock.unlock();
+
+      const int claimed = own_thread ? acquire_threads(1) : 0;
+      timings[s].start_ms = elapsed_ms();
+      const bool ok = run_or_load(
+        stages[s], buffers, cache, buffer_keys, key_needed, timings[s].cached);
+      timings[s].end_ms = elapsed_ms();
+      release_threads(claimed);
+
+      lock.lock();
+      running--;
+      finished++;
+      if (!ok) {
+        stage_log(std::cerr, "Error: stage '", stages[s].name, "' failed");
+        failed = true;
+        ready.clear();
+      } else if (!failed) {
+        for (int d : dependents[s]) {
+          if (--pending[d] == 0) ready.push_back(d);
+        }
+      }
+      // Free intermediates whose last consumer just finished
+      for (const auto & name : stages[s].inputs) {
+        if (--consumers_left[name] == 0) release(buffers.at(name));
+      }
+      for (const auto & name : stages[s].outputs) {
+        if (consumers_left[name] == 0) release(buffers.at(name));
+      }
+      ready_changed.notify_all();
+    }
+  };
+
+  int num_workers = num_threads > 0 ?
+    num_threads : (int)std::thread::hardware_concurrency();
+  num_workers = std::max(1, std::min(num_workers, num_stages));
+  std::vector<std::thread> workers;
+  for (int t = 1; t < num_workers; ++t) {
+    workers.emplace_back(worker, true);
+  }
+  worker(false);
+  for (auto & thread : workers) {
+    thread.join();
+  }
+
+  if (!failed && finished != num_stages) {
+    std::cerr << "Error: stage graph contains a cycle" << std::endl;
+    return false;
+  }
+  return !failed;
+}
+
+void stage_log_line(std::ostream & out, const std::string & line)
+{
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  out << line << std::endl;
+}
+
+void print_stage_summary(
+  const std::vector<Stage> & stages,
+  const std::vector<StageTiming> & timings,
+  std::ostream & out)
+{
+  const int num_stages = stages.size();
+  std::vector<std::vector<int> > producers;
+  if (!resolve_producers(stages, StageBuffers(), true, producers)) {
+    return;
+  }
+
+  // Longest chain of durations ending at each stage. Stages only depend on
+  // earlier-finishing stages, so visiting them by end time is a valid
+  // topological order.
+  std::vector<int> order(num_stages);
+  for (int s = 0; s < num_stages; ++s) order[s] = s;
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return timings[a].end_ms < timings[b].end_ms;
+  });
+  std::vector<double> path_ms(num_stages, 0.0);
+  std::vector<int> previous(num_stages, -1);
+  double wall_ms = 0.0;
+  int last = -1;
+  for (int s : order) {
+    double longest = 0.0;
+    for (int p : producers[s]) {
+      if (p >= 0 && path_ms[p] > longest) {
+        longest = path_ms[p];
+        previous[s] = p;
+      }
+    }
+    path_ms[s] = longest + (timings[s].end_ms - timings[s].start_ms);
+    if (last < 0 || path_ms[s] > path_ms[last]) last = s;
+    wall_ms = std::max(wall_ms, timings[s].end_ms);
+  }
+
+  // Format locally so the caller's stream keeps its flags
+  std::ostringstream summary;
+  summary << std::fixed << std::setprecision(1);
+  summary << "\nStage summary:" << std::endl;
+  for (int s = 0; s < num_stages; ++s) {
+    summary << "  " << std::left << std::setw(24) << stages[s].name << std::right
+        << " start " << std::setw(8) << timings[s].start_ms << " ms"
+        << "  took " << std::setw(8) << timings[s].end_ms - timings[s].start_ms
+        << " ms" << (timings[s].cached ? "  (cached)" : "") << std::endl;
+  }
+  if (last < 0) {
+    out << summary.str() << std::flush;
+    return;
+  }
+
+  std::vector<int> path;
+  for (int s = last; s >= 0; s = previous[s]) path.push_back(s);
+  std::reverse(path.begin(), path.end());
+  summary << "Critical path (" << path_ms[last] << " ms of " << wall_ms
+      << " ms wall):";
+  for (size_t i = 0; i < path.size(); ++i) {
+    summary << (i == 0 ? " " : " -> ") << stages[path[i]].name;
+  }
+  summary << std::endl;
+  out << summary.str() << std::flush;
+}
@@ -0,0 +1,181 @@
+#include "swizzle.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <functional>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+  // Split the rows of a width x height image across threads
+  void for_each_span(
+    const int width,
+    const int height,
+    const std::function<void(size_t, int)> & span)
+  {
+    parallel_for(height, rows_per_chunk(4 * width), [&](const int begin, const int end) {
+      span((size_t)begin * width, (end - begin) * width);
+    });
+  }
+
+  void rgb_to_rgba_span(
+    const unsigned char * rgb,
+    const int num_pixels,
+    const unsigned char alpha,
+    unsigned char * rgba)
+  {
+    int i = 0;
+#if defined(__SSSE3__)
+    // Realign each run of 4 pixels (12 bytes) to the start of a block, then
+    // spread it to 16 bytes and fill in alpha
+    const __m128i spread = _mm_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alphas = _mm_set1_epi32((int)((unsigned)alpha << 24));
+    for (; i + 16 <= num_pixels; i += 16) {
+      const __m128i * p = reinterpret_cast<const __m128i *>(rgb + 3 * i);
+      const __m128i v0 = _mm_loadu_si128(p);
+      const __m128i v1 = _mm_loadu_si128(p + 1);
+      const __m128i v2 = _mm_loadu_si128(p + 2);
+      const __m128i runs[4] = {
+        v0,
+        _mm_alignr_epi8(v1, v0, 12),
+        _mm_alignr_epi8(v2, v1, 8),
+        _mm_srli_si128(v2, 4)};
+      __m128i * q = reinterpret_cast<__m128i *>(rgba + 4 * i);
+      for (int k = 0; k < 4; ++k) {
+        _mm_storeu_si128(q + k, _mm_or_si128(_mm_shuffle_epi8(runs[k], spread), alphas));
+      }
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= num_pixels; i += 16) {
+      const uint8x16x3_t v = vld3q_u8(rgb + 3 * i);
+      uint8x16x4_t w;
+      w.val[0] = v.val[0];
+      w.val[1] = v.val[1];
+      w.val[2] = v.val[2];
+      w.val[3] = vdupq_n_u8(alpha);
+      vst4q_u8(rgba + 4 * i, w);
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      rgba[i * 4] = rgb[i * 3];
+      rgba[i * 4 + 1] = rgb[i * 3 + 1];
+      rgba[i * 4 + 2] = rgb[i * 3 + 2];
+      rgba[i * 4 + 3] = alpha;
+    }
+  }
+
+  // Swap the first and third channel of 4-channel pixels (bgra <-> rgba)
+  void swap_red_blue_span(
+    const unsigned char * input,
+    const int num_pixels,
+    unsigned char * output)
+  {
+    int i = 0;
+#if defined(__SSSE3__)
+    const __m128i swap = _mm_setr_epi8(
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    for (; i + 4 <= num_pixels; i += 4) {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + 4 * i));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(output + 4 * i), _mm_shuffle_epi8(v, swap));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= num_pixels; i += 16) {
+      uint8x16x4_t v = vld4q_u8(input + 4 * i);
+      const uint8x16_t first = v.val[0];
+      v.val[0] = v.val[2];
+      v.val[2] = first;
+      vst4q_u8(output + 4 * i, v);
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      const unsigned char first = input[i * 4];
+      output[i * 4] = input[i * 4 + 2];
+      output[i * 4 + 1] = input[i * 4 + 1];
+      output[i * 4 + 2] = first;
+      output[i * 4 + 3] = input[i * 4 + 3];
+    }
+  }
+
+  void extract_alpha_span(
+    const unsigned char * rgba,
+    const int num_pixels,
+    unsigned char * alpha)
+  {
+    int i = 0;
+#if defined(__SSSE3__)
+    // Gather the 4 alphas of each block into its first 32 bits, then
+    // interleave the four blocks' 32-bit groups
+    const __m128i gather = _mm_setr_epi8(
+      3, 7, 11, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    for (; i + 16 <= num_pixels; i += 16) {
+      const __m128i * p = reinterpret_cast<const __m128i *>(rgba + 4 * i);
+      const __m128i a0 = _mm_shuffle_epi8(_mm_loadu_si128(p), gather);
+      const __m128i a1 = _mm_shuffle_epi8(_mm_loadu_si128(p + 1), gather);
+      const __m128i a2 = _mm_shuffle_epi8(_mm_loadu_si128(p + 2), gather);
+      const __m128i a3 = _mm_shuffle_epi8(_mm_loadu_si128(p + 3), gather);
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(alpha + i),
+        _mm_unpacklo_epi64(_mm_unpacklo_epi32(a0, a1), _mm_unpacklo_epi32(a2, a3)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= num_pixels; i += 16) {
+      vst1q_u8(alpha + i, vld4q_u8(rgba + 4 * i).val[3]);
+    }
+#endif
+    for (; i < num_pixels; ++i) {
+      alpha[i] = rgba[i * 4 + 3];
+    }
+  }
+}
+
+void rgb_to_rgba(
+  const std::vector<unsigned char> & rgb,
+  const int width,
+  const int height,
+  const unsigned char alpha,
+  std::vector<unsigned char> & rgba)
+{
+  rgba.resize((size_t)width * height * 4);
+  for_each_span(width, height, [&](const size_t first, const int num_pixels) {
+    rgb_to_rgba_span(rgb.data() + 3 * first, num_pixels, alpha, rgba.data() + 4 * first);
+  });
+}
+
+void bgra_to_rgba(
+  const std::vector<unsigned char> & bgra,
+  const int width,
+  const int height,
+  std::vector<unsigned char> & rgba)
+{
+  rgba.resize((size_t)width * height * 4);
+  for_each_span(width, height, [&](const size_t first, const int num_pixels) {
+    swap_red_blue_span(bgra.data() + 4 * first, num_pixels, rgba.data() + 4 * first);
+  });
+}
+
+void rgba_to_bgra(
+  const std::vector<unsigned char> & rgba,
+  const int width,
+  const int height,
+  std::vector<unsigned char> & bgra)
+{
+  // The same swap in the other direction
+  bgra_to_rgba(rgba, width, height, bgra);
+}
+
+void extract_alpha(
+  const std::vector<unsigned char> & rgba,
+  const int width,
+  const int height,
+  std::vector<unsigned char> & alpha)
+{
+  alpha.resize((size_t)width * height);
+  for_each_span(width, height, [&](const size_t first, const int num_pixels) {
+    extract_alpha_span(rgba.data() + 4 * first, num_pixels, alpha.data() + first);
+  });
+}
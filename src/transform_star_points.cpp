@@ -1,4 +1,5 @@
 #include "transform_star_points.h"
+#include <cstddef>
 
 void transform_star_points(
   const std::vector<StarPoint> & input_points,
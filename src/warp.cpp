@@ -0,0 +1,460 @@
+#include "warp.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  // Source positions are stepped along each output row in 32.32 fixed point
+  // (exact enough that a row never drifts), and sampled at 16.16 with 8-bit
+  // fractional weights. Pixel centers sit at integer positions.
+  const int64_t one = int64_t(1) << 32;
+
+  // Catmull-Rom weights of the 4 taps around each 1/256 fraction, in 1/256
+  // units summing to exactly 256
+  struct CubicWeights {
+    std::array<std::array<int32_t, 256>, 4> taps;
+
+    CubicWeights()
+    {
+      for (int f = 0; f < 256; ++f) {
+        const double t = f / 256.0;
+        const double w[4] = {
+          (-t * t * t + 2 * t * t - t) / 2,
+          (3 * t * t * t - 5 * t * t + 2) / 2,
+          (-3 * t * t * t + 4 * t * t + t) / 2,
+          (t * t * t - t * t) / 2};
+        int sum = 0;
+        for (int i = 0; i < 4; ++i) {
+          taps[i][f] = (int32_t)std::lround(256 * w[i]);
+          sum += taps[i][f];
+        }
+        taps[1][f] += 256 - sum;
+      }
+    }
+  };
+  const CubicWeights cubic_weights;
+
+  template <int num_taps>
+  inline int tap_weight(const int i, const int f)
+  {
+    if constexpr (num_taps == 2) {
+      return i == 0 ? 256 - f : f;
+    } else {
+      return cubic_weights.taps[i][f];
+    }
+  }
+
+  struct Source {
+    const unsigned char * data;
+    int width;
+    int height;
+    std::ptrdiff_t row_size;
+    // Whether every byte offset into data fits the 32-bit gather indices of
+    // sample_pixels8 (images of 2 GiB and more are sampled one pixel at a
+    // time)
+    bool gatherable;
+  };
+
+  // Sample one pixel at 16.16 position (px,py). Taps outside the image are
+  // clamped to its edge when clamp is set (near the borders).
+  template <int num_channels, int num_taps>
+  inline void sample_pixel(
+    const Source & source,
+    const int32_t px,
+    const int32_t py,
+    const bool clamp,
+    unsigned char * output)
+  {
+    const int x0 = (px >> 16) - (num_taps / 2 - 1);
+    const int y0 = (py >> 16) - (num_taps / 2 - 1);
+    const int fx = (px >> 8) & 255;
+    const int fy = (py >> 8) & 255;
+    int columns[num_taps];
+    const unsigned char * rows[num_taps];
+    for (int i = 0; i < num_taps; ++i) {
+      const int x = clamp ? std::min(std::max(x0 + i, 0), source.width - 1) : x0 + i;
+      const int y = clamp ? std::min(std::max(y0 + i, 0), source.height - 1) : y0 + i;
+      columns[i] = x * num_channels;
+      rows[i] = source.data + y * source.row_size;
+    }
+    for (int c = 0; c < num_channels; ++c) {
+      int value = 0;
+      for (int j = 0; j < num_taps; ++j) {
+        int row = 0;
+        for (int i = 0; i < num_taps; ++i) {
+          row += tap_weight<num_taps>(i, fx) * rows[j][columns[i] + c];
+        }
+        value += tap_weight<num_taps>(j, fy) * row;
+      }
+      output[c] = (unsigned char)std::min(std::max((value + 32768) >> 16, 0), 255);
+    }
+  }
+
+#if defined(__AVX2__)
+  // Sample 8 consecutive output pixels whose taps all lie inside the image.
+  // Each tap is a 32-bit gather of a whole pixel, so the same code serves
+  // 1 to 4 channels; the integer arithmetic matches sample_pixel exactly.
+  template <int num_channels, int num_taps>
+  inline void sample_pixels8(
+    const Source & source,
+    const __m256i px,
+    const __m256i py,
+    unsigned char * output)
+  {
+    const __m256i bytes = _mm256_set1_epi32(255);
+    const __m256i x0 = _mm256_sub_epi32(_mm256_srai_epi32(px, 16), _mm256_set1_epi32(num_taps / 2 - 1));
+    const __m256i y0 = _mm256_sub_epi32(_mm256_srai_epi32(py, 16), _mm256_set1_epi32(num_taps / 2 - 1));
+    const __m256i fx = _mm256_and_si256(_mm256_srli_epi32(px, 8), bytes);
+    const __m256i fy = _mm256_and_si256(_mm256_srli_epi32(py, 8), bytes);
+    const __m256i offsets = _mm256_add_epi32(
+      _mm256_mullo_epi32(y0, _mm256_set1_epi32((int)source.row_size)),
+      _mm256_mullo_epi32(x0, _mm256_set1_epi32(num_channels)));
+    __m256i wx[num_taps], wy[num_taps];
+    for (int i = 0; i < num_taps; ++i) {
+      if constexpr (num_taps == 2) {
+        wx[i] = i == 0 ? _mm256_sub_epi32(_mm256_set1_epi32(256), fx) : fx;
+        wy[i] = i == 0 ? _mm256_sub_epi32(_mm256_set1_epi32(256), fy) : fy;
+      } else {
+        wx[i] = _mm256_i32gather_epi32(cubic_weights.taps[i].data(), fx, 4);
+        wy[i] = _mm256_i32gather_epi32(cubic_weights.taps[i].data(), fy, 4);
+      }
+    }
+    __m256i taps[num_taps][num_taps];
+    for (int j = 0; j < num_taps; ++j) {
+      for (int i = 0; i < num_taps; ++i) {
+        taps[j][i] = _mm256_i32gather_epi32(
+          reinterpret_cast<const int *>(source.data + j * source.row_size + i * num_channels), offsets, 1);
+      }
+    }
+    __m256i pixels = _mm256_setzero_si256();
+    for (int c = 0; c < num_channels; ++c) {
+      __m256i value = _mm256_set1_epi32(32768);
+      for (int j = 0; j < num_taps; ++j) {
+        __m256i row = _mm256_setzero_si256();
+        for (int i = 0; i < num_taps; ++i) {
+          const __m256i tap = _mm256_and_si256(_mm256_srli_epi32(taps[j][i], 8 * c), bytes);
+          row = _mm256_add_epi32(row, _mm256_mullo_epi32(wx[i], tap));
+        }
+        value = _mm256_add_epi32(value, _mm256_mullo_epi32(wy[j], row));
+      }
+      value = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(value, 16), _mm256_setzero_si256()), bytes);
+      pixels = _mm256_or_si256(pixels, _mm256_slli_epi32(value, 8 * c));
+    }
+    if constexpr (num_channels == 4) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(output), pixels);
+    } else {
+      // Drop the unused bytes of each 32-bit pixel, then write exactly the
+      // 8*num_channels bytes of the 8 pixels
+      alignas(32) unsigned char packed[32];
+      const __m256i compact = num_channels == 1
+        ? _mm256_setr_epi8(
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)
+        : num_channels == 2
+        ? _mm256_setr_epi8(
+            0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+            0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1)
+        : _mm256_setr_epi8(
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+      _mm256_store_si256(reinterpret_cast<__m256i *>(packed), _mm256_shuffle_epi8(pixels, compact));
+      std::memcpy(output, packed, 4 * num_channels);
+      std::memcpy(output + 4 * num_channels, packed + 16, 4 * num_channels);
+    }
+  }
+#endif
+
+  // floor(a/b) for b > 0
+  inline int64_t floor_div(const int64_t a, const int64_t b)
+  {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+  }
+
+  // Narrow [begin,end) to the x with lo <= start + x*step < hi
+  void clip_span(
+    const int64_t start,
+    const int64_t step,
+    const int64_t lo,
+    const int64_t hi,
+    int & begin,
+    int & end)
+  {
+    int64_t first = begin;
+    int64_t last = end;
+    if (step > 0) {
+      first = std::max(first, -floor_div(start - lo, step));
+      last = std::min(last, floor_div(hi - 1 - start, step) + 1);
+    } else if (step < 0) {
+      first = std::max(first, floor_div(start - hi, -step) + 1);
+      last = std::min(last, floor_div(start - lo, -step) + 1);
+    } else if (start < lo || start >= hi) {
+      last = first;
+    }
+    first = std::min(first, (int64_t)end);
+    begin = (int)first;
+    end = (int)std::max(first, last);
+  }
+
+  // Narrow [begin,end), in floating point, to the x with
+  // -1 <= start + x*step <= size, i.e., to within half a pixel of a source
+  // of size pixels (a margin for rounding)
+  void clip_near(
+    const double start,
+    const double step,
+    const int size,
+    int & begin,
+    int & end)
+  {
+    double first = begin;
+    double last = end;
+    if (step != 0) {
+      const double a = (-1 - start) / step;
+      const double b = (size - start) / step;
+      first = std::max(first, std::ceil(std::min(a, b)));
+      last = std::min(last, std::floor(std::max(a, b)) + 1);
+    } else if (!(start >= -1 && start <= size)) {
+      last = first;
+    }
+    first = std::min(first, (double)end);
+    begin = (int)first;
+    end = (int)std::max(first, last);
+  }
+
+  // Inverse map from output pixel (x,y) to its source position
+  //   (sx + x*sx_x + y*sx_y, sy + x*sy_x + y*sy_y)
+  struct InverseMap {
+    double sx, sx_x, sx_y;
+    double sy, sy_x, sy_y;
+  };
+
+  // Resample the output pixels [x_begin,x_end) of row y
+  template <int num_channels, int num_taps>
+  void resample_row(
+    const Source & source,
+    const InverseMap & map,
+    const int y,
+    const int x_begin,
+    const int x_end,
+    unsigned char * row)
+  {
+    // Pixels that land well outside the source are 0. Dropping them before
+    // going to fixed point keeps the positions below near the source, so a
+    // strong contraction, which throws most rows millions of pixels away
+    // (and steps by as much), cannot overflow them.
+    const double row_x = map.sx + y * map.sx_y;
+    const double row_y = map.sy + y * map.sy_y;
+    int near_begin = x_begin;
+    int near_end = x_end;
+    clip_near(row_x, map.sx_x, source.width, near_begin, near_end);
+    clip_near(row_y, map.sy_x, source.height, near_begin, near_end);
+    std::memset(row + x_begin * num_channels, 0, (near_begin - x_begin) * num_channels);
+    std::memset(row + near_end * num_channels, 0, (x_end - near_end) * num_channels);
+    if (near_begin == near_end) {
+      return;
+    }
+    // A step longer than the source leaves at most one pixel near it, so
+    // capping it changes nothing
+    const auto fixed = [](const double position) {
+      return std::llround(std::clamp(position, -65536.0, 65536.0) * one);
+    };
+
+    // From here on, x counts from near_begin
+    row += near_begin * num_channels;
+    const int64_t start_x = fixed(row_x + near_begin * map.sx_x);
+    const int64_t start_y = fixed(row_y + near_begin * map.sy_x);
+    const int64_t step_x = fixed(map.sx_x);
+    const int64_t step_y = fixed(map.sy_x);
+
+    // Pixels whose centers fall inside the source are sampled ...
+    int inside_begin = 0;
+    int inside_end = near_end - near_begin;
+    clip_span(start_x, step_x, -one / 2, source.width * one - one / 2, inside_begin, inside_end);
+    clip_span(start_y, step_y, -one / 2, source.height * one - one / 2, inside_begin, inside_end);
+    // ... without clamping where all taps are inside. Each tap reads 4 bytes,
+    // so the last few columns of narrow pixel formats stay out.
+    const int margin = 3 / num_channels;
+    const int64_t tap_lo = int64_t(num_taps / 2 - 1) << 32;
+    int interior_begin = inside_begin;
+    int interior_end = inside_end;
+    clip_span(start_x, step_x, tap_lo, int64_t(source.width - num_taps / 2 - margin) << 32,
+      interior_begin, interior_end);
+    clip_span(start_y, step_y, tap_lo, int64_t(source.height - num_taps / 2) << 32,
+      interior_begin, interior_end);
+    if (interior_begin >= interior_end) {
+      interior_begin = interior_end = inside_end;
+    }
+
+    // Source position of the next pixel, advanced by one step per pixel
+    int64_t px = start_x + inside_begin * step_x;
+    int64_t py = start_y + inside_begin * step_y;
+    const auto sample = [&](const int x, const bool clamp) {
+      sample_pixel<num_channels, num_taps>(
+        source, (int32_t)(px >> 16), (int32_t)(py >> 16), clamp, row + x * num_channels);
+      px += step_x;
+      py += step_y;
+    };
+
+    std::memset(row, 0, inside_begin * num_channels);
+    int x = inside_begin;
+    for (; x < interior_begin; ++x) {
+      sample(x, true);
+    }
+#if defined(__AVX2__)
+    {
+      // The 32.32 positions of pixels x..x+7 in two vectors of 4, stepped by
+      // 8 pixels at a time and narrowed to 16.16 (interior positions are
+      // never negative)
+      const auto lanes = [](const int64_t base, const int64_t step, const int k) {
+        return _mm256_setr_epi64x(base + k * step, base + (k + 1) * step, base + (k + 2) * step, base + (k + 3) * step);
+      };
+      const auto narrow = [](const __m256i low, const __m256i high) {
+        const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        return _mm256_permute2x128_si256(
+          _mm256_permutevar8x32_epi32(_mm256_srli_epi64(low, 16), even),
+          _mm256_permutevar8x32_epi32(_mm256_srli_epi64(high, 16), even), 0x20);
+      };
+      __m256i x_low = lanes(px, step_x, 0);
+      __m256i x_high = lanes(px, step_x, 4);
+      __m256i y_low = lanes(py, step_y, 0);
+      __m256i y_high = lanes(py, step_y, 4);
+      const __m256i step8_x = _mm256_set1_epi64x(8 * step_x);
+      const __m256i step8_y = _mm256_set1_epi64x(8 * step_y);
+      const int simd_begin = x;
+      for (; source.gatherable && x + 8 <= interior_end; x += 8) {
+        sample_pixels8<num_channels, num_taps>(
+          source, narrow(x_low, x_high), narrow(y_low, y_high), row + x * num_channels);
+        x_low = _mm256_add_epi64(x_low, step8_x);
+        x_high = _mm256_add_epi64(x_high, step8_x);
+        y_low = _mm256_add_epi64(y_low, step8_y);
+        y_high = _mm256_add_epi64(y_high, step8_y);
+      }
+      px += (x - simd_begin) * step_x;
+      py += (x - simd_begin) * step_y;
+    }
+#endif
+    for (; x < interior_end; ++x) {
+      sample(x, false);
+    }
+    for (; x < inside_end; ++x) {
+      sample(x, true);
+    }
+    std::memset(row + inside_end * num_channels, 0, (near_end - near_begin - inside_end) * num_channels);
+  }
+
+  // Resample the whole output in 32x256 tiles (so that the source footprint
+  // of a tile stays in cache), with threads taking bands of tile rows
+  template <int num_channels, int num_taps>
+  void resample(
+    const Source & source,
+    const InverseMap & map,
+    const int width,
+    const int height,
+    std::vector<unsigned char> & output)
+  {
+    const int tile_height = 32;
+    const int tile_width = 256;
+    const int num_bands = (height + tile_height - 1) / tile_height;
+    parallel_for(num_bands, rows_per_chunk(tile_height * width * num_channels), [&](const int begin, const int end) {
+      for (int band = begin; band < end; ++band) {
+        const int y_end = std::min((band + 1) * tile_height, height);
+        for (int x0 = 0; x0 < width; x0 += tile_width) {
+          const int x1 = std::min(x0 + tile_width, width);
+          for (int y = band * tile_height; y < y_end; ++y) {
+            resample_row<num_channels, num_taps>(
+              source, map, y, x0, x1, output.data() + (std::size_t)y * width * num_channels);
+          }
+        }
+      }
+    });
+  }
+
+  template <int num_taps>
+  void resample_channels(
+    const Source & source,
+    const int num_channels,
+    const InverseMap & map,
+    const int width,
+    const int height,
+    std::vector<unsigned char> & output)
+  {
+    switch (num_channels) {
+      case 1: resample<1, num_taps>(source, map, width, height, output); break;
+      case 2: resample<2, num_taps>(source, map, width, height, output); break;
+      case 3: resample<3, num_taps>(source, map, width, height, output); break;
+      case 4: resample<4, num_taps>(source, map, width, height, output); break;
+      default: assert(false && "affine_warp supports 1 to 4 channels");
+    }
+  }
+}
+
+
+AffineMatrix scaling(
+  const double center_x,
+  const double center_y,
+  const double scale_factor)
+{
+  return {
+    scale_factor, 0, center_x - scale_factor * center_x,
+    0, scale_factor, center_y - scale_factor * center_y};
+}
+
+AffineMatrix compose(const AffineMatrix & first, const AffineMatrix & second)
+{
+  const AffineMatrix & m = second;
+  const AffineMatrix & n = first;
+  return {
+    m[0] * n[0] + m[1] * n[3], m[0] * n[1] + m[1] * n[4], m[0] * n[2] + m[1] * n[5] + m[2],
+    m[3] * n[0] + m[4] * n[3], m[3] * n[1] + m[4] * n[4], m[3] * n[2] + m[4] * n[5] + m[5]};
+}
+
+void affine_warp(
+  const std::vector<unsigned char> & input,
+  const int width,
+  const int height,
+  const int num_channels,
+  const AffineMatrix & matrix,
+  const Interpolation interpolation,
+  const int warped_width,
+  const int warped_height,
+  std::vector<unsigned char> & warped)
+{
+  assert(width > 0 && height > 0 && width < 32768 && height < 32768);
+  assert(warped_width >= 0 && warped_height >= 0);
+  assert(input.size() >= (std::size_t)width * height * num_channels);
+  const double determinant = matrix[0] * matrix[4] - matrix[1] * matrix[3];
+  assert(determinant != 0 && "affine_warp needs an invertible matrix");
+  warped.resize((std::size_t)warped_width * warped_height * num_channels);
+
+  // Invert the matrix, then shift both sides by half a pixel so that output
+  // pixel (x,y) maps onto source pixel indices (centers at integers)
+  const double a = matrix[4] / determinant;
+  const double b = -matrix[1] / determinant;
+  const double d = -matrix[3] / determinant;
+  const double e = matrix[0] / determinant;
+  const double c = -(a * matrix[2] + b * matrix[5]);
+  const double f = -(d * matrix[2] + e * matrix[5]);
+  InverseMap map;
+  map.sx = a * 0.5 + b * 0.5 + c - 0.5;
+  map.sx_x = a;
+  map.sx_y = b;
+  map.sy = d * 0.5 + e * 0.5 + f - 0.5;
+  map.sy_x = d;
+  map.sy_y = e;
+
+  const std::ptrdiff_t row_size = (std::ptrdiff_t)width * num_channels;
+  const Source source = {input.data(), width, height, row_size, row_size * height <= INT32_MAX};
+  if (interpolation == Interpolation::bilinear) {
+    resample_channels<2>(source, num_channels, map, warped_width, warped_height, warped);
+  } else {
+    resample_channels<4>(source, num_channels, map, warped_width, warped_height, warped);
+  }
+}
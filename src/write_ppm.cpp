@@ -10,6 +10,16 @@ bool write_ppm(
   const int height,
   const int num_channels)
 {
+  return write_ppm(filename, make_image_view(data, width, height, num_channels));
+}
+
+bool write_ppm(
+  const std::string & filename,
+  const ImageView & view)
+{
+  const int width = view.width;
+  const int height = view.height;
+  const int num_channels = view.num_channels;
   assert(
     (num_channels == 3 || num_channels == 1 ) &&
     ".ppm only supports RGB or grayscale images");
@@ -32,8 +42,9 @@ bool write_ppm(
 
     // Write pixels
     for (int y = 0; y < height; ++y) {
+        const unsigned char * data = view.data + view.offset + y * view.y_stride;
         for (int x = 0; x < width; ++x) {
-            int idx = (y * width + x) * num_channels;
+            std::ptrdiff_t idx = x * view.x_stride;
 
             if (num_channels == 1) {
                 ofs << static_cast<int>(data[idx]) << " ";
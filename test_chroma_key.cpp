@@ -0,0 +1,151 @@
+#include "chroma_key.h"
+#include "over.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// The matte must follow the CbCr distance ramp, the SIMD path must agree
+// with the scalar one exactly, and the keyed layer must composite with over
+// without further conversion.
+
+const std::array<unsigned char, 3> green = {40, 200, 60};
+
+// A width*height image of pseudo-random colors, a third of them a noisy
+// version of the green backdrop
+std::vector<unsigned char> green_screen(const int width, const int height) {
+    std::vector<unsigned char> rgb(3 * width * height);
+    unsigned int state = 31;
+    for (int i = 0; i < width * height; i++) {
+        for (int c = 0; c < 3; c++) {
+            state = state * 1664525u + 1013904223u;
+            const int noise = (state >> 24) % 21 - 10;
+            rgb[3 * i + c] = i % 3 == 0 ? std::clamp(green[c] + noise, 0, 255) : (state >> 16) & 255;
+        }
+    }
+    return rgb;
+}
+
+double alpha_reference(const int r, const int g, const int b, const double inner, const double outer) {
+    const double cb = -0.168736 * (r - green[0]) - 0.331264 * (g - green[1]) + 0.5 * (b - green[2]);
+    const double cr = 0.5 * (r - green[0]) - 0.418688 * (g - green[1]) - 0.081312 * (b - green[2]);
+    const double distance = std::sqrt(cb * cb + cr * cr);
+    return std::clamp((distance - inner) / (outer - inner), 0.0, 1.0) * 255.0;
+}
+
+bool test_matte(const int width, const int height) {
+    std::cout << "Testing the matte of " << width << "x" << height << "..." << std::endl;
+    const std::vector<unsigned char> rgb = green_screen(width, height);
+    std::vector<unsigned char> rgba;
+    chroma_key(rgb, width, height, green, 20.0, 60.0, rgba);
+
+    std::vector<unsigned char> pixel_rgba;
+    for (int i = 0; i < width * height; i++) {
+        for (int c = 0; c < 3; c++) {
+            if (rgba[4 * i + c] != rgb[3 * i + c]) {
+                std::cerr << "FAIL: pixel " << i << " color changed" << std::endl;
+                return false;
+            }
+        }
+        const double expected = alpha_reference(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2], 20.0, 60.0);
+        if (std::abs(rgba[4 * i + 3] - expected) > 1.0) {
+            std::cerr << "FAIL: pixel " << i << " alpha is " << int(rgba[4 * i + 3])
+                      << ", expected " << expected << std::endl;
+            return false;
+        }
+        // A lone pixel takes the scalar path
+        chroma_key({rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]}, 1, 1, green, 20.0, 60.0, pixel_rgba);
+        if (pixel_rgba[3] != rgba[4 * i + 3]) {
+            std::cerr << "FAIL: pixel " << i << " alpha is " << int(rgba[4 * i + 3])
+                      << " in the image but " << int(pixel_rgba[3]) << " alone" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_hard_key() {
+    std::cout << "Testing a hard key..." << std::endl;
+    const std::vector<unsigned char> rgb = {40, 200, 60, 255, 0, 255, 40, 200, 61};
+    std::vector<unsigned char> rgba;
+    chroma_key(rgb, 3, 1, green, 0.0, 0.0, rgba);
+    return rgba[3] == 0 && rgba[7] == 255 && rgba[11] == 255;
+}
+
+bool test_over() {
+    std::cout << "Testing the keyed layer over a background..." << std::endl;
+    const int width = 64;
+    const int height = 48;
+    const std::vector<unsigned char> rgb = green_screen(width, height);
+    std::vector<unsigned char> layer;
+    chroma_key(rgb, width, height, green, 20.0, 60.0, layer);
+    std::vector<unsigned char> background(4 * width * height);
+    for (int i = 0; i < width * height; i++) {
+        background[4 * i] = 200;
+        background[4 * i + 1] = i % 256;
+        background[4 * i + 2] = 30;
+        background[4 * i + 3] = 255;
+    }
+
+    // Layers go first, as in main.cpp
+    std::vector<unsigned char> composite;
+    over(layer, background, width, height, composite);
+    for (int i = 0; i < width * height; i++) {
+        const double alpha = layer[4 * i + 3] / 255.0;
+        for (int c = 0; c < 3; c++) {
+            const double expected = alpha * rgb[3 * i + c] + (1 - alpha) * background[4 * i + c];
+            if (std::abs(composite[4 * i + c] - expected) > 1.0) {
+                std::cerr << "FAIL: pixel " << i << " is " << int(composite[4 * i + c])
+                          << ", expected " << expected << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Not a pass/fail test
+void benchmark() {
+    const int width = 4096;
+    const int height = 4096;
+    const std::vector<unsigned char> rgb = green_screen(width, height);
+    std::vector<unsigned char> rgba;
+    std::cout << "chroma_key on 4096x4096: "
+              << time_ms([&] { chroma_key(rgb, width, height, green, 20.0, 60.0, rgba); }) << " ms" << std::endl;
+}
+
+int main() {
+    std::cout << "=== Test: chroma key ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    // Rows that end mid-vector, and a frame large enough to be split
+    // across threads
+    const int sizes[][2] = {{1, 1}, {9, 1}, {61, 7}, {700, 400}};
+    for (const auto & size : sizes) {
+        total_tests++;
+        if (test_matte(size[0], size[1])) {
+            std::cout << "PASS: matte " << size[0] << "x" << size[1] << std::endl;
+            passed_tests++;
+        }
+    }
+    total_tests++;
+    if (test_hard_key()) {
+        std::cout << "PASS: hard key" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_over()) {
+        std::cout << "PASS: over" << std::endl;
+        passed_tests++;
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+#include "color_lut.h"
+#include "desaturate.h"
+#include "hue_shift.h"
+#include "test_helpers.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// A 3D lookup table baked from a chain of edits must reproduce the chain
+// closely (and the identity exactly), and .cube files must load.
+
+bool test_identity(const std::vector<unsigned char> & rgb, const int size) {
+    std::cout << "Testing identity table of size " << size << "..." << std::endl;
+    ColorLut lut;
+    bake_color_lut(size, {}, lut);
+    std::vector<unsigned char> graded;
+    apply_color_lut(lut, rgb, all_colors_width, all_colors_height, graded);
+    const long differences = count_differences(graded, rgb);
+    if (differences > 0) {
+        std::cerr << "FAIL: " << differences << " samples changed" << std::endl;
+    }
+    return differences == 0;
+}
+
+bool test_chain(const std::vector<unsigned char> & rgb, const int size) {
+    std::cout << "Testing hue_shift + desaturate baked into size " << size << "..." << std::endl;
+    const std::vector<ColorEdit> chain = {
+        [](const std::vector<unsigned char> & input, int width, int height,
+           std::vector<unsigned char> & output) {
+            hue_shift(input, width, height, 37.5, output);
+        },
+        [](const std::vector<unsigned char> & input, int width, int height,
+           std::vector<unsigned char> & output) {
+            desaturate(input, width, height, 0.25, output);
+        }};
+
+    std::vector<unsigned char> shifted, expected;
+    const double chain_ms = time_ms([&] {
+        chain[0](rgb, all_colors_width, all_colors_height, shifted);
+        chain[1](shifted, all_colors_width, all_colors_height, expected);
+    });
+
+    ColorLut lut;
+    const double bake_ms = time_ms([&] { bake_color_lut(size, chain, lut); });
+    std::vector<unsigned char> graded;
+    const double apply_ms = time_ms([&] {
+        apply_color_lut(lut, rgb, all_colors_width, all_colors_height, graded);
+    });
+    std::cout << "  chain " << chain_ms << " ms, bake " << bake_ms
+              << " ms, apply " << apply_ms << " ms" << std::endl;
+
+    // The chain is piecewise smooth; the table may only blur it a little
+    double total_error = 0;
+    int max_error = 0;
+    long within_two = 0;
+    for (size_t i = 0; i < rgb.size(); i++) {
+        const int error = std::abs(int(graded[i]) - int(expected[i]));
+        total_error += error;
+        max_error = std::max(max_error, error);
+        within_two += error <= 2;
+    }
+    const double mean_error = total_error / rgb.size();
+    const double fraction_within_two = double(within_two) / rgb.size();
+    std::cout << "  mean error " << mean_error << ", max error " << max_error
+              << ", " << 100 * fraction_within_two << "% within 2" << std::endl;
+    if (mean_error > 0.5 || fraction_within_two < 0.99) {
+        std::cerr << "FAIL: table too far from the chain" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_read_cube() {
+    std::cout << "Testing .cube import..." << std::endl;
+
+    // A 2x2x2 table that inverts every channel, over the default domain
+    const std::string filename = "test_color_lut_invert.cube";
+    {
+        std::ofstream ofs(filename);
+        ofs << "# inverts r, g and b\n"
+            << "TITLE \"Invert\"\n"
+            << "LUT_3D_SIZE 2\n"
+            << "DOMAIN_MIN 0.0 0.0 0.0\n"
+            << "DOMAIN_MAX 1.0 1.0 1.0\n\n";
+        for (int b = 1; b >= 0; b--) {
+            for (int g = 1; g >= 0; g--) {
+                for (int r = 1; r >= 0; r--) {
+                    ofs << r << ".0 " << g << ".0 " << b << ".0\n";
+                }
+            }
+        }
+    }
+    ColorLut lut;
+    const bool read = read_cube(filename, lut);
+    std::remove(filename.c_str());
+    if (!read || lut.size != 2) {
+        std::cerr << "FAIL: could not read " << filename << std::endl;
+        return false;
+    }
+
+    // An odd width so both the SIMD loop and the scalar tail run
+    const int width = 61;
+    const int height = 7;
+    std::vector<unsigned char> rgb(3 * width * height);
+    for (size_t i = 0; i < rgb.size(); i++) {
+        rgb[i] = (i * 97) % 256;
+    }
+    std::vector<unsigned char> graded;
+    apply_color_lut(lut, rgb, width, height, graded);
+    for (size_t i = 0; i < rgb.size(); i++) {
+        if (graded[i] != 255 - rgb[i]) {
+            std::cerr << "FAIL: sample " << i << " is " << int(graded[i])
+                      << ", expected " << 255 - int(rgb[i]) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    std::cout << "=== Test: 3D color lookup tables ===" << std::endl;
+
+    const std::vector<unsigned char> rgb = all_colors();
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    for (const int size : {33, 65}) {
+        total_tests++;
+        if (test_identity(rgb, size)) {
+            std::cout << "PASS: identity " << size << std::endl;
+            passed_tests++;
+        }
+        total_tests++;
+        if (test_chain(rgb, size)) {
+            std::cout << "PASS: chain " << size << std::endl;
+            passed_tests++;
+        }
+    }
+
+    total_tests++;
+    if (test_read_cube()) {
+        std::cout << "PASS: .cube import" << std::endl;
+        passed_tests++;
+    }
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+#include "curve.h"
+#include "intensity_lut.h"
+#include "test_helpers.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Curves must evaluate to their formulas, splines must pass through their
+// control points without overshooting, a composed chain must match the
+// edits applied one pass at a time, and the per-channel SIMD lookup must
+// match a per-byte one.
+
+// A width*height image of num_channels pseudo-random intensities
+std::vector<unsigned char> noise(const int width, const int height, const int num_channels) {
+    std::vector<unsigned char> image((size_t)width * height * num_channels);
+    unsigned int state = 99;
+    for (size_t i = 0; i < image.size(); i++) {
+        state = state * 1664525u + 1013904223u;
+        image[i] = state >> 24;
+    }
+    return image;
+}
+
+bool near(const double a, const double b) {
+    return std::abs(a - b) < 1e-12;
+}
+
+bool test_formulas() {
+    std::cout << "Testing brightness, contrast, gamma and levels..." << std::endl;
+    const Curve levels = levels_curve(0.2, 0.8, 2.0, 0.1, 0.9);
+    const bool ok =
+        near(brightness_curve(0.1)(0.3), 0.4) &&
+        near(contrast_curve(2.0)(0.75), 1.0) &&
+        near(contrast_curve(2.0)(0.5), 0.5) &&
+        near(gamma_curve(2.0)(0.25), 0.5) &&
+        near(levels(0.1), 0.1) &&
+        near(levels(0.2), 0.1) &&
+        near(levels(0.35), 0.1 + 0.8 * 0.5) &&
+        near(levels(0.9), 0.9);
+    if (!ok) {
+        std::cerr << "FAIL: a curve does not match its formula" << std::endl;
+        return false;
+    }
+    // The identity chain bakes to the identity
+    return bake_curve(compose_curves({brightness_curve(0.0), contrast_curve(1.0), gamma_curve(1.0)})) ==
+        identity_lut();
+}
+
+bool test_spline() {
+    std::cout << "Testing spline_curve..." << std::endl;
+    // An S-curve with a flat stretch
+    const std::vector<std::array<double, 2>> points = {
+        {0.0, 0.0}, {0.25, 0.15}, {0.5, 0.5}, {0.6, 0.5}, {0.75, 0.85}, {1.0, 1.0}};
+    const Curve curve = spline_curve(points);
+    for (const auto & point : points) {
+        if (!near(curve(point[0]), point[1])) {
+            std::cerr << "FAIL: curve(" << point[0] << ") is " << curve(point[0]) << std::endl;
+            return false;
+        }
+    }
+    double previous = curve(0.0);
+    for (int i = 1; i <= 1000; i++) {
+        const double y = curve(i / 1000.0);
+        if (y < previous - 1e-12) {
+            std::cerr << "FAIL: curve decreases at " << i / 1000.0 << std::endl;
+            return false;
+        }
+        if (i >= 500 && i <= 600 && !near(y, 0.5)) {
+            std::cerr << "FAIL: curve overshoots the flat stretch at " << i / 1000.0 << std::endl;
+            return false;
+        }
+        previous = y;
+    }
+    return near(curve(-1.0), 0.0) && near(curve(2.0), 1.0);
+}
+
+bool test_chain() {
+    std::cout << "Testing a composed chain against one pass per edit..." << std::endl;
+    const std::vector<Curve> edits = {
+        brightness_curve(0.05), contrast_curve(1.3), gamma_curve(1.4),
+        levels_curve(0.05, 0.95, 1.0, 0.0, 1.0)};
+    const int width = 300;
+    const int height = 200;
+    const std::vector<unsigned char> rgb = noise(width, height, 3);
+
+    std::vector<unsigned char> sequential = rgb;
+    for (const Curve & edit : edits) {
+        apply_curves(sequential, width, height, 3, {edit}, sequential);
+    }
+    std::vector<unsigned char> composed;
+    apply_curves(rgb, width, height, 3, {compose_curves(edits)}, composed);
+
+    // Rounding after every edit drifts by at most an intensity or two
+    int max_difference = 0;
+    for (size_t i = 0; i < rgb.size(); i++) {
+        max_difference = std::max(max_difference, std::abs(sequential[i] - composed[i]));
+    }
+    std::cout << "  max difference " << max_difference << std::endl;
+    if (max_difference > 2) {
+        std::cerr << "FAIL: composed chain differs from the sequential passes" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_per_channel(const int width, const int height, const int num_channels) {
+    std::cout << "Testing per-channel curves on " << width << "x" << height << "x"
+              << num_channels << "..." << std::endl;
+    const std::vector<unsigned char> image = noise(width, height, num_channels);
+    std::vector<Curve> curves;
+    std::vector<IntensityLut> luts;
+    for (int c = 0; c < num_channels; c++) {
+        curves.push_back(c % 2 == 0 ? gamma_curve(0.5 + c) : contrast_curve(0.5 + c));
+        luts.push_back(bake_curve(curves.back()));
+    }
+    std::vector<unsigned char> output;
+    apply_curves(image, width, height, num_channels, curves, output);
+    for (size_t i = 0; i < image.size(); i++) {
+        const int expected = luts[i % num_channels][image[i]];
+        if (output[i] != expected) {
+            std::cerr << "FAIL: sample " << i << " is " << int(output[i])
+                      << ", expected " << expected << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Not a pass/fail test: a chain of edits in one pass against one pass each
+void benchmark() {
+    std::cout << "Benchmarking 4 edits on 4096x4096 rgb..." << std::endl;
+    const int width = 4096;
+    const int height = 4096;
+    const std::vector<unsigned char> rgb = noise(width, height, 3);
+    const std::vector<Curve> edits = {
+        brightness_curve(0.05), contrast_curve(1.3), gamma_curve(1.4),
+        spline_curve({{0.0, 0.0}, {0.3, 0.25}, {0.7, 0.8}, {1.0, 1.0}})};
+    std::vector<unsigned char> output;
+
+    std::cout << "  one pass per edit " << time_ms([&] {
+        output = rgb;
+        for (const Curve & edit : edits) {
+            apply_curves(output, width, height, 3, {edit}, output);
+        }
+    }) << " ms" << std::endl;
+    std::cout << "  composed " << time_ms([&] {
+        apply_curves(rgb, width, height, 3, {compose_curves(edits)}, output);
+    }) << " ms" << std::endl;
+    std::cout << "  composed, a curve per channel " << time_ms([&] {
+        const Curve composed = compose_curves(edits);
+        apply_curves(rgb, width, height, 3, {composed, composed, brightness_curve(0.1)}, output);
+    }) << " ms" << std::endl;
+}
+
+int main() {
+    std::cout << "=== Test: tone curves ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    total_tests++;
+    if (test_formulas()) {
+        std::cout << "PASS: formulas" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_spline()) {
+        std::cout << "PASS: spline" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_chain()) {
+        std::cout << "PASS: composed chain" << std::endl;
+        passed_tests++;
+    }
+    // Every channel count, with rows that end mid-vector, and a frame large
+    // enough to be split across threads
+    const int sizes[][3] = {{1, 1, 2}, {33, 5, 1}, {33, 5, 2}, {33, 5, 3}, {33, 5, 4}, {1000, 1001, 3}};
+    for (const auto & size : sizes) {
+        total_tests++;
+        if (test_per_channel(size[0], size[1], size[2])) {
+            std::cout << "PASS: per-channel " << size[0] << "x" << size[1] << "x" << size[2] << std::endl;
+            passed_tests++;
+        }
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,292 @@
+#include "demosaic.h"
+#include "read_ppm.h"
+#include "simulate_bayer_mosaic.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// demosaic must reproduce data/validation/demosaicked.ppm exactly and agree
+// with a per-pixel reference on every image size and Bayer pattern,
+// including the borders of images too small to have an interior.
+// demosaic_malvar must match the published Malvar-He-Cutler kernels exactly
+// and beat demosaic on a real image.
+
+// Pseudo-random width*height mosaic, dark enough that zeros are common
+std::vector<unsigned char> noise(const int width, const int height) {
+    std::vector<unsigned char> bayer(width * height);
+    unsigned int state = 5;
+    for (auto & value : bayer) {
+        state = state * 1664525u + 1013904223u;
+        value = state >> 24;
+        value = value < 64 ? 0 : value;
+    }
+    return bayer;
+}
+
+// Each missing color sums its neighbors of that color inside the 3x3 block,
+// each divided by how many there are; the sampled color is kept
+std::vector<unsigned char> demosaic_reference(
+    const std::vector<unsigned char> & bayer,
+    const int width,
+    const int height,
+    const CfaPattern pattern) {
+    const auto sampled = [&](const int x, const int y) {
+        return cfa_channel(pattern, x, y);
+    };
+    std::vector<unsigned char> rgb(3 * width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                std::vector<int> neighbors;
+                for (int ny = y - 1; ny <= y + 1; ny++) {
+                    for (int nx = x - 1; nx <= x + 1; nx++) {
+                        if (nx >= 0 && nx < width && ny >= 0 && ny < height && sampled(nx, ny) == c) {
+                            neighbors.push_back(bayer[ny * width + nx]);
+                        }
+                    }
+                }
+                int value = 0;
+                for (const int neighbor : neighbors) {
+                    value += neighbor / (int)neighbors.size();
+                }
+                rgb[3 * (y * width + x) + c] = c == sampled(x, y) ? bayer[y * width + x] : value;
+            }
+        }
+    }
+    return rgb;
+}
+
+const CfaPattern patterns[] = {CfaPattern::rggb, CfaPattern::bggr, CfaPattern::grbg, CfaPattern::gbrg};
+
+bool test_sizes() {
+    std::cout << "Testing against the per-pixel reference..." << std::endl;
+    const int sizes[][2] = {{1, 1}, {1, 7}, {9, 1}, {2, 2}, {3, 3}, {4, 5}, {19, 6}, {20, 7}, {37, 40}, {301, 97}};
+    for (const auto & size : sizes) {
+        const std::vector<unsigned char> bayer = noise(size[0], size[1]);
+        std::vector<unsigned char> rgb;
+        demosaic(bayer, size[0], size[1], rgb);
+        if (rgb != demosaic_reference(bayer, size[0], size[1], CfaPattern::gbrg)) {
+            std::cerr << "FAIL: " << size[0] << "x" << size[1] << " differs from the reference" << std::endl;
+            return false;
+        }
+        for (const CfaPattern pattern : patterns) {
+            demosaic(bayer, size[0], size[1], pattern, rgb);
+            if (rgb != demosaic_reference(bayer, size[0], size[1], pattern)) {
+                std::cerr << "FAIL: " << size[0] << "x" << size[1] << " in pattern "
+                          << (int)pattern << " differs from the reference" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool test_mosaic() {
+    std::cout << "Testing simulate_bayer_mosaic..." << std::endl;
+    for (const int width : {1, 2, 17, 33, 100}) {
+        const int height = 5;
+        const std::vector<unsigned char> rgb = noise(3 * width, height);
+        std::vector<unsigned char> bayer, default_bayer;
+        simulate_bayer_mosaic(rgb, width, height, default_bayer);
+        for (const CfaPattern pattern : patterns) {
+            simulate_bayer_mosaic(rgb, width, height, pattern, bayer);
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    if (bayer[y * width + x] != rgb[3 * (y * width + x) + cfa_channel(pattern, x, y)]) {
+                        std::cerr << "FAIL: pixel (" << x << "," << y << ") of pattern "
+                                  << (int)pattern << " samples the wrong channel" << std::endl;
+                        return false;
+                    }
+                }
+            }
+            if (pattern == CfaPattern::gbrg && bayer != default_bayer) {
+                std::cerr << "FAIL: the default pattern is not gbrg" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Malvar-He-Cutler kernels in eighths, as published, for green at red or
+// blue, for a color found left and right of a green, above and below a
+// green, and at the diagonals of red or blue
+const double malvar_kernels[4][5][5] = {
+    {{0, 0, -1, 0, 0}, {0, 0, 2, 0, 0}, {-1, 2, 4, 2, -1}, {0, 0, 2, 0, 0}, {0, 0, -1, 0, 0}},
+    {{0, 0, 0.5, 0, 0}, {0, -1, 0, -1, 0}, {-1, 4, 5, 4, -1}, {0, -1, 0, -1, 0}, {0, 0, 0.5, 0, 0}},
+    {{0, 0, -1, 0, 0}, {0, -1, 4, -1, 0}, {0.5, 0, 5, 0, 0.5}, {0, -1, 4, -1, 0}, {0, 0, -1, 0, 0}},
+    {{0, 0, -1.5, 0, 0}, {0, 2, 0, 2, 0}, {-1.5, 0, 6, 0, -1.5}, {0, 2, 0, 2, 0}, {0, 0, -1.5, 0, 0}}};
+
+std::vector<unsigned char> malvar_reference(
+    const std::vector<unsigned char> & bayer,
+    const int width,
+    const int height,
+    const CfaPattern pattern) {
+    // Mirror about the edges without repeating them
+    const auto mirror = [](int i, const int n) {
+        i = std::abs(i);
+        return i >= n ? 2 * (n - 1) - i : i;
+    };
+    std::vector<unsigned char> rgb(3 * width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const int sampled = cfa_channel(pattern, x, y);
+            for (int c = 0; c < 3; c++) {
+                if (c == sampled) {
+                    rgb[3 * (y * width + x) + c] = bayer[y * width + x];
+                    continue;
+                }
+                const int kernel = sampled == 1
+                    ? (cfa_channel(pattern, x + 1, y) == c ? 1 : 2)
+                    : (c == 1 ? 0 : 3);
+                double value = 0;
+                for (int j = 0; j < 5; j++) {
+                    for (int i = 0; i < 5; i++) {
+                        value += malvar_kernels[kernel][j][i] *
+                                 bayer[mirror(y + j - 2, height) * width + mirror(x + i - 2, width)];
+                    }
+                }
+                rgb[3 * (y * width + x) + c] = std::clamp(std::floor(value / 8 + 0.5), 0.0, 255.0);
+            }
+        }
+    }
+    return rgb;
+}
+
+bool test_malvar() {
+    std::cout << "Testing demosaic_malvar against the published kernels..." << std::endl;
+    const int sizes[][2] = {{3, 3}, {4, 5}, {5, 4}, {19, 6}, {20, 7}, {37, 40}, {301, 97}};
+    for (const auto & size : sizes) {
+        const std::vector<unsigned char> bayer = noise(size[0], size[1]);
+        for (const CfaPattern pattern : patterns) {
+            std::vector<unsigned char> rgb;
+            demosaic_malvar(bayer, size[0], size[1], pattern, rgb);
+            if (rgb != malvar_reference(bayer, size[0], size[1], pattern)) {
+                std::cerr << "FAIL: " << size[0] << "x" << size[1] << " in pattern "
+                          << (int)pattern << " differs from the reference" << std::endl;
+                return false;
+            }
+        }
+    }
+    // Too small for the kernels
+    const std::vector<unsigned char> bayer = noise(2, 9);
+    std::vector<unsigned char> rgb, expected;
+    demosaic_malvar(bayer, 2, 9, CfaPattern::rggb, rgb);
+    demosaic(bayer, 2, 9, CfaPattern::rggb, expected);
+    return rgb == expected;
+}
+
+bool test_malvar_quality() {
+    std::cout << "Testing demosaic_malvar on data/validation/rgb.ppm..." << std::endl;
+    std::vector<unsigned char> rgb;
+    int width, height, num_channels;
+    if (!read_ppm(std::string(DATA_DIR) + "/validation/rgb.ppm", rgb, width, height, num_channels)) {
+        std::cerr << "FAIL: could not read rgb.ppm" << std::endl;
+        return false;
+    }
+    const auto psnr = [&](const std::vector<unsigned char> & estimate) {
+        double squared = 0;
+        for (size_t i = 0; i < rgb.size(); i++) {
+            squared += (estimate[i] - rgb[i]) * (estimate[i] - rgb[i]);
+        }
+        return 10 * std::log10(255.0 * 255.0 * rgb.size() / squared);
+    };
+    std::vector<unsigned char> bayer, bilinear, malvar;
+    simulate_bayer_mosaic(rgb, width, height, bayer);
+    demosaic(bayer, width, height, bilinear);
+    demosaic_malvar(bayer, width, height, CfaPattern::gbrg, malvar);
+    std::cout << "  PSNR: demosaic " << psnr(bilinear) << " dB, demosaic_malvar " << psnr(malvar) << " dB" << std::endl;
+    return psnr(malvar) > psnr(bilinear) + 1.0;
+}
+
+bool test_dark_neighbors() {
+    std::cout << "Testing dark neighbors..." << std::endl;
+    // A black neighbor still counts: the red at the center of this blue's
+    // diagonals is (0 + 0 + 0 + 200/4), not 200
+    const std::vector<unsigned char> bayer = {
+        9, 9, 9,
+        0, 9, 0,
+        9, 9, 9,
+        0, 9, 200};
+    std::vector<unsigned char> rgb;
+    demosaic(bayer, 3, 4, rgb);
+    const int blue = 3 * (2 * 3 + 1);
+    return rgb[blue] == 50 && rgb[blue + 2] == 9;
+}
+
+bool test_validation_image() {
+    std::cout << "Testing against data/validation/demosaicked.ppm..." << std::endl;
+    std::vector<unsigned char> bayer, expected;
+    int width, height, num_channels;
+    if (!read_ppm(std::string(DATA_DIR) + "/validation/bayer.ppm", bayer, width, height, num_channels) ||
+        !read_ppm(std::string(DATA_DIR) + "/validation/demosaicked.ppm", expected, width, height, num_channels)) {
+        std::cerr << "FAIL: could not read validation images" << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> rgb;
+    demosaic(bayer, width, height, rgb);
+    const long differences = count_differences(rgb, expected);
+    if (differences > 0) {
+        std::cerr << "FAIL: " << differences << " samples differ from demosaicked.ppm" << std::endl;
+    }
+    return differences == 0;
+}
+
+// Not a pass/fail test
+void benchmark() {
+    const int width = 6000;
+    const int height = 4000;
+    const std::vector<unsigned char> bayer = noise(width, height);
+    std::vector<unsigned char> rgb;
+    std::cout << "demosaic on 6000x4000: "
+              << time_ms([&] { demosaic(bayer, width, height, rgb); }) << " ms" << std::endl;
+    std::cout << "demosaic_malvar on 6000x4000: "
+              << time_ms([&] { demosaic_malvar(bayer, width, height, CfaPattern::gbrg, rgb); }) << " ms" << std::endl;
+}
+
+int main() {
+    std::cout << "=== Test: demosaic ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    total_tests++;
+    if (test_sizes()) {
+        std::cout << "PASS: sizes" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_mosaic()) {
+        std::cout << "PASS: mosaic" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_malvar()) {
+        std::cout << "PASS: malvar" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_malvar_quality()) {
+        std::cout << "PASS: malvar quality" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_dark_neighbors()) {
+        std::cout << "PASS: dark neighbors" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_validation_image()) {
+        std::cout << "PASS: validation image" << std::endl;
+        passed_tests++;
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
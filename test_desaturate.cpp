@@ -0,0 +1,102 @@
+#include "desaturate.h"
+#include "hsv_to_rgb.h"
+#include "read_ppm.h"
+#include "rgb_to_hsv.h"
+#include "test_helpers.h"
+#include <iostream>
+#include <vector>
+
+// desaturate skips the hsv round trip with a closed form on large images.
+// Its output must be identical to the round trip for every color.
+
+void desaturate_reference(
+    const std::vector<unsigned char> & rgb,
+    const double factor,
+    std::vector<unsigned char> & desaturated) {
+    desaturated.resize(rgb.size());
+    for (size_t i = 0; i < rgb.size(); i += 3) {
+        double h, s, v, r, g, b;
+        rgb_to_hsv(rgb[i], rgb[i + 1], rgb[i + 2], h, s, v);
+        hsv_to_rgb(h, s * (1 - factor), v, r, g, b);
+        desaturated[i] = r;
+        desaturated[i + 1] = g;
+        desaturated[i + 2] = b;
+    }
+}
+
+bool test_all_colors(const std::vector<unsigned char> & rgb, const double factor) {
+    std::cout << "Testing all 2^24 colors with factor " << factor << "..." << std::endl;
+
+    std::vector<unsigned char> expected, desaturated;
+    const double reference_ms = time_ms([&] { desaturate_reference(rgb, factor, expected); });
+    const double closed_form_ms = time_ms([&] { desaturate(rgb, 4096, 4096, factor, desaturated); });
+    std::cout << "  round trip " << reference_ms << " ms, desaturate "
+              << closed_form_ms << " ms" << std::endl;
+
+    const long differences = count_differences(expected, desaturated);
+    if (differences > 0) {
+        std::cerr << "FAIL: " << differences << " samples differ from the round trip" << std::endl;
+    }
+    return differences == 0;
+}
+
+bool test_validation_image() {
+    std::cout << "Testing against data/validation/desaturated.ppm..." << std::endl;
+
+    std::vector<unsigned char> rgb, expected;
+    int width, height, num_channels;
+    if (!read_ppm(std::string(DATA_DIR) + "/validation/rgb.ppm", rgb, width, height, num_channels) ||
+        !read_ppm(std::string(DATA_DIR) + "/validation/desaturated.ppm", expected, width, height, num_channels)) {
+        std::cerr << "FAIL: could not read validation images" << std::endl;
+        return false;
+    }
+
+    // main.cpp desaturates by 25%
+    std::vector<unsigned char> round_trip, desaturated;
+    desaturate_reference(rgb, 0.25, round_trip);
+    desaturate(rgb, width, height, 0.25, desaturated);
+    const long differences = count_differences(round_trip, desaturated);
+    if (differences > 0) {
+        std::cerr << "FAIL: " << differences << " samples differ from the round trip" << std::endl;
+    }
+
+    // The validation image rounds a few exact-integer middle channels the
+    // other way; desaturate must agree with it wherever the round trip does
+    long disagreements = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        disagreements += desaturated[i] != expected[i] && round_trip[i] == expected[i];
+    }
+    std::cout << "  " << count_differences(round_trip, expected)
+              << " samples of the round trip differ from desaturated.ppm" << std::endl;
+    if (disagreements > 0) {
+        std::cerr << "FAIL: " << disagreements << " samples differ from desaturated.ppm" << std::endl;
+    }
+    return differences == 0 && disagreements == 0;
+}
+
+int main() {
+    std::cout << "=== Test: desaturate closed form ===" << std::endl;
+
+    const std::vector<unsigned char> rgb = all_colors();
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    for (const double factor : {0.0, 0.2, 0.25, 0.37, 0.5, 1.0}) {
+        total_tests++;
+        if (test_all_colors(rgb, factor)) {
+            std::cout << "PASS: factor " << factor << std::endl;
+            passed_tests++;
+        }
+    }
+
+    total_tests++;
+    if (test_validation_image()) {
+        std::cout << "PASS: validation image" << std::endl;
+        passed_tests++;
+    }
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+#include "dither.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Dithering must preserve the average color of an area, leave colors that
+// are already in the palette alone, and the parallel wavefront must produce
+// exactly the same image as a plain sequential Floyd-Steinberg scan.
+
+// Sequential Floyd-Steinberg with the same integer arithmetic as
+// diffusion_dither, over a full-size error buffer
+void diffusion_reference(
+    const std::vector<unsigned char> & rgb,
+    const int width,
+    const int height,
+    const Palette & palette,
+    const bool serpentine,
+    std::vector<unsigned char> & indices) {
+    indices.resize(width * height);
+    std::vector<int> errors(3 * width * (height + 1), 0);
+    for (int y = 0; y < height; y++) {
+        const int direction = serpentine && y % 2 == 1 ? -1 : 1;
+        for (int k = 0; k < width; k++) {
+            const int x = direction > 0 ? k : width - 1 - k;
+            int value[3];
+            for (int c = 0; c < 3; c++) {
+                const int error = errors[3 * (y * width + x) + c];
+                value[c] = std::clamp(rgb[3 * (y * width + x) + c] + ((error + 8) >> 4), 0, 255);
+            }
+            const int index = palette.nearest[(value[0] >> 2) * 4096 + (value[1] >> 2) * 64 + (value[2] >> 2)];
+            indices[y * width + x] = index;
+            for (int c = 0; c < 3; c++) {
+                const int error = value[c] - palette.colors[index][c];
+                const int ahead = x + direction;
+                const int behind = x - direction;
+                if (ahead >= 0 && ahead < width) {
+                    errors[3 * (y * width + ahead) + c] += 7 * error;
+                    errors[3 * ((y + 1) * width + ahead) + c] += error;
+                }
+                if (behind >= 0 && behind < width) {
+                    errors[3 * ((y + 1) * width + behind) + c] += 3 * error;
+                }
+                errors[3 * ((y + 1) * width + x) + c] += 5 * error;
+            }
+        }
+    }
+}
+
+// A width*height image of smooth gradients with some noise
+std::vector<unsigned char> gradient(const int width, const int height) {
+    std::vector<unsigned char> rgb(3 * width * height);
+    unsigned int state = 5;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            state = state * 1664525u + 1013904223u;
+            const int noise = (state >> 28) - 8;
+            rgb[3 * (y * width + x)] = std::clamp(255 * x / width + noise, 0, 255);
+            rgb[3 * (y * width + x) + 1] = std::clamp(255 * y / height + noise, 0, 255);
+            rgb[3 * (y * width + x) + 2] = std::clamp(255 - 255 * x / width + noise, 0, 255);
+        }
+    }
+    return rgb;
+}
+
+bool test_palette() {
+    std::cout << "Testing palettes..." << std::endl;
+    const Palette palette = uniform_palette(6);
+    if (palette.colors.size() != 216) {
+        std::cerr << "FAIL: web palette has " << palette.colors.size() << " colors" << std::endl;
+        return false;
+    }
+    // Every palette color maps to itself
+    for (size_t i = 0; i < palette.colors.size(); i++) {
+        const auto & color = palette.colors[i];
+        if (palette.nearest[(color[0] >> 2) * 4096 + (color[1] >> 2) * 64 + (color[2] >> 2)] != i) {
+            std::cerr << "FAIL: color " << i << " is not its own nearest color" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Mean absolute difference of the 16x16-block averages of two images
+double block_error(
+    const std::vector<unsigned char> & a,
+    const std::vector<unsigned char> & b,
+    const int width,
+    const int height) {
+    double total = 0;
+    int blocks = 0;
+    for (int by = 0; by + 16 <= height; by += 16) {
+        for (int bx = 0; bx + 16 <= width; bx += 16) {
+            for (int c = 0; c < 3; c++) {
+                double sum = 0;
+                for (int y = by; y < by + 16; y++) {
+                    for (int x = bx; x < bx + 16; x++) {
+                        sum += a[3 * (y * width + x) + c] - b[3 * (y * width + x) + c];
+                    }
+                }
+                total += std::abs(sum) / 256;
+                blocks++;
+            }
+        }
+    }
+    return total / blocks;
+}
+
+bool test_ordered() {
+    std::cout << "Testing ordered_dither..." << std::endl;
+    // Odd width, so rows end in the scalar tail
+    const int width = 301;
+    const int height = 200;
+    const std::vector<unsigned char> rgb = gradient(width, height);
+    for (const int levels : {2, 3, 6}) {
+        const Palette palette = uniform_palette(levels);
+        std::vector<unsigned char> indices, dithered;
+        ordered_dither(rgb, width, height, palette, indices);
+        indices_to_rgb(indices, width, height, palette, dithered);
+        const double error = block_error(rgb, dithered, width, height);
+        std::cout << "  " << levels << " levels: mean block error " << error << std::endl;
+        if (error > 6.0) {
+            std::cerr << "FAIL: ordered dither does not preserve local averages" << std::endl;
+            return false;
+        }
+    }
+
+    // A 50% gray dithered to black and white is half white in every 8x8 tile
+    const Palette black_white = make_palette({{0, 0, 0}, {255, 255, 255}});
+    std::vector<unsigned char> indices;
+    ordered_dither(std::vector<unsigned char>(3 * 64 * 64, 128), 64, 64, black_white, indices);
+    for (int ty = 0; ty < 64; ty += 8) {
+        for (int tx = 0; tx < 64; tx += 8) {
+            int white = 0;
+            for (int y = ty; y < ty + 8; y++) {
+                for (int x = tx; x < tx + 8; x++) {
+                    white += indices[y * 64 + x];
+                }
+            }
+            if (white != 32) {
+                std::cerr << "FAIL: tile has " << white << " white pixels" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool test_diffusion(const bool serpentine) {
+    std::cout << "Testing diffusion_dither" << (serpentine ? " (serpentine)" : "") << "..." << std::endl;
+    const int width = 301;
+    const int height = 200;
+    const std::vector<unsigned char> rgb = gradient(width, height);
+    for (const int levels : {2, 3, 6}) {
+        const Palette palette = uniform_palette(levels);
+        std::vector<unsigned char> indices, expected, dithered;
+        diffusion_dither(rgb, width, height, palette, serpentine, indices);
+        diffusion_reference(rgb, width, height, palette, serpentine, expected);
+        if (indices != expected) {
+            std::cerr << "FAIL: differs from a sequential scan" << std::endl;
+            return false;
+        }
+        indices_to_rgb(indices, width, height, palette, dithered);
+        const double error = block_error(rgb, dithered, width, height);
+        std::cout << "  " << levels << " levels: mean block error " << error << std::endl;
+        if (error > 2.0) {
+            std::cerr << "FAIL: error diffusion does not preserve local averages" << std::endl;
+            return false;
+        }
+    }
+
+    // Palette colors come through untouched
+    const Palette palette = uniform_palette(3);
+    std::vector<unsigned char> flat(3 * 40 * 30), indices;
+    for (int i = 0; i < 40 * 30; i++) {
+        const auto & color = palette.colors[i % 27];
+        std::copy(color.begin(), color.end(), flat.begin() + 3 * i);
+    }
+    diffusion_dither(flat, 40, 30, palette, serpentine, indices);
+    for (int i = 0; i < 40 * 30; i++) {
+        if (indices[i] != i % 27) {
+            std::cerr << "FAIL: palette color " << i % 27 << " became " << int(indices[i]) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Not a pass/fail test: throughput of each method
+void benchmark() {
+    std::cout << "Benchmarking on 4096x4096 with 216 colors..." << std::endl;
+    const int width = 4096;
+    const int height = 4096;
+    const std::vector<unsigned char> rgb = gradient(width, height);
+    std::vector<unsigned char> indices;
+    Palette palette;
+    std::cout << "  uniform_palette " << time_ms([&] { palette = uniform_palette(6); }) << " ms" << std::endl;
+    std::cout << "  ordered_dither " << time_ms([&] { ordered_dither(rgb, width, height, palette, indices); })
+              << " ms" << std::endl;
+    std::cout << "  diffusion_dither " << time_ms([&] {
+        diffusion_dither(rgb, width, height, palette, false, indices); }) << " ms" << std::endl;
+    std::cout << "  diffusion_dither (serpentine) " << time_ms([&] {
+        diffusion_dither(rgb, width, height, palette, true, indices); }) << " ms" << std::endl;
+}
+
+int main() {
+    std::cout << "=== Test: dithering to a palette ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    total_tests++;
+    if (test_palette()) {
+        std::cout << "PASS: palette" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_ordered()) {
+        std::cout << "PASS: ordered dither" << std::endl;
+        passed_tests++;
+    }
+    for (const bool serpentine : {false, true}) {
+        total_tests++;
+        if (test_diffusion(serpentine)) {
+            std::cout << "PASS: error diffusion" << (serpentine ? " (serpentine)" : "") << std::endl;
+            passed_tests++;
+        }
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#ifndef TEST_HELPERS_H
+#define TEST_HELPERS_H
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// Fixtures and timing shared by the test_*.cpp programs
+
+// Size of the all_colors() image
+const int all_colors_width = 4096;
+const int all_colors_height = 4096;
+
+// A 4096x4096 rgb image holding every color exactly once
+inline std::vector<unsigned char> all_colors() {
+    std::vector<unsigned char> rgb(3 * all_colors_width * all_colors_height);
+    for (int i = 0; i < all_colors_width * all_colors_height; i++) {
+        rgb[3 * i] = i >> 16;
+        rgb[3 * i + 1] = i >> 8;
+        rgb[3 * i + 2] = i;
+    }
+    return rgb;
+}
+
+// Number of samples in which two images of the same size differ
+inline long count_differences(
+    const std::vector<unsigned char> & a,
+    const std::vector<unsigned char> & b) {
+    long differences = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        differences += a[i] != b[i];
+    }
+    return differences;
+}
+
+// Wall time of kernel() in milliseconds, the best of runs calls
+template <typename Kernel>
+double time_ms(const Kernel & kernel, const int runs = 1) {
+    double best = 0;
+    for (int run = 0; run < runs; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        kernel();
+        const double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        best = run == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+#endif
@@ -0,0 +1,234 @@
+#include "histogram.h"
+#include "intensity_lut.h"
+#include "rgb_to_gray.h"
+#include "test_helpers.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Histograms counted on threads must equal a serial count, auto-levels and
+// equalization must produce the expected lookup tables, and the SIMD lookup
+// must match a per-byte one.
+
+// A width*height image of num_channels pseudo-random intensities in
+// [low,high]
+std::vector<unsigned char> noise(
+    const int width, const int height, const int num_channels, const int low, const int high) {
+    std::vector<unsigned char> image((size_t)width * height * num_channels);
+    unsigned int state = 7;
+    for (size_t i = 0; i < image.size(); i++) {
+        state = state * 1664525u + 1013904223u;
+        image[i] = low + (state >> 16) % (high - low + 1);
+    }
+    return image;
+}
+
+bool test_channel_histograms(const int width, const int height, const int num_channels) {
+    std::cout << "Testing " << num_channels << "-channel histograms of "
+              << width << "x" << height << "..." << std::endl;
+    const std::vector<unsigned char> image = noise(width, height, num_channels, 0, 255);
+    std::vector<Histogram> expected(num_channels, Histogram{});
+    for (size_t i = 0; i < image.size(); i++) {
+        expected[i % num_channels][image[i]]++;
+    }
+    std::vector<Histogram> histograms;
+    channel_histograms(image, width, height, num_channels, histograms);
+    if (histograms != expected) {
+        std::cerr << "FAIL: histograms differ from a serial count" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_luminance_histogram() {
+    std::cout << "Testing luminance histogram..." << std::endl;
+    const int width = 640;
+    const int height = 480;
+    const std::vector<unsigned char> rgb = noise(width, height, 3, 0, 255);
+    std::vector<unsigned char> gray;
+    rgb_to_gray(rgb, width, height, gray);
+    Histogram expected{};
+    for (const unsigned char v : gray) {
+        expected[v]++;
+    }
+    Histogram histogram;
+    luminance_histogram(rgb, width, height, histogram);
+    if (histogram != expected) {
+        std::cerr << "FAIL: histogram differs from a count of rgb_to_gray" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_auto_levels() {
+    std::cout << "Testing auto_levels..." << std::endl;
+    // Red spans [40,180], green [60,200], blue [50,190]: the shared stretch
+    // maps 40 to 0 and 200 to 255
+    const int width = 256;
+    const int height = 256;
+    std::vector<unsigned char> rgb = noise(width, height, 3, 60, 180);
+    rgb[0] = 40;
+    rgb[4] = 200;
+    rgb[8] = 190;
+    rgb[11] = 50;
+    std::vector<unsigned char> leveled;
+    auto_levels(rgb, width, height, 0.0, leveled);
+    for (size_t i = 0; i < rgb.size(); i++) {
+        const int expected = std::lround((rgb[i] - 40) * 255.0 / 160.0);
+        if (leveled[i] != expected) {
+            std::cerr << "FAIL: " << int(rgb[i]) << " becomes " << int(leveled[i])
+                      << ", expected " << expected << std::endl;
+            return false;
+        }
+    }
+
+    // Clipping ignores the few outliers
+    std::vector<Histogram> histograms;
+    channel_histograms(rgb, width, height, 3, histograms);
+    const IntensityLut clipped = auto_levels_lut(histograms, 0.001);
+    if (clipped[60] != 0 || clipped[180] != 255) {
+        std::cerr << "FAIL: clipped levels map 60 to " << int(clipped[60])
+                  << " and 180 to " << int(clipped[180]) << std::endl;
+        return false;
+    }
+
+    // A flat image is left alone
+    auto_levels(std::vector<unsigned char>(3 * 16, 99), 4, 4, 0.0, leveled);
+    return leveled == std::vector<unsigned char>(3 * 16, 99);
+}
+
+bool test_equalize() {
+    std::cout << "Testing equalize..." << std::endl;
+    // Uniform luminance in [64,127] spreads over [0,255]
+    Histogram histogram{};
+    for (int v = 64; v < 128; v++) {
+        histogram[v] = 1000;
+    }
+    const IntensityLut lut = equalization_lut(histogram);
+    for (int v = 64; v < 128; v++) {
+        const int expected = std::lround((v - 64) * 255.0 / 63.0);
+        if (lut[v] != expected) {
+            std::cerr << "FAIL: " << v << " becomes " << int(lut[v])
+                      << ", expected " << expected << std::endl;
+            return false;
+        }
+    }
+    if (lut[0] != 0 || lut[255] != 255) {
+        return false;
+    }
+
+    // The equalized gray image has a roughly flat histogram
+    const int width = 512;
+    const int height = 512;
+    std::vector<unsigned char> rgb((size_t)width * height * 3);
+    const std::vector<unsigned char> dark = noise(width, height, 1, 0, 255);
+    for (int i = 0; i < width * height; i++) {
+        // Squaring crowds the intensities towards black
+        rgb[3 * i] = rgb[3 * i + 1] = rgb[3 * i + 2] = dark[i] * dark[i] / 255;
+    }
+    std::vector<unsigned char> equalized;
+    equalize(rgb, width, height, equalized);
+    std::vector<Histogram> histograms;
+    channel_histograms(equalized, width, height, 3, histograms);
+    std::uint64_t lower_half = 0;
+    for (int v = 0; v < 128; v++) {
+        lower_half += histograms[0][v];
+    }
+    const double fraction = double(lower_half) / (width * height);
+    std::cout << "  " << 100 * fraction << "% of equalized samples below 128" << std::endl;
+    if (fraction < 0.45 || fraction > 0.55) {
+        std::cerr << "FAIL: equalized histogram is not flat" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_apply_intensity_lut(const int width, const int height, const int num_channels) {
+    std::cout << "Testing apply_intensity_lut on " << width << "x" << height << "x"
+              << num_channels << "..." << std::endl;
+    const std::vector<unsigned char> image = noise(width, height, num_channels, 0, 255);
+    IntensityLut lut;
+    for (int v = 0; v < 256; v++) {
+        lut[v] = (v * 37 + 11) % 256;
+    }
+    std::vector<unsigned char> output;
+    apply_intensity_lut(image, width, height, num_channels, lut, output);
+    for (size_t i = 0; i < image.size(); i++) {
+        if (output[i] != lut[image[i]]) {
+            std::cerr << "FAIL: sample " << i << " is " << int(output[i])
+                      << ", expected " << int(lut[image[i]]) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Not a pass/fail test: statistics and lookup against a per-byte loop
+void benchmark() {
+    std::cout << "Benchmarking on 4096x4096 rgb..." << std::endl;
+    const int width = 4096;
+    const int height = 4096;
+    const std::vector<unsigned char> rgb = noise(width, height, 3, 0, 255);
+    std::vector<unsigned char> output(rgb.size());
+    const IntensityLut lut = identity_lut();
+
+    std::vector<Histogram> histograms;
+    std::cout << "  channel_histograms "
+              << time_ms([&] { channel_histograms(rgb, width, height, 3, histograms); }) << " ms"
+              << std::endl;
+    std::cout << "  per-byte lookup " << time_ms([&] {
+        for (size_t i = 0; i < rgb.size(); i++) {
+            output[i] = lut[rgb[i]];
+        }
+    }) << " ms" << std::endl;
+    std::cout << "  apply_intensity_lut "
+              << time_ms([&] { apply_intensity_lut(rgb, width, height, 3, lut, output); }) << " ms"
+              << std::endl;
+}
+
+int main() {
+    std::cout << "=== Test: histograms, auto-levels and equalization ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    // Small and large enough to be split across threads
+    for (const int num_channels : {1, 3, 4}) {
+        for (const int width : {7, 1500}) {
+            total_tests++;
+            if (test_channel_histograms(width, 999, num_channels)) {
+                std::cout << "PASS: " << num_channels << "-channel histograms, width " << width << std::endl;
+                passed_tests++;
+            }
+        }
+    }
+    total_tests++;
+    if (test_luminance_histogram()) {
+        std::cout << "PASS: luminance histogram" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_auto_levels()) {
+        std::cout << "PASS: auto_levels" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_equalize()) {
+        std::cout << "PASS: equalize" << std::endl;
+        passed_tests++;
+    }
+    const int sizes[][3] = {{1, 1, 1}, {63, 1, 1}, {65, 3, 3}, {1000, 1001, 3}};
+    for (const auto & size : sizes) {
+        total_tests++;
+        if (test_apply_intensity_lut(size[0], size[1], size[2])) {
+            std::cout << "PASS: apply_intensity_lut " << size[0] << "x" << size[1] << "x" << size[2] << std::endl;
+            passed_tests++;
+        }
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
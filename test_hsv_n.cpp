@@ -0,0 +1,110 @@
+#include "hue_shift.h"
+#include "desaturate.h"
+#include "test_helpers.h"
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// The float batch hsv kernels (HsvAccuracy::within_one) must stay within ±1
+// of the double-precision per-pixel path (HsvAccuracy::exact) on every
+// channel, for every rgb color.
+
+bool within_one(
+    const std::vector<unsigned char> & exact,
+    const std::vector<unsigned char> & approximate,
+    const std::string & label) {
+    long off_by_one = 0;
+    long failures = 0;
+    for (size_t i = 0; i < exact.size(); i++) {
+        const int difference = std::abs(int(exact[i]) - int(approximate[i]));
+        off_by_one += difference == 1;
+        if (difference > 1) {
+            if (failures < 10) {
+                std::cerr << "FAIL: " << label << " sample " << i << " exact="
+                          << int(exact[i]) << " within_one=" << int(approximate[i]) << std::endl;
+            }
+            failures++;
+        }
+    }
+    std::cout << "  " << label << ": " << off_by_one << " samples off by one" << std::endl;
+    return failures == 0;
+}
+
+bool test_hue_shift(const std::vector<unsigned char> & rgb, const double shift) {
+    std::cout << "Testing hue_shift by " << shift << " degrees..." << std::endl;
+    std::vector<unsigned char> exact, approximate;
+    const double exact_ms = time_ms([&] { hue_shift(rgb, 4096, 4096, shift, HsvAccuracy::exact, exact); });
+    const double within_one_ms = time_ms([&] {
+        hue_shift(rgb, 4096, 4096, shift, HsvAccuracy::within_one, approximate);
+    });
+    std::cout << "  exact " << exact_ms << " ms, within_one " << within_one_ms << " ms" << std::endl;
+    return within_one(exact, approximate, "hue_shift");
+}
+
+bool test_desaturate(const std::vector<unsigned char> & rgb, const double factor) {
+    std::cout << "Testing desaturate by " << factor << "..." << std::endl;
+    std::vector<unsigned char> exact, approximate;
+    const double exact_ms = time_ms([&] { desaturate(rgb, 4096, 4096, factor, HsvAccuracy::exact, exact); });
+    const double within_one_ms = time_ms([&] {
+        desaturate(rgb, 4096, 4096, factor, HsvAccuracy::within_one, approximate);
+    });
+    std::cout << "  exact " << exact_ms << " ms, within_one " << within_one_ms << " ms" << std::endl;
+    return within_one(exact, approximate, "desaturate");
+}
+
+bool test_odd_sizes() {
+    std::cout << "Testing odd image sizes (SIMD tails)..." << std::endl;
+    std::mt19937 rng(31);
+    bool passed = true;
+    for (int width = 1; width <= 19; width++) {
+        std::vector<unsigned char> rgb(3 * width * 3);
+        for (auto & value : rgb) {
+            value = rng();
+        }
+        std::vector<unsigned char> exact, approximate;
+        hue_shift(rgb, width, 3, -73.0, HsvAccuracy::exact, exact);
+        hue_shift(rgb, width, 3, -73.0, HsvAccuracy::within_one, approximate);
+        for (size_t i = 0; i < exact.size(); i++) {
+            if (std::abs(int(exact[i]) - int(approximate[i])) > 1) {
+                std::cerr << "FAIL: width " << width << " sample " << i << std::endl;
+                passed = false;
+            }
+        }
+    }
+    return passed;
+}
+
+int main() {
+    std::cout << "=== Test: batch hsv kernels ===" << std::endl;
+
+    const std::vector<unsigned char> rgb = all_colors();
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    for (const double shift : {-180.0, -37.5, 0.0, 60.0, 150.0}) {
+        total_tests++;
+        if (test_hue_shift(rgb, shift)) {
+            std::cout << "PASS: hue_shift " << shift << std::endl;
+            passed_tests++;
+        }
+    }
+
+    for (const double factor : {0.0, 0.2, 1.0}) {
+        total_tests++;
+        if (test_desaturate(rgb, factor)) {
+            std::cout << "PASS: desaturate " << factor << std::endl;
+            passed_tests++;
+        }
+    }
+
+    total_tests++;
+    if (test_odd_sizes()) {
+        std::cout << "PASS: odd sizes" << std::endl;
+        passed_tests++;
+    }
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include "hue_shift.h"
+#include "hsv_to_rgb.h"
+#include "read_ppm.h"
+#include "rgb_to_hsv.h"
+#include "test_helpers.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// hue_shift dispatches shifts by multiples of 60 degrees to a dedicated
+// kernel on large images. Its output must be identical to the generic
+// rgb_to_hsv -> fmod -> hsv_to_rgb path for every color.
+
+void hue_shift_reference(
+    const std::vector<unsigned char> & rgb,
+    const double shift,
+    std::vector<unsigned char> & shifted) {
+    shifted.resize(rgb.size());
+    for (size_t i = 0; i < rgb.size(); i += 3) {
+        double h, s, v, r, g, b;
+        rgb_to_hsv(rgb[i], rgb[i + 1], rgb[i + 2], h, s, v);
+        h = std::fmod(h + shift, 360.0);
+        if (h < 0.0) {
+            h += 360.0;
+        }
+        if (h >= 360.0) {
+            h -= 360.0;
+        }
+        hsv_to_rgb(h, s, v, r, g, b);
+        shifted[i] = r;
+        shifted[i + 1] = g;
+        shifted[i + 2] = b;
+    }
+}
+
+bool test_all_colors(const std::vector<unsigned char> & rgb, const double shift) {
+    std::cout << "Testing all 2^24 colors with shift " << shift << "..." << std::endl;
+
+    std::vector<unsigned char> expected, shifted;
+    const double reference_ms = time_ms([&] { hue_shift_reference(rgb, shift, expected); });
+    const double shift_ms = time_ms([&] { hue_shift(rgb, 4096, 4096, shift, shifted); });
+    std::cout << "  generic " << reference_ms << " ms, hue_shift "
+              << shift_ms << " ms" << std::endl;
+
+    const long differences = count_differences(expected, shifted);
+    if (differences > 0) {
+        std::cerr << "FAIL: " << differences << " samples differ from the generic path" << std::endl;
+    }
+    return differences == 0;
+}
+
+bool test_validation_image() {
+    std::cout << "Testing against data/validation/shifted.ppm..." << std::endl;
+
+    std::vector<unsigned char> rgb, expected;
+    int width, height, num_channels;
+    if (!read_ppm(std::string(DATA_DIR) + "/validation/rgb.ppm", rgb, width, height, num_channels) ||
+        !read_ppm(std::string(DATA_DIR) + "/validation/shifted.ppm", expected, width, height, num_channels)) {
+        std::cerr << "FAIL: could not read validation images" << std::endl;
+        return false;
+    }
+
+    // main.cpp shifts by 180 degrees
+    std::vector<unsigned char> generic, shifted;
+    hue_shift_reference(rgb, 180.0, generic);
+    hue_shift(rgb, width, height, 180.0, shifted);
+    const long differences = count_differences(generic, shifted);
+    if (differences > 0) {
+        std::cerr << "FAIL: " << differences << " samples differ from the generic path" << std::endl;
+    }
+
+    // The validation image rounds some min and middle channels differently
+    // from the generic path; hue_shift must agree with it wherever the
+    // generic path does
+    long disagreements = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        disagreements += shifted[i] != expected[i] && generic[i] == expected[i];
+    }
+    std::cout << "  " << count_differences(generic, expected)
+              << " samples of the generic path differ from shifted.ppm" << std::endl;
+    if (disagreements > 0) {
+        std::cerr << "FAIL: " << disagreements << " samples differ from shifted.ppm" << std::endl;
+    }
+    return differences == 0 && disagreements == 0;
+}
+
+int main() {
+    std::cout << "=== Test: hue_shift by multiples of 60 degrees ===" << std::endl;
+
+    const std::vector<unsigned char> rgb = all_colors();
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    // Every sixth of a turn, a few beyond [-180,180), and one generic angle
+    for (const double shift : {-180.0, -120.0, -60.0, 0.0, 60.0, 120.0, 180.0, -300.0, 240.0, 37.5}) {
+        total_tests++;
+        if (test_all_colors(rgb, shift)) {
+            std::cout << "PASS: shift " << shift << std::endl;
+            passed_tests++;
+        }
+    }
+
+    total_tests++;
+    if (test_validation_image()) {
+        std::cout << "PASS: validation image" << std::endl;
+        passed_tests++;
+    }
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
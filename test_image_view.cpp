@@ -0,0 +1,268 @@
+#include "image_view.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Every view edit, alone and chained with others (crops included), must
+// materialize to the same pixels as the edit done by copying pixel by pixel.
+// Sizes cover partial and whole 16x16 SIMD blocks and 64x64 tiles, and the
+// channel counts cover both the SIMD-transposed (1 and 4) and generic tiles.
+// Views built by hand with gaps between pixels must materialize too.
+
+// A row-major image that reference edits copy pixel by pixel
+struct Image {
+    int width;
+    int height;
+    int num_channels;
+    std::vector<unsigned char> data;
+};
+
+// Pseudo-random width*height*num_channels image
+Image noise(const int width, const int height, const int num_channels) {
+    Image image = {width, height, num_channels, std::vector<unsigned char>((size_t)width * height * num_channels)};
+    unsigned int state = 11;
+    for (auto & value : image.data) {
+        state = state * 1664525u + 1013904223u;
+        value = state >> 24;
+    }
+    return image;
+}
+
+// Image of the given size whose pixel (x,y) is pixel source_of(x,y) of input
+template <typename SourceOf>
+Image remap(const Image & input, const int width, const int height, const SourceOf & source_of) {
+    Image output = {width, height, input.num_channels,
+        std::vector<unsigned char>((size_t)width * height * input.num_channels)};
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int sx, sy;
+            source_of(x, y, sx, sy);
+            for (int c = 0; c < input.num_channels; c++) {
+                output.data[((size_t)y * width + x) * input.num_channels + c] =
+                    input.data[((size_t)sy * input.width + sx) * input.num_channels + c];
+            }
+        }
+    }
+    return output;
+}
+
+// One edit applied both to a view and to a reference image
+struct Edit {
+    enum Kind { FlipHorizontal, FlipVertical, Transpose, Rotate, Crop } kind;
+    int turns = 0;                            // Rotate
+    int x = 0, y = 0, width = 0, height = 0;  // Crop
+
+    std::string name() const {
+        switch (kind) {
+            case FlipHorizontal: return "flip_horizontal";
+            case FlipVertical: return "flip_vertical";
+            case Transpose: return "transpose";
+            case Rotate: return "rotate_view(" + std::to_string(turns) + ")";
+            default:
+                return "crop(" + std::to_string(x) + "," + std::to_string(y) + "," +
+                       std::to_string(width) + "," + std::to_string(height) + ")";
+        }
+    }
+
+    ImageView apply(const ImageView & view) const {
+        switch (kind) {
+            case FlipHorizontal: return flip_horizontal(view);
+            case FlipVertical: return flip_vertical(view);
+            case Transpose: return transpose(view);
+            case Rotate: return rotate_view(view, turns);
+            default: return crop(view, x, y, width, height);
+        }
+    }
+
+    Image apply(const Image & image) const {
+        const int w = image.width;
+        const int h = image.height;
+        switch (kind) {
+            case FlipHorizontal:
+                return remap(image, w, h, [&](int px, int py, int & sx, int & sy) { sx = w - 1 - px; sy = py; });
+            case FlipVertical:
+                return remap(image, w, h, [&](int px, int py, int & sx, int & sy) { sx = px; sy = h - 1 - py; });
+            case Transpose:
+                return remap(image, h, w, [&](int px, int py, int & sx, int & sy) { sx = py; sy = px; });
+            case Rotate: {
+                // One counter-clockwise turn takes output (x,y) from input (width-1-y, x)
+                Image rotated = image;
+                for (int turn = ((turns % 4) + 4) % 4; turn > 0; turn--) {
+                    const int rw = rotated.width;
+                    rotated = remap(rotated, rotated.height, rotated.width,
+                        [&](int px, int py, int & sx, int & sy) { sx = rw - 1 - py; sy = px; });
+                }
+                return rotated;
+            }
+            default:
+                return remap(image, width, height,
+                    [&](int px, int py, int & sx, int & sy) { sx = x + px; sy = y + py; });
+        }
+    }
+};
+
+// Apply edits to a view and to a copy of the image it shows, and compare
+// the materialized view with the copy
+bool check(ImageView view, Image expected, const std::vector<Edit> & edits, const std::string & name) {
+    for (const Edit & edit : edits) {
+        view = edit.apply(view);
+        expected = edit.apply(expected);
+    }
+    std::vector<unsigned char> actual;
+    materialize(view, actual);
+    if (view.width != expected.width || view.height != expected.height || actual != expected.data) {
+        std::cerr << "FAIL: " << name;
+        for (const Edit & edit : edits) {
+            std::cerr << " " << edit.name();
+        }
+        if (view.width != expected.width || view.height != expected.height) {
+            std::cerr << " is " << view.width << "x" << view.height << " instead of "
+                      << expected.width << "x" << expected.height << std::endl;
+        } else {
+            std::cerr << " gives different pixels" << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool check(const Image & image, const std::vector<Edit> & edits) {
+    return check(make_image_view(image.data, image.width, image.height, image.num_channels), image, edits,
+                 std::to_string(image.width) + "x" + std::to_string(image.height) + "x" +
+                 std::to_string(image.num_channels));
+}
+
+bool test_single_edits(const Image & image) {
+    const int w = image.width;
+    const int h = image.height;
+    std::vector<std::vector<Edit> > cases = {
+        {},
+        {{Edit::FlipHorizontal}},
+        {{Edit::FlipVertical}},
+        {{Edit::Transpose}},
+        {{Edit::Crop, 0, 0, 0, w, h}},
+        {{Edit::Crop, 0, w / 3, h / 2, w - w / 3, (h + 1) / 2}},
+        {{Edit::Crop, 0, w - 1, h - 1, 1, 1}},
+    };
+    for (int turns = -5; turns <= 5; turns++) {
+        cases.push_back({{Edit::Rotate, turns}});
+    }
+    for (const auto & edits : cases) {
+        if (!check(image, edits)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Chains of random edits with random crops of whatever size the view has
+// reached so far
+bool test_composed_edits(const Image & image, const int num_chains) {
+    unsigned int state = 3;
+    const auto next = [&](const int n) {
+        state = state * 1664525u + 1013904223u;
+        return (int)((state >> 8) % n);
+    };
+    for (int chain = 0; chain < num_chains; chain++) {
+        std::vector<Edit> edits;
+        int width = image.width;
+        int height = image.height;
+        for (int length = 1 + next(6); length > 0; length--) {
+            Edit edit = {(Edit::Kind)next(5)};
+            if (edit.kind == Edit::Rotate) {
+                edit.turns = next(9) - 4;
+            } else if (edit.kind == Edit::Crop) {
+                edit.width = 1 + next(width);
+                edit.height = 1 + next(height);
+                edit.x = next(width - edit.width + 1);
+                edit.y = next(height - edit.height + 1);
+            }
+            if (edit.kind == Edit::Crop) {
+                width = edit.width;
+                height = edit.height;
+            } else if (edit.kind == Edit::Transpose || (edit.kind == Edit::Rotate && edit.turns % 2 != 0)) {
+                std::swap(width, height);
+            }
+            edits.push_back(edit);
+        }
+        if (!check(image, edits)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Views built by hand whose pixels are not adjacent in the source: every
+// other column, every other row, and every third pixel of every other row,
+// alone and turned so that their rows run along source columns
+bool test_sparse_views(const Image & image) {
+    const int w = image.width;
+    const int h = image.height;
+    const int n = image.num_channels;
+    const std::ptrdiff_t row = (std::ptrdiff_t)w * n;
+    struct Sparse {
+        int step_x, step_y;
+    };
+    for (const Sparse sparse : {Sparse{2, 1}, Sparse{1, 2}, Sparse{3, 2}}) {
+        const int width = (w + sparse.step_x - 1) / sparse.step_x;
+        const int height = (h + sparse.step_y - 1) / sparse.step_y;
+        const ImageView view = {image.data.data(), width, height, n, 0, sparse.step_x * n, sparse.step_y * row};
+        const Image expected = remap(image, width, height,
+            [&](int px, int py, int & sx, int & sy) { sx = px * sparse.step_x; sy = py * sparse.step_y; });
+        const std::string name = std::to_string(w) + "x" + std::to_string(h) + "x" + std::to_string(n) +
+                                 " every (" + std::to_string(sparse.step_x) + "," +
+                                 std::to_string(sparse.step_y) + ")";
+        const std::vector<std::vector<Edit> > cases = {
+            {},
+            {{Edit::Transpose}},
+            {{Edit::FlipHorizontal}, {Edit::Rotate, 1}},
+            {{Edit::Rotate, -1}, {Edit::Crop, 0, height / 2, width / 3, height - height / 2, width - width / 3}},
+        };
+        for (const auto & edits : cases) {
+            if (!check(view, expected, edits, name)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main() {
+    std::cout << "=== Test: image views ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    const int sizes[][2] = {{1, 1}, {5, 3}, {16, 16}, {17, 33}, {70, 130}, {200, 67}};
+    for (const auto & size : sizes) {
+        for (const int num_channels : {1, 3, 4}) {
+            const Image image = noise(size[0], size[1], num_channels);
+            const std::string name = std::to_string(size[0]) + "x" + std::to_string(size[1]) + "x" +
+                                     std::to_string(num_channels);
+            std::cout << "Testing " << name << "..." << std::endl;
+
+            total_tests++;
+            if (test_single_edits(image)) {
+                std::cout << "PASS: single edits of " << name << std::endl;
+                passed_tests++;
+            }
+
+            total_tests++;
+            if (test_composed_edits(image, 300)) {
+                std::cout << "PASS: composed edits of " << name << std::endl;
+                passed_tests++;
+            }
+
+            total_tests++;
+            if (test_sparse_views(image)) {
+                std::cout << "PASS: sparse views of " << name << std::endl;
+                passed_tests++;
+            }
+        }
+    }
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+#include "demosaic.h"
+#include "over.h"
+#include "srgb.h"
+#include "test_helpers.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// The compile-time sRGB tables must match the transfer function evaluated
+// with std::pow, and the linear-light kernels must match a double-precision
+// reference to within one intensity. Also reports what linear light costs
+// over the sRGB-space kernels.
+
+double decode_reference(const double encoded) {
+    return encoded <= 0.04045 ? encoded / 12.92 : std::pow((encoded + 0.055) / 1.055, 2.4);
+}
+
+double encode_reference(const double linear) {
+    return linear <= 0.0031308 ? 12.92 * linear : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+}
+
+bool test_tables() {
+    std::cout << "Testing tables against std::pow..." << std::endl;
+    for (int i = 0; i < 256; i++) {
+        const int expected = decode_reference(i / 255.0) * 65535.0 + 0.5;
+        if (srgb_to_linear_table[i] != expected) {
+            std::cerr << "FAIL: srgb_to_linear(" << i << ") is " << srgb_to_linear_table[i]
+                      << ", expected " << expected << std::endl;
+            return false;
+        }
+    }
+    for (int i = 0; i < 4096; i++) {
+        const int expected = encode_reference(i / 4095.0) * 255.0 + 0.5;
+        if (linear_to_srgb_table[i] != expected) {
+            std::cerr << "FAIL: linear_to_srgb_table[" << i << "] is " << int(linear_to_srgb_table[i])
+                      << ", expected " << expected << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_round_trip() {
+    std::cout << "Testing sRGB -> linear -> sRGB..." << std::endl;
+    for (int i = 0; i < 256; i++) {
+        const int round_trip = linear_to_srgb(srgb_to_linear(i));
+        if (round_trip != i) {
+            std::cerr << "FAIL: " << i << " comes back as " << round_trip << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// A width*height image of num_channels pseudo-random intensities in [1,255]
+// (demosaic reads 0 as a missing neighbor)
+std::vector<unsigned char> noise(const int width, const int height, const int num_channels) {
+    std::vector<unsigned char> image(width * height * num_channels);
+    unsigned int state = 12345;
+    for (size_t i = 0; i < image.size(); i++) {
+        state = state * 1664525u + 1013904223u;
+        image[i] = 1 + (state >> 24) % 255;
+    }
+    return image;
+}
+
+bool test_over_linear() {
+    std::cout << "Testing over_linear against a double-precision reference..." << std::endl;
+    // Every pair of alphas, with arbitrary colors
+    const int width = 256;
+    const int height = 256;
+    std::vector<unsigned char> A = noise(width, height, 4);
+    std::vector<unsigned char> B = noise(height, width, 4);
+    for (int i = 0; i < width * height; i++) {
+        A[i * 4 + 3] = i % 256;
+        B[i * 4 + 3] = i / 256;
+    }
+    std::vector<unsigned char> C;
+    over_linear(A, B, width, height, C);
+
+    for (int i = 0; i < width * height; i++) {
+        const double alpha_s = B[i * 4 + 3] / 255.0;
+        const double alpha_d = A[i * 4 + 3] / 255.0;
+        for (int c = 0; c < 3; c++) {
+            const double s = decode_reference(B[i * 4 + c] / 255.0);
+            const double d = decode_reference(A[i * 4 + c] / 255.0);
+            const int expected = encode_reference(
+                alpha_s * (1.0 - alpha_d) * s + alpha_s * alpha_d * d) * 255.0 + 0.5;
+            if (std::abs(C[i * 4 + c] - expected) > 1) {
+                std::cerr << "FAIL: pixel " << i << " channel " << c << " is " << int(C[i * 4 + c])
+                          << ", expected " << expected << std::endl;
+                return false;
+            }
+        }
+        if (C[i * 4 + 3] != B[i * 4 + 3]) {
+            std::cerr << "FAIL: pixel " << i << " alpha is " << int(C[i * 4 + 3]) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_demosaic_linear() {
+    std::cout << "Testing demosaic_linear..." << std::endl;
+
+    // A flat mosaic stays flat, at every intensity
+    const int width = 7;
+    const int height = 5;
+    std::vector<unsigned char> rgb;
+    for (int v = 0; v < 256; v++) {
+        demosaic_linear(std::vector<unsigned char>(width * height, v), width, height, rgb);
+        for (size_t i = 0; i < rgb.size(); i++) {
+            if (rgb[i] != v) {
+                std::cerr << "FAIL: flat " << v << " becomes " << int(rgb[i]) << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // Averages of mixed intensities, against a double-precision reference
+    const std::vector<unsigned char> bayer = noise(width, height, 1);
+    demosaic_linear(bayer, width, height, rgb);
+    const auto sampled = [](const int x, const int y) {
+        return y % 2 == 0 ? (x % 2 == 0 ? 1 : 2) : (x % 2 == 0 ? 0 : 1);
+    };
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                int expected = bayer[y * width + x];
+                if (c != sampled(x, y)) {
+                    double sum = 0.0;
+                    int count = 0;
+                    for (int ny = y - 1; ny <= y + 1; ny++) {
+                        for (int nx = x - 1; nx <= x + 1; nx++) {
+                            if (ny >= 0 && ny < height && nx >= 0 && nx < width && sampled(nx, ny) == c) {
+                                sum += decode_reference(bayer[ny * width + nx] / 255.0);
+                                count++;
+                            }
+                        }
+                    }
+                    expected = encode_reference(sum / count) * 255.0 + 0.5;
+                }
+                if (std::abs(rgb[(y * width + x) * 3 + c] - expected) > 1) {
+                    std::cerr << "FAIL: (" << x << "," << y << ") channel " << c << " is "
+                              << int(rgb[(y * width + x) * 3 + c]) << ", expected " << expected << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Not a pass/fail test: the cost of linear light over the sRGB kernels
+void benchmark() {
+    std::cout << "Benchmarking sRGB vs linear light on 2048x2048..." << std::endl;
+    const int width = 2048;
+    const int height = 2048;
+    const std::vector<unsigned char> A = noise(width, height, 4);
+    const std::vector<unsigned char> B = noise(height, width, 4);
+    const std::vector<unsigned char> bayer = noise(width, height, 1);
+    std::vector<unsigned char> output;
+
+    const double over_ms = time_ms([&] { over(A, B, width, height, output); });
+    const double over_linear_ms = time_ms([&] { over_linear(A, B, width, height, output); });
+    const double demosaic_ms = time_ms([&] { demosaic(bayer, width, height, output); });
+    const double demosaic_linear_ms = time_ms([&] { demosaic_linear(bayer, width, height, output); });
+    std::cout << "  over " << over_ms << " ms, over_linear " << over_linear_ms << " ms" << std::endl;
+    std::cout << "  demosaic " << demosaic_ms << " ms, demosaic_linear " << demosaic_linear_ms << " ms" << std::endl;
+}
+
+int main() {
+    std::cout << "=== Test: linear-light processing ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    total_tests++;
+    if (test_tables()) {
+        std::cout << "PASS: tables" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_round_trip()) {
+        std::cout << "PASS: round trip" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_over_linear()) {
+        std::cout << "PASS: over_linear" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_demosaic_linear()) {
+        std::cout << "PASS: demosaic_linear" << std::endl;
+        passed_tests++;
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+#include "orientation.h"
+#include "reflect.h"
+#include "rotate.h"
+#include "test_helpers.h"
+#include <iostream>
+#include <vector>
+
+// The 8 orientations must form a group under compose, and orienting once
+// with a composed chain must match applying each step of the chain in turn.
+
+// Pseudo-random width*height*num_channels image
+std::vector<unsigned char> noise(const int width, const int height, const int num_channels) {
+    std::vector<unsigned char> image(width * height * num_channels);
+    unsigned int state = 3;
+    for (auto & value : image) {
+        state = state * 1664525u + 1013904223u;
+        value = state >> 24;
+    }
+    return image;
+}
+
+std::vector<Orientation> all_orientations() {
+    std::vector<Orientation> orientations;
+    for (int i = 0; i < 8; i++) {
+        orientations.push_back({(i & 4) != 0, (i & 2) != 0, (i & 1) != 0});
+    }
+    return orientations;
+}
+
+bool test_group() {
+    std::cout << "Testing the group structure..." << std::endl;
+    const std::vector<Orientation> orientations = all_orientations();
+    for (const Orientation & a : orientations) {
+        if (compose(a, inverse(a)) != Orientation{} || compose(inverse(a), a) != Orientation{}) {
+            std::cerr << "FAIL: inverse does not undo an orientation" << std::endl;
+            return false;
+        }
+        for (const Orientation & b : orientations) {
+            for (const Orientation & c : orientations) {
+                if (compose(compose(a, b), c) != compose(a, compose(b, c))) {
+                    std::cerr << "FAIL: compose is not associative" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    if (rotation(1) == rotation(-1) || compose({rotation(1), rotation(1)}) != rotation(2) ||
+        rotation(4) != Orientation{} || rotation(5) != rotation(1) ||
+        compose(horizontal_flip(), vertical_flip()) != rotation(2)) {
+        std::cerr << "FAIL: rotations do not compose as expected" << std::endl;
+        return false;
+    }
+    // The 8 EXIF tags cover the 8 orientations
+    for (int tag = 1; tag <= 8; tag++) {
+        for (int other = 1; other < tag; other++) {
+            if (exif_orientation(tag) == exif_orientation(other)) {
+                std::cerr << "FAIL: EXIF tags " << other << " and " << tag << " coincide" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Apply each step with its own copy, as chained reflect/rotate calls would
+void orient_steps(
+    std::vector<unsigned char> image,
+    int width,
+    int height,
+    const int num_channels,
+    const std::vector<Orientation> & steps,
+    std::vector<unsigned char> & oriented) {
+    for (const Orientation & step : steps) {
+        orient(image, width, height, num_channels, step, oriented);
+        if (step.transposed) {
+            std::swap(width, height);
+        }
+        image = oriented;
+    }
+    oriented = image;
+}
+
+bool test_chains(const int width, const int height, const int num_channels) {
+    std::cout << "Testing chains on " << width << "x" << height << "x" << num_channels << "..." << std::endl;
+    const std::vector<unsigned char> input = noise(width, height, num_channels);
+    const std::vector<Orientation> elementary = {
+        horizontal_flip(), vertical_flip(), transposition(), rotation(1), rotation(-1), rotation(2)};
+    unsigned int state = 11;
+    for (int trial = 0; trial < 50; trial++) {
+        std::vector<Orientation> steps;
+        for (int i = 0; i <= trial % 5; i++) {
+            state = state * 1664525u + 1013904223u;
+            steps.push_back(elementary[(state >> 16) % elementary.size()]);
+        }
+        std::vector<unsigned char> once, stepwise;
+        orient(input, width, height, num_channels, compose(steps), once);
+        orient_steps(input, width, height, num_channels, steps, stepwise);
+        if (once != stepwise) {
+            std::cerr << "FAIL: a chain of " << steps.size() << " steps differs from its composition" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_reflect_rotate() {
+    std::cout << "Testing reflect and rotate..." << std::endl;
+    const int width = 37;
+    const int height = 23;
+    const std::vector<unsigned char> input = noise(width, height, 3);
+    std::vector<unsigned char> reflected, rotated;
+    reflect(input, width, height, 3, reflected);
+    rotate(input, width, height, 3, rotated);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                const unsigned char value = input[3 * (y * width + x) + c];
+                if (reflected[3 * (y * width + (width - 1 - x)) + c] != value ||
+                    rotated[3 * ((width - 1 - x) * height + y) + c] != value) {
+                    std::cerr << "FAIL: pixel (" << x << "," << y << ") moved to the wrong place" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Not a pass/fail test: a reflect after a rotate, step by step and composed
+void benchmark() {
+    const int width = 4096;
+    const int height = 4096;
+    const std::vector<unsigned char> input = noise(width, height, 3);
+    std::vector<unsigned char> rotated, reflected;
+    std::cout << "rotate then reflect on 4096x4096: "
+              << time_ms([&] {
+                     rotate(input, width, height, 3, rotated);
+                     reflect(rotated, height, width, 3, reflected);
+                 })
+              << " ms, composed "
+              << time_ms([&] { orient(input, width, height, 3, compose(rotation(1), horizontal_flip()), reflected); })
+              << " ms" << std::endl;
+}
+
+int main() {
+    std::cout << "=== Test: orientations ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    total_tests++;
+    if (test_group()) {
+        std::cout << "PASS: group" << std::endl;
+        passed_tests++;
+    }
+    const int sizes[][3] = {{1, 1, 3}, {17, 5, 1}, {61, 37, 3}, {70, 33, 4}};
+    for (const auto & size : sizes) {
+        total_tests++;
+        if (test_chains(size[0], size[1], size[2])) {
+            std::cout << "PASS: chains " << size[0] << "x" << size[1] << "x" << size[2] << std::endl;
+            passed_tests++;
+        }
+    }
+    total_tests++;
+    if (test_reflect_rotate()) {
+        std::cout << "PASS: reflect and rotate" << std::endl;
+        passed_tests++;
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
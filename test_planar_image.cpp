@@ -0,0 +1,203 @@
+#include "planar_image.h"
+#include "desaturate.h"
+#include "hue_shift.h"
+#include "test_helpers.h"
+#include <iostream>
+#include <vector>
+
+// Splitting an image into planes and interleaving it back must give back
+// every byte, for any size (so that both the 16-pixel SIMD blocks and the
+// scalar tails run). The planar hue_shift and desaturate must match the
+// interleaved ones exactly, on their fast paths too.
+
+// A width*height image of num_channels pseudo-random intensities
+std::vector<unsigned char> noise(const int width, const int height, const int num_channels) {
+    std::vector<unsigned char> image((size_t)width * height * num_channels);
+    unsigned int state = 77;
+    for (size_t i = 0; i < image.size(); i++) {
+        state = state * 1664525u + 1013904223u;
+        image[i] = state >> 24;
+    }
+    return image;
+}
+
+// Check that planar holds channel c of pixel i of the interleaved image at
+// plane(planar, c)[i], for its first num_channels planes
+bool check_planes(
+    const PlanarImage & planar,
+    const std::vector<unsigned char> & interleaved,
+    const int width,
+    const int height,
+    const int interleaved_channels,
+    const int num_channels) {
+    if (planar.width != width || planar.height != height || planar.num_channels != num_channels ||
+        planar.data.size() != (size_t)width * height * num_channels) {
+        std::cerr << "FAIL: planar image is " << planar.width << "x" << planar.height << "x"
+                  << planar.num_channels << std::endl;
+        return false;
+    }
+    for (int c = 0; c < num_channels; c++) {
+        for (int i = 0; i < width * height; i++) {
+            if (plane(planar, c)[i] != interleaved[(size_t)i * interleaved_channels + c]) {
+                std::cerr << "FAIL: plane " << c << " differs at pixel " << i << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool test_round_trip(const int width, const int height, const int num_channels) {
+    const std::vector<unsigned char> input = noise(width, height, num_channels);
+    PlanarImage planar;
+    interleaved_to_planar(input, width, height, num_channels, planar);
+    if (!check_planes(planar, input, width, height, num_channels, num_channels)) {
+        return false;
+    }
+    std::vector<unsigned char> output;
+    planar_to_interleaved(planar, output);
+    if (output != input) {
+        std::cerr << "FAIL: " << count_differences(output, input)
+                  << " samples differ after the round trip" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_rgba_to_planar_rgb(const int width, const int height) {
+    const std::vector<unsigned char> rgba = noise(width, height, 4);
+    PlanarImage planar;
+    rgba_to_planar_rgb(rgba, width, height, planar);
+    if (!check_planes(planar, rgba, width, height, 4, 3)) {
+        return false;
+    }
+    std::vector<unsigned char> rgb;
+    planar_to_interleaved(planar, rgb);
+    for (int i = 0; i < width * height; i++) {
+        for (int c = 0; c < 3; c++) {
+            if (rgb[3 * i + c] != rgba[4 * i + c]) {
+                std::cerr << "FAIL: rgb differs from rgba without alpha at pixel " << i << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool test_size(const int width, const int height) {
+    std::cout << "Testing " << width << "x" << height << "..." << std::endl;
+    for (const int num_channels : {1, 3, 4}) {
+        if (!test_round_trip(width, height, num_channels)) {
+            std::cerr << "  with " << num_channels << " channels" << std::endl;
+            return false;
+        }
+    }
+    return test_rgba_to_planar_rgb(width, height);
+}
+
+// Apply an interleaved edit and its planar overload to rgb and compare
+template <typename Interleaved, typename Planar>
+bool same_as_interleaved(
+    const std::vector<unsigned char> & rgb,
+    const int width,
+    const int height,
+    const Interleaved & interleaved,
+    const Planar & planar) {
+    std::vector<unsigned char> expected;
+    interleaved(rgb, width, height, expected);
+    PlanarImage input, edited;
+    interleaved_to_planar(rgb, width, height, 3, input);
+    planar(input, edited);
+    std::vector<unsigned char> actual;
+    planar_to_interleaved(edited, actual);
+    const long differences = count_differences(actual, expected);
+    if (differences > 0) {
+        std::cerr << "FAIL: " << differences << " samples differ from the interleaved version" << std::endl;
+    }
+    return differences == 0;
+}
+
+bool test_planar_edits(const std::vector<unsigned char> & rgb, const int width, const int height) {
+    std::cout << "Testing planar hue_shift and desaturate on " << width << "x" << height << "..." << std::endl;
+    for (const double shift : {120.0, -60.0, 37.5}) {
+        const bool same = same_as_interleaved(rgb, width, height,
+            [&](const std::vector<unsigned char> & input, const int w, const int h,
+                std::vector<unsigned char> & output) { hue_shift(input, w, h, shift, output); },
+            [&](const PlanarImage & input, PlanarImage & output) { hue_shift(input, shift, output); });
+        if (!same) {
+            std::cerr << "  hue_shift by " << shift << std::endl;
+            return false;
+        }
+    }
+    for (const double factor : {0.25, 1.0}) {
+        const bool same = same_as_interleaved(rgb, width, height,
+            [&](const std::vector<unsigned char> & input, const int w, const int h,
+                std::vector<unsigned char> & output) { desaturate(input, w, h, factor, output); },
+            [&](const PlanarImage & input, PlanarImage & output) { desaturate(input, factor, output); });
+        if (!same) {
+            std::cerr << "  desaturate by " << factor << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Not a pass/fail test: the planar and interleaved fast paths side by side
+void benchmark(const std::vector<unsigned char> & rgb) {
+    std::cout << "Benchmarking on 4096x4096..." << std::endl;
+    const int width = all_colors_width;
+    const int height = all_colors_height;
+    PlanarImage planar, edited;
+    interleaved_to_planar(rgb, width, height, 3, planar);
+    std::vector<unsigned char> output;
+    std::cout << "  interleaved_to_planar "
+              << time_ms([&] { interleaved_to_planar(rgb, width, height, 3, planar); }) << " ms" << std::endl;
+    std::cout << "  planar_to_interleaved "
+              << time_ms([&] { planar_to_interleaved(planar, output); }) << " ms" << std::endl;
+    std::cout << "  hue_shift by 120: interleaved "
+              << time_ms([&] { hue_shift(rgb, width, height, 120, output); }) << " ms, planar "
+              << time_ms([&] { hue_shift(planar, 120, edited); }) << " ms" << std::endl;
+    std::cout << "  desaturate by 0.25: interleaved "
+              << time_ms([&] { desaturate(rgb, width, height, 0.25, output); }) << " ms, planar "
+              << time_ms([&] { desaturate(planar, 0.25, edited); }) << " ms" << std::endl;
+}
+
+int main() {
+    std::cout << "=== Test: planar images ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    // Single pixels, partial blocks, and whole blocks plus a tail
+    const int sizes[][2] = {{1, 1}, {15, 1}, {16, 1}, {17, 3}, {61, 7}, {1000, 1001}};
+    for (const auto & size : sizes) {
+        total_tests++;
+        if (test_size(size[0], size[1])) {
+            std::cout << "PASS: " << size[0] << "x" << size[1] << std::endl;
+            passed_tests++;
+        }
+    }
+
+    // Small images take the per-pixel paths; 1001x67 takes the fast paths
+    // with a tail of 3 pixels; every color takes them on every input
+    const std::vector<unsigned char> rgb = all_colors();
+    const int edit_sizes[][2] = {{61, 7}, {1001, 67}};
+    for (const auto & size : edit_sizes) {
+        total_tests++;
+        if (test_planar_edits(noise(size[0], size[1], 3), size[0], size[1])) {
+            std::cout << "PASS: planar edits on " << size[0] << "x" << size[1] << std::endl;
+            passed_tests++;
+        }
+    }
+    total_tests++;
+    if (test_planar_edits(rgb, all_colors_width, all_colors_height)) {
+        std::cout << "PASS: planar edits on every color" << std::endl;
+        passed_tests++;
+    }
+
+    benchmark(rgb);
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
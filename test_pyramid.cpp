@@ -0,0 +1,140 @@
+#include "pyramid.h"
+#include "srgb.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Each level must be the 2x2 average of the level above it (with odd edges
+// averaged with themselves), however the streaming pass and its bands
+// happen to split the work.
+
+// Pseudo-random width*height*num_channels image
+std::vector<unsigned char> noise(const int width, const int height, const int num_channels) {
+    std::vector<unsigned char> image(width * height * num_channels);
+    unsigned int state = 13;
+    for (auto & value : image) {
+        state = state * 1664525u + 1013904223u;
+        value = state >> 24;
+    }
+    return image;
+}
+
+// Reduce one level directly, one pixel at a time
+std::vector<unsigned char> reduce_reference(
+    const std::vector<unsigned char> & image,
+    const int width,
+    const int height,
+    const int num_channels,
+    const bool gamma_correct) {
+    const int new_width = (width + 1) / 2;
+    const int new_height = (height + 1) / 2;
+    std::vector<unsigned char> reduced(new_width * new_height * num_channels);
+    for (int y = 0; y < new_height; y++) {
+        for (int x = 0; x < new_width; x++) {
+            const int xs[2] = {2 * x, std::min(2 * x + 1, width - 1)};
+            const int ys[2] = {2 * y, std::min(2 * y + 1, height - 1)};
+            for (int c = 0; c < num_channels; c++) {
+                const bool alpha = (num_channels == 2 || num_channels == 4) && c == num_channels - 1;
+                unsigned int sum = 0;
+                for (const int sy : ys) {
+                    for (const int sx : xs) {
+                        const unsigned char value = image[(sy * width + sx) * num_channels + c];
+                        sum += gamma_correct && !alpha ? srgb_to_linear(value) : value;
+                    }
+                }
+                reduced[(y * new_width + x) * num_channels + c] =
+                    gamma_correct && !alpha ? linear_to_srgb((sum + 2) / 4) : (sum + 2) / 4;
+            }
+        }
+    }
+    return reduced;
+}
+
+bool test_levels(const int width, const int height, const int num_channels, const bool gamma_correct) {
+    std::cout << "Testing " << width << "x" << height << "x" << num_channels
+              << (gamma_correct ? " (gamma-correct)" : "") << "..." << std::endl;
+    std::vector<unsigned char> image = noise(width, height, num_channels);
+    std::vector<PyramidLevel> levels;
+    build_pyramid(image, width, height, num_channels, gamma_correct, levels);
+    int w = width;
+    int h = height;
+    for (size_t k = 0; k < levels.size(); k++) {
+        const std::vector<unsigned char> expected = reduce_reference(image, w, h, num_channels, gamma_correct);
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        if (levels[k].width != w || levels[k].height != h || levels[k].pixels != expected) {
+            std::cerr << "FAIL: level " << k + 1 << " differs from a 2x2 average of the level above" << std::endl;
+            return false;
+        }
+        image = levels[k].pixels;
+    }
+    if (w != 1 || h != 1) {
+        std::cerr << "FAIL: the pyramid stops at " << w << "x" << h << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_gamma() {
+    std::cout << "Testing gamma-correct averaging..." << std::endl;
+    // A black and white checkerboard is half as bright in linear light,
+    // which is about 188 in sRGB rather than 128
+    std::vector<unsigned char> checkerboard(8 * 8 * 4);
+    for (int i = 0; i < 64; i++) {
+        const unsigned char value = (i % 8 + i / 8) % 2 ? 255 : 0;
+        std::memset(checkerboard.data() + 4 * i, value, 3);
+        checkerboard[4 * i + 3] = value;
+    }
+    std::vector<PyramidLevel> plain, linear;
+    build_pyramid(checkerboard, 8, 8, 4, false, plain);
+    build_pyramid(checkerboard, 8, 8, 4, true, linear);
+    return plain[0].pixels[0] == 128 && linear[0].pixels[0] == 188 && linear[0].pixels[3] == 128;
+}
+
+// Not a pass/fail test: the whole pyramid against one copy of the source
+void benchmark() {
+    const int width = 8000;
+    const int height = 6000;
+    const std::vector<unsigned char> image = noise(width, height, 3);
+    std::vector<unsigned char> copy(image.size());
+    std::vector<PyramidLevel> levels;
+    std::cout << "8000x6000 rgb: memcpy " << time_ms([&] { std::memcpy(copy.data(), image.data(), image.size()); })
+              << " ms, pyramid " << time_ms([&] { build_pyramid(image, width, height, 3, false, levels); })
+              << " ms, gamma-correct " << time_ms([&] { build_pyramid(image, width, height, 3, true, levels); })
+              << " ms" << std::endl;
+}
+
+int main() {
+    std::cout << "=== Test: image pyramids ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    // Odd sizes, single rows and columns, and images tall enough for several
+    // bands and a second cascade
+    const int sizes[][2] = {{1, 1}, {2, 1}, {1, 9}, {37, 20}, {301, 257}, {130, 4100}};
+    for (const auto & size : sizes) {
+        for (const int num_channels : {1, 2, 3, 4}) {
+            for (const bool gamma_correct : {false, true}) {
+                total_tests++;
+                if (test_levels(size[0], size[1], num_channels, gamma_correct)) {
+                    passed_tests++;
+                }
+            }
+        }
+    }
+    std::cout << (passed_tests == total_tests ? "PASS" : "FAIL") << ": levels" << std::endl;
+    total_tests++;
+    if (test_gamma()) {
+        std::cout << "PASS: gamma" << std::endl;
+        passed_tests++;
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+#include "resize.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Every filter must keep flat images flat and same-size images unchanged,
+// agree with a floating-point two-pass resampler, and reuse cached plans.
+
+const ResizeFilter filters[] = {
+    ResizeFilter::box, ResizeFilter::bilinear, ResizeFilter::bicubic, ResizeFilter::lanczos3};
+const char * filter_names[] = {"box", "bilinear", "bicubic", "lanczos3"};
+
+// Smooth gradients with some noise
+std::vector<unsigned char> test_image(const int width, const int height, const int num_channels) {
+    std::vector<unsigned char> image(width * height * num_channels);
+    unsigned int state = 9;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < num_channels; c++) {
+                state = state * 1664525u + 1013904223u;
+                const int noise = (state >> 27) - 16;
+                image[(y * width + x) * num_channels + c] =
+                    std::clamp((c + 1) * 255 * (x + y) / (width + height) % 256 + noise, 0, 255);
+            }
+        }
+    }
+    return image;
+}
+
+double filter_weight(const ResizeFilter filter, const double x) {
+    const double t = std::abs(x);
+    switch (filter) {
+        case ResizeFilter::box: return x >= -0.5 && x < 0.5 ? 1 : 0;
+        case ResizeFilter::bilinear: return std::max(0.0, 1 - t);
+        case ResizeFilter::bicubic:
+            return t < 1 ? 1.5 * t * t * t - 2.5 * t * t + 1 : (t < 2 ? -0.5 * t * t * t + 2.5 * t * t - 4 * t + 2 : 0);
+        case ResizeFilter::lanczos3:
+            return t < 1e-8 ? 1 : (t < 3 ? 3 * std::sin(M_PI * t) * std::sin(M_PI * t / 3) / (M_PI * M_PI * t * t) : 0);
+    }
+    return 0;
+}
+
+// Resample one axis in double precision (stride between samples along the
+// axis, count samples)
+void resample_axis(
+    const std::vector<double> & source,
+    const int size,
+    const int new_size,
+    const int lines,
+    const int line_stride,
+    const int sample_stride,
+    const int new_line_stride,
+    const int new_sample_stride,
+    const ResizeFilter filter,
+    std::vector<double> & target) {
+    const double scale = (double)size / new_size;
+    const double stretch = std::max(scale, 1.0);
+    const double support = (filter == ResizeFilter::box ? 0.5 : filter == ResizeFilter::bilinear ? 1 :
+                            filter == ResizeFilter::bicubic ? 2 : 3) * stretch;
+    for (int i = 0; i < new_size; i++) {
+        const double center = (i + 0.5) * scale;
+        double sum = 0;
+        std::vector<std::pair<int, double>> taps;
+        for (int j = (int)std::floor(center - support - 0.5); j <= (int)std::ceil(center + support - 0.5); j++) {
+            const double weight = filter_weight(filter, (j + 0.5 - center) / stretch);
+            taps.push_back({std::clamp(j, 0, size - 1), weight});
+            sum += weight;
+        }
+        for (int line = 0; line < lines; line++) {
+            double value = 0;
+            for (const auto & [j, weight] : taps) {
+                value += weight / sum * source[line * line_stride + j * sample_stride];
+            }
+            target[line * new_line_stride + i * new_sample_stride] = value;
+        }
+    }
+}
+
+bool test_reference(
+    const int width,
+    const int height,
+    const int num_channels,
+    const int new_width,
+    const int new_height) {
+    std::cout << "Testing " << width << "x" << height << "x" << num_channels << " -> "
+              << new_width << "x" << new_height << "..." << std::endl;
+    const std::vector<unsigned char> input = test_image(width, height, num_channels);
+    for (int f = 0; f < 4; f++) {
+        std::vector<unsigned char> resized;
+        resize(input, width, height, num_channels, new_width, new_height, filters[f], resized);
+        if (resized.size() != (size_t)new_width * new_height * num_channels) {
+            std::cerr << "FAIL: " << filter_names[f] << " output has the wrong size" << std::endl;
+            return false;
+        }
+        // Each channel separately: horizontal then vertical
+        for (int c = 0; c < num_channels; c++) {
+            std::vector<double> source(width * height), columns(new_width * height), expected(new_width * new_height);
+            for (int i = 0; i < width * height; i++) {
+                source[i] = input[i * num_channels + c];
+            }
+            resample_axis(source, width, new_width, height, width, 1, new_width, 1, filters[f], columns);
+            // The intermediate image is 8-bit, so ringing is clipped between passes
+            for (double & value : columns) {
+                value = std::clamp(value, 0.0, 255.0);
+            }
+            resample_axis(columns, height, new_height, new_width, 1, new_width, 1, new_width, filters[f], expected);
+            for (int i = 0; i < new_width * new_height; i++) {
+                const double value = std::clamp(expected[i], 0.0, 255.0);
+                // Both passes round to 8 bits
+                if (std::abs(resized[i * num_channels + c] - value) > 1.5) {
+                    std::cerr << "FAIL: " << filter_names[f] << " sample " << i << " channel " << c << " is "
+                              << int(resized[i * num_channels + c]) << ", expected " << value << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool test_invariants() {
+    std::cout << "Testing flat and same-size images..." << std::endl;
+    const std::vector<unsigned char> input = test_image(33, 21, 3);
+    const std::vector<unsigned char> flat(33 * 21 * 3, 77);
+    for (int f = 0; f < 4; f++) {
+        std::vector<unsigned char> resized;
+        resize(input, 33, 21, 3, 33, 21, filters[f], resized);
+        if (resized != input) {
+            std::cerr << "FAIL: " << filter_names[f] << " changes a same-size image" << std::endl;
+            return false;
+        }
+        for (const auto & size : {std::pair{10, 7}, std::pair{90, 50}, std::pair{33, 5}, std::pair{1, 1}}) {
+            resize(flat, 33, 21, 3, size.first, size.second, filters[f], resized);
+            if (std::any_of(resized.begin(), resized.end(), [](const unsigned char v) { return v != 77; })) {
+                std::cerr << "FAIL: " << filter_names[f] << " changes a flat image at "
+                          << size.first << "x" << size.second << std::endl;
+                return false;
+            }
+        }
+    }
+    // Halving with a box is a 2x2 average (up to the rounding of each pass)
+    std::vector<unsigned char> halved;
+    resize(input, 33, 21, 3, 16, 10, ResizeFilter::box, halved);
+    const std::vector<unsigned char> even = test_image(32, 20, 1);
+    resize(even, 32, 20, 1, 16, 10, ResizeFilter::box, halved);
+    for (int y = 0; y < 10; y++) {
+        for (int x = 0; x < 16; x++) {
+            const double average = (even[2 * y * 32 + 2 * x] + even[2 * y * 32 + 2 * x + 1] +
+                                    even[(2 * y + 1) * 32 + 2 * x] + even[(2 * y + 1) * 32 + 2 * x + 1]) / 4.0;
+            if (std::abs(halved[y * 16 + x] - average) > 1.0) {
+                std::cerr << "FAIL: box halving is not a 2x2 average" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool test_plan_cache() {
+    std::cout << "Testing the plan cache..." << std::endl;
+    const auto plan = resize_plan(640, 480, 320, 240, ResizeFilter::lanczos3);
+    return plan == resize_plan(640, 480, 320, 240, ResizeFilter::lanczos3) &&
+           plan != resize_plan(640, 480, 320, 240, ResizeFilter::bicubic) &&
+           plan->horizontal.first.size() == 320 && plan->vertical.first.size() == 240;
+}
+
+// Not a pass/fail test: downscaling a 24 MP photo to a preview, per filter
+void benchmark() {
+    const int width = 6000;
+    const int height = 4000;
+    const std::vector<unsigned char> input = test_image(width, height, 3);
+    std::vector<unsigned char> resized;
+    for (int f = 0; f < 4; f++) {
+        std::cout << "6000x4000 -> 1500x1000 " << filter_names[f] << ": "
+                  << time_ms([&] { resize(input, width, height, 3, 1500, 1000, filters[f], resized); })
+                  << " ms" << std::endl;
+    }
+}
+
+int main() {
+    std::cout << "=== Test: resize ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    // Downscales, upscales and mixed, for every channel count
+    const int cases[][5] = {
+        {64, 48, 3, 20, 15}, {20, 15, 3, 67, 41}, {50, 30, 1, 13, 70}, {37, 29, 4, 37, 9},
+        {41, 23, 2, 100, 11}, {9, 7, 1, 2, 3}, {300, 200, 3, 71, 133}};
+    for (const auto & c : cases) {
+        total_tests++;
+        if (test_reference(c[0], c[1], c[2], c[3], c[4])) {
+            std::cout << "PASS: " << c[0] << "x" << c[1] << "x" << c[2] << " -> " << c[3] << "x" << c[4] << std::endl;
+            passed_tests++;
+        }
+    }
+    total_tests++;
+    if (test_invariants()) {
+        std::cout << "PASS: invariants" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_plan_cache()) {
+        std::cout << "PASS: plan cache" << std::endl;
+        passed_tests++;
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
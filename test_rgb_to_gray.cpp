@@ -0,0 +1,138 @@
+#include "rgb_to_gray.h"
+#include "planar_image.h"
+#include "read_ppm.h"
+#include "test_helpers.h"
+#include <iostream>
+#include <random>
+#include <vector>
+
+// rgb_to_gray computes luma in fixed point (with SIMD and threads). It must
+// be bit-exact with evaluating the luma formula in double precision and
+// truncating, which is how data/validation/gray.ppm was produced.
+
+unsigned char gray_reference(const int r, const int g, const int b) {
+#if defined(RGB_TO_GRAY_BT601)
+    return static_cast<unsigned char>(0.299 * r + 0.587 * g + 0.114 * b);
+#else
+    return static_cast<unsigned char>(0.2126 * r + 0.7152 * g + 0.0722 * b);
+#endif
+}
+
+bool count_mismatches(
+    const std::vector<unsigned char> & rgb,
+    const std::vector<unsigned char> & gray,
+    const std::string & label) {
+    long mismatches = 0;
+    for (size_t i = 0; i < gray.size(); i++) {
+        if (gray[i] != gray_reference(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2])) {
+            if (mismatches < 10) {
+                std::cerr << "FAIL: " << label << " rgb=(" << int(rgb[3 * i]) << ", "
+                          << int(rgb[3 * i + 1]) << ", " << int(rgb[3 * i + 2])
+                          << ") gray=" << int(gray[i]) << std::endl;
+            }
+            mismatches++;
+        }
+    }
+    if (mismatches > 0) {
+        std::cerr << "FAIL: " << label << " " << mismatches << " mismatches" << std::endl;
+    }
+    return mismatches == 0;
+}
+
+bool test_all_colors() {
+    std::cout << "Testing all 2^24 rgb colors..." << std::endl;
+
+    const int width = all_colors_width;
+    const int height = all_colors_height;
+    const std::vector<unsigned char> rgb = all_colors();
+
+    std::vector<unsigned char> gray;
+    std::cout << "  Converted " << width * height << " pixels in "
+              << time_ms([&] { rgb_to_gray(rgb, width, height, gray); })
+              << " ms" << std::endl;
+    bool passed = count_mismatches(rgb, gray, "interleaved");
+
+    PlanarImage planar;
+    interleaved_to_planar(rgb, width, height, 3, planar);
+    std::vector<unsigned char> planar_gray;
+    rgb_to_gray(planar, planar_gray);
+    passed = count_mismatches(rgb, planar_gray, "planar") && passed;
+    return passed;
+}
+
+bool test_odd_sizes() {
+    std::cout << "Testing odd image sizes (SIMD tails)..." << std::endl;
+
+    std::mt19937 rng(7);
+    bool passed = true;
+    for (int width = 1; width <= 19; width++) {
+        for (int height = 1; height <= 3; height++) {
+            std::vector<unsigned char> rgb(3 * width * height);
+            for (auto & value : rgb) {
+                // Neutral grays are the inputs the double formula truncates low
+                value = (rng() % 4 == 0) ? 255 : rng();
+            }
+            std::vector<unsigned char> gray;
+            rgb_to_gray(rgb, width, height, gray);
+            passed = count_mismatches(rgb, gray, "odd size") && passed;
+        }
+    }
+    return passed;
+}
+
+bool test_validation_image() {
+    std::cout << "Testing against data/validation/gray.ppm..." << std::endl;
+
+    std::vector<unsigned char> rgb, expected;
+    int width, height, num_channels, gray_width, gray_height, gray_channels;
+    if (!read_ppm(std::string(DATA_DIR) + "/validation/rgb.ppm", rgb, width, height, num_channels) ||
+        !read_ppm(std::string(DATA_DIR) + "/validation/gray.ppm", expected, gray_width, gray_height, gray_channels)) {
+        std::cerr << "FAIL: could not read validation images" << std::endl;
+        return false;
+    }
+
+    std::vector<unsigned char> gray;
+    rgb_to_gray(rgb, width, height, gray);
+#if defined(RGB_TO_GRAY_BT601)
+    // The validation image uses BT.709 weights
+    return count_mismatches(rgb, gray, "validation");
+#else
+    long mismatches = 0;
+    for (size_t i = 0; i < gray.size(); i++) {
+        mismatches += gray[i] != expected[i];
+    }
+    if (mismatches > 0) {
+        std::cerr << "FAIL: " << mismatches << " pixels differ from gray.ppm" << std::endl;
+    }
+    return mismatches == 0;
+#endif
+}
+
+int main() {
+    std::cout << "=== Test: rgb_to_gray fixed-point kernel ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    total_tests++;
+    if (test_all_colors()) {
+        std::cout << "PASS: all colors" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_odd_sizes()) {
+        std::cout << "PASS: odd sizes" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_validation_image()) {
+        std::cout << "PASS: validation image" << std::endl;
+        passed_tests++;
+    }
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+#include "rotate.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Every right-angle rotation must match a per-pixel reference for 1, 3 and
+// 4 channels, including sizes that leave partial tiles and partial SIMD
+// blocks at the edges. Arbitrary angles must agree with a floating-point
+// resampler up to the 8-bit sampling weights, and reproduce right angles
+// exactly.
+
+// Pseudo-random width*height*num_channels image
+std::vector<unsigned char> noise(const int width, const int height, const int num_channels) {
+    std::vector<unsigned char> image(width * height * num_channels);
+    unsigned int state = 17;
+    for (auto & value : image) {
+        state = state * 1664525u + 1013904223u;
+        value = state >> 24;
+    }
+    return image;
+}
+
+// Output (x,y) of one counter-clockwise turn is input (width-1-y, x)
+void rotate_reference(
+    const std::vector<unsigned char> & input,
+    const int width,
+    const int height,
+    const int num_channels,
+    const int quarter_turns,
+    std::vector<unsigned char> & rotated) {
+    std::vector<unsigned char> current = input;
+    int w = width;
+    int h = height;
+    for (int turn = ((quarter_turns % 4) + 4) % 4; turn > 0; turn--) {
+        rotated.assign(current.size(), 0);
+        for (int y = 0; y < w; y++) {
+            for (int x = 0; x < h; x++) {
+                for (int c = 0; c < num_channels; c++) {
+                    rotated[(y * h + x) * num_channels + c] = current[(x * w + (w - 1 - y)) * num_channels + c];
+                }
+            }
+        }
+        current = rotated;
+        std::swap(w, h);
+    }
+    rotated = current;
+}
+
+bool test_rotate(const int width, const int height, const int num_channels) {
+    std::cout << "Testing " << width << "x" << height << " with " << num_channels << " channels..." << std::endl;
+    const std::vector<unsigned char> input = noise(width, height, num_channels);
+    for (const int quarter_turns : {-1, 0, 1, 2, 3, 5}) {
+        std::vector<unsigned char> rotated, expected;
+        rotate(input, width, height, num_channels, quarter_turns, rotated);
+        rotate_reference(input, width, height, num_channels, quarter_turns, expected);
+        if (rotated != expected) {
+            std::cerr << "FAIL: " << quarter_turns << " quarter turns differ from the reference" << std::endl;
+            return false;
+        }
+    }
+    // The original signature is one counter-clockwise turn
+    std::vector<unsigned char> rotated, expected;
+    rotate(input, width, height, num_channels, rotated);
+    rotate_reference(input, width, height, num_channels, 1, expected);
+    if (rotated != expected) {
+        std::cerr << "FAIL: rotate differs from one quarter turn" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Catmull-Rom weight of the tap at distance d from the sample position
+double cubic(const double d) {
+    const double t = std::abs(d);
+    return t < 1 ? 1.5 * t * t * t - 2.5 * t * t + 1 : (t < 2 ? -0.5 * t * t * t + 2.5 * t * t - 4 * t + 2 : 0);
+}
+
+bool test_angle(
+    const int width,
+    const int height,
+    const int num_channels,
+    const double degrees,
+    const Interpolation interpolation,
+    const bool expand) {
+    const std::vector<unsigned char> input = noise(width, height, num_channels);
+    std::vector<unsigned char> rotated;
+    int rotated_width, rotated_height;
+    rotate_by_angle(input, width, height, num_channels, degrees, interpolation, expand,
+        rotated, rotated_width, rotated_height);
+    const double c = std::cos(degrees * M_PI / 180);
+    const double s = std::sin(degrees * M_PI / 180);
+    const int expected_width = expand ? (int)std::ceil(width * std::abs(c) + height * std::abs(s) - 1e-6) : width;
+    const int expected_height = expand ? (int)std::ceil(width * std::abs(s) + height * std::abs(c) - 1e-6) : height;
+    if (rotated_width != expected_width || rotated_height != expected_height ||
+        rotated.size() != (size_t)rotated_width * rotated_height * num_channels) {
+        std::cerr << "FAIL: canvas is " << rotated_width << "x" << rotated_height << std::endl;
+        return false;
+    }
+    const int radius = interpolation == Interpolation::bilinear ? 1 : 2;
+    for (int y = 0; y < rotated_height; y++) {
+        for (int x = 0; x < rotated_width; x++) {
+            const double u = x + 0.5 - rotated_width / 2.0;
+            const double v = y + 0.5 - rotated_height / 2.0;
+            const double sx = width / 2.0 - 0.5 + c * u - s * v;
+            const double sy = height / 2.0 - 0.5 + s * u + c * v;
+            // Skip centers too close to the edge of the input to call
+            const double edge = std::min(
+                std::min(std::abs(sx + 0.5), std::abs(sx - width + 0.5)),
+                std::min(std::abs(sy + 0.5), std::abs(sy - height + 0.5)));
+            if (edge < 1e-3) {
+                continue;
+            }
+            const bool inside = sx >= -0.5 && sx < width - 0.5 && sy >= -0.5 && sy < height - 0.5;
+            for (int ch = 0; ch < num_channels; ch++) {
+                double expected = 0;
+                if (inside) {
+                    for (int j = (int)std::floor(sy) - radius + 1; j <= (int)std::floor(sy) + radius; j++) {
+                        for (int i = (int)std::floor(sx) - radius + 1; i <= (int)std::floor(sx) + radius; i++) {
+                            const double weight = interpolation == Interpolation::bilinear
+                                ? (1 - std::abs(sx - i)) * (1 - std::abs(sy - j))
+                                : cubic(sx - i) * cubic(sy - j);
+                            const int xi = std::clamp(i, 0, width - 1);
+                            const int yj = std::clamp(j, 0, height - 1);
+                            expected += weight * input[(yj * width + xi) * num_channels + ch];
+                        }
+                    }
+                    expected = std::clamp(expected, 0.0, 255.0);
+                }
+                const int actual = rotated[(y * rotated_width + x) * num_channels + ch];
+                if (std::abs(actual - expected) > 3.0) {
+                    std::cerr << "FAIL: pixel (" << x << "," << y << ") is " << actual
+                              << ", expected " << expected << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool test_angles() {
+    std::cout << "Testing arbitrary angles..." << std::endl;
+    for (const auto interpolation : {Interpolation::bilinear, Interpolation::bicubic}) {
+        for (const int num_channels : {1, 2, 3, 4}) {
+            for (const double degrees : {0.0, 3.5, -17.0, 45.0, 133.0, 270.0 + 1e-3}) {
+                for (const bool expand : {false, true}) {
+                    if (!test_angle(61, 37, num_channels, degrees, interpolation, expand)) {
+                        std::cerr << "  at " << degrees << " degrees, " << num_channels << " channels" << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return test_angle(1, 1, 3, 30.0, Interpolation::bicubic, true) &&
+           test_angle(700, 500, 3, 7.0, Interpolation::bilinear, true);
+}
+
+bool test_right_angles() {
+    std::cout << "Testing right angles through rotate_by_angle..." << std::endl;
+    const int width = 45;
+    const int height = 29;
+    for (const int num_channels : {1, 3, 4}) {
+        const std::vector<unsigned char> input = noise(width, height, num_channels);
+        for (const int quarter_turns : {0, 1, 2, 3}) {
+            std::vector<unsigned char> expected;
+            rotate(input, width, height, num_channels, quarter_turns, expected);
+            for (const auto interpolation : {Interpolation::bilinear, Interpolation::bicubic}) {
+                std::vector<unsigned char> rotated;
+                int rotated_width, rotated_height;
+                rotate_by_angle(input, width, height, num_channels, 90.0 * quarter_turns, interpolation, true,
+                    rotated, rotated_width, rotated_height);
+                if (rotated != expected) {
+                    std::cerr << "FAIL: " << 90 * quarter_turns << " degrees differs from rotate" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Not a pass/fail test: rotation throughput against a plain copy
+void benchmark() {
+    const int width = 8000;
+    const int height = 6144;
+    for (const int num_channels : {1, 3, 4}) {
+        const std::vector<unsigned char> input = noise(width, height, num_channels);
+        std::vector<unsigned char> output(input.size());
+        std::cout << "50 MP, " << num_channels << " channels: memcpy "
+                  << time_ms([&] { std::memcpy(output.data(), input.data(), input.size()); }) << " ms";
+        for (const int quarter_turns : {1, 2, 3}) {
+            std::cout << ", " << 90 * quarter_turns << "° "
+                      << time_ms([&] { rotate(input, width, height, num_channels, quarter_turns, output); })
+                      << " ms";
+        }
+        std::cout << std::endl;
+    }
+    const std::vector<unsigned char> input = noise(width, height, 3);
+    std::vector<unsigned char> output;
+    int rotated_width, rotated_height;
+    for (const auto interpolation : {Interpolation::bilinear, Interpolation::bicubic}) {
+        const double ms = time_ms([&] {
+            rotate_by_angle(input, width, height, 3, 7.0, interpolation, false, output, rotated_width, rotated_height);
+        });
+        std::cout << "50 MP rgb by 7° (" << (interpolation == Interpolation::bilinear ? "bilinear" : "bicubic")
+                  << "): " << ms << " ms" << std::endl;
+    }
+}
+
+int main() {
+    std::cout << "=== Test: right-angle rotations ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    const int sizes[][2] = {{1, 1}, {17, 5}, {61, 37}, {128, 64}, {1000, 999}};
+    for (const auto & size : sizes) {
+        for (const int num_channels : {1, 3, 4}) {
+            total_tests++;
+            if (test_rotate(size[0], size[1], num_channels)) {
+                std::cout << "PASS: " << size[0] << "x" << size[1] << "x" << num_channels << std::endl;
+                passed_tests++;
+            }
+        }
+    }
+
+    total_tests++;
+    if (test_right_angles()) {
+        std::cout << "PASS: right angles" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_angles()) {
+        std::cout << "PASS: arbitrary angles" << std::endl;
+        passed_tests++;
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
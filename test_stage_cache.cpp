@@ -0,0 +1,368 @@
+#include "stage_cache.h"
+#include "stage_graph.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Keys must follow every byte (and length) they hash, entries must load back
+// exactly what was stored, eviction must drop the least recently used
+// entries first, and a hit must skip the stage that would have made them.
+
+namespace fs = std::filesystem;
+
+// Pseudo-random buffer of size bytes
+std::vector<unsigned char> noise(const size_t size, unsigned int state) {
+    std::vector<unsigned char> bytes(size);
+    for (auto & value : bytes) {
+        state = state * 1664525u + 1013904223u;
+        value = state >> 24;
+    }
+    return bytes;
+}
+
+// Empty directory for one test's cache
+std::string fresh_directory(const std::string & name) {
+    const fs::path directory = fs::temp_directory_path() / ("raster_test_stage_cache_" + name);
+    fs::remove_all(directory);
+    return directory.string();
+}
+
+bool test_hash() {
+    std::cout << "Testing key hashing..." << std::endl;
+    // FNV-1a of "a"
+    if (stage_cache_hash("a", 1, 14695981039346656037ull) != 0xaf63dc4c8601ec8cull) {
+        std::cerr << "FAIL: hash of \"a\" is not 64-bit FNV-1a" << std::endl;
+        return false;
+    }
+    const std::uint64_t seed = stage_cache_hash_seed();
+    if (seed != stage_cache_hash_seed() ||
+        seed != stage_cache_hash(std::string(STAGE_CACHE_VERSION), 14695981039346656037ull)) {
+        std::cerr << "FAIL: seed is not the hash of STAGE_CACHE_VERSION" << std::endl;
+        return false;
+    }
+    // Lengths are folded in, so moving a byte from one part to the next
+    // gives another key
+    if (stage_cache_hash(std::string("c"), stage_cache_hash(std::string("ab"), seed)) ==
+        stage_cache_hash(std::string("bc"), stage_cache_hash(std::string("a"), seed))) {
+        std::cerr << "FAIL: string boundaries don't change the key" << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> bytes = noise(4096, 1);
+    const std::uint64_t key = stage_cache_hash(bytes, seed);
+    if (key != stage_cache_hash(bytes, seed)) {
+        std::cerr << "FAIL: hashing the same bytes twice gives different keys" << std::endl;
+        return false;
+    }
+    for (const size_t i : {(size_t)0, (size_t)1000, bytes.size() - 1}) {
+        bytes[i] ^= 1;
+        const bool same = stage_cache_hash(bytes, seed) == key;
+        bytes[i] ^= 1;
+        if (same) {
+            std::cerr << "FAIL: flipping byte " << i << " doesn't change the key" << std::endl;
+            return false;
+        }
+    }
+    bytes.push_back(0);
+    if (stage_cache_hash(bytes, seed) == key) {
+        std::cerr << "FAIL: appending a zero doesn't change the key" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Write bytes to a file, with a modification time seconds after the epoch
+// of the file clock (so rewrites are told apart however coarse file times
+// are)
+void write_file(const fs::path & path, const std::vector<unsigned char> & bytes, const int seconds) {
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    fs::last_write_time(path, fs::file_time_type(std::chrono::seconds(1700000000 + seconds)));
+}
+
+bool test_file_hash() {
+    std::cout << "Testing file hashing..." << std::endl;
+    const fs::path directory = fresh_directory("file_hash");
+    fs::create_directories(directory);
+    const fs::path path = directory / "input.bin";
+    std::vector<unsigned char> bytes = noise(100000, 6);
+    write_file(path, bytes, 0);
+
+    const std::uint64_t seed = stage_cache_hash_seed();
+    std::uint64_t first = seed, second = seed;
+    if (!stage_cache_hash_file(path.string(), first) || !stage_cache_hash_file(path.string(), second) ||
+        first != second || first == seed) {
+        std::cerr << "FAIL: hashing the same file twice gives different keys" << std::endl;
+        return false;
+    }
+    // Same size, one byte changed, newer file time
+    bytes[77777] ^= 1;
+    write_file(path, bytes, 1);
+    std::uint64_t changed = seed;
+    if (!stage_cache_hash_file(path.string(), changed) || changed == first) {
+        std::cerr << "FAIL: changing the file doesn't change the key" << std::endl;
+        return false;
+    }
+    std::uint64_t missing = seed;
+    if (stage_cache_hash_file((directory / "missing.bin").string(), missing)) {
+        std::cerr << "FAIL: hashed a missing file" << std::endl;
+        return false;
+    }
+    fs::remove_all(directory);
+    return true;
+}
+
+bool test_round_trip() {
+    std::cout << "Testing store/load round trip..." << std::endl;
+    StageCache cache(fresh_directory("round_trip"), 1 << 20);
+    const std::vector<unsigned char> first = noise(1000, 2);
+    const std::vector<unsigned char> empty;
+    const std::vector<unsigned char> last = noise(65, 3);
+    if (!stage_cache_store(cache, 42, {&first, &empty, &last})) {
+        std::cerr << "FAIL: store failed" << std::endl;
+        return false;
+    }
+
+    std::vector<std::vector<unsigned char> > outputs;
+    if (!stage_cache_load(cache, 42, outputs) || outputs.size() != 3 ||
+        outputs[0] != first || outputs[1] != empty || outputs[2] != last) {
+        std::cerr << "FAIL: loaded outputs differ from the stored ones" << std::endl;
+        return false;
+    }
+    if (stage_cache_load(cache, 43, outputs)) {
+        std::cerr << "FAIL: loaded a key that was never stored" << std::endl;
+        return false;
+    }
+
+    // A truncated entry is a miss, not a short output
+    const fs::path entry = fs::path(cache.directory) / "000000000000002a.bin";
+    fs::resize_file(entry, fs::file_size(entry) - 1);
+    if (stage_cache_load(cache, 42, outputs)) {
+        std::cerr << "FAIL: loaded a truncated entry" << std::endl;
+        return false;
+    }
+    if (cache.hits != 1 || cache.misses != 2) {
+        std::cerr << "FAIL: counted " << cache.hits << " hits and " << cache.misses << " misses" << std::endl;
+        return false;
+    }
+    fs::remove_all(cache.directory);
+    return true;
+}
+
+bool test_eviction() {
+    std::cout << "Testing LRU eviction..." << std::endl;
+    // Each entry is a 64-byte header plus 1000 bytes; room for 3 of them
+    StageCache cache(fresh_directory("eviction"), 3 * (64 + 1000));
+    const std::vector<unsigned char> bytes = noise(1000, 4);
+    // File times may be coarser than these calls are apart
+    const auto tick = [] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); };
+
+    for (const std::uint64_t key : {1, 2, 3}) {
+        stage_cache_store(cache, key, {&bytes});
+        tick();
+    }
+    std::vector<std::vector<unsigned char> > outputs;
+    stage_cache_load(cache, 1, outputs);
+    tick();
+    stage_cache_store(cache, 4, {&bytes});
+
+    // Entry 1 was used after 2 and 3 were stored, so 2 is the oldest
+    if (cache.evictions != 1) {
+        std::cerr << "FAIL: evicted " << cache.evictions << " entries instead of 1" << std::endl;
+        return false;
+    }
+    for (const std::uint64_t key : {1, 2, 3, 4}) {
+        if (stage_cache_load(cache, key, outputs) != (key != 2)) {
+            std::cerr << "FAIL: entry " << key << (key == 2 ? " was kept" : " was evicted") << std::endl;
+            return false;
+        }
+    }
+    fs::remove_all(cache.directory);
+    return true;
+}
+
+bool test_stage_graph() {
+    std::cout << "Testing cached stages in run_stage_graph..." << std::endl;
+    StageCache cache(fresh_directory("stage_graph"), 1 << 20);
+    int runs = 0;
+    std::vector<unsigned char> result;
+    std::string params = "x2";
+    const std::vector<Stage> stages = {
+        {"double", {"in"}, {"out"}, [&](StageBuffers & buffers) {
+            runs++;
+            std::vector<unsigned char> & out = buffers.at("out");
+            out = buffers.at("in");
+            for (auto & value : out) {
+                value *= 2;
+            }
+            return true;
+        }, params},
+        {"check", {"out"}, {}, [&](StageBuffers & buffers) {
+            result = buffers.at("out");
+            return true;
+        }},
+    };
+
+    // Run the graph on input, expecting the double stage to run or not
+    const auto check = [&](const std::vector<Stage> & graph, const std::vector<unsigned char> & input,
+                           const bool expect_run) {
+        StageBuffers buffers = {{"in", input}};
+        std::vector<StageTiming> timings;
+        const int runs_before = runs;
+        result.clear();
+        if (!run_stage_graph(graph, buffers, 2, &cache, timings)) {
+            std::cerr << "FAIL: graph failed" << std::endl;
+            return false;
+        }
+        if ((runs > runs_before) != expect_run || timings[0].cached == expect_run) {
+            std::cerr << "FAIL: stage " << (expect_run ? "was skipped" : "ran again") << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < input.size(); i++) {
+            if (result.size() != input.size() || result[i] != (unsigned char)(2 * input[i])) {
+                std::cerr << "FAIL: wrong output" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    };
+
+    const std::vector<unsigned char> input = noise(500, 5);
+    std::vector<unsigned char> changed = input;
+    changed[250]++;
+    std::vector<Stage> renamed = stages;
+    renamed[0].cache_params = "x2 again";
+    if (!check(stages, input, true) || !check(stages, input, false) ||
+        !check(stages, changed, true) || !check(renamed, input, true) ||
+        !check(stages, input, false)) {
+        return false;
+    }
+    // Without a cache every run computes
+    StageBuffers buffers = {{"in", input}};
+    std::vector<StageTiming> timings;
+    const int runs_before = runs;
+    if (!run_stage_graph(stages, buffers, 1, nullptr, timings) || runs != runs_before + 1) {
+        std::cerr << "FAIL: stage didn't run without a cache" << std::endl;
+        return false;
+    }
+    fs::remove_all(cache.directory);
+    return true;
+}
+
+// A cached stage reading a file feeding another cached stage: the second is
+// keyed by the first's key, so both are skipped until the file changes
+bool test_file_chain() {
+    std::cout << "Testing chained cached stages reading a file..." << std::endl;
+    StageCache cache(fresh_directory("file_chain"), 1 << 20);
+    const fs::path path = fs::path(cache.directory + "_input.bin");
+    std::vector<unsigned char> bytes = noise(300, 7);
+    write_file(path, bytes, 0);
+
+    std::vector<int> runs(2, 0);
+    std::vector<unsigned char> result;
+    const std::vector<Stage> stages = {
+        {"read", {}, {"raw"}, [&](StageBuffers & buffers) {
+            runs[0]++;
+            std::ifstream ifs(path, std::ios::binary);
+            std::vector<unsigned char> & raw = buffers.at("raw");
+            raw.resize(fs::file_size(path));
+            ifs.read(reinterpret_cast<char *>(raw.data()), raw.size());
+            return (bool)ifs;
+        }, "raw", {path.string()}},
+        {"invert", {"raw"}, {"inverted"}, [&](StageBuffers & buffers) {
+            runs[1]++;
+            std::vector<unsigned char> & inverted = buffers.at("inverted");
+            inverted = buffers.at("raw");
+            for (auto & value : inverted) {
+                value = 255 - value;
+            }
+            return true;
+        }, "invert"},
+        {"check", {"inverted"}, {}, [&](StageBuffers & buffers) {
+            result = buffers.at("inverted");
+            return true;
+        }},
+    };
+
+    const auto check = [&](const int expected_runs) {
+        StageBuffers buffers;
+        std::vector<StageTiming> timings;
+        if (!run_stage_graph(stages, buffers, 2, &cache, timings)) {
+            std::cerr << "FAIL: graph failed" << std::endl;
+            return false;
+        }
+        if (runs[0] != expected_runs || runs[1] != expected_runs) {
+            std::cerr << "FAIL: stages ran " << runs[0] << " and " << runs[1] << " times instead of "
+                      << expected_runs << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < bytes.size(); i++) {
+            if (result.size() != bytes.size() || result[i] != 255 - bytes[i]) {
+                std::cerr << "FAIL: wrong output" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (!check(1) || !check(1)) {
+        return false;
+    }
+    bytes[150] ^= 1;
+    write_file(path, bytes, 1);
+    if (!check(2) || !check(2)) {
+        return false;
+    }
+    fs::remove_all(cache.directory);
+    fs::remove(path);
+    return true;
+}
+
+int main() {
+    std::cout << "=== Test: stage cache ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    total_tests++;
+    if (test_hash()) {
+        std::cout << "PASS: key hashing" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_file_hash()) {
+        std::cout << "PASS: file hashing" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_round_trip()) {
+        std::cout << "PASS: store/load round trip" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_eviction()) {
+        std::cout << "PASS: LRU eviction" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_stage_graph()) {
+        std::cout << "PASS: cached stages" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_file_chain()) {
+        std::cout << "PASS: chained cached stages" << std::endl;
+        passed_tests++;
+    }
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
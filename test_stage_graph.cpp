@@ -0,0 +1,324 @@
+#include "parallel_for.h"
+#include "stage_graph.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Stages must only start once their producers have finished, buffers must
+// be released after their last consumer, a failing stage must stop its
+// dependents, malformed graphs must be rejected before anything runs, the
+// summary must name the critical path, and concurrent stages must share the
+// thread budget of parallel_for.
+
+// Stage that records its start and end in a shared log, then fills each of
+// its outputs with one byte per input
+Stage logged_stage(
+    const std::string & name,
+    const std::vector<std::string> & inputs,
+    const std::vector<std::string> & outputs,
+    std::vector<std::string> & log,
+    std::mutex & mutex) {
+    return {name, inputs, outputs, [=, &log, &mutex](StageBuffers & buffers) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            log.push_back("start " + name);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        for (const auto & output : outputs) {
+            buffers.at(output).assign(inputs.size() + 1, 1);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        log.push_back("end " + name);
+        return true;
+    }};
+}
+
+// Position of an entry in the log (-1 if missing)
+int position(const std::vector<std::string> & log, const std::string & entry) {
+    const auto it = std::find(log.begin(), log.end(), entry);
+    return it == log.end() ? -1 : (int)(it - log.begin());
+}
+
+bool test_ordering() {
+    std::cout << "Testing dependency ordering..." << std::endl;
+    // A diamond (a -> b, c -> d) next to an independent chain (e -> f),
+    // listed out of order
+    std::vector<std::string> log;
+    std::mutex mutex;
+    const std::vector<Stage> stages = {
+        logged_stage("d", {"b_out", "c_out"}, {"d_out"}, log, mutex),
+        logged_stage("f", {"e_out"}, {}, log, mutex),
+        logged_stage("b", {"a_out"}, {"b_out"}, log, mutex),
+        logged_stage("c", {"a_out"}, {"c_out"}, log, mutex),
+        logged_stage("a", {}, {"a_out"}, log, mutex),
+        logged_stage("e", {}, {"e_out"}, log, mutex),
+    };
+    const std::vector<std::pair<std::string, std::string> > edges = {
+        {"a", "b"}, {"a", "c"}, {"b", "d"}, {"c", "d"}, {"e", "f"}};
+
+    for (const int num_threads : {1, 4}) {
+        log.clear();
+        StageBuffers buffers;
+        std::vector<StageTiming> timings;
+        if (!run_stage_graph(stages, buffers, num_threads, nullptr, timings) || log.size() != 12) {
+            std::cerr << "FAIL: graph failed on " << num_threads << " threads" << std::endl;
+            return false;
+        }
+        for (const auto & [producer, consumer] : edges) {
+            if (position(log, "end " + producer) > position(log, "start " + consumer)) {
+                std::cerr << "FAIL: " << consumer << " started before " << producer << " finished on "
+                          << num_threads << " threads" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool test_release() {
+    std::cout << "Testing release of intermediate buffers..." << std::endl;
+    // source (supplied) -> a -> mid -> b, c -> unused; b runs before c, so
+    // mid must survive b and be gone once c has read it
+    std::vector<size_t> seen;
+    const std::vector<Stage> stages = {
+        {"a", {"source"}, {"mid"}, [](StageBuffers & buffers) {
+            buffers.at("mid") = buffers.at("source");
+            return true;
+        }},
+        {"b", {"mid"}, {"b_out"}, [&](StageBuffers & buffers) {
+            seen.push_back(buffers.at("mid").size());
+            buffers.at("b_out").assign(5, 0);
+            return true;
+        }},
+        {"c", {"mid", "b_out"}, {"unused"}, [&](StageBuffers & buffers) {
+            seen.push_back(buffers.at("mid").size());
+            buffers.at("unused").assign(7, 0);
+            return true;
+        }},
+        {"d", {"unused"}, {}, [&](StageBuffers & buffers) {
+            // c, the last reader of mid, has finished
+            seen.push_back(buffers.at("mid").size());
+            seen.push_back(buffers.at("unused").size());
+            return true;
+        }},
+    };
+    StageBuffers buffers = {{"source", std::vector<unsigned char>(100, 3)}};
+    std::vector<StageTiming> timings;
+    if (!run_stage_graph(stages, buffers, 1, nullptr, timings)) {
+        std::cerr << "FAIL: graph failed" << std::endl;
+        return false;
+    }
+    if (seen != std::vector<size_t>{100, 100, 0, 7}) {
+        std::cerr << "FAIL: buffers released too early or too late" << std::endl;
+        return false;
+    }
+    for (const char * name : {"source", "mid", "b_out", "unused"}) {
+        if (!buffers.at(name).empty() || buffers.at(name).capacity() != 0) {
+            std::cerr << "FAIL: " << name << " still holds memory after the run" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_failure() {
+    std::cout << "Testing a failing stage..." << std::endl;
+    std::vector<std::string> log;
+    std::mutex mutex;
+    std::vector<Stage> stages = {
+        logged_stage("a", {}, {"a_out"}, log, mutex),
+        {"fail", {"a_out"}, {"fail_out"}, [](StageBuffers &) { return false; }},
+        logged_stage("after", {"fail_out"}, {"after_out"}, log, mutex),
+        logged_stage("last", {"after_out"}, {}, log, mutex),
+    };
+    StageBuffers buffers;
+    std::vector<StageTiming> timings;
+    if (run_stage_graph(stages, buffers, 2, nullptr, timings)) {
+        std::cerr << "FAIL: run succeeded although a stage failed" << std::endl;
+        return false;
+    }
+    if (position(log, "end a") < 0 || position(log, "start after") >= 0 || position(log, "start last") >= 0) {
+        std::cerr << "FAIL: dependents of the failing stage ran" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_malformed() {
+    std::cout << "Testing malformed graphs..." << std::endl;
+    std::vector<std::string> log;
+    std::mutex mutex;
+    const std::vector<std::vector<Stage> > graphs = {
+        // Nobody produces "missing"
+        {logged_stage("a", {}, {"a_out"}, log, mutex), logged_stage("b", {"missing"}, {}, log, mutex)},
+        // Two producers of "x"
+        {logged_stage("a", {}, {"x"}, log, mutex), logged_stage("b", {}, {"x"}, log, mutex)},
+        // x -> y -> x
+        {logged_stage("a", {"y"}, {"x"}, log, mutex), logged_stage("b", {"x"}, {"y"}, log, mutex)},
+    };
+    for (const auto & stages : graphs) {
+        StageBuffers buffers;
+        std::vector<StageTiming> timings;
+        if (run_stage_graph(stages, buffers, 2, nullptr, timings)) {
+            std::cerr << "FAIL: accepted a malformed graph" << std::endl;
+            return false;
+        }
+    }
+    if (!log.empty()) {
+        std::cerr << "FAIL: " << log.front() << " in a malformed graph" << std::endl;
+        return false;
+    }
+    // A cycle next to a valid stage: the valid stage may run, the cycle
+    // must not
+    log.clear();
+    const std::vector<Stage> stages = {
+        logged_stage("ok", {}, {}, log, mutex),
+        logged_stage("a", {"y"}, {"x"}, log, mutex),
+        logged_stage("b", {"x"}, {"y"}, log, mutex),
+    };
+    StageBuffers buffers;
+    std::vector<StageTiming> timings;
+    if (run_stage_graph(stages, buffers, 2, nullptr, timings) ||
+        position(log, "start a") >= 0 || position(log, "start b") >= 0) {
+        std::cerr << "FAIL: ran a cycle" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_critical_path() {
+    std::cout << "Testing the critical path summary..." << std::endl;
+    // a (10 ms) -> c (20 ms) outlasts b (5 ms) -> d (20 ms) and e (28 ms)
+    const auto stage = [](const std::string & name, const std::vector<std::string> & inputs,
+                          const std::vector<std::string> & outputs) {
+        return Stage{name, inputs, outputs, [](StageBuffers &) { return true; }};
+    };
+    const std::vector<Stage> stages = {
+        stage("a", {}, {"a_out"}),
+        stage("b", {}, {"b_out"}),
+        stage("c", {"a_out"}, {}),
+        stage("d", {"b_out"}, {}),
+        stage("e", {}, {}),
+    };
+    const std::vector<StageTiming> timings = {
+        {0.0, 10.0, false}, {0.0, 5.0, false}, {10.0, 30.0, false}, {5.0, 25.0, true}, {1.0, 29.0, false}};
+    std::ostringstream out;
+    out << std::setprecision(3);
+    print_stage_summary(stages, timings, out);
+    const std::string summary = out.str();
+    const std::string expected = "Critical path (30.0 ms of 30.0 ms wall): a -> c\n";
+    if (summary.size() < expected.size() ||
+        summary.compare(summary.size() - expected.size(), expected.size(), expected) != 0) {
+        std::cerr << "FAIL: summary ends with\n" << summary << std::endl;
+        return false;
+    }
+    if (summary.find("(cached)") == std::string::npos || out.precision() != 3) {
+        std::cerr << "FAIL: summary lost the cached mark or changed the stream" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_thread_budget() {
+    std::cout << "Testing the shared thread budget..." << std::endl;
+    const int hardware = std::max(1u, std::thread::hardware_concurrency());
+    const int granted = acquire_threads(1 << 20);
+    const int again = acquire_threads(1);
+    release_threads(granted + again);
+    if (granted != hardware - 1 || again != 0) {
+        std::cerr << "FAIL: granted " << granted << " then " << again << " of " << hardware - 1
+                  << " spare threads" << std::endl;
+        return false;
+    }
+
+    // 8 concurrent stages, each a parallel_for that asks for every core
+    std::atomic<int> active(0);
+    std::atomic<int> peak(0);
+    std::vector<Stage> stages;
+    for (int s = 0; s < 8; s++) {
+        stages.push_back({"stage " + std::to_string(s), {}, {}, [&](StageBuffers &) {
+            parallel_for(1 << 20, 1, [&](int, int) {
+                const int now = ++active;
+                int seen = peak.load();
+                while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                --active;
+            });
+            return true;
+        }});
+    }
+    StageBuffers buffers;
+    std::vector<StageTiming> timings;
+    if (!run_stage_graph(stages, buffers, 8, nullptr, timings)) {
+        std::cerr << "FAIL: graph failed" << std::endl;
+        return false;
+    }
+    // Each of the 8 stage workers runs its own chunk, and all the extra
+    // chunks together come out of the hardware-1 spare threads (without the
+    // budget, every stage would run a chunk per core)
+    if (peak > 8 + hardware - 1) {
+        std::cerr << "FAIL: " << peak << " chunks ran at once on " << hardware << " cores" << std::endl;
+        return false;
+    }
+    if (acquire_threads(1 << 20) != hardware - 1) {
+        std::cerr << "FAIL: threads were not given back" << std::endl;
+        return false;
+    }
+    release_threads(hardware - 1);
+    return true;
+}
+
+int main() {
+    std::cout << "=== Test: stage graph ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    total_tests++;
+    if (test_ordering()) {
+        std::cout << "PASS: dependency ordering" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_release()) {
+        std::cout << "PASS: buffer release" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_failure()) {
+        std::cout << "PASS: failing stage" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_malformed()) {
+        std::cout << "PASS: malformed graphs" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_critical_path()) {
+        std::cout << "PASS: critical path" << std::endl;
+        passed_tests++;
+    }
+
+    total_tests++;
+    if (test_thread_budget()) {
+        std::cout << "PASS: thread budget" << std::endl;
+        passed_tests++;
+    }
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include "rgba_to_rgb.h"
+#include "swizzle.h"
+#include "test_helpers.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// The shuffle-based swizzles must match per-byte copies for any image size
+// (so that both the 16-pixel SIMD blocks and the scalar tails run, on one
+// thread and on several), and should run at about the speed of memcpy.
+
+// A width*height image of num_channels pseudo-random intensities
+std::vector<unsigned char> noise(const int width, const int height, const int num_channels) {
+    std::vector<unsigned char> image((size_t)width * height * num_channels);
+    unsigned int state = 2024;
+    for (size_t i = 0; i < image.size(); i++) {
+        state = state * 1664525u + 1013904223u;
+        image[i] = state >> 24;
+    }
+    return image;
+}
+
+// Check every output byte against expected(pixel, channel)
+template <typename Expected>
+bool check(
+    const std::vector<unsigned char> & output,
+    const int num_pixels,
+    const int num_channels,
+    const Expected & expected) {
+    if (output.size() != (size_t)num_pixels * num_channels) {
+        std::cerr << "FAIL: output has " << output.size() << " bytes" << std::endl;
+        return false;
+    }
+    for (int i = 0; i < num_pixels; i++) {
+        for (int c = 0; c < num_channels; c++) {
+            if (output[(size_t)i * num_channels + c] != expected(i, c)) {
+                std::cerr << "FAIL: pixel " << i << " channel " << c << " is "
+                          << int(output[(size_t)i * num_channels + c]) << ", expected "
+                          << int(expected(i, c)) << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool test_size(const int width, const int height) {
+    std::cout << "Testing " << width << "x" << height << "..." << std::endl;
+    const int num_pixels = width * height;
+    const std::vector<unsigned char> rgba = noise(width, height, 4);
+    const std::vector<unsigned char> rgb = noise(width, height, 3);
+    std::vector<unsigned char> output;
+
+    rgba_to_rgb(rgba, width, height, output);
+    if (!check(output, num_pixels, 3, [&](int i, int c) { return rgba[i * 4 + c]; })) {
+        return false;
+    }
+    rgb_to_rgba(rgb, width, height, 200, output);
+    if (!check(output, num_pixels, 4, [&](int i, int c) {
+            return c == 3 ? (unsigned char)200 : rgb[i * 3 + c]; })) {
+        return false;
+    }
+    bgra_to_rgba(rgba, width, height, output);
+    if (!check(output, num_pixels, 4, [&](int i, int c) {
+            return rgba[i * 4 + (c == 3 ? 3 : 2 - c)]; })) {
+        return false;
+    }
+    rgba_to_bgra(rgba, width, height, output);
+    if (!check(output, num_pixels, 4, [&](int i, int c) {
+            return rgba[i * 4 + (c == 3 ? 3 : 2 - c)]; })) {
+        return false;
+    }
+    extract_alpha(rgba, width, height, output);
+    return check(output, num_pixels, 1, [&](int i, int) { return rgba[i * 4 + 3]; });
+}
+
+// Not a pass/fail test: each swizzle against a memcpy of its output size
+void benchmark() {
+    std::cout << "Benchmarking on 4096x4096..." << std::endl;
+    const int width = 4096;
+    const int height = 4096;
+    const std::vector<unsigned char> rgba = noise(width, height, 4);
+    const std::vector<unsigned char> rgb = noise(width, height, 3);
+    std::vector<unsigned char> output(rgba.size());
+
+    std::cout << "  memcpy rgba " << time_ms([&] { std::memcpy(output.data(), rgba.data(), rgba.size()); }, 3)
+              << " ms" << std::endl;
+    std::cout << "  rgba_to_rgb " << time_ms([&] { rgba_to_rgb(rgba, width, height, output); }, 3)
+              << " ms" << std::endl;
+    std::cout << "  rgb_to_rgba " << time_ms([&] { rgb_to_rgba(rgb, width, height, 255, output); }, 3)
+              << " ms" << std::endl;
+    std::cout << "  bgra_to_rgba " << time_ms([&] { bgra_to_rgba(rgba, width, height, output); }, 3)
+              << " ms" << std::endl;
+    std::cout << "  extract_alpha " << time_ms([&] { extract_alpha(rgba, width, height, output); }, 3)
+              << " ms" << std::endl;
+}
+
+int main() {
+    std::cout << "=== Test: channel swizzles ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    // Single pixels, partial blocks, and a frame large enough to be split
+    // across threads
+    const int sizes[][2] = {{1, 1}, {15, 1}, {16, 1}, {17, 3}, {61, 7}, {1000, 1001}};
+    for (const auto & size : sizes) {
+        total_tests++;
+        if (test_size(size[0], size[1])) {
+            std::cout << "PASS: " << size[0] << "x" << size[1] << std::endl;
+            passed_tests++;
+        }
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}
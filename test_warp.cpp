@@ -0,0 +1,215 @@
+#include "warp.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Warps that land exactly on pixel centers (identity, whole-pixel shifts)
+// must copy pixels exactly, and scalings and shears must match a
+// double-precision reference.
+
+// Pseudo-random width*height*num_channels image
+std::vector<unsigned char> noise(const int width, const int height, const int num_channels) {
+    std::vector<unsigned char> image(width * height * num_channels);
+    unsigned int state = 7;
+    for (auto & value : image) {
+        state = state * 1664525u + 1013904223u;
+        value = state >> 24;
+    }
+    return image;
+}
+
+double cubic(const double d) {
+    const double t = std::abs(d);
+    return t < 1 ? 1.5 * t * t * t - 2.5 * t * t + 1 : (t < 2 ? -0.5 * t * t * t + 2.5 * t * t - 4 * t + 2 : 0);
+}
+
+bool test_shift(const int num_channels, const Interpolation interpolation) {
+    std::cout << "Testing whole-pixel shifts of " << num_channels << " channels..." << std::endl;
+    const int width = 53;
+    const int height = 21;
+    const std::vector<unsigned char> input = noise(width, height, num_channels);
+    for (const int dx : {0, 3, -40}) {
+        for (const int dy : {0, -2, 5}) {
+            std::vector<unsigned char> warped;
+            affine_warp(input, width, height, num_channels, {1, 0, (double)dx, 0, 1, (double)dy},
+                interpolation, width, height, warped);
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    const int sx = x - dx;
+                    const int sy = y - dy;
+                    const bool inside = sx >= 0 && sx < width && sy >= 0 && sy < height;
+                    for (int c = 0; c < num_channels; c++) {
+                        const int expected = inside ? input[(sy * width + sx) * num_channels + c] : 0;
+                        if (warped[(y * width + x) * num_channels + c] != expected) {
+                            std::cerr << "FAIL: shift by (" << dx << "," << dy << ") differs at ("
+                                      << x << "," << y << ")" << std::endl;
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool test_warp(
+    const int width,
+    const int height,
+    const int num_channels,
+    const AffineMatrix & matrix,
+    const Interpolation interpolation,
+    const int warped_width,
+    const int warped_height) {
+    const std::vector<unsigned char> input = noise(width, height, num_channels);
+    std::vector<unsigned char> warped;
+    affine_warp(input, width, height, num_channels, matrix, interpolation, warped_width, warped_height, warped);
+    if (warped.size() != (size_t)warped_width * warped_height * num_channels) {
+        std::cerr << "FAIL: output has " << warped.size() << " bytes" << std::endl;
+        return false;
+    }
+    const double determinant = matrix[0] * matrix[4] - matrix[1] * matrix[3];
+    const int radius = interpolation == Interpolation::bilinear ? 1 : 2;
+    for (int y = 0; y < warped_height; y++) {
+        for (int x = 0; x < warped_width; x++) {
+            // Invert the map at the pixel center, back to source pixel indices
+            const double u = x + 0.5 - matrix[2];
+            const double v = y + 0.5 - matrix[5];
+            const double sx = (matrix[4] * u - matrix[1] * v) / determinant - 0.5;
+            const double sy = (-matrix[3] * u + matrix[0] * v) / determinant - 0.5;
+            // Skip centers too close to the edge of the input to call
+            const double edge = std::min(
+                std::min(std::abs(sx + 0.5), std::abs(sx - width + 0.5)),
+                std::min(std::abs(sy + 0.5), std::abs(sy - height + 0.5)));
+            if (edge < 1e-3) {
+                continue;
+            }
+            const bool inside = sx >= -0.5 && sx < width - 0.5 && sy >= -0.5 && sy < height - 0.5;
+            for (int c = 0; c < num_channels; c++) {
+                double expected = 0;
+                if (inside) {
+                    for (int j = (int)std::floor(sy) - radius + 1; j <= (int)std::floor(sy) + radius; j++) {
+                        for (int i = (int)std::floor(sx) - radius + 1; i <= (int)std::floor(sx) + radius; i++) {
+                            const double weight = interpolation == Interpolation::bilinear
+                                ? (1 - std::abs(sx - i)) * (1 - std::abs(sy - j))
+                                : cubic(sx - i) * cubic(sy - j);
+                            const int xi = std::clamp(i, 0, width - 1);
+                            const int yj = std::clamp(j, 0, height - 1);
+                            expected += weight * input[(yj * width + xi) * num_channels + c];
+                        }
+                    }
+                    expected = std::clamp(expected, 0.0, 255.0);
+                }
+                const int actual = warped[(y * warped_width + x) * num_channels + c];
+                if (std::abs(actual - expected) > 3.0) {
+                    std::cerr << "FAIL: pixel (" << x << "," << y << ") is " << actual
+                              << ", expected " << expected << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool test_warps() {
+    std::cout << "Testing scalings and shears..." << std::endl;
+    const AffineMatrix shear = {1, 0.3, -4, -0.2, 0.9, 6};
+    const AffineMatrix matrices[] = {
+        scaling(30.5, 18.5, 1.7),
+        scaling(30.5, 18.5, 0.45),
+        scaling(0, 0, -1.0),
+        compose(shear, scaling(20, 10, 1.3)),
+    };
+    for (const auto interpolation : {Interpolation::bilinear, Interpolation::bicubic}) {
+        for (const int num_channels : {1, 2, 3, 4}) {
+            for (const auto & matrix : matrices) {
+                if (!test_warp(61, 37, num_channels, matrix, interpolation, 67, 41)) {
+                    std::cerr << "  with " << num_channels << " channels" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return test_warp(1, 1, 3, scaling(0.5, 0.5, 3), Interpolation::bicubic, 3, 3) &&
+           test_warp(700, 500, 3, compose(shear, scaling(350, 250, 1.05)), Interpolation::bilinear, 700, 500);
+}
+
+bool test_contractions() {
+    std::cout << "Testing strong contractions..." << std::endl;
+    // The whole input shrinks to a speck: rows land up to 1e12 pixels
+    // away from it and step by as much. About a pixel center, exactly that
+    // one output pixel still shows its input pixel.
+    const AffineMatrix shear = {1, 0.3, -4, -0.2, 0.9, 6};
+    return test_warp(64, 64, 3, scaling(32, 32, 1e-7), Interpolation::bilinear, 4000, 4000) &&
+           test_warp(64, 64, 4, scaling(31.5, 31.5, 1e-7), Interpolation::bicubic, 64, 64) &&
+           test_warp(64, 64, 1, scaling(31.5, 31.5, 1e-12), Interpolation::bilinear, 64, 64) &&
+           test_warp(61, 37, 3, compose(scaling(20, 10, 1e-9), shear), Interpolation::bicubic, 300, 300);
+}
+
+bool test_compose() {
+    std::cout << "Testing compose..." << std::endl;
+    // Scaling by 2 about (1,1), then by 3 about (1,1), is scaling by 6 about
+    // (1,1); a translation after a scaling moves only the offset
+    const AffineMatrix six = compose(scaling(1, 1, 2), scaling(1, 1, 3));
+    const AffineMatrix moved = compose(scaling(0, 0, 2), {1, 0, 5, 0, 1, -7});
+    return six == scaling(1, 1, 6) && moved == AffineMatrix{2, 0, 5, 0, 2, -7};
+}
+
+// Not a pass/fail test: a pulsing zoom of a large frame
+void benchmark() {
+    const int width = 4096;
+    const int height = 4096;
+    const std::vector<unsigned char> input = noise(width, height, 4);
+    std::vector<unsigned char> warped;
+    for (const auto interpolation : {Interpolation::bilinear, Interpolation::bicubic}) {
+        const double ms = time_ms([&] {
+            affine_warp(input, width, height, 4, scaling(width / 2.0, height / 2.0, 1.1), interpolation,
+                width, height, warped);
+        });
+        std::cout << "4096x4096 rgba scaled by 1.1 ("
+                  << (interpolation == Interpolation::bilinear ? "bilinear" : "bicubic") << "): "
+                  << ms << " ms" << std::endl;
+    }
+}
+
+int main() {
+    std::cout << "=== Test: affine warp ===" << std::endl;
+
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    for (const int num_channels : {1, 2, 3, 4}) {
+        for (const auto interpolation : {Interpolation::bilinear, Interpolation::bicubic}) {
+            total_tests++;
+            if (test_shift(num_channels, interpolation)) {
+                std::cout << "PASS: shifts of " << num_channels << " channels" << std::endl;
+                passed_tests++;
+            }
+        }
+    }
+    total_tests++;
+    if (test_warps()) {
+        std::cout << "PASS: scalings and shears" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_contractions()) {
+        std::cout << "PASS: strong contractions" << std::endl;
+        passed_tests++;
+    }
+    total_tests++;
+    if (test_compose()) {
+        std::cout << "PASS: compose" << std::endl;
+        passed_tests++;
+    }
+
+    benchmark();
+
+    std::cout << "\n=== Test Summary ===" << std::endl;
+    std::cout << "Passed: " << passed_tests << "/" << total_tests << std::endl;
+    return passed_tests == total_tests ? 0 : 1;
+}